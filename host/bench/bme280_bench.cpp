@@ -0,0 +1,202 @@
+/*
+ *  Title: bme280_bench.cpp
+ *  Description: Conformance and throughput of the batch BME280 compensation. Every instruction
+ *               set the CPU has is checked bit for bit against the firmware's scalar routine over
+ *               random coefficient sets, including ones far outside what real sensors carry, with
+ *               raw values over the whole ADC range and its edges. Then samples per second for
+ *               each instruction set on one realistic sensor. Last the firmware's 32 bit fast path:
+ *               its pressure error against the reference over the sensor's operating range, checked
+ *               against the documented bound, and its cost next to the reference routines
+ *
+ *               bme280_bench [SAMPLES] [COEFFICIENT_SETS]
+ *  Author: Tinna Osk Traustadottir
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <chrono>
+#include <random>
+#include <vector>
+#include <Bme280Batch.h>
+
+// Trimming parameters of a sensor on the bench, close to the datasheet's example
+const BME280_COEFFS TYPICAL = {27504, 36477, 26435, -1000, -10685, 3024, 2855, 140, -7, 15500, -14600, 6000, 362, 313, 50, 75, 0, 30};
+
+/// @brief Columns with room for a batch
+struct BenchColumns {
+    std::vector<int32_t> raw_t, raw_p, raw_h;
+    std::vector<float> t, p, h;
+    BenchColumns(size_t n) : raw_t(n), raw_p(n), raw_h(n), t(n), p(n), h(n) {};
+    Bme280_COLUMNS columns(void) {
+        return {raw_t.data(), raw_p.data(), raw_h.data(), t.data(), p.data(), h.data()};
+    }
+};
+
+/// @brief A sensor's coefficients, spread around the typical ones, or anything at all when wild
+static BME280_COEFFS randomCoeffs(std::mt19937& random, bool wild) {
+    uint8_t bytes[BME280_CALIB_BYTES];
+    for(uint8_t& b : bytes) b = random();
+    BME280_COEFFS c;
+    bme280Coefficients(bytes, &c);
+    if(wild) return c;
+    auto around = [&](int value, int spread) { return value + (int)(random() % (2 * spread + 1)) - spread; };
+    c.dig_T1 = around(TYPICAL.dig_T1, 2000);
+    c.dig_T2 = around(TYPICAL.dig_T2, 2000);
+    c.dig_T3 = around(TYPICAL.dig_T3, 1000);
+    c.dig_P1 = around(TYPICAL.dig_P1, 3000);
+    c.dig_P2 = around(TYPICAL.dig_P2, 1000);
+    c.dig_P3 = around(TYPICAL.dig_P3, 500);
+    c.dig_P4 = around(TYPICAL.dig_P4, 3000);
+    c.dig_P5 = around(TYPICAL.dig_P5, 200);
+    c.dig_P6 = around(TYPICAL.dig_P6, 10);
+    c.dig_P7 = around(TYPICAL.dig_P7, 2000);
+    c.dig_P8 = around(TYPICAL.dig_P8, 2000);
+    c.dig_P9 = around(TYPICAL.dig_P9, 2000);
+    c.dig_H1 = random() % 100;
+    c.dig_H2 = around(TYPICAL.dig_H2, 60);
+    c.dig_H3 = random() % 10;
+    c.dig_H4 = around(TYPICAL.dig_H4, 60);
+    c.dig_H5 = around(TYPICAL.dig_H5, 20);
+    c.dig_H6 = around(TYPICAL.dig_H6, 10);
+    return c;
+}
+
+/// @brief Raw values over the whole ADC range, every 16th row at an edge of it
+static void randomRaw(std::mt19937& random, BenchColumns& b) {
+    const int32_t edges_20[] = {0, 1, 0x7FFFF, 0x80000, 0xFFFFE, 0xFFFFF};
+    const int32_t edges_16[] = {0, 1, 0x7FFF, 0x8000, 0xFFFE, 0xFFFF};
+    for(size_t i = 0; i < b.raw_t.size(); i++) {
+        bool edge = i % 16 == 0;
+        b.raw_t[i] = edge ? edges_20[random() % 6] : random() & 0xFFFFF;
+        b.raw_p[i] = edge ? edges_20[random() % 6] : random() & 0xFFFFF;
+        b.raw_h[i] = edge ? edges_16[random() % 6] : random() & 0xFFFF;
+    }
+}
+
+/// @brief Raw values of an indoor sensor: 15-30 °C, 950-1050 hPa, 20-80 %RH
+static void realisticRaw(std::mt19937& random, BenchColumns& b) {
+    for(size_t i = 0; i < b.raw_t.size(); i++) {
+        b.raw_t[i] = 500000 + random() % 60000;
+        b.raw_p[i] = 300000 + random() % 60000;
+        b.raw_h[i] = 20000 + random() % 30000;
+    }
+}
+
+static bool sameBits(float a, float b) {
+    return memcmp(&a, &b, sizeof(a)) == 0;
+}
+
+int main(int argc, char** argv) {
+    size_t samples = argc > 1 ? atol(argv[1]) : 4000000;
+    unsigned sets = argc > 2 ? atoi(argv[2]) : 400;
+    std::mt19937 random(1);
+
+    std::vector<BME280_ISA> isas;
+    for(uint8_t isa = 0; isa <= (uint8_t)Bme280Batch::bestIsa(); isa++) isas.push_back((BME280_ISA)isa);
+    printf("Instruction sets: ");
+    for(BME280_ISA isa : isas) printf("%s ", Bme280Batch::isaName(isa));
+    printf("\n");
+
+    // Conformance, half the sets realistic, half wild. Odd batch lengths and offsets exercise the tails
+    bool ok = true;
+    BenchColumns b(4099);
+    uint64_t checked = 0;
+    for(BME280_ISA isa : isas) {
+        std::mt19937 sequence(7);
+        uint64_t mismatches[3] = {};
+        for(unsigned s = 0; s < sets; s++) {
+            BME280_COEFFS c = randomCoeffs(sequence, s % 2);
+            randomRaw(sequence, b);
+            Bme280Batch batch(c, isa);
+            size_t begin = s % 5;
+            batch.compensate(b.columns(), begin, b.raw_t.size());
+            for(size_t i = begin; i < b.raw_t.size(); i++) {
+                float t, p, h;
+                bme280Compensate(c, {b.raw_t[i], b.raw_p[i], b.raw_h[i]}, &t, &p, &h);
+                mismatches[0] += !sameBits(t, b.t[i]);
+                mismatches[1] += !sameBits(p, b.p[i]);
+                mismatches[2] += !sameBits(h, b.h[i]);
+                if(isa == isas.back()) checked++;
+            }
+        }
+        bool same = mismatches[0] + mismatches[1] + mismatches[2] == 0;
+        ok &= same;
+        printf("  %-7s %s", Bme280Batch::isaName(isa), same ? "bit identical to the firmware\n" : "MISMATCH:");
+        if(!same) printf(" %llu temperature, %llu pressure, %llu humidity\n", (unsigned long long)mismatches[0],
+                         (unsigned long long)mismatches[1], (unsigned long long)mismatches[2]);
+    }
+    printf("%llu rows of %u coefficient sets per instruction set\n", (unsigned long long)checked, sets);
+
+    // Throughput
+    BenchColumns bench(samples);
+    realisticRaw(random, bench);
+    double scalar_rate = 0.0;
+    for(BME280_ISA isa : isas) {
+        Bme280Batch batch(TYPICAL, isa);
+        batch.compensate(bench.columns(), 0, samples);     // Warm up, also faults the outputs in
+        const int repeats = 5;
+        auto start = std::chrono::steady_clock::now();
+        for(int r = 0; r < repeats; r++) batch.compensate(bench.columns(), 0, samples);
+        double s = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() / repeats;
+        double rate = samples / s;
+        if(isa == BME280_ISA::Scalar) scalar_rate = rate;
+        printf("  %-7s %8.1f Msamples/s  %5.1f ns/sample  x%.1f\n", Bme280Batch::isaName(isa), rate / 1e6,
+               1e9 / rate, rate / scalar_rate);
+    }
+
+    // Fast path error, over -40 to 85 °C and 300 to 1100 hPa on realistic sensors
+    std::mt19937 sequence(11);
+    uint64_t rows = 0, mismatches = 0;
+    double max_error = 0.0, square_error = 0.0;
+    for(unsigned s = 0; s < sets; s++) {
+        BME280_COEFFS c = s ? randomCoeffs(sequence, false) : TYPICAL;
+        BME280_FAST_COEFFS f;
+        bme280FastCoefficients(c, &f);
+        for(size_t i = 0; i < 20000; i++) {
+            BME280_RAW raw = {(int32_t)(sequence() & 0xFFFFF), (int32_t)(sequence() & 0xFFFFF), (int32_t)(sequence() & 0xFFFF)};
+            BME280_FIXED reference, fast;
+            bme280CompensateFixed(c, raw, &reference);
+            if(reference.temperature < -4000 || reference.temperature > 8500) continue;
+            if(reference.pressure < 30000u * 256 || reference.pressure > 110000u * 256) continue;
+            bme280CompensateFast(f, raw, &fast);
+            mismatches += reference.temperature != fast.temperature || reference.humidity != fast.humidity;
+            double error = fabs(((double)fast.pressure - (double)reference.pressure) / 256.0);
+            if(error > max_error) max_error = error;
+            square_error += error * error;
+            rows++;
+        }
+    }
+    bool bounded = max_error <= BME280_FAST_PRESSURE_MAX_ERROR_PA && mismatches == 0;
+    ok &= bounded;
+    printf("Fast path over %llu rows: pressure error max %.2f Pa (bound %u Pa), RMS %.2f Pa, %llu temperature or humidity mismatches\n",
+           (unsigned long long)rows, max_error, BME280_FAST_PRESSURE_MAX_ERROR_PA, sqrt(square_error / rows),
+           (unsigned long long)mismatches);
+
+    // Cost per sample. This host multiplies and divides 64 bit in hardware, the M0+ does neither so
+    // the counts that matter are the firmware's boot report (reportBme280Cycles)
+    BME280_FAST_COEFFS fast;
+    bme280FastCoefficients(TYPICAL, &fast);
+    const char* names[3] = {"reference float", "reference fixed", "fast fixed"};
+    for(int routine = 0; routine < 3; routine++) {
+        volatile uint32_t sink = 0;
+        auto start = std::chrono::steady_clock::now();
+        for(size_t i = 0; i < samples; i++) {
+            BME280_RAW raw = {bench.raw_t[i], bench.raw_p[i], bench.raw_h[i]};
+            BME280_FIXED fixed;
+            if(routine == 0) {
+                bme280Compensate(TYPICAL, raw, &bench.t[i], &bench.p[i], &bench.h[i]);
+                continue;
+            }
+            if(routine == 1) bme280CompensateFixed(TYPICAL, raw, &fixed);
+            else bme280CompensateFast(fast, raw, &fixed);
+            sink = sink + fixed.temperature + fixed.pressure + fixed.humidity;
+        }
+        double s = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        printf("  %-16s %5.1f ns/sample\n", names[routine], 1e9 * s / samples);
+    }
+
+    printf("%s\n", ok ? "PASS: every instruction set matches the firmware bit for bit, the fast path is within its bound"
+                      : "FAIL: results differ");
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,221 @@
+/*
+ *  Title: decode_bench.cpp
+ *  Description: Cost per packet of getting sensor values from the bus buffers into the telemetry
+ *               frame and the displays. The old path decodes into locals, then SEN55_VALUES and
+ *               the SCD30 members, copies into the sample, narrows into a packet_t, copies that
+ *               into the queue and widens to double for the displays. The new path decodes words
+ *               straight into the sample slots and writes the packet fields in place in the frame.
+ *               Both paths check the CRC of every word they read
+ *  Author: Tinna Osk Traustadottir
+ */
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <chrono>
+#include <TelemetryFrame.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define HAVE_TSC 1
+#endif
+
+const uint32_t PACKETS = 2000000;
+
+uint8_t crc(const uint8_t* data) {
+    uint8_t crc = 0xFF;
+    for(int i = 0; i < 2; i++) {
+        crc ^= data[i];
+        for(uint8_t bit = 8; bit > 0; --bit) {
+            crc = (crc & 0x80) ? (crc << 1) ^ 0x31u : (crc << 1);
+        }
+    }
+    return crc;
+}
+
+/// @brief Bus buffers as they come off the I2C reads, words with CRC
+uint8_t sen55_bus[24];
+uint8_t scd30_bus[18];
+
+void fillBus(uint32_t i) {
+    uint16_t sen55[8] = {(uint16_t)(100 + i % 50), (uint16_t)(150 + i % 70), 180, 200, 4500, 4400, 1000, 10};
+    for(int w = 0; w < 8; w++) {
+        sen55_bus[3 * w] = sen55[w] >> 8;
+        sen55_bus[3 * w + 1] = sen55[w] & 0xFF;
+        sen55_bus[3 * w + 2] = crc(sen55_bus + 3 * w);
+    }
+    float scd30[3] = {400.0f + (float)(i % 300), 21.5f, 45.0f};
+    for(int f = 0; f < 3; f++) {
+        uint32_t bits;
+        memcpy(&bits, &scd30[f], sizeof(bits));
+        uint16_t words[2] = {(uint16_t)(bits >> 16), (uint16_t)(bits & 0xFFFF)};
+        for(int w = 0; w < 2; w++) {
+            uint8_t* p = scd30_bus + 6 * f + 3 * w;
+            p[0] = words[w] >> 8;
+            p[1] = words[w] & 0xFF;
+            p[2] = crc(p);
+        }
+    }
+}
+
+/// @brief Where the results end up, so neither path can be optimised away
+struct Sink {
+    uint8_t queue[TELEMETRY_MAX_FRAME];
+    double display[5];
+    uint32_t checksum = 0;
+
+    void consume(void) {
+        checksum += queue[sizeof(TelemetryFrame_HEADER) + 4] + queue[sizeof(TelemetryFrame_HEADER) + 10] + (uint32_t)display[2];
+    }
+};
+
+struct SEN55_VALUES {
+    float pm1, pm2_5, pm4, pm10, RH, temp, NOx, VOC;
+    uint64_t timestamp;
+};
+
+/// @brief The decode chain as it was: every field is copied four times and converted three times
+template<bool Seal>
+__attribute__((noinline)) bool oldPath(Sink& sink, uint64_t timestamp) {
+    for(uint16_t i = 0; i < 24; i += 3) {
+        if(crc(sen55_bus + i) != sen55_bus[i + 2]) return false;
+    }
+    uint16_t _pm1 = 0, _pm2_5 = 0, _pm4 = 0, _pm10 = 0;
+    int16_t _rh = 0, _temp = 0, _voc = 0, _nox = 0;
+    _pm1 = sen55_bus[0] << 8 | sen55_bus[1];
+    _pm2_5 = sen55_bus[3] << 8 | sen55_bus[4];
+    _pm4 = sen55_bus[6] << 8 | sen55_bus[7];
+    _pm10 = sen55_bus[9] << 8 | sen55_bus[10];
+    _rh = sen55_bus[12] << 8 | sen55_bus[13];
+    _temp = sen55_bus[15] << 8 | sen55_bus[16];
+    _voc = sen55_bus[18] << 8 | sen55_bus[19];
+    _nox = sen55_bus[21] << 8 | sen55_bus[22];
+    SEN55_VALUES values;
+    values.pm1 = _pm1/10.0f;
+    values.pm2_5 = _pm2_5/10.0f;
+    values.pm4 = _pm4/10.0f;
+    values.pm10 = _pm10/10.0f;
+    values.RH = _rh/100.0f;
+    values.temp = _temp/200.0f;
+    values.VOC = _voc/10.0f;
+    values.NOx = _nox/10.0f;
+    values.timestamp = timestamp;
+    float pm_sample[4] = {values.pm1, values.pm2_5, values.pm4, values.pm10};
+
+    for(uint8_t i = 0; i < 18; i += 3) {
+        if(crc(scd30_bus + i) != scd30_bus[i + 2]) return false;
+    }
+    uint32_t _co2 = (uint32_t)scd30_bus[0] << 24 | (uint32_t)scd30_bus[1] << 16 | scd30_bus[3] << 8 | scd30_bus[4];
+    uint32_t _t = (uint32_t)scd30_bus[6] << 24 | (uint32_t)scd30_bus[7] << 16 | scd30_bus[9] << 8 | scd30_bus[10];
+    uint32_t _hum = (uint32_t)scd30_bus[12] << 24 | (uint32_t)scd30_bus[13] << 16 | scd30_bus[15] << 8 | scd30_bus[16];
+    float co2, temp, hum;
+    memcpy(&co2, &_co2, sizeof(co2));
+    memcpy(&temp, &_t, sizeof(temp));
+    memcpy(&hum, &_hum, sizeof(hum));
+    float co2_sample[3] = {co2, temp, hum};
+
+    packet_t packet;
+    packet.temperature = co2_sample[1];
+    packet.humidity = co2_sample[2];
+    packet.no2 = 0.02f;
+    packet.co2 = co2_sample[0];
+    packet.pm10 = pm_sample[3];
+    packet.pm4 = pm_sample[2];
+    packet.pm2_5 = pm_sample[1];
+    packet.pm1 = pm_sample[0];
+    if(Seal) {
+        telemetryEncode(sink.queue, TELEMETRY_SAMPLE, 0, 0, timestamp, packet.raw, sizeof(packet.raw));
+    } else {
+        telemetryBegin(sink.queue, TELEMETRY_SAMPLE, 0, 0, timestamp, sizeof(packet.raw));
+        memcpy(sink.queue + sizeof(TelemetryFrame_HEADER), packet.raw, sizeof(packet.raw));
+    }
+
+    sink.display[0] = (double)packet.temperature;
+    sink.display[1] = (double)packet.no2;
+    sink.display[2] = packet.co2;
+    sink.display[3] = packet.pm10;
+    sink.display[4] = packet.pm1;
+    return true;
+}
+
+/// @brief Decode into the destination: bus words straight into the sample slots, which are
+///        written in place into the frame. Only the four PM words are read from the SEN55
+template<bool Seal>
+__attribute__((noinline)) bool newPath(Sink& sink, uint64_t timestamp) {
+    static const float scale[4] = {0.1f, 0.1f, 0.1f, 0.1f};
+    float pm_sample[4];
+    for(uint8_t i = 0; i < 4; i++) {
+        if(crc(sen55_bus + 3 * i) != sen55_bus[3 * i + 2]) return false;
+        pm_sample[i] = (float)(uint16_t)(sen55_bus[3 * i] << 8 | sen55_bus[3 * i + 1]) * scale[i];
+    }
+
+    float co2_sample[3];
+    uint16_t words[6];
+    for(uint8_t i = 0; i < 6; i++) {
+        if(crc(scd30_bus + 3 * i) != scd30_bus[3 * i + 2]) return false;
+        words[i] = (uint16_t)(scd30_bus[3 * i] << 8 | scd30_bus[3 * i + 1]);
+    }
+    for(uint8_t i = 0; i < 3; i++) {
+        uint32_t bits = (uint32_t)words[2 * i] << 16 | words[2 * i + 1];
+        memcpy(&co2_sample[i], &bits, sizeof(float));
+    }
+
+    telemetryBegin(sink.queue, TELEMETRY_SAMPLE, 0, 0, timestamp, sizeof(packet_t));
+    uint8_t* payload = sink.queue + sizeof(TelemetryFrame_HEADER);
+    packetPutFloat(payload, offsetof(packet_t, temperature), co2_sample[1]);
+    packetPutFloat(payload, offsetof(packet_t, no2), 0.02f);
+    packetPutU16(payload, offsetof(packet_t, humidity), co2_sample[2]);
+    packetPutU16(payload, offsetof(packet_t, co2), co2_sample[0]);
+    packetPutU16(payload, offsetof(packet_t, pm10), pm_sample[3]);
+    packetPutU16(payload, offsetof(packet_t, pm4), pm_sample[2]);
+    packetPutU16(payload, offsetof(packet_t, pm2_5), pm_sample[1]);
+    packetPutU16(payload, offsetof(packet_t, pm1), pm_sample[0]);
+    if(Seal) telemetryEnd(sink.queue, sizeof(packet_t));
+
+    sink.display[0] = co2_sample[1];
+    sink.display[1] = 0.02f;
+    sink.display[2] = co2_sample[0];
+    sink.display[3] = pm_sample[3];
+    sink.display[4] = pm_sample[0];
+    return true;
+}
+
+/// @brief Time one path, the bus buffers are refilled outside the timed region every 64 packets
+template<typename Run>
+double bench(const char* name, Run run) {
+    Sink sink;
+    double ns = 0.0, cycles = 0.0;
+    for(uint32_t i = 0; i < PACKETS; i += 64) {
+        fillBus(i);
+#ifdef HAVE_TSC
+        uint64_t c0 = __rdtsc();
+#endif
+        auto start = std::chrono::steady_clock::now();
+        for(uint32_t j = 0; j < 64; j++) {
+            run(sink, i + j);
+            sink.consume();
+        }
+        auto end = std::chrono::steady_clock::now();
+#ifdef HAVE_TSC
+        cycles += (double)(__rdtsc() - c0);
+#endif
+        ns += std::chrono::duration<double, std::nano>(end - start).count();
+    }
+    ns /= PACKETS;
+    cycles /= PACKETS;
+    printf("%-10s %8.1f ns/packet %8.0f TSC cycles/packet  (checksum %u)\n", name, ns, cycles, sink.checksum);
+    return ns;
+}
+
+int main() {
+    // The frame CRC-16 is the same work on both paths and dominates on the host, so the paths
+    // are timed with and without it
+    printf("Without the frame CRC:\n");
+    double before = bench("old", oldPath<false>);
+    double after = bench("direct", newPath<false>);
+    printf("%-10s %+8.1f %%\n", "difference", 100.0 * (after - before) / before);
+    printf("Complete frame:\n");
+    before = bench("old", oldPath<true>);
+    after = bench("direct", newPath<true>);
+    printf("%-10s %+8.1f %%\n", "difference", 100.0 * (after - before) / before);
+    printf("SEN55 bus read: old 24 bytes, direct 12 bytes\n");
+    return 0;
+}
@@ -0,0 +1,53 @@
+/*
+ *  Title: filter_bench.cpp
+ *  Description: Updates per second of the streaming median and Hampel filters for window sizes 5 to 255
+ *  Author: Tinna Osk Traustadottir
+ */
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <chrono>
+#include <vector>
+#include <OutlierFilter.h>
+
+const size_t SAMPLES = 4000000;
+
+/// @brief Time a filter over the input and return updates per second
+template<typename F, typename Update>
+double run(const std::vector<float>& input, F& filter, Update update) {
+    volatile float sink = 0.0f; // Keeps the loop from being optimized away
+    auto start = std::chrono::steady_clock::now();
+    for(float x : input) sink = update(filter, x);
+    auto end = std::chrono::steady_clock::now();
+    (void)sink;
+    return input.size() / std::chrono::duration<double>(end - start).count();
+}
+
+template<uint8_t W>
+void bench(const std::vector<float>& input) {
+    MedianFilter<W> median;
+    HampelFilter<W> hampel;
+    double median_rate = run(input, median, [](MedianFilter<W>& f, float x) { return f.add(x); });
+    double hampel_rate = run(input, hampel, [](HampelFilter<W>& f, float x) { return f.filter(x); });
+    printf("%6u %16.0f %16.0f %10lu\n", W, median_rate, hampel_rate, (unsigned long)hampel.rejections());
+}
+
+template<uint8_t... Ws>
+void benchAll(const std::vector<float>& input) {
+    (bench<Ws>(input), ...);
+}
+
+int main() {
+    // PM-like signal: slow drift, noise and a spike every few hundred samples
+    std::vector<float> input(SAMPLES);
+    srand(1);
+    for(size_t i = 0; i < SAMPLES; i++) {
+        float noise = (rand() % 1000) / 100.0f;
+        float spike = (rand() % 400 == 0) ? 500.0f : 0.0f;
+        input[i] = 20.0f + 5.0f * (float)((i / 1000) % 10) + noise + spike;
+    }
+
+    printf("%6s %16s %16s %10s\n", "window", "median upd/s", "hampel upd/s", "rejected");
+    benchAll<5, 7, 9, 15, 31, 63, 127, 255>(input);
+    return 0;
+}
@@ -0,0 +1,197 @@
+/*
+ *  Title: history_bench.cpp
+ *  Description: Range queries over a long packet history, from the rollup index against binning
+ *               the raw .aqts rows. Synthetic history at the firmware's 2.5 s output period, values
+ *               are random walks. Each query is one node and one metric, stepped so a plot gets a
+ *               few hundred to a few thousand points, plus the single aggregate over the range
+ *
+ *               history_bench [NODES] [DAYS] [DIRECTORY]
+ *  Author: Tinna Osk Traustadottir
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <sys/stat.h>
+#include <chrono>
+#include <random>
+#include <string>
+#include <vector>
+#include <History.h>
+
+const uint64_t OUTPUT_PERIOD_US = 2500000;
+const uint64_t EPOCH_US = 1759968000000000ull;      // Midnight UTC, rollup buckets line up with it
+const uint64_t MINUTE_US = 60000000ull;
+const uint64_t HOUR_US = 60 * MINUTE_US;
+const uint64_t DAY_US = 24 * HOUR_US;
+
+size_t fileSize(const std::string& path) {
+    struct stat info;
+    return stat(path.c_str(), &info) == 0 ? info.st_size : 0;
+}
+
+/// @brief Time f, repeated until at least 50 ms have passed, and return microseconds per call
+template<typename F>
+double timed(F f) {
+    size_t calls = 0;
+    auto start = std::chrono::steady_clock::now();
+    double us = 0.0;
+    do {
+        f();
+        calls++;
+        us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+    } while(us < 50000.0);
+    return us / calls;
+}
+
+/// @brief The same points as History::series, binned from every raw row in the range
+void rawSeries(const TsReader& reader, uint16_t node, uint8_t metric, uint64_t from, uint64_t to, uint64_t step,
+               std::vector<Rollup_POINT>& out) {
+    out.clear();
+    uint64_t start = from - from % step;
+    for(uint64_t t = start; t <= to; t += step) out.push_back({t, 0, INFINITY, -INFINITY, 0.0});
+    TsQuery query;
+    query.node = node;
+    query.t_from = from;
+    query.t_to = to;
+    static uint64_t timestamps[65536];
+    static float values[65536];
+    reader.forEachBlock(query, [&](const TsBlock& block) {
+        block.timestamps(timestamps);
+        block.column(metric, values);
+        for(uint16_t r = 0; r < block.header().rows; r++) {
+            if(timestamps[r] < from || timestamps[r] > to) continue;
+            Rollup_POINT& point = out[(timestamps[r] - start) / step];
+            point.count++;
+            point.min = fminf(point.min, values[r]);
+            point.max = fmaxf(point.max, values[r]);
+            point.sum += values[r];
+        }
+    });
+}
+
+/// @brief True if both give the same points, sums to float rounding
+bool samePoints(const std::vector<Rollup_POINT>& a, const std::vector<Rollup_POINT>& b) {
+    if(a.size() != b.size()) return false;
+    for(size_t i = 0; i < a.size(); i++) {
+        if(a[i].count != b[i].count) return false;
+        if(a[i].count == 0) continue;
+        if(a[i].min != b[i].min || a[i].max != b[i].max) return false;
+        if(fabs(a[i].sum - b[i].sum) > 1e-9 * fabs(a[i].sum) + 1e-6) return false;
+    }
+    return true;
+}
+
+int main(int argc, char** argv) {
+    unsigned nodes = argc > 1 ? atoi(argv[1]) : 2;
+    unsigned days = argc > 2 ? atoi(argv[2]) : 365;
+    std::string directory = argc > 3 ? argv[3] : "/tmp";
+    std::string ts_path = directory + "/history_bench.aqts";
+    std::string index_path = historyIndexPath(ts_path.c_str());
+    remove(ts_path.c_str());
+    remove(index_path.c_str());
+
+    // Write the history the way TsStore does, raw blocks and rollups side by side
+    std::mt19937 random(1);
+    std::normal_distribution<float> step(0.0f, 1.0f);
+    const float scale[TS_COLUMNS] = {0.02f, 0.0005f, 0.2f, 8.0f, 0.5f, 0.4f, 0.3f, 0.2f};
+    const float low[TS_COLUMNS] = {-10.0f, 0.0f, 5.0f, 400.0f, 0.0f, 0.0f, 0.0f, 0.0f};
+    const float high[TS_COLUMNS] = {40.0f, 0.5f, 95.0f, 2000.0f, 500.0f, 500.0f, 500.0f, 500.0f};
+    std::vector<TsRow> state(nodes);
+    for(unsigned n = 0; n < nodes; n++) {
+        state[n].node = n;
+        float start[TS_COLUMNS] = {21.0f, 0.02f, 45.0f, 600.0f, 12.0f, 10.0f, 8.0f, 5.0f};
+        memcpy(state[n].values, start, sizeof(start));
+    }
+    size_t rows_per_node = (size_t)days * (DAY_US / OUTPUT_PERIOD_US);
+    TsWriter writer;
+    RollupIndex rollups;
+    writer.open(ts_path.c_str());
+    double write_s = 0.0, rollup_s = 0.0;
+    std::vector<TsRow> batch;
+    for(size_t i = 0; i < rows_per_node; i++) {
+        for(unsigned n = 0; n < nodes; n++) {
+            TsRow& row = state[n];
+            row.timestamp = EPOCH_US + i * OUTPUT_PERIOD_US + n * 1000;
+            for(uint8_t c = 0; c < TS_COLUMNS; c++) {
+                float value = row.values[c] + step(random) * scale[c];
+                row.values[c] = value < low[c] ? low[c] : value > high[c] ? high[c] : value;
+            }
+            TsRow out = row;
+            for(uint8_t c = TS_HUMIDITY; c < TS_COLUMNS; c++) out.values[c] = (float)(int)(row.values[c] + 0.5f);
+            batch.push_back(out);
+        }
+        if(batch.size() >= 65536 || i + 1 == rows_per_node) {
+            auto t0 = std::chrono::steady_clock::now();
+            for(const TsRow& row : batch) writer.append(row);
+            auto t1 = std::chrono::steady_clock::now();
+            for(const TsRow& row : batch) rollups.add(row.node, row.timestamp, row.values);
+            auto t2 = std::chrono::steady_clock::now();
+            write_s += std::chrono::duration<double>(t1 - t0).count();
+            rollup_s += std::chrono::duration<double>(t2 - t1).count();
+            batch.clear();
+        }
+    }
+    writer.close();
+    rollups.save(index_path.c_str(), fileSize(ts_path));
+    size_t total = rows_per_node * nodes;
+
+    printf("%zu rows, %u nodes, %u days\n", total, nodes, days);
+    printf("  aqts    %8.1f MB   appended at %5.1f Mrows/s\n", fileSize(ts_path) / 1e6, total / write_s / 1e6);
+    printf("  rollups %8.1f MB   updated at  %5.1f Mrows/s, %zu buckets\n", fileSize(index_path) / 1e6,
+           total / rollup_s / 1e6, rollups.buckets());
+
+    History history;
+    auto open_start = std::chrono::steady_clock::now();
+    if(!history.open(ts_path.c_str())) {
+        fprintf(stderr, "Can't open %s\n", ts_path.c_str());
+        return 1;
+    }
+    double open_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - open_start).count();
+    remove(index_path.c_str());
+    History rebuilt;
+    auto rebuild_start = std::chrono::steady_clock::now();
+    rebuilt.open(ts_path.c_str());
+    double rebuild_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - rebuild_start).count();
+    printf("  index loaded in %.1f ms, rebuilt from the raw blocks in %.1f ms\n", open_ms, rebuild_ms);
+    rebuilt.close();
+
+    TsReader reader;
+    reader.open(ts_path.c_str());
+
+    struct {
+        const char* name;
+        uint64_t range;
+        uint64_t step;
+    } queries[] = {
+        {"1 hour @ 10 s", HOUR_US, 10000000ull},
+        {"1 day @ 1 min", DAY_US, MINUTE_US},
+        {"1 week @ 10 min", 7 * DAY_US, 10 * MINUTE_US},
+        {"30 days @ 1 h", 30 * DAY_US, HOUR_US},
+        {"365 days @ 1 day", 365 * DAY_US, DAY_US},
+    };
+    const char* level_names[ROLLUP_LEVELS + 1] = {"raw", "minute", "hour", "day"};
+    uint16_t node = nodes - 1;
+    uint64_t end = EPOCH_US + rows_per_node * OUTPUT_PERIOD_US;
+
+    printf("CO2 of node %u, ending at the newest row:\n", node);
+    printf("  %-18s %6s %7s %12s %12s %12s\n", "range", "points", "level", "history us", "raw scan us", "aggregate us");
+    bool ok = true;
+    for(auto& q : queries) {
+        uint64_t range = q.range < end - EPOCH_US ? q.range : end - EPOCH_US;
+        uint64_t to = end - 1, from = end - range;
+        std::vector<Rollup_POINT> points, raw;
+        ROLLUP_LEVEL level = history.series(node, TS_CO2, from, to, q.step, points);
+        rawSeries(reader, node, TS_CO2, from, to, q.step, raw);
+        ok &= samePoints(points, raw);
+
+        double history_us = timed([&]() { history.series(node, TS_CO2, from, to, q.step, points); });
+        double raw_us = timed([&]() { rawSeries(reader, node, TS_CO2, from, to, q.step, raw); });
+        Rollup_POINT aggregate;
+        double aggregate_us = timed([&]() { history.aggregate(node, TS_CO2, from, to, &aggregate); });
+        printf("  %-18s %6zu %7s %12.1f %12.1f %12.2f\n", q.name, points.size(), level_names[(uint8_t)level],
+               history_us, raw_us, aggregate_us);
+    }
+    printf("Rollup points %s the raw scan\n", ok ? "match" : "DIFFER FROM");
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,118 @@
+/*
+ *  Title: ingest_bench.cpp
+ *  Description: Sustained ingest rate of the ingestion server from synthetic nodes. Every node is
+ *               a thread writing pre-encoded TELEMETRY_SAMPLE frames into a Unix socketpair as fast
+ *               as the server takes them, so the figure is the server's ceiling on this machine
+ *
+ *               ingest_bench [NODES] [SECONDS] [WORKERS] [STORE_FILE]
+ *               Without STORE_FILE the samples go to a NullStore, a .aqts STORE_FILE is written
+ *               columnar like ingestd does, anything else as a raw sample log
+ *  Author: Tinna Osk Traustadottir
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include <IngestServer.h>
+#include <TsStore.h>
+#include <TelemetryFrame.h>
+
+const double TARGET_RATE = 1e6;             // Samples per second the server has to sustain
+const uint32_t FRAMES_PER_NODE = 65536;     // One full turn of the sequence number, so the buffer repeats seamlessly
+const size_t WRITE_CHUNK = 64 * 1024;
+
+/// @brief The byte stream one node sends, built once
+std::vector<uint8_t> buildStream(uint16_t node) {
+    std::vector<uint8_t> stream;
+    uint8_t frame[TELEMETRY_MAX_FRAME];
+    for(uint32_t i = 0; i < FRAMES_PER_NODE; i++) {
+        packet_t packet;
+        packet.temperature = 20.0f + (float)(i % 100) / 10.0f;
+        packet.no2 = 0.01f * (float)(i % 7);
+        packet.humidity = 40 + i % 20;
+        packet.co2 = 400 + i % 600;
+        packet.pm10 = 10 + i % 30;
+        packet.pm4 = 8 + i % 25;
+        packet.pm2_5 = 5 + i % 20;
+        packet.pm1 = 3 + i % 10;
+        size_t n = telemetryEncode(frame, TELEMETRY_SAMPLE, (uint16_t)i, node, (uint64_t)i * 1000000ull,
+                                   packet.raw, sizeof(packet.raw));
+        stream.insert(stream.end(), frame, frame + n);
+    }
+    return stream;
+}
+
+int main(int argc, char** argv) {
+    unsigned nodes = argc > 1 ? atoi(argv[1]) : 16;
+    unsigned seconds = argc > 2 ? atoi(argv[2]) : 5;
+    IngestServer_OPTIONS options;
+    if(argc > 3) options.workers = atoi(argv[3]);
+    const char* store_path = argc > 4 ? argv[4] : nullptr;
+
+    NullStore null_store;
+    LogStore log_store;
+    TsStore ts_store;
+    SampleStore* store = &null_store;
+    if(store_path != nullptr) {
+        size_t length = strlen(store_path);
+        bool columnar = length >= 5 && strcmp(store_path + length - 5, ".aqts") == 0;
+        unlink(store_path);
+        if(columnar ? !ts_store.open(store_path) : !log_store.open(store_path)) {
+            fprintf(stderr, "Can't open %s\n", store_path);
+            return 1;
+        }
+        store = columnar ? (SampleStore*)&ts_store : &log_store;
+    }
+
+    IngestServer server(*store, options);
+    std::atomic<bool> running{true};
+    std::vector<std::thread> producers;
+    std::vector<std::vector<uint8_t>> streams;
+    for(unsigned i = 0; i < nodes; i++) streams.push_back(buildStream(i));
+
+    server.start();
+    for(unsigned i = 0; i < nodes; i++) {
+        int pair[2];
+        if(socketpair(AF_UNIX, SOCK_STREAM, 0, pair) != 0) return 1;
+        server.addFd(pair[0], "synthetic");
+        producers.emplace_back([&running, &stream = streams[i], fd = pair[1]]() {
+            size_t offset = 0;
+            while(running.load(std::memory_order_relaxed)) {
+                size_t chunk = stream.size() - offset < WRITE_CHUNK ? stream.size() - offset : WRITE_CHUNK;
+                ssize_t n = write(fd, stream.data() + offset, chunk);
+                if(n <= 0) break;
+                offset = (offset + n) % stream.size();
+            }
+            close(fd);
+        });
+    }
+
+    // One second of warm up, then measure
+    std::this_thread::sleep_for(std::chrono::seconds(1));
+    IngestServer_STATS start = server.stats();
+    auto t0 = std::chrono::steady_clock::now();
+    std::this_thread::sleep_for(std::chrono::seconds(seconds));
+    IngestServer_STATS end = server.stats();
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+
+    running = false;
+    for(auto& producer : producers) producer.join();
+    server.stop();
+    IngestServer_STATS total = server.stats();
+
+    double rate = (double)(end.samples - start.samples) / elapsed;
+    double written = (double)(end.written - start.written) / elapsed;
+    printf("%u nodes, %u workers, %s store\n", nodes, options.workers, store_path ? store_path : "null");
+    printf("Decoded %12.0f samples/s  %8.1f MB/s in\n", rate, (double)(end.bytes - start.bytes) / elapsed / 1e6);
+    printf("Written %12.0f samples/s  in %llu batches\n", written, (unsigned long long)total.batches);
+    printf("Lost %llu, reordered %llu, CRC errors %llu, skipped %llu bytes, stalls %llu\n",
+           (unsigned long long)total.lost, (unsigned long long)total.reordered, (unsigned long long)total.crc_errors,
+           (unsigned long long)total.skipped, (unsigned long long)total.stalls);
+    printf("%s: target %.0f samples/s\n", rate >= TARGET_RATE ? "PASS" : "FAIL", TARGET_RATE);
+    return rate >= TARGET_RATE ? 0 : 1;
+}
@@ -0,0 +1,143 @@
+/*
+ *  Title: list_bench.cpp
+ *  Description: PoolList against the malloc based linked list from pointer.cpp, used as a queue of
+ *               pending samples (push at the back, pop at the front) and as a deque worked at the
+ *               back. The original removeFromBack freed the node before the last and kept the last
+ *               one linked, here it frees the right node so the benchmark can run
+ *  Author: Tinna Osk Traustadottir
+ */
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <chrono>
+#include <PoolList.h>
+
+const uint32_t OPERATIONS = 2000000;
+
+/// @brief pointer.cpp's list
+namespace original {
+    struct LinkedList {
+        int data;
+        struct LinkedList* next;
+    };
+
+    LinkedList* first = NULL;
+
+    void addFront(int data) {
+        LinkedList* temp = (LinkedList*)malloc(sizeof(LinkedList));
+        temp->data = data;
+        temp->next = first;
+        first = temp;
+    }
+
+    void addBack(int data) {
+        LinkedList* temp = (LinkedList*)malloc(sizeof(LinkedList));
+        temp->data = data;
+        temp->next = NULL;
+        if(first == NULL) {
+            first = temp;
+        } else {
+            LinkedList* lk = first;
+            while(lk->next != NULL) lk = lk->next;
+            lk->next = temp;
+        }
+    }
+
+    int removeFromFront() {
+        LinkedList* temp = first;
+        int data = temp->data;
+        first = first->next;
+        free(temp);
+        return data;
+    }
+
+    int removeFromBack() {
+        if(first->next == NULL) {
+            int data = first->data;
+            free(first);
+            first = NULL;
+            return data;
+        }
+        LinkedList* lk = first;
+        while(lk->next->next != NULL) lk = lk->next;
+        int data = lk->next->data;
+        free(lk->next);
+        lk->next = NULL;
+        return data;
+    }
+}
+
+/// @brief Print ns per operation of one run
+void report(const char* name, uint16_t depth, std::chrono::steady_clock::time_point start, long checksum) {
+    double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / OPERATIONS;
+    printf("%-22s depth %4u %10.1f ns/op  (checksum %ld)\n", name, depth, ns, checksum);
+}
+
+/// @brief Time the original list and PoolList at one depth
+/// @return False if a PoolList pop found the list empty
+template<uint16_t Depth>
+bool benchDepth(void) {
+    static PoolList<int, Depth + 1> pool;
+    long checksum;
+
+    // Queue: keep Depth samples pending, push one at the back and take the oldest from the front
+    for(uint16_t i = 0; i < Depth; i++) original::addBack(i);
+    checksum = 0;
+    auto start = std::chrono::steady_clock::now();
+    for(uint32_t i = 0; i < OPERATIONS / 2; i++) {
+        original::addBack(i);
+        checksum += original::removeFromFront();
+    }
+    report("original queue", Depth, start, checksum);
+    while(original::first != NULL) original::removeFromFront();
+
+    for(uint16_t i = 0; i < Depth; i++) pool.pushBack(i);
+    checksum = 0;
+    start = std::chrono::steady_clock::now();
+    for(uint32_t i = 0; i < OPERATIONS / 2; i++) {
+        int data = 0;
+        pool.pushBack(i);
+        if(!pool.popFront(&data)) {
+            printf("PoolList queue: pop from an empty list\n");
+            return false;
+        }
+        checksum += data;
+    }
+    report("PoolList queue", Depth, start, checksum);
+    pool.clear();
+
+    // Deque worked at the back, as a stack on top of Depth older elements
+    for(uint16_t i = 0; i < Depth; i++) original::addFront(i);
+    checksum = 0;
+    start = std::chrono::steady_clock::now();
+    for(uint32_t i = 0; i < OPERATIONS / 2; i++) {
+        original::addBack(i);
+        checksum += original::removeFromBack();
+    }
+    report("original back", Depth, start, checksum);
+    while(original::first != NULL) original::removeFromFront();
+
+    for(uint16_t i = 0; i < Depth; i++) pool.pushFront(i);
+    checksum = 0;
+    start = std::chrono::steady_clock::now();
+    for(uint32_t i = 0; i < OPERATIONS / 2; i++) {
+        int data = 0;
+        pool.pushBack(i);
+        if(!pool.popBack(&data)) {
+            printf("PoolList back: pop from an empty list\n");
+            return false;
+        }
+        checksum += data;
+    }
+    report("PoolList back", Depth, start, checksum);
+    pool.clear();
+    return true;
+}
+
+int main() {
+    bool ok = benchDepth<1>() && benchDepth<16>() && benchDepth<256>();
+    printf("Node size: original %zu bytes + heap overhead, PoolList %zu bytes\n",
+        sizeof(original::LinkedList), sizeof(PoolList<int, 1>::Node));
+    if(!ok) printf("FAIL: PoolList lost elements\n");
+    return ok ? 0 : 1;
+}
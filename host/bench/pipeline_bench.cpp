@@ -0,0 +1,166 @@
+/*
+ *  Title: pipeline_bench.cpp
+ *  Description: Cost per tick of the compile-time pipeline against the same three sensor nodes
+ *               written out by hand. Device reads are replaced by a synthetic signal so only
+ *               the dispatch and the stage bodies are measured. Code size of the two paths:
+ *               nm -C --size-sort pipeline_bench | grep -E "runPipeline|runHandWritten"
+ *  Author: Tinna Osk Traustadottir
+ */
+#include <stdio.h>
+#include <stdint.h>
+#include <chrono>
+#include <initializer_list>
+#include <Pipeline.h>
+
+const uint32_t TICKS = 5000000;
+
+/// @brief Stand-ins for the firmware sinks, they only accumulate so the work can't be dropped
+struct MockResampler {
+    float sum = 0.0f;
+    void push(uint8_t channel, uint64_t timestamp, float value) { sum += value + channel + (float)(timestamp & 1); }
+};
+
+struct MockAlerts {
+    uint32_t raised = 0;
+    void evaluate(uint8_t metric, float value, uint64_t) { if(value > 1000.0f + metric) raised++; }
+};
+
+struct MockAdaptive {
+    uint32_t updates = 0;
+    bool due(uint8_t stream, uint32_t tick) { return (tick + stream) % 2 == 0; }
+    void update(uint8_t, float value, uint64_t, uint32_t) { if(value > 0.0f) updates++; }
+    void retry(uint8_t, uint32_t) {}
+};
+
+struct BenchContext {
+    MockResampler& resampler;
+    MockAlerts& alerts;
+    MockAdaptive& adaptive;
+    bool adaptive_sampling;
+};
+
+/// @brief Synthetic sensor value for a tick and channel
+inline float signal(uint32_t tick, uint8_t channel) {
+    return 20.0f + (float)((tick * 7 + channel * 13) % 50);
+}
+
+struct No2Acquire {
+    bool process(Pipeline_SAMPLE<1>& sample, BenchContext&) {
+        sample.timestamp = sample.tick * 1000000ull;
+        sample.raw[0] = (int32_t)(signal(sample.tick, 0) * 1000.0f);
+        return true;
+    }
+};
+
+struct No2Calibrate {
+    bool process(Pipeline_SAMPLE<1>& sample, BenchContext&) {
+        sample.values[0] = sample.values[0] * 7.69042969e-10f + 0.0f;
+        return true;
+    }
+};
+
+struct PmAcquire {
+    bool process(Pipeline_SAMPLE<4>& sample, BenchContext&) {
+        sample.timestamp = sample.tick * 1000000ull;
+        for(uint8_t c = 0; c < 4; c++) sample.values[c] = signal(sample.tick, c);
+        return true;
+    }
+};
+
+struct Co2Acquire {
+    bool process(Pipeline_SAMPLE<3>& sample, BenchContext&) {
+        if(sample.tick % 2 != 0) return false;  // SCD30 not ready every other tick
+        sample.timestamp = sample.tick * 1000000ull;
+        for(uint8_t c = 0; c < 3; c++) sample.values[c] = signal(sample.tick, c) * 20.0f;
+        return true;
+    }
+};
+
+typedef PipelineNode<Pipeline_SAMPLE<1>,
+    AdaptiveGate<2>, No2Acquire, DecodeStage<0>, No2Calibrate, AlertSink<0, 1>, HampelStage<0, 9, 35>,
+    ResamplerSink<1>, AdaptiveSink<0, 2>> No2Node;
+typedef PipelineNode<Pipeline_SAMPLE<4>,
+    AdaptiveGate<1>, PmAcquire, AlertSink<1, 6>,
+    HampelStage<0, 7, 30>, HampelStage<1, 7, 30>, HampelStage<2, 7, 30>, HampelStage<3, 7, 30>,
+    ResamplerSink<7, 6, 5, 4>, AdaptiveSink<1, 1>> PmNode;
+typedef PipelineNode<Pipeline_SAMPLE<3>,
+    AdaptiveGate<0>, Co2Acquire,
+    AlertSink<0, 3>, ResamplerSink<3, 0, 2>, AdaptiveSink<0, 0>> Co2Node;
+
+Pipeline<No2Node, PmNode, Co2Node> pipeline;
+
+/// @brief The same nodes written the way main.cpp did before the pipeline
+struct HandWritten {
+    HampelFilter<9> no2_filter{3.5f};
+    HampelFilter<7> pm_filter[4] = {HampelFilter<7>(3.0f), HampelFilter<7>(3.0f), HampelFilter<7>(3.0f), HampelFilter<7>(3.0f)};
+
+    void run(BenchContext& context, uint32_t tick) {
+        if(!context.adaptive_sampling || context.adaptive.due(2, tick)) {
+            uint64_t timestamp = tick * 1000000ull;
+            int32_t raw = (int32_t)(signal(tick, 0) * 1000.0f);
+            float no2 = (float)raw * 7.69042969e-10f + 0.0f;
+            context.alerts.evaluate(1, no2, timestamp);
+            no2 = no2_filter.filter(no2);
+            context.resampler.push(1, timestamp, no2);
+            if(context.adaptive_sampling) context.adaptive.update(2, no2, timestamp, tick);
+        }
+        if(!context.adaptive_sampling || context.adaptive.due(1, tick)) {
+            uint64_t timestamp = tick * 1000000ull;
+            context.alerts.evaluate(6, signal(tick, 1), timestamp);
+            float pm1 = pm_filter[0].filter(signal(tick, 0));
+            float pm2_5 = pm_filter[1].filter(signal(tick, 1));
+            float pm4 = pm_filter[2].filter(signal(tick, 2));
+            float pm10 = pm_filter[3].filter(signal(tick, 3));
+            context.resampler.push(7, timestamp, pm1);
+            context.resampler.push(6, timestamp, pm2_5);
+            context.resampler.push(5, timestamp, pm4);
+            context.resampler.push(4, timestamp, pm10);
+            if(context.adaptive_sampling) context.adaptive.update(1, pm2_5, timestamp, tick);
+        }
+        if((!context.adaptive_sampling || context.adaptive.due(0, tick)) && tick % 2 == 0) {
+            uint64_t timestamp = tick * 1000000ull;
+            float co2 = signal(tick, 0) * 20.0f;
+            context.alerts.evaluate(3, co2, timestamp);
+            context.resampler.push(3, timestamp, co2);
+            context.resampler.push(0, timestamp, signal(tick, 1) * 20.0f);
+            context.resampler.push(2, timestamp, signal(tick, 2) * 20.0f);
+            if(context.adaptive_sampling) context.adaptive.update(0, co2, timestamp, tick);
+        }
+    }
+} hand_written;
+
+__attribute__((noinline)) void runPipeline(BenchContext& context, uint32_t tick) {
+    pipeline.run(context, tick);
+}
+
+__attribute__((noinline)) void runHandWritten(BenchContext& context, uint32_t tick) {
+    hand_written.run(context, tick);
+}
+
+/// @brief Time one path and return ns per tick
+template<typename Run>
+double bench(const char* name, bool adaptive_sampling, Run run) {
+    MockResampler resampler;
+    MockAlerts alerts;
+    MockAdaptive adaptive;
+    BenchContext context = {resampler, alerts, adaptive, adaptive_sampling};
+
+    auto start = std::chrono::steady_clock::now();
+    for(uint32_t tick = 0; tick < TICKS; tick++) run(context, tick);
+    auto end = std::chrono::steady_clock::now();
+
+    double ns = std::chrono::duration<double, std::nano>(end - start).count() / TICKS;
+    printf("%-14s %-9s %10.1f ns/tick  (checksum %.0f, %u alerts, %u updates)\n", name,
+        adaptive_sampling ? "adaptive" : "fixed", ns, resampler.sum, alerts.raised, adaptive.updates);
+    return ns;
+}
+
+int main() {
+    for(bool adaptive_sampling : {false, true}) {
+        double hand = bench("hand-written", adaptive_sampling, runHandWritten);
+        double composed = bench("pipeline", adaptive_sampling, runPipeline);
+        printf("%-14s %-9s %+9.1f %%\n", "difference", "", 100.0 * (composed - hand) / hand);
+    }
+    printf("State: pipeline %zu bytes, hand-written %zu bytes\n", sizeof(pipeline), sizeof(hand_written));
+    return 0;
+}
@@ -0,0 +1,133 @@
+/*
+ *  Title: recal_bench.cpp
+ *  Description: Recalibration throughput over raw capture records: scalar on one thread, AVX2 on
+ *               one thread and AVX2 on every core. Synthetic records for a fleet, half the nodes
+ *               with their own coefficients. The tables go through an ingestd sample log and
+ *               recalLoad() first, and every run has to match the scalar values bit for bit
+ *
+ *               recal_bench [RECORDS_PER_SOURCE] [NODES] [DIRECTORY]
+ *  Author: Tinna Osk Traustadottir
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <random>
+#include <string>
+#include <thread>
+#include <Recalibration.h>
+
+const uint8_t BENCH_SOURCES[] = {RAW_MCP3564R, RAW_SEN55, RAW_SCD30};
+
+/// @brief Codes as each sensor sends them
+IngestSample rawRecord(std::mt19937& random, uint8_t source, uint16_t node, uint64_t timestamp) {
+    IngestSample sample = {};
+    sample.timestamp = timestamp;
+    sample.received = 1760000000000000ull + timestamp;
+    sample.node = node;
+    sample.type = TELEMETRY_RAW;
+    sample.source = source;
+    sample.count = RECAL_SOURCE_CHANNELS[source];
+    if(source == RAW_MCP3564R) {
+        sample.adc = (random() % 3 + 1) | 9 << 4;   // Gain x1 to x4
+        sample.codes[0] = (int32_t)(random() % 0x1000000) - 0x800000;
+    } else if(source == RAW_SEN55) {
+        for(uint8_t c = 0; c < 4; c++) sample.codes[c] = random() % 2000;
+        sample.codes[4] = random() % 10000;
+        sample.codes[5] = (uint16_t)(int16_t)((int)(random() % 10000) - 2000);
+        sample.codes[6] = random() % 5000;
+        sample.codes[7] = random() % 5000;
+    } else {
+        float values[3] = {400.0f + random() % 2000, 15.0f + (random() % 1000) / 100.0f, (random() % 10000) / 100.0f};
+        memcpy(sample.codes, values, sizeof(values));
+    }
+    return sample;
+}
+
+int main(int argc, char** argv) {
+    size_t records = argc > 1 ? atol(argv[1]) : 4000000;
+    unsigned nodes = argc > 2 ? atoi(argv[2]) : 256;
+    std::string directory = argc > 3 ? argv[3] : "/tmp";
+    std::string log_path = directory + "/recal_bench.aqlog";
+
+    std::mt19937 random(1);
+    remove(log_path.c_str());
+    {
+        LogStore log;
+        if(!log.open(log_path.c_str())) {
+            fprintf(stderr, "Can't write %s\n", log_path.c_str());
+            return 1;
+        }
+        std::vector<IngestSample> batch;
+        for(size_t i = 0; i < records; i++) {
+            for(uint8_t source : BENCH_SOURCES) batch.push_back(rawRecord(random, source, i % nodes, i * 1000));
+            if(batch.size() >= 4096) {
+                log.write(batch.data(), batch.size());
+                batch.clear();
+            }
+        }
+        log.write(batch.data(), batch.size());
+    }
+
+    static RecalTable tables[RAW_SOURCES];
+    auto load_start = std::chrono::steady_clock::now();
+    if(!recalLoad(log_path.c_str(), tables)) {
+        fprintf(stderr, "Can't read %s back\n", log_path.c_str());
+        return 1;
+    }
+    double load_s = std::chrono::duration<double>(std::chrono::steady_clock::now() - load_start).count();
+    printf("%zu records per source, %u nodes, loaded at %.1f Mrecords/s\n", records, nodes,
+           3 * records / load_s / 1e6);
+
+    RecalCalibration calibration;
+    for(unsigned n = 0; n < nodes; n += 2) {
+        for(uint8_t source : BENCH_SOURCES) {
+            for(uint8_t c = 0; c < RECAL_SOURCE_CHANNELS[source]; c++) {
+                Recal_COEFFS coeffs = calibration.get(n, source, c);
+                coeffs.c0 += 0.01f * (n % 7);
+                coeffs.c1 *= 1.0f + 0.001f * (n % 13);
+                coeffs.c2 = 1e-6f * coeffs.c1;
+                calibration.set(n, source, c, coeffs);
+            }
+        }
+    }
+
+    unsigned cores = std::max(1u, std::thread::hardware_concurrency());
+    struct {
+        const char* name;
+        unsigned threads;
+        bool simd;
+    } runs[] = {
+        {"scalar, 1 thread", 1, false},
+        {"AVX2, 1 thread", 1, true},
+        {"AVX2, all cores", cores, true},
+    };
+    if(!RecalEngine::haveAvx2()) printf("No AVX2 on this CPU, the AVX2 runs use the scalar kernels\n");
+
+    std::vector<float> reference[RAW_SOURCES][RECAL_CHANNELS];
+    bool ok = true;
+    for(auto& r : runs) {
+        RecalEngine engine(calibration, r.threads, r.simd);
+        printf("%s (%u threads):\n", r.name, engine.threads());
+        for(uint8_t source : BENCH_SOURCES) {
+            RecalTable& table = tables[source];
+            engine.run(table);  // Warm up, also faults the values in
+            const int repeats = 5;
+            auto start = std::chrono::steady_clock::now();
+            for(int i = 0; i < repeats; i++) engine.run(table);
+            double s = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() / repeats;
+            uint8_t channels = RECAL_SOURCE_CHANNELS[source];
+            size_t mismatches = 0;
+            for(uint8_t c = 0; c < channels; c++) {
+                if(reference[source][c].empty()) reference[source][c] = table.values[c];
+                else if(memcmp(reference[source][c].data(), table.values[c].data(), table.size() * sizeof(float)) != 0) mismatches++;
+            }
+            ok &= mismatches == 0;
+            printf("  %-9s %8.1f Mrecords/s %8.1f Mvalues/s %s\n", RECAL_SOURCE_NAMES[source], table.size() / s / 1e6,
+                   table.size() * channels / s / 1e6, mismatches ? "MISMATCH" : "");
+        }
+    }
+    remove(log_path.c_str());
+    printf("%s\n", ok ? "All runs bit identical to scalar" : "FAIL: runs differ");
+    return ok ? 0 : 1;
+}
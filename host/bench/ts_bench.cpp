@@ -0,0 +1,275 @@
+/*
+ *  Title: ts_bench.cpp
+ *  Description: Size and scan speed of .aqts against the CSV logs it replaces and a raw array of
+ *               rows. Synthetic history for a fleet at the firmware's 2.5 s output period, values
+ *               are random walks of window means. The files are scanned right after being written,
+ *               so every scan runs from the page cache
+ *
+ *               ts_bench [NODES] [ROWS_PER_NODE] [DIRECTORY]
+ *  Author: Tinna Osk Traustadottir
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <chrono>
+#include <random>
+#include <string>
+#include <vector>
+#include <TsFile.h>
+
+const uint64_t OUTPUT_PERIOD_US = 2500000;
+const uint64_t EPOCH_US = 1760000000000000ull;
+
+std::vector<TsRow> generate(unsigned nodes, unsigned rows_per_node) {
+    std::mt19937 random(1);
+    std::normal_distribution<float> step(0.0f, 1.0f);
+    std::uniform_int_distribution<int> jitter(-2000, 2000);
+    std::vector<TsRow> rows;
+    rows.reserve((size_t)nodes * rows_per_node);
+    std::vector<TsRow> state(nodes);
+    for(unsigned n = 0; n < nodes; n++) {
+        state[n].node = n;
+        float start[TS_COLUMNS] = {21.0f, 0.02f, 45.0f, 600.0f, 12.0f, 10.0f, 8.0f, 5.0f};
+        memcpy(state[n].values, start, sizeof(start));
+    }
+    const float scale[TS_COLUMNS] = {0.02f, 0.0005f, 0.2f, 8.0f, 0.5f, 0.4f, 0.3f, 0.2f};
+    const float low[TS_COLUMNS] = {-10.0f, 0.0f, 5.0f, 400.0f, 0.0f, 0.0f, 0.0f, 0.0f};
+    const float high[TS_COLUMNS] = {40.0f, 0.5f, 95.0f, 2000.0f, 500.0f, 500.0f, 500.0f, 500.0f};
+    for(unsigned i = 0; i < rows_per_node; i++) {
+        for(unsigned n = 0; n < nodes; n++) {
+            TsRow& row = state[n];
+            row.timestamp = EPOCH_US + (uint64_t)i * OUTPUT_PERIOD_US + n * 1000 + jitter(random);
+            for(uint8_t c = 0; c < TS_COLUMNS; c++) {
+                float value = row.values[c] + step(random) * scale[c];
+                row.values[c] = value < low[c] ? low[c] : value > high[c] ? high[c] : value;
+            }
+            TsRow out = row;
+            for(uint8_t c = TS_HUMIDITY; c < TS_COLUMNS; c++) out.values[c] = (float)(int)(row.values[c] + 0.5f);
+            rows.push_back(out);
+        }
+    }
+    return rows;
+}
+
+size_t fileSize(const std::string& path) {
+    struct stat info;
+    return stat(path.c_str(), &info) == 0 ? info.st_size : 0;
+}
+
+/// @brief Time a scan, print it and return its result so it can be compared
+template<typename Scan>
+double timed(const char* name, size_t rows, Scan scan) {
+    auto start = std::chrono::steady_clock::now();
+    double result = scan();
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    printf("  %-10s %9.1f ms %8.1f Mrows/s   result %.6g\n", name, ms, rows / ms / 1000.0, result);
+    return result;
+}
+
+/// @brief Fields of one CSV line, parsed the way an ad-hoc log reader would
+bool parseCsv(char*& p, char* end, TsRow& row) {
+    if(p >= end) return false;
+    row.timestamp = strtoull(p, &p, 10);
+    row.node = (uint16_t)strtoul(p + 1, &p, 10);
+    for(uint8_t c = 0; c < TS_COLUMNS; c++) row.values[c] = strtof(p + 1, &p);
+    while(p < end && *p != '\n') p++;
+    p++;
+    return true;
+}
+
+/// @brief Map a file for the raw and CSV scans
+struct Mapping {
+    char* data = nullptr;
+    size_t size = 0;
+    Mapping(const std::string& path) {
+        int fd = open(path.c_str(), O_RDONLY);
+        size = fileSize(path);
+        data = (char*)mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+        close(fd);
+    }
+    ~Mapping() { munmap(data, size); }
+};
+
+int main(int argc, char** argv) {
+    unsigned nodes = argc > 1 ? atoi(argv[1]) : 16;
+    unsigned rows_per_node = argc > 2 ? atoi(argv[2]) : 125000;
+    std::string directory = argc > 3 ? argv[3] : "/tmp";
+    std::string csv_path = directory + "/ts_bench.csv";
+    std::string raw_path = directory + "/ts_bench.raw";
+    std::string ts_path = directory + "/ts_bench.aqts";
+
+    std::vector<TsRow> rows = generate(nodes, rows_per_node);
+    size_t total = rows.size();
+
+    FILE* csv = fopen(csv_path.c_str(), "w");
+    fprintf(csv, "timestamp,node");
+    for(uint8_t c = 0; c < TS_COLUMNS; c++) fprintf(csv, ",%s", TS_COLUMN_NAMES[c]);
+    fprintf(csv, "\n");
+    for(const TsRow& row : rows) {
+        fprintf(csv, "%llu,%u,%.9g,%.9g,%.0f,%.0f,%.0f,%.0f,%.0f,%.0f\n", (unsigned long long)row.timestamp, row.node,
+                row.values[0], row.values[1], row.values[2], row.values[3], row.values[4], row.values[5],
+                row.values[6], row.values[7]);
+    }
+    fclose(csv);
+
+    FILE* raw = fopen(raw_path.c_str(), "wb");
+    fwrite(rows.data(), sizeof(TsRow), total, raw);
+    fclose(raw);
+
+    remove(ts_path.c_str());
+    TsWriter writer;
+    auto write_start = std::chrono::steady_clock::now();
+    writer.open(ts_path.c_str());
+    for(const TsRow& row : rows) writer.append(row);
+    writer.close();
+    double write_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - write_start).count();
+
+    printf("%zu rows, %u nodes\n", total, nodes);
+    printf("  %-10s %9.1f MB %6.1f bytes/row\n", "csv", fileSize(csv_path) / 1e6, (double)fileSize(csv_path) / total);
+    printf("  %-10s %9.1f MB %6.1f bytes/row\n", "raw", fileSize(raw_path) / 1e6, (double)fileSize(raw_path) / total);
+    printf("  %-10s %9.1f MB %6.1f bytes/row  (%llu blocks, written at %.1f Mrows/s)\n", "aqts",
+           fileSize(ts_path) / 1e6, (double)fileSize(ts_path) / total, (unsigned long long)writer.blocks(),
+           total / write_ms / 1000.0);
+
+    Mapping csv_map(csv_path), raw_map(raw_path);
+    TsReader reader;
+    if(!reader.open(ts_path.c_str())) {
+        fprintf(stderr, "Can't read %s back\n", ts_path.c_str());
+        return 1;
+    }
+    static uint64_t timestamps[65536];
+    static float values[65536];
+
+    // Round trip check, every decoded column has to match what was written
+    {
+        size_t mismatches = 0, checked = 0;
+        std::vector<size_t> next(nodes, 0);
+        reader.forEachBlock(TsQuery(), [&](const TsBlock& block) {
+            const TsBlock_HEADER& h = block.header();
+            block.timestamps(timestamps);
+            for(uint8_t c = 0; c < TS_COLUMNS; c++) {
+                block.column(c, values);
+                for(uint16_t i = 0; i < h.rows; i++) {
+                    const TsRow& row = rows[(next[h.node] + i) * nodes + h.node];
+                    if(values[i] != row.values[c] || (c == 0 && timestamps[i] != row.timestamp)) mismatches++;
+                    checked++;
+                }
+            }
+            next[h.node] += h.rows;
+        });
+        printf("Round trip: %zu values checked, %zu mismatches\n", checked, mismatches);
+        if(mismatches != 0) return 1;
+    }
+
+    printf("Mean CO2, all rows:\n");
+    timed("csv", total, [&]() {
+        char* p = csv_map.data;
+        char* end = p + csv_map.size;
+        while(*p != '\n') p++;
+        p++;
+        double sum = 0.0;
+        size_t n = 0;
+        TsRow row;
+        while(parseCsv(p, end, row)) { sum += row.values[TS_CO2]; n++; }
+        return sum / n;
+    });
+    timed("raw", total, [&]() {
+        const TsRow* r = (const TsRow*)raw_map.data;
+        double sum = 0.0;
+        for(size_t i = 0; i < total; i++) sum += r[i].values[TS_CO2];
+        return sum / total;
+    });
+    timed("aqts", total, [&]() {
+        double sum = 0.0;
+        size_t n = 0;
+        reader.forEachBlock(TsQuery(), [&](const TsBlock& block) {
+            block.column(TS_CO2, values);
+            for(uint16_t i = 0; i < block.header().rows; i++) sum += values[i];
+            n += block.header().rows;
+        });
+        return sum / n;
+    });
+
+    // One node over 1% of the time span
+    uint64_t span = (uint64_t)rows_per_node * OUTPUT_PERIOD_US;
+    TsQuery window;
+    window.node = nodes / 2;
+    window.t_from = EPOCH_US + span / 2;
+    window.t_to = window.t_from + span / 100;
+    printf("Mean temperature, node %d over 1%% of the time:\n", window.node);
+    auto inWindow = [&](const TsRow& row) {
+        return row.node == window.node && row.timestamp >= window.t_from && row.timestamp <= window.t_to;
+    };
+    timed("csv", total, [&]() {
+        char* p = csv_map.data;
+        char* end = p + csv_map.size;
+        while(*p != '\n') p++;
+        p++;
+        double sum = 0.0;
+        size_t n = 0;
+        TsRow row;
+        while(parseCsv(p, end, row)) if(inWindow(row)) { sum += row.values[TS_TEMPERATURE]; n++; }
+        return sum / n;
+    });
+    timed("raw", total, [&]() {
+        const TsRow* r = (const TsRow*)raw_map.data;
+        double sum = 0.0;
+        size_t n = 0;
+        for(size_t i = 0; i < total; i++) if(inWindow(r[i])) { sum += r[i].values[TS_TEMPERATURE]; n++; }
+        return sum / n;
+    });
+    size_t skipped = 0;
+    timed("aqts", total, [&]() {
+        double sum = 0.0;
+        size_t n = 0;
+        skipped = reader.forEachBlock(window, [&](const TsBlock& block) {
+            block.timestamps(timestamps);
+            block.column(TS_TEMPERATURE, values);
+            for(uint16_t i = 0; i < block.header().rows; i++) {
+                if(timestamps[i] >= window.t_from && timestamps[i] <= window.t_to) { sum += values[i]; n++; }
+            }
+        });
+        return sum / n;
+    });
+    printf("  aqts skipped %zu of %llu blocks on their headers\n", skipped, (unsigned long long)writer.blocks());
+
+    // Rare high readings, most blocks never get there
+    TsQuery high;
+    high.column = TS_CO2;
+    high.min = 1500.0f;
+    printf("Rows with CO2 >= 1500 ppm:\n");
+    timed("csv", total, [&]() {
+        char* p = csv_map.data;
+        char* end = p + csv_map.size;
+        while(*p != '\n') p++;
+        p++;
+        size_t n = 0;
+        TsRow row;
+        while(parseCsv(p, end, row)) n += row.values[TS_CO2] >= high.min;
+        return (double)n;
+    });
+    timed("raw", total, [&]() {
+        const TsRow* r = (const TsRow*)raw_map.data;
+        size_t n = 0;
+        for(size_t i = 0; i < total; i++) n += r[i].values[TS_CO2] >= high.min;
+        return (double)n;
+    });
+    timed("aqts", total, [&]() {
+        size_t n = 0;
+        skipped = reader.forEachBlock(high, [&](const TsBlock& block) {
+            block.column(TS_CO2, values);
+            for(uint16_t i = 0; i < block.header().rows; i++) n += values[i] >= high.min;
+        });
+        return (double)n;
+    });
+    printf("  aqts skipped %zu of %llu blocks on their headers\n", skipped, (unsigned long long)writer.blocks());
+
+    remove(csv_path.c_str());
+    remove(raw_path.c_str());
+    remove(ts_path.c_str());
+    return 0;
+}
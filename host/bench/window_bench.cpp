@@ -0,0 +1,77 @@
+/*
+ *  Title: window_bench.cpp
+ *  Description: Checks WindowStats min, max and mean against a brute force window on ramps, steps
+ *               and noise, and times its updates
+ *  Author: Tinna Osk Traustadottir
+ */
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <math.h>
+#include <chrono>
+#include <vector>
+#include <WindowStats.h>
+
+const size_t SAMPLES = 2000000;
+
+/// @brief Feed the input and compare every update against the last SIZE samples
+/// @return Number of updates where min, max or mean differ
+template<uint32_t WindowMs, uint32_t SamplePeriodMs>
+size_t check(const char* name, const std::vector<float>& input) {
+    typedef WindowStats<WindowMs, SamplePeriodMs> W;
+    W window;
+    size_t mismatches = 0;
+    for(size_t i = 0; i < input.size(); i++) {
+        window.add(input[i]);
+        size_t first = (i + 1 > W::SIZE) ? i + 1 - W::SIZE : 0;
+        float lo = input[first], hi = input[first];
+        double sum = 0.0;
+        for(size_t j = first; j <= i; j++) {
+            if(input[j] < lo) lo = input[j];
+            if(input[j] > hi) hi = input[j];
+            sum += input[j];
+        }
+        float mean = sum / (i + 1 - first);
+        if(window.min() != lo || window.max() != hi || fabsf(window.mean() - mean) > 1e-3f * (1.0f + fabsf(mean))) {
+            mismatches++;
+        }
+    }
+    printf("%-12s window %4u: %zu of %zu updates differ\n", name, W::SIZE, mismatches, input.size());
+    return mismatches;
+}
+
+template<uint32_t WindowMs, uint32_t SamplePeriodMs>
+size_t checkAll(void) {
+    const size_t n = 10 * WindowMs / SamplePeriodMs + 7;
+    std::vector<float> rising(n), falling(n), steps(n), noise(n);
+    srand(1);
+    for(size_t i = 0; i < n; i++) {
+        rising[i] = (float)i;
+        falling[i] = (float)(n - i);
+        steps[i] = (float)((i / 5) % 4);
+        noise[i] = (rand() % 1000) / 10.0f;
+    }
+    return check<WindowMs, SamplePeriodMs>("increasing", rising) + check<WindowMs, SamplePeriodMs>("decreasing", falling) +
+           check<WindowMs, SamplePeriodMs>("steps", steps) + check<WindowMs, SamplePeriodMs>("noise", noise);
+}
+
+int main() {
+    // The firmware's 1 minute window and two smaller ones
+    size_t mismatches = checkAll<2, 1>() + checkAll<7, 1>() + checkAll<60000, 2500>();
+
+    std::vector<float> input(SAMPLES);
+    for(size_t i = 0; i < SAMPLES; i++) input[i] = (rand() % 1000) / 10.0f;
+    WindowStats<3600000, 60000> window;
+    volatile float sink = 0.0f; // Keeps the loop from being optimized away
+    auto start = std::chrono::steady_clock::now();
+    for(float x : input) {
+        window.add(x);
+        sink = window.min() + window.max();
+    }
+    auto end = std::chrono::steady_clock::now();
+    (void)sink;
+    printf("%.0f updates/s, window %u\n", SAMPLES / std::chrono::duration<double>(end - start).count(), window.SIZE);
+
+    printf("%s\n", mismatches == 0 ? "PASS: min, max and mean match a brute force window" : "FAIL: results differ");
+    return mismatches == 0 ? 0 : 1;
+}
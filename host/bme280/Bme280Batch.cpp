@@ -0,0 +1,360 @@
+/*
+ *  Title: Bme280Batch.cpp
+ *  Description: BME280 compensation over columns of raw ADC values
+ *  Author: Tinna Osk Traustadottir
+ */
+#include "Bme280Batch.h"
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+// Largest quotients and divisors the vector pressure division takes, lanes over them go to the
+// scalar code. Real sensors give quotients around 2^33 and divisors around 2^29. Up to 2^50 the
+// double quotient is within one, AVX2 also needs the quotient over 2^13 to be a 32 bit multiplier
+const double BME280_QUOTIENT_LIMIT = 1125899906842624.0;    // 2^50
+const double BME280_QUOTIENT_LIMIT_AVX2 = 8796093022208.0;  // 2^43
+const int64_t BME280_DIVISOR_LIMIT = (int64_t)1 << 52;      // Exact as a double
+const double BME280_INTEGER_BIAS = 6755399441055744.0;      // 2^52 + 2^51
+
+static void compensateScalar(const BME280_COEFFS& c, const Bme280_COLUMNS& k, size_t begin, size_t end) {
+    for(size_t i = begin; i < end; i++) {
+        int32_t t_fine = bme280TFine(c, k.raw_temperature[i]);
+        k.temperature[i] = bme280Temperature(t_fine);
+        if(k.raw_pressure != nullptr) k.pressure[i] = bme280Pressure(c, t_fine, k.raw_pressure[i]);
+        if(k.raw_humidity != nullptr) k.humidity[i] = bme280Humidity(c, t_fine, k.raw_humidity[i]);
+    }
+}
+
+/// @brief Redo the pressure of the lanes set in a mask with the scalar code
+static void redoPressure(const BME280_COEFFS& c, const int32_t* t_fine, const int32_t* raw, float* out, int mask) {
+    for(int lane = 0; mask != 0; lane++, mask >>= 1) {
+        if(mask & 1) out[lane] = bme280Pressure(c, t_fine[lane], raw[lane]);
+    }
+}
+
+#if defined(__x86_64__)
+/*
+ * The vector kernels follow the scalar code operation by operation. Temperature and humidity are
+ * plain 32 bit lane math, and the conversions to float round the same way the scalar ones do.
+ *
+ * Pressure needs 64 bit multiplies, arithmetic shifts and a division. AVX-512DQ has all but the
+ * division. With AVX2 they are put together from 32 bit pieces:
+ *   - products of two 32 bit values use mul_epi32, which is exact
+ *   - other 64 bit products are built from 32 x 32 multiplies, the low 64 bits are all the
+ *     scalar code keeps as well
+ *   - arithmetic shifts flip negative values to positive around a logical shift
+ * That costs too much at two lanes wide to beat the scalar divide, so the SSE4.1 kernel leaves
+ * pressure to the scalar code. The division runs in double precision: the numerator is rounded
+ * once on the way in and the truncated quotient is within one of the integer quotient, which the
+ * exact remainder then corrects. AVX2 turns quotients back into integers by adding a bias that
+ * puts them in the low bits of the mantissa
+ */
+
+#define SSE41 __attribute__((target("sse4.1")))
+#define AVX2 __attribute__((target("avx2")))
+#define AVX512 __attribute__((target("avx2,avx512f,avx512dq,avx512vl")))
+#define INLINE inline __attribute__((always_inline))
+
+SSE41 static void compensateSse(const BME280_COEFFS& c, const Bme280_COLUMNS& k, size_t begin, size_t end) {
+    const __m128i T1 = _mm_set1_epi32(c.dig_T1), T1x2 = _mm_set1_epi32((int32_t)c.dig_T1 << 1);
+    const __m128i T2 = _mm_set1_epi32(c.dig_T2), T3 = _mm_set1_epi32(c.dig_T3);
+    const __m128i H1 = _mm_set1_epi32(c.dig_H1), H2 = _mm_set1_epi32(c.dig_H2), H3 = _mm_set1_epi32(c.dig_H3);
+    const __m128i H4x = _mm_set1_epi32(((int32_t)c.dig_H4) << 20), H5 = _mm_set1_epi32(c.dig_H5), H6 = _mm_set1_epi32(c.dig_H6);
+    size_t i = begin;
+    for(; i + 4 <= end; i += 4) {
+        __m128i raw = _mm_loadu_si128((const __m128i*)(k.raw_temperature + i));
+        __m128i var1 = _mm_srai_epi32(_mm_mullo_epi32(_mm_sub_epi32(_mm_srai_epi32(raw, 3), T1x2), T2), 11);
+        __m128i d = _mm_sub_epi32(_mm_srai_epi32(raw, 4), T1);
+        __m128i var2 = _mm_srai_epi32(_mm_mullo_epi32(_mm_srai_epi32(_mm_mullo_epi32(d, d), 12), T3), 14);
+        __m128i t_fine = _mm_add_epi32(var1, var2);
+        __m128i T = _mm_srai_epi32(_mm_add_epi32(_mm_mullo_epi32(t_fine, _mm_set1_epi32(5)), _mm_set1_epi32(128)), 8);
+        _mm_storeu_ps(k.temperature + i, _mm_div_ps(_mm_cvtepi32_ps(T), _mm_set1_ps(100.0f)));
+
+        if(k.raw_pressure != nullptr) {
+            int32_t lanes[4];
+            _mm_storeu_si128((__m128i*)lanes, t_fine);
+            redoPressure(c, lanes, k.raw_pressure + i, k.pressure + i, 0xF);
+        }
+
+        if(k.raw_humidity != nullptr) {
+            __m128i raw_h = _mm_loadu_si128((const __m128i*)(k.raw_humidity + i));
+            __m128i h = _mm_sub_epi32(t_fine, _mm_set1_epi32(76800));
+            __m128i x = _mm_sub_epi32(_mm_sub_epi32(_mm_slli_epi32(raw_h, 14), H4x), _mm_mullo_epi32(H5, h));
+            x = _mm_srai_epi32(_mm_add_epi32(x, _mm_set1_epi32(16384)), 15);
+            __m128i y = _mm_srai_epi32(_mm_mullo_epi32(h, H6), 10);
+            __m128i z = _mm_add_epi32(_mm_srai_epi32(_mm_mullo_epi32(h, H3), 11), _mm_set1_epi32(32768));
+            __m128i w = _mm_add_epi32(_mm_srai_epi32(_mm_mullo_epi32(y, z), 10), _mm_set1_epi32(2097152));
+            w = _mm_srai_epi32(_mm_add_epi32(_mm_mullo_epi32(w, H2), _mm_set1_epi32(8192)), 14);
+            h = _mm_mullo_epi32(x, w);
+            __m128i s = _mm_srai_epi32(h, 15);
+            s = _mm_srai_epi32(_mm_mullo_epi32(_mm_srai_epi32(_mm_mullo_epi32(s, s), 7), H1), 4);
+            h = _mm_sub_epi32(h, s);
+            h = _mm_min_epi32(_mm_max_epi32(h, _mm_setzero_si128()), _mm_set1_epi32(419430400));
+            _mm_storeu_ps(k.humidity + i, _mm_div_ps(_mm_cvtepi32_ps(_mm_srai_epi32(h, 12)), _mm_set1_ps(1024.0f)));
+        }
+    }
+    compensateScalar(c, k, i, end);
+}
+
+AVX2 static INLINE __m256i mullo64Avx2(__m256i a, __m256i b) {
+    __m256i cross = _mm256_add_epi64(_mm256_mul_epu32(_mm256_srli_epi64(a, 32), b), _mm256_mul_epu32(a, _mm256_srli_epi64(b, 32)));
+    return _mm256_add_epi64(_mm256_mul_epu32(a, b), _mm256_slli_epi64(cross, 32));
+}
+
+AVX2 static INLINE __m256i mulu32x64Avx2(__m256i a, __m256i b) {
+    return _mm256_add_epi64(_mm256_mul_epu32(a, b), _mm256_slli_epi64(_mm256_mul_epu32(_mm256_srli_epi64(a, 32), b), 32));
+}
+
+AVX2 static INLINE __m256i srai64Avx2(__m256i x, int n) {
+    __m256i sign = _mm256_srai_epi32(_mm256_shuffle_epi32(x, _MM_SHUFFLE(3, 3, 1, 1)), 31);
+    return _mm256_xor_si256(_mm256_srli_epi64(_mm256_xor_si256(x, sign), n), sign);
+}
+
+/// @brief Pressure coefficients broadcast to 64 bit lanes, once per batch
+struct PressureAvx2 {
+    __m256i P1, P2, P3, P4x, P5, P6, P7x, P8, P9;
+};
+
+/// @brief Pressure of four lanes
+/// @param t_fine 
+///        Fine temperature of the lanes
+/// @param raw 
+///        Raw pressure of the lanes
+/// @param out 
+///        Output, four floats
+/// @return Mask of the lanes the scalar code has to redo
+AVX2 static INLINE int pressureAvx2(const PressureAvx2& c, __m128i t_fine, __m128i raw, float* out) {
+    const __m256i zero = _mm256_setzero_si256(), ones = _mm256_set1_epi64x(-1);
+    const __m256i low = _mm256_setr_epi32(0, 2, 4, 6, 0, 2, 4, 6), high = _mm256_setr_epi32(1, 3, 5, 7, 1, 3, 5, 7);
+    __m256i v1 = _mm256_sub_epi64(_mm256_cvtepi32_epi64(t_fine), _mm256_set1_epi64x(128000));
+    __m256i v1v1 = _mm256_mul_epi32(v1, v1);
+    __m256i var2 = mullo64Avx2(v1v1, c.P6);
+    var2 = _mm256_add_epi64(var2, _mm256_slli_epi64(_mm256_mul_epi32(v1, c.P5), 17));
+    var2 = _mm256_add_epi64(var2, c.P4x);
+    __m256i var1 = srai64Avx2(mullo64Avx2(v1v1, c.P3), 8);
+    var1 = _mm256_add_epi64(var1, _mm256_slli_epi64(_mm256_mul_epi32(v1, c.P2), 12));
+    var1 = srai64Avx2(mulu32x64Avx2(_mm256_add_epi64(_mm256_set1_epi64x((int64_t)1 << 47), var1), c.P1), 33);
+
+    __m256i p = _mm256_sub_epi64(_mm256_set1_epi64x(1048576), _mm256_cvtepi32_epi64(raw));
+    __m256i n = mulu32x64Avx2(_mm256_sub_epi64(_mm256_slli_epi64(p, 31), var2), _mm256_set1_epi64x(3125));
+
+    __m128i n_lo = _mm256_castsi256_si128(_mm256_permutevar8x32_epi32(n, low));
+    __m128i n_hi = _mm256_castsi256_si128(_mm256_permutevar8x32_epi32(n, high));
+    __m256d nd = _mm256_add_pd(_mm256_mul_pd(_mm256_cvtepi32_pd(n_hi), _mm256_set1_pd(4294967296.0)),
+                               _mm256_add_pd(_mm256_cvtepi32_pd(_mm_xor_si128(n_lo, _mm_set1_epi32(INT32_MIN))), _mm256_set1_pd(2147483648.0)));
+    __m256d qd = _mm256_div_pd(nd, _mm256_cvtepi32_pd(_mm256_castsi256_si128(_mm256_permutevar8x32_epi32(var1, low))));
+    __m256i fits = _mm256_and_si256(_mm256_cmpgt_epi64(var1, zero), _mm256_cmpgt_epi64(_mm256_set1_epi64x(INT32_MAX), var1));
+    __m256d small = _mm256_cmp_pd(_mm256_andnot_pd(_mm256_set1_pd(-0.0), qd), _mm256_set1_pd(BME280_QUOTIENT_LIMIT_AVX2), _CMP_LT_OQ);
+    fits = _mm256_and_si256(fits, _mm256_castpd_si256(small));
+
+    const __m256d bias = _mm256_set1_pd(BME280_INTEGER_BIAS);
+    qd = _mm256_round_pd(qd, _MM_FROUND_TO_ZERO | _MM_FROUND_NO_EXC);
+    __m256i q = _mm256_sub_epi64(_mm256_castpd_si256(_mm256_add_pd(qd, bias)), _mm256_castpd_si256(bias));
+    __m256i r = _mm256_sub_epi64(n, mulu32x64Avx2(q, var1));
+    __m256i negative = _mm256_cmpgt_epi64(zero, n);
+    __m256i up = _mm256_blendv_epi8(_mm256_xor_si256(_mm256_cmpgt_epi64(var1, r), ones), _mm256_cmpgt_epi64(r, zero), negative);
+    __m256i down = _mm256_blendv_epi8(_mm256_cmpgt_epi64(zero, r), _mm256_xor_si256(_mm256_cmpgt_epi64(r, _mm256_sub_epi64(zero, var1)), ones), negative);
+    q = _mm256_add_epi64(_mm256_sub_epi64(q, up), down);
+
+    __m256i q13 = srai64Avx2(q, 13);
+    var1 = srai64Avx2(mullo64Avx2(_mm256_mul_epi32(c.P9, q13), q13), 25);
+    var2 = srai64Avx2(mullo64Avx2(c.P8, q), 19);
+    p = _mm256_add_epi64(srai64Avx2(_mm256_add_epi64(_mm256_add_epi64(q, var1), var2), 8), c.P7x);
+
+    // uint32 to float in two exact halves and one rounding
+    __m128i u = _mm256_castsi256_si128(_mm256_permutevar8x32_epi32(p, low));
+    __m128 f = _mm_add_ps(_mm_mul_ps(_mm_cvtepi32_ps(_mm_srli_epi32(u, 16)), _mm_set1_ps(65536.0f)),
+                          _mm_cvtepi32_ps(_mm_and_si128(u, _mm_set1_epi32(0xFFFF))));
+    _mm_storeu_ps(out, _mm_div_ps(f, _mm_set1_ps(25600.0f)));
+    return _mm256_movemask_pd(_mm256_castsi256_pd(fits)) ^ 0xF;
+}
+
+AVX2 static void compensateAvx2(const BME280_COEFFS& c, const Bme280_COLUMNS& k, size_t begin, size_t end) {
+    const __m256i T1 = _mm256_set1_epi32(c.dig_T1), T1x2 = _mm256_set1_epi32((int32_t)c.dig_T1 << 1);
+    const __m256i T2 = _mm256_set1_epi32(c.dig_T2), T3 = _mm256_set1_epi32(c.dig_T3);
+    const __m256i H1 = _mm256_set1_epi32(c.dig_H1), H2 = _mm256_set1_epi32(c.dig_H2), H3 = _mm256_set1_epi32(c.dig_H3);
+    const __m256i H4x = _mm256_set1_epi32(((int32_t)c.dig_H4) << 20), H5 = _mm256_set1_epi32(c.dig_H5);
+    const __m256i H6 = _mm256_set1_epi32(c.dig_H6);
+    const PressureAvx2 pc = {
+        _mm256_set1_epi64x(c.dig_P1), _mm256_set1_epi64x(c.dig_P2), _mm256_set1_epi64x(c.dig_P3),
+        _mm256_set1_epi64x(((int64_t)c.dig_P4) << 35), _mm256_set1_epi64x(c.dig_P5), _mm256_set1_epi64x(c.dig_P6),
+        _mm256_set1_epi64x(((int64_t)c.dig_P7) << 4), _mm256_set1_epi64x(c.dig_P8), _mm256_set1_epi64x(c.dig_P9)};
+    size_t i = begin;
+    for(; i + 8 <= end; i += 8) {
+        __m256i raw = _mm256_loadu_si256((const __m256i*)(k.raw_temperature + i));
+        __m256i var1 = _mm256_srai_epi32(_mm256_mullo_epi32(_mm256_sub_epi32(_mm256_srai_epi32(raw, 3), T1x2), T2), 11);
+        __m256i d = _mm256_sub_epi32(_mm256_srai_epi32(raw, 4), T1);
+        __m256i var2 = _mm256_srai_epi32(_mm256_mullo_epi32(_mm256_srai_epi32(_mm256_mullo_epi32(d, d), 12), T3), 14);
+        __m256i t_fine = _mm256_add_epi32(var1, var2);
+        __m256i T = _mm256_srai_epi32(_mm256_add_epi32(_mm256_mullo_epi32(t_fine, _mm256_set1_epi32(5)), _mm256_set1_epi32(128)), 8);
+        _mm256_storeu_ps(k.temperature + i, _mm256_div_ps(_mm256_cvtepi32_ps(T), _mm256_set1_ps(100.0f)));
+
+        if(k.raw_pressure != nullptr) {
+            int redo = pressureAvx2(pc, _mm256_castsi256_si128(t_fine), _mm_loadu_si128((const __m128i*)(k.raw_pressure + i)),
+                                    k.pressure + i);
+            redo |= pressureAvx2(pc, _mm256_extracti128_si256(t_fine, 1), _mm_loadu_si128((const __m128i*)(k.raw_pressure + i + 4)),
+                                 k.pressure + i + 4) << 4;
+            if(redo != 0) {
+                int32_t lanes[8];
+                _mm256_storeu_si256((__m256i*)lanes, t_fine);
+                redoPressure(c, lanes, k.raw_pressure + i, k.pressure + i, redo);
+            }
+        }
+
+        if(k.raw_humidity != nullptr) {
+            __m256i raw_h = _mm256_loadu_si256((const __m256i*)(k.raw_humidity + i));
+            __m256i h = _mm256_sub_epi32(t_fine, _mm256_set1_epi32(76800));
+            __m256i x = _mm256_sub_epi32(_mm256_sub_epi32(_mm256_slli_epi32(raw_h, 14), H4x), _mm256_mullo_epi32(H5, h));
+            x = _mm256_srai_epi32(_mm256_add_epi32(x, _mm256_set1_epi32(16384)), 15);
+            __m256i y = _mm256_srai_epi32(_mm256_mullo_epi32(h, H6), 10);
+            __m256i z = _mm256_add_epi32(_mm256_srai_epi32(_mm256_mullo_epi32(h, H3), 11), _mm256_set1_epi32(32768));
+            __m256i w = _mm256_add_epi32(_mm256_srai_epi32(_mm256_mullo_epi32(y, z), 10), _mm256_set1_epi32(2097152));
+            w = _mm256_srai_epi32(_mm256_add_epi32(_mm256_mullo_epi32(w, H2), _mm256_set1_epi32(8192)), 14);
+            h = _mm256_mullo_epi32(x, w);
+            __m256i s = _mm256_srai_epi32(h, 15);
+            s = _mm256_srai_epi32(_mm256_mullo_epi32(_mm256_srai_epi32(_mm256_mullo_epi32(s, s), 7), H1), 4);
+            h = _mm256_sub_epi32(h, s);
+            h = _mm256_min_epi32(_mm256_max_epi32(h, _mm256_setzero_si256()), _mm256_set1_epi32(419430400));
+            _mm256_storeu_ps(k.humidity + i, _mm256_div_ps(_mm256_cvtepi32_ps(_mm256_srai_epi32(h, 12)), _mm256_set1_ps(1024.0f)));
+        }
+    }
+    compensateScalar(c, k, i, end);
+}
+/// @brief Pressure coefficients broadcast to 64 bit lanes, once per batch
+struct PressureAvx512 {
+    __m512i P1, P2, P3, P4x, P5, P6, P7x, P8, P9;
+};
+
+/// @brief Pressure of eight lanes, as pressureAvx2() but with 64 bit lanes for real
+AVX512 static INLINE __mmask8 pressureAvx512(const PressureAvx512& c, __m256i t_fine, __m256i raw, float* out) {
+    const __m512i zero = _mm512_setzero_si512(), one = _mm512_set1_epi64(1);
+    __m512i v1 = _mm512_sub_epi64(_mm512_cvtepi32_epi64(t_fine), _mm512_set1_epi64(128000));
+    __m512i v1v1 = _mm512_mullo_epi64(v1, v1);
+    __m512i var2 = _mm512_mullo_epi64(v1v1, c.P6);
+    var2 = _mm512_add_epi64(var2, _mm512_slli_epi64(_mm512_mullo_epi64(v1, c.P5), 17));
+    var2 = _mm512_add_epi64(var2, c.P4x);
+    __m512i var1 = _mm512_srai_epi64(_mm512_mullo_epi64(v1v1, c.P3), 8);
+    var1 = _mm512_add_epi64(var1, _mm512_slli_epi64(_mm512_mullo_epi64(v1, c.P2), 12));
+    var1 = _mm512_srai_epi64(_mm512_mullo_epi64(_mm512_add_epi64(_mm512_set1_epi64((int64_t)1 << 47), var1), c.P1), 33);
+
+    __m512i p = _mm512_sub_epi64(_mm512_set1_epi64(1048576), _mm512_cvtepi32_epi64(raw));
+    __m512i n = _mm512_mullo_epi64(_mm512_sub_epi64(_mm512_slli_epi64(p, 31), var2), _mm512_set1_epi64(3125));
+
+    __m512d qd = _mm512_div_pd(_mm512_cvtepi64_pd(n), _mm512_cvtepi64_pd(var1));
+    __mmask8 fits = _mm512_cmpgt_epi64_mask(var1, zero) & _mm512_cmplt_epi64_mask(var1, _mm512_set1_epi64(BME280_DIVISOR_LIMIT)) &
+                    _mm512_cmp_pd_mask(_mm512_abs_pd(qd), _mm512_set1_pd(BME280_QUOTIENT_LIMIT), _CMP_LT_OQ);
+    __m512i q = _mm512_cvttpd_epi64(qd);
+    __m512i r = _mm512_sub_epi64(n, _mm512_mullo_epi64(q, var1));
+    __mmask8 negative = _mm512_cmplt_epi64_mask(n, zero);
+    __mmask8 up = (~negative & _mm512_cmpge_epi64_mask(r, var1)) | (negative & _mm512_cmpgt_epi64_mask(r, zero));
+    __mmask8 down = (~negative & _mm512_cmplt_epi64_mask(r, zero)) | (negative & _mm512_cmple_epi64_mask(r, _mm512_sub_epi64(zero, var1)));
+    q = _mm512_mask_add_epi64(q, up, q, one);
+    q = _mm512_mask_sub_epi64(q, down, q, one);
+
+    __m512i q13 = _mm512_srai_epi64(q, 13);
+    var1 = _mm512_srai_epi64(_mm512_mullo_epi64(_mm512_mullo_epi64(c.P9, q13), q13), 25);
+    var2 = _mm512_srai_epi64(_mm512_mullo_epi64(c.P8, q), 19);
+    p = _mm512_add_epi64(_mm512_srai_epi64(_mm512_add_epi64(_mm512_add_epi64(q, var1), var2), 8), c.P7x);
+
+    __m256 f = _mm512_cvtepu64_ps(_mm512_and_si512(p, _mm512_set1_epi64(0xFFFFFFFF)));
+    _mm256_storeu_ps(out, _mm256_div_ps(f, _mm256_set1_ps(25600.0f)));
+    return (__mmask8)~fits;
+}
+
+AVX512 static void compensateAvx512(const BME280_COEFFS& c, const Bme280_COLUMNS& k, size_t begin, size_t end) {
+    const __m512i T1 = _mm512_set1_epi32(c.dig_T1), T1x2 = _mm512_set1_epi32((int32_t)c.dig_T1 << 1);
+    const __m512i T2 = _mm512_set1_epi32(c.dig_T2), T3 = _mm512_set1_epi32(c.dig_T3);
+    const __m512i H1 = _mm512_set1_epi32(c.dig_H1), H2 = _mm512_set1_epi32(c.dig_H2), H3 = _mm512_set1_epi32(c.dig_H3);
+    const __m512i H4x = _mm512_set1_epi32(((int32_t)c.dig_H4) << 20), H5 = _mm512_set1_epi32(c.dig_H5);
+    const __m512i H6 = _mm512_set1_epi32(c.dig_H6);
+    const PressureAvx512 pc = {
+        _mm512_set1_epi64(c.dig_P1), _mm512_set1_epi64(c.dig_P2), _mm512_set1_epi64(c.dig_P3),
+        _mm512_set1_epi64(((int64_t)c.dig_P4) << 35), _mm512_set1_epi64(c.dig_P5), _mm512_set1_epi64(c.dig_P6),
+        _mm512_set1_epi64(((int64_t)c.dig_P7) << 4), _mm512_set1_epi64(c.dig_P8), _mm512_set1_epi64(c.dig_P9)};
+    size_t i = begin;
+    for(; i + 16 <= end; i += 16) {
+        __m512i raw = _mm512_loadu_si512(k.raw_temperature + i);
+        __m512i var1 = _mm512_srai_epi32(_mm512_mullo_epi32(_mm512_sub_epi32(_mm512_srai_epi32(raw, 3), T1x2), T2), 11);
+        __m512i d = _mm512_sub_epi32(_mm512_srai_epi32(raw, 4), T1);
+        __m512i var2 = _mm512_srai_epi32(_mm512_mullo_epi32(_mm512_srai_epi32(_mm512_mullo_epi32(d, d), 12), T3), 14);
+        __m512i t_fine = _mm512_add_epi32(var1, var2);
+        __m512i T = _mm512_srai_epi32(_mm512_add_epi32(_mm512_mullo_epi32(t_fine, _mm512_set1_epi32(5)), _mm512_set1_epi32(128)), 8);
+        _mm512_storeu_ps(k.temperature + i, _mm512_div_ps(_mm512_cvtepi32_ps(T), _mm512_set1_ps(100.0f)));
+
+        if(k.raw_pressure != nullptr) {
+            int redo = pressureAvx512(pc, _mm512_castsi512_si256(t_fine), _mm256_loadu_si256((const __m256i*)(k.raw_pressure + i)),
+                                      k.pressure + i);
+            redo |= pressureAvx512(pc, _mm512_extracti64x4_epi64(t_fine, 1), _mm256_loadu_si256((const __m256i*)(k.raw_pressure + i + 8)),
+                                   k.pressure + i + 8) << 8;
+            if(redo != 0) {
+                int32_t lanes[16];
+                _mm512_storeu_si512(lanes, t_fine);
+                redoPressure(c, lanes, k.raw_pressure + i, k.pressure + i, redo);
+            }
+        }
+
+        if(k.raw_humidity != nullptr) {
+            __m512i raw_h = _mm512_loadu_si512(k.raw_humidity + i);
+            __m512i h = _mm512_sub_epi32(t_fine, _mm512_set1_epi32(76800));
+            __m512i x = _mm512_sub_epi32(_mm512_sub_epi32(_mm512_slli_epi32(raw_h, 14), H4x), _mm512_mullo_epi32(H5, h));
+            x = _mm512_srai_epi32(_mm512_add_epi32(x, _mm512_set1_epi32(16384)), 15);
+            __m512i y = _mm512_srai_epi32(_mm512_mullo_epi32(h, H6), 10);
+            __m512i z = _mm512_add_epi32(_mm512_srai_epi32(_mm512_mullo_epi32(h, H3), 11), _mm512_set1_epi32(32768));
+            __m512i w = _mm512_add_epi32(_mm512_srai_epi32(_mm512_mullo_epi32(y, z), 10), _mm512_set1_epi32(2097152));
+            w = _mm512_srai_epi32(_mm512_add_epi32(_mm512_mullo_epi32(w, H2), _mm512_set1_epi32(8192)), 14);
+            h = _mm512_mullo_epi32(x, w);
+            __m512i s = _mm512_srai_epi32(h, 15);
+            s = _mm512_srai_epi32(_mm512_mullo_epi32(_mm512_srai_epi32(_mm512_mullo_epi32(s, s), 7), H1), 4);
+            h = _mm512_sub_epi32(h, s);
+            h = _mm512_min_epi32(_mm512_max_epi32(h, _mm512_setzero_si512()), _mm512_set1_epi32(419430400));
+            _mm512_storeu_ps(k.humidity + i, _mm512_div_ps(_mm512_cvtepi32_ps(_mm512_srai_epi32(h, 12)), _mm512_set1_ps(1024.0f)));
+        }
+    }
+    compensateScalar(c, k, i, end);
+}
+#endif
+
+/// @param isa 
+///        Instruction set to use, lowered to what the CPU has
+Bme280Batch::Bme280Batch(const BME280_COEFFS& coeffs, BME280_ISA isa) : _coeffs(coeffs) {
+    _isa = isa > bestIsa() ? bestIsa() : isa;
+}
+
+BME280_ISA Bme280Batch::bestIsa(void) {
+#if defined(__x86_64__)
+    if(__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512dq") && __builtin_cpu_supports("avx512vl")) {
+        return BME280_ISA::Avx512;
+    }
+    if(__builtin_cpu_supports("avx2")) return BME280_ISA::Avx2;
+    if(__builtin_cpu_supports("sse4.1")) return BME280_ISA::Sse41;
+#endif
+    return BME280_ISA::Scalar;
+}
+
+const char* Bme280Batch::isaName(BME280_ISA isa) {
+    switch(isa) {
+        case BME280_ISA::Avx512: return "AVX-512";
+        case BME280_ISA::Avx2:   return "AVX2";
+        case BME280_ISA::Sse41:  return "SSE4.1";
+        default:                 return "scalar";
+    }
+}
+
+/// @brief Compensate rows [begin, end) of a batch
+void Bme280Batch::compensate(const Bme280_COLUMNS& columns, size_t begin, size_t end) const {
+#if defined(__x86_64__)
+    if(_isa == BME280_ISA::Avx512) {
+        compensateAvx512(_coeffs, columns, begin, end);
+        return;
+    }
+    if(_isa == BME280_ISA::Avx2) {
+        compensateAvx2(_coeffs, columns, begin, end);
+        return;
+    }
+    if(_isa == BME280_ISA::Sse41) {
+        compensateSse(_coeffs, columns, begin, end);
+        return;
+    }
+#endif
+    compensateScalar(_coeffs, columns, begin, end);
+}
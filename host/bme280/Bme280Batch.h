@@ -0,0 +1,48 @@
+/*
+ *  Title: Bme280Batch.h
+ *  Description: BME280 compensation over columns of raw ADC values, for reprocessing stored raw
+ *               capture. Same Bosch integer math as the firmware (BME280Compensation.h) and bit
+ *               identical to it, with SSE4.1, AVX2 and AVX-512 kernels picked at run time:
+ *               temperature and humidity in 32 bit lanes, the 64 bit pressure path in 64 bit lanes
+ *               (AVX2 and AVX-512) with the division done in double precision and corrected to the
+ *               exact integer quotient. Lanes whose numbers fall outside what the vector division
+ *               covers are redone with the scalar code, so any coefficients give the firmware's
+ *               result for ADC values in their 20 and 16 bit ranges
+ *  Author: Tinna Osk Traustadottir
+ */
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <BME280Compensation.h>
+
+enum class BME280_ISA : uint8_t {
+    Scalar = 0,
+    Sse41,      // Pressure stays scalar, two 64 bit lanes don't beat the hardware divide
+    Avx2,
+    Avx512,     // F, DQ and VL
+};
+
+/// @brief One batch as columns. Pressure and humidity are skipped when their pointers are nullptr
+struct Bme280_COLUMNS {
+    const int32_t* raw_temperature;
+    const int32_t* raw_pressure;
+    const int32_t* raw_humidity;
+    float* temperature;     // °C
+    float* pressure;        // hPa
+    float* humidity;        // %RH
+};
+
+class Bme280Batch {
+public:
+    Bme280Batch(const BME280_COEFFS& coeffs, BME280_ISA isa = bestIsa());
+
+    void compensate(const Bme280_COLUMNS& columns, size_t begin, size_t end) const;
+
+    BME280_ISA isa(void) const { return _isa; }
+    static BME280_ISA bestIsa(void);
+    static const char* isaName(BME280_ISA isa);
+
+private:
+    BME280_COEFFS _coeffs;
+    BME280_ISA _isa;
+};
@@ -0,0 +1,124 @@
+/*
+ *  Title: History.cpp
+ *  Description: Query side of the packet history
+ *  Author: Tinna Osk Traustadottir
+ */
+#include "History.h"
+#include <sys/stat.h>
+
+/// @brief Rollup index path for an .aqts path: the extension replaced with .aqru
+std::string historyIndexPath(const char* path) {
+    std::string index(path);
+    size_t dot = index.rfind('.');
+    if(dot != std::string::npos && index.find('/', dot) == std::string::npos) index.resize(dot);
+    return index + ".aqru";
+}
+
+static uint64_t fileSize(const char* path) {
+    struct stat info;
+    return stat(path, &info) == 0 ? (uint64_t)info.st_size : 0;
+}
+
+/// @brief Load the rollup index of an .aqts file. Blocks appended after the index was saved are
+///        folded in and the index saved again, a missing index or one larger than the file is
+///        rebuilt from every block
+/// @param path 
+///        The .aqts file, a file that doesn't exist yet gives an empty index
+/// @return True if the index matches the file
+bool History::loadIndex(const char* path, RollupIndex& index) {
+    std::string index_path = historyIndexPath(path);
+    uint64_t size = fileSize(path);
+    if(size == 0) {
+        index.clear();
+        return true;
+    }
+    uint64_t covered = 0;
+    if(index.load(index_path.c_str(), &covered) && covered == size) return true;
+    if(covered < sizeof(TsFile_HEADER) || covered > size) {
+        index.clear();
+        covered = sizeof(TsFile_HEADER);
+    }
+
+    TsReader reader;
+    if(!reader.open(path)) return false;
+    size_t end = covered;
+    std::vector<uint64_t> timestamps;
+    std::vector<float> columns;
+    reader.forEachBlock(TsQuery(), [&](const TsBlock& block) {
+        uint16_t rows = block.header().rows;
+        timestamps.resize(rows);
+        columns.resize((size_t)rows * TS_COLUMNS);
+        block.timestamps(timestamps.data());
+        for(uint8_t c = 0; c < TS_COLUMNS; c++) block.column(c, &columns[(size_t)c * rows]);
+        for(uint16_t r = 0; r < rows; r++) {
+            float values[TS_COLUMNS];
+            for(uint8_t c = 0; c < TS_COLUMNS; c++) values[c] = columns[(size_t)c * rows + r];
+            index.add(block.header().node, timestamps[r], values);
+        }
+    }, covered, &end);
+    // Only a cache, a failed save means folding the same blocks in next time. A truncated tail
+    // is left out so the saved size stays on a block boundary
+    if(end != covered) index.save(index_path.c_str(), end);
+    return true;
+}
+
+/// @brief Map an .aqts file and load its rollup index
+bool History::open(const char* path) {
+    close();
+    return _reader.open(path) && loadIndex(path, _index);
+}
+
+void History::close(void) {
+    _reader.close();
+    _index.clear();
+}
+
+/// @brief Points of one metric every step_us, from the coarsest level that gives them exactly
+/// @param out 
+///        Output, one point per step from from rounded down to a step up to to
+/// @return Level the points were read from
+ROLLUP_LEVEL History::series(uint16_t node, uint8_t metric, uint64_t from, uint64_t to, uint64_t step_us,
+                             std::vector<Rollup_POINT>& out) const {
+    ROLLUP_LEVEL level = RollupIndex::plan(step_us);
+    if(level == ROLLUP_LEVEL::Raw) rawSeries(node, metric, from, to, step_us, out);
+    else _index.series(node, metric, from, to, step_us, level, out);
+    return level;
+}
+
+/// @brief Count, min, max and sum of one metric over every minute that overlaps the range
+bool History::aggregate(uint16_t node, uint8_t metric, uint64_t from, uint64_t to, Rollup_POINT* out) const {
+    return _index.aggregate(node, metric, from, to, out);
+}
+
+/// @brief Bin raw rows into steps, only blocks of the node overlapping the range are decoded
+void History::rawSeries(uint16_t node, uint8_t metric, uint64_t from, uint64_t to, uint64_t step_us,
+                        std::vector<Rollup_POINT>& out) const {
+    out.clear();
+    if(step_us == 0 || metric >= TS_COLUMNS || to < from) return;
+    uint64_t start = from - from % step_us;
+    for(uint64_t t = start; t <= to; t += step_us) {
+        out.push_back({t, 0, std::numeric_limits<float>::infinity(), -std::numeric_limits<float>::infinity(), 0.0});
+    }
+
+    TsQuery query;
+    query.node = node;
+    query.t_from = from;
+    query.t_to = to;
+    std::vector<uint64_t> timestamps;
+    std::vector<float> values;
+    _reader.forEachBlock(query, [&](const TsBlock& block) {
+        uint16_t rows = block.header().rows;
+        timestamps.resize(rows);
+        values.resize(rows);
+        block.timestamps(timestamps.data());
+        block.column(metric, values.data());
+        for(uint16_t r = 0; r < rows; r++) {
+            if(timestamps[r] < from || timestamps[r] > to) continue;
+            Rollup_POINT& point = out[(timestamps[r] - start) / step_us];
+            point.count++;
+            if(values[r] < point.min) point.min = values[r];
+            if(values[r] > point.max) point.max = values[r];
+            point.sum += values[r];
+        }
+    });
+}
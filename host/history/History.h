@@ -0,0 +1,35 @@
+/*
+ *  Title: History.h
+ *  Description: Query side of the packet history: an .aqts file together with its rollup index
+ *               (the same name with .aqru). Queries go to the coarsest rollup level that answers
+ *               them exactly and only fall back to decoding raw blocks for steps under a minute
+ *  Author: Tinna Osk Traustadottir
+ */
+#pragma once
+#include <string>
+#include <vector>
+#include <TsFile.h>
+#include "Rollup.h"
+
+std::string historyIndexPath(const char* path);
+
+class History {
+public:
+    bool open(const char* path);
+    void close(void);
+
+    ROLLUP_LEVEL series(uint16_t node, uint8_t metric, uint64_t from, uint64_t to, uint64_t step_us,
+                        std::vector<Rollup_POINT>& out) const;
+    bool aggregate(uint16_t node, uint8_t metric, uint64_t from, uint64_t to, Rollup_POINT* out) const;
+
+    const RollupIndex& index(void) const { return _index; }
+
+    static bool loadIndex(const char* path, RollupIndex& index);
+
+private:
+    TsReader _reader;
+    RollupIndex _index;
+
+    void rawSeries(uint16_t node, uint8_t metric, uint64_t from, uint64_t to, uint64_t step_us,
+                   std::vector<Rollup_POINT>& out) const;
+};
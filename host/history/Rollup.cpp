@@ -0,0 +1,221 @@
+/*
+ *  Title: Rollup.cpp
+ *  Description: Multi-resolution rollups of packet history
+ *  Author: Tinna Osk Traustadottir
+ */
+#include "Rollup.h"
+#include <stdio.h>
+#include <string>
+#include <limits>
+
+const uint32_t ROLLUP_MAGIC = 0x55525141;   // "AQRU"
+const uint16_t ROLLUP_VERSION = 1;
+
+struct Rollup_FILE_HEADER {
+    uint32_t magic;
+    uint16_t version;
+    uint8_t levels;
+    uint8_t metrics;
+    uint64_t raw_bytes;     // Size of the raw file the index covers, later blocks are folded in on load
+    uint32_t series;        // Series records that follow
+    uint32_t reserved;
+} __attribute__((packed));
+
+struct Rollup_SERIES_HEADER {
+    uint16_t node;
+    uint8_t level;          // 0 for Minute
+    uint8_t reserved;
+    uint32_t count;         // Buckets that follow
+    int64_t first;
+} __attribute__((packed));
+
+static void emptyBucket(Rollup_BUCKET* bucket) {
+    bucket->count = 0;
+    for(uint8_t m = 0; m < TS_COLUMNS; m++) {
+        bucket->min[m] = std::numeric_limits<float>::infinity();
+        bucket->max[m] = -std::numeric_limits<float>::infinity();
+        bucket->sum[m] = 0.0;
+    }
+}
+
+/// @brief Add one row to every level, O(1) unless the row is older than anything seen for the node
+/// @param node 
+///        Node ID
+/// @param timestamp 
+///        Microseconds since the Unix epoch
+/// @param values 
+///        TS_COLUMNS values in packet order
+void RollupIndex::add(uint16_t node, uint64_t timestamp, const float* values) {
+    std::array<Series, ROLLUP_LEVELS>& levels = _nodes[node];
+    for(uint8_t l = 0; l < ROLLUP_LEVELS; l++) {
+        Series& series = levels[l];
+        int64_t index = (int64_t)(timestamp / ROLLUP_WIDTH_US[l + 1]);
+        if(series.buckets.empty()) {
+            series.first = index;
+        } else if(index < series.first) {
+            Rollup_BUCKET empty;
+            emptyBucket(&empty);
+            series.buckets.insert(series.buckets.begin(), series.first - index, empty);
+            series.first = index;
+        }
+        size_t offset = index - series.first;
+        if(offset >= series.buckets.size()) {
+            Rollup_BUCKET empty;
+            emptyBucket(&empty);
+            series.buckets.resize(offset + 1, empty);
+        }
+        Rollup_BUCKET& bucket = series.buckets[offset];
+        bucket.count++;
+        for(uint8_t m = 0; m < TS_COLUMNS; m++) {
+            if(values[m] < bucket.min[m]) bucket.min[m] = values[m];
+            if(values[m] > bucket.max[m]) bucket.max[m] = values[m];
+            bucket.sum[m] += values[m];
+        }
+    }
+}
+
+/// @brief Query planner: the coarsest level whose buckets add up to exactly one step
+/// @param step_us 
+///        Spacing of the points asked for
+/// @return The level, Raw if the step is finer than a minute or not a whole number of minutes
+ROLLUP_LEVEL RollupIndex::plan(uint64_t step_us) {
+    for(uint8_t l = ROLLUP_LEVELS; l > 0; l--) {
+        if(step_us >= ROLLUP_WIDTH_US[l] && step_us % ROLLUP_WIDTH_US[l] == 0) return (ROLLUP_LEVEL)l;
+    }
+    return ROLLUP_LEVEL::Raw;
+}
+
+/// @brief Points of one metric every step_us from from (rounded down to a step) up to to
+/// @param level 
+///        Level to read, normally plan(step_us), must not be Raw
+/// @param out 
+///        Output, one point per step, empty steps included with a count of 0
+/// @return Number of buckets read
+size_t RollupIndex::series(uint16_t node, uint8_t metric, uint64_t from, uint64_t to, uint64_t step_us, ROLLUP_LEVEL level,
+                           std::vector<Rollup_POINT>& out) const {
+    out.clear();
+    uint8_t l = (uint8_t)level;
+    if(l == 0 || l > ROLLUP_LEVELS || metric >= TS_COLUMNS || step_us % ROLLUP_WIDTH_US[l] != 0 || to < from) return 0;
+    auto found = _nodes.find(node);
+    const Series* series = (found != _nodes.end()) ? &found->second[l - 1] : nullptr;
+    uint64_t width = ROLLUP_WIDTH_US[l];
+    size_t read = 0;
+
+    for(uint64_t t = from - from % step_us; t <= to; t += step_us) {
+        Rollup_POINT point = {t, 0, std::numeric_limits<float>::infinity(), -std::numeric_limits<float>::infinity(), 0.0};
+        if(series != nullptr) {
+            for(int64_t index = t / width; index < (int64_t)((t + step_us) / width); index++) {
+                const Rollup_BUCKET* b = bucket(*series, index);
+                if(b != nullptr) merge(&point, *b, metric);
+                read++;
+            }
+        }
+        out.push_back(point);
+    }
+    return read;
+}
+
+/// @brief Count, min, max and sum of one metric over a time range, exact to whole minutes: every
+///        minute that overlaps the range is included. The range is covered with the fewest buckets,
+///        days where whole days fit, hours next to them and minutes at the ends
+/// @param out 
+///        Output, timestamp is from rounded down to a minute
+/// @return True if the node has any rows in the range
+bool RollupIndex::aggregate(uint16_t node, uint8_t metric, uint64_t from, uint64_t to, Rollup_POINT* out) const {
+    const uint64_t minute = ROLLUP_WIDTH_US[1];
+    uint64_t cursor = from - from % minute;
+    uint64_t end = to - to % minute + minute;   // Exclusive
+    *out = {cursor, 0, std::numeric_limits<float>::infinity(), -std::numeric_limits<float>::infinity(), 0.0};
+    auto found = _nodes.find(node);
+    if(found == _nodes.end() || metric >= TS_COLUMNS || to < from) return false;
+
+    // Nothing outside the minutes the node has data for, open ended ranges cost no more
+    const Series& minutes = found->second[0];
+    uint64_t first = (uint64_t)minutes.first * minute;
+    uint64_t last = first + minutes.buckets.size() * minute;
+    if(cursor < first) cursor = first;
+    if(end > last) end = last;
+
+    while(cursor < end) {
+        uint8_t l = ROLLUP_LEVELS;
+        while(l > 1 && (cursor % ROLLUP_WIDTH_US[l] != 0 || cursor + ROLLUP_WIDTH_US[l] > end)) l--;
+        const Rollup_BUCKET* b = bucket(found->second[l - 1], cursor / ROLLUP_WIDTH_US[l]);
+        if(b != nullptr) merge(out, *b, metric);
+        cursor += ROLLUP_WIDTH_US[l];
+    }
+    return out->count > 0;
+}
+
+/// @brief Buckets held, for sizing
+size_t RollupIndex::buckets(void) const {
+    size_t n = 0;
+    for(auto& node : _nodes) {
+        for(const Series& series : node.second) n += series.buckets.size();
+    }
+    return n;
+}
+
+/// @brief Write the whole index to a temporary file renamed over path, so a reader never sees
+///        a half written index while the writer saves it
+/// @param raw_bytes 
+///        Size of the raw file it covers, a block boundary
+bool RollupIndex::save(const char* path, uint64_t raw_bytes) const {
+    std::string temp_path = std::string(path) + ".tmp";
+    FILE* file = fopen(temp_path.c_str(), "wb");
+    if(file == nullptr) return false;
+    Rollup_FILE_HEADER header = {ROLLUP_MAGIC, ROLLUP_VERSION, ROLLUP_LEVELS, TS_COLUMNS, raw_bytes,
+                                 (uint32_t)(_nodes.size() * ROLLUP_LEVELS), 0};
+    bool ok = fwrite(&header, sizeof(header), 1, file) == 1;
+    for(auto& node : _nodes) {
+        for(uint8_t l = 0; ok && l < ROLLUP_LEVELS; l++) {
+            const Series& series = node.second[l];
+            Rollup_SERIES_HEADER record = {node.first, l, 0, (uint32_t)series.buckets.size(), series.first};
+            ok = fwrite(&record, sizeof(record), 1, file) == 1 &&
+                 fwrite(series.buckets.data(), sizeof(Rollup_BUCKET), series.buckets.size(), file) == series.buckets.size();
+        }
+    }
+    ok &= fclose(file) == 0;
+    if(ok) ok = rename(temp_path.c_str(), path) == 0;
+    else remove(temp_path.c_str());
+    return ok;
+}
+
+/// @brief Read an index saved by save()
+/// @param raw_bytes 
+///        Output, size of the raw file the index covers. Blocks after it are not in the index
+/// @return True if loaded, false if missing or unreadable
+bool RollupIndex::load(const char* path, uint64_t* raw_bytes) {
+    clear();
+    FILE* file = fopen(path, "rb");
+    if(file == nullptr) return false;
+    Rollup_FILE_HEADER header;
+    bool ok = fread(&header, sizeof(header), 1, file) == 1 && header.magic == ROLLUP_MAGIC &&
+              header.version == ROLLUP_VERSION && header.levels == ROLLUP_LEVELS &&
+              header.metrics == TS_COLUMNS;
+    for(uint32_t i = 0; ok && i < header.series; i++) {
+        Rollup_SERIES_HEADER record;
+        ok = fread(&record, sizeof(record), 1, file) == 1 && record.level < ROLLUP_LEVELS;
+        if(!ok) break;
+        Series& series = _nodes[record.node][record.level];
+        series.first = record.first;
+        series.buckets.resize(record.count);
+        ok = fread(series.buckets.data(), sizeof(Rollup_BUCKET), record.count, file) == record.count;
+    }
+    fclose(file);
+    if(!ok) clear();
+    else *raw_bytes = header.raw_bytes;
+    return ok;
+}
+
+const Rollup_BUCKET* RollupIndex::bucket(const Series& series, int64_t index) const {
+    if(index < series.first || index - series.first >= (int64_t)series.buckets.size()) return nullptr;
+    const Rollup_BUCKET* b = &series.buckets[index - series.first];
+    return b->count ? b : nullptr;
+}
+
+void RollupIndex::merge(Rollup_POINT* point, const Rollup_BUCKET& bucket, uint8_t metric) {
+    point->count += bucket.count;
+    if(bucket.min[metric] < point->min) point->min = bucket.min[metric];
+    if(bucket.max[metric] > point->max) point->max = bucket.max[metric];
+    point->sum += bucket.sum[metric];
+}
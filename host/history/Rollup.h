@@ -0,0 +1,72 @@
+/*
+ *  Title: Rollup.h
+ *  Description: Multi-resolution rollups of packet history. Every row updates a 1 minute, a 1 hour
+ *               and a 1 day bucket of its node with count, min, max and sum per metric, so a query
+ *               over any length of history reads a bounded number of buckets
+ *  Author: Tinna Osk Traustadottir
+ */
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <array>
+#include <map>
+#include <vector>
+#include <TsFile.h>
+
+/// @brief Resolutions, finest first. Raw is the .aqts rows themselves
+enum class ROLLUP_LEVEL : uint8_t {
+    Raw = 0,
+    Minute,
+    Hour,
+    Day,
+};
+
+const uint8_t ROLLUP_LEVELS = 3;    // Rolled up levels, Minute to Day
+const uint64_t ROLLUP_WIDTH_US[ROLLUP_LEVELS + 1] = {0, 60000000ull, 3600000000ull, 86400000000ull};
+
+/// @brief One bucket of one node, all metrics
+struct Rollup_BUCKET {
+    uint32_t count;                 // Rows in the bucket, 0 if empty
+    float min[TS_COLUMNS];
+    float max[TS_COLUMNS];
+    double sum[TS_COLUMNS];
+};
+
+/// @brief Query result for one metric over a span of time
+struct Rollup_POINT {
+    uint64_t timestamp;             // Start of the span, microseconds
+    uint32_t count;
+    float min;
+    float max;
+    double sum;
+
+    double mean(void) const { return count ? sum / count : 0.0; }
+};
+
+class RollupIndex {
+public:
+    void add(uint16_t node, uint64_t timestamp, const float* values);
+    void clear(void) { _nodes.clear(); }
+
+    static ROLLUP_LEVEL plan(uint64_t step_us);
+    size_t series(uint16_t node, uint8_t metric, uint64_t from, uint64_t to, uint64_t step_us, ROLLUP_LEVEL level,
+                  std::vector<Rollup_POINT>& out) const;
+    bool aggregate(uint16_t node, uint8_t metric, uint64_t from, uint64_t to, Rollup_POINT* out) const;
+
+    bool save(const char* path, uint64_t raw_bytes) const;
+    bool load(const char* path, uint64_t* raw_bytes);
+
+    size_t buckets(void) const;
+
+private:
+    /// @brief Dense run of buckets of one node at one level, bucket i covers (first + i) * width
+    struct Series {
+        int64_t first = 0;
+        std::vector<Rollup_BUCKET> buckets;
+    };
+
+    std::map<uint16_t, std::array<Series, ROLLUP_LEVELS>> _nodes;
+
+    const Rollup_BUCKET* bucket(const Series& series, int64_t index) const;
+    static void merge(Rollup_POINT* point, const Rollup_BUCKET& bucket, uint8_t metric);
+};
@@ -0,0 +1,64 @@
+/*
+ *  Title: histquery.cpp
+ *  Description: Queries one metric of one node from an .aqts history through its rollup index,
+ *               printing CSV points, or a single aggregate when STEP is 0. The index is built and
+ *               saved next to the file the first time
+ *
+ *               histquery FILE.aqts NODE METRIC FROM TO STEP
+ *
+ *               FROM, TO and STEP in seconds, FROM and TO since the Unix epoch
+ *  Author: Tinna Osk Traustadottir
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include "History.h"
+
+static const char* LEVEL_NAMES[ROLLUP_LEVELS + 1] = {"raw", "minute", "hour", "day"};
+
+int main(int argc, char** argv) {
+    if(argc != 7) {
+        fprintf(stderr, "usage: histquery FILE.aqts NODE METRIC FROM TO STEP\n");
+        return 2;
+    }
+    uint16_t node = (uint16_t)strtoul(argv[2], nullptr, 10);
+    uint8_t metric = TS_COLUMNS;
+    for(uint8_t c = 0; c < TS_COLUMNS; c++) {
+        if(!strcmp(argv[3], TS_COLUMN_NAMES[c])) metric = c;
+    }
+    if(metric == TS_COLUMNS) {
+        fprintf(stderr, "histquery: unknown metric %s\n", argv[3]);
+        return 2;
+    }
+    uint64_t from = strtoull(argv[4], nullptr, 10) * 1000000ull;
+    uint64_t to = strtoull(argv[5], nullptr, 10) * 1000000ull;
+    uint64_t step = strtoull(argv[6], nullptr, 10) * 1000000ull;
+
+    History history;
+    if(!history.open(argv[1])) {
+        fprintf(stderr, "histquery: can't open %s\n", argv[1]);
+        return 1;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    std::vector<Rollup_POINT> points;
+    ROLLUP_LEVEL level = ROLLUP_LEVEL::Raw;
+    if(step == 0) {
+        points.resize(1);
+        history.aggregate(node, metric, from, to, &points[0]);
+    } else {
+        level = history.series(node, metric, from, to, step, points);
+    }
+    double us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+
+    printf("timestamp,count,min,max,mean\n");
+    for(const Rollup_POINT& point : points) {
+        if(point.count == 0) printf("%llu,0,,,\n", (unsigned long long)(point.timestamp / 1000000));
+        else printf("%llu,%u,%g,%g,%g\n", (unsigned long long)(point.timestamp / 1000000), point.count,
+                    point.min, point.max, point.mean());
+    }
+    if(step == 0) fprintf(stderr, "histquery: aggregated from the rollups in %.1f us\n", us);
+    else fprintf(stderr, "histquery: %zu points from the %s level in %.1f us\n", points.size(), LEVEL_NAMES[(uint8_t)level], us);
+    return 0;
+}
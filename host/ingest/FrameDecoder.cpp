@@ -0,0 +1,30 @@
+/*
+ *  Title: FrameDecoder.cpp
+ *  Description: Table driven CRC for the telemetry frame decoder
+ *  Author: Tinna Osk Traustadottir
+ */
+#include "FrameDecoder.h"
+
+/// @brief Build the 256 entry table of the CRC-16/CCITT-FALSE polynomial
+struct CrcTable {
+    uint16_t entry[256];
+    CrcTable() {
+        for(int i = 0; i < 256; i++) {
+            uint16_t crc = (uint16_t)(i << 8);
+            for(int bit = 0; bit < 8; bit++) {
+                crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : (crc << 1);
+            }
+            entry[i] = crc;
+        }
+    }
+};
+
+static const CrcTable crc_table;
+
+uint16_t ingestCrc(const uint8_t* data, size_t length) {
+    uint16_t crc = 0xFFFF;
+    for(size_t i = 0; i < length; i++) {
+        crc = (uint16_t)(crc << 8) ^ crc_table.entry[(crc >> 8) ^ data[i]];
+    }
+    return crc;
+}
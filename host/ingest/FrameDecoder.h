@@ -0,0 +1,109 @@
+/*
+ *  Title: FrameDecoder.h
+ *  Description: Splits a byte stream from one node, or a gateway's interleaved nodes, into
+ *               telemetry frames. Resyncs on the sync word after garbage or a bad CRC. Same checks as telemetryDecode() but with a table driven
+ *               CRC, the bitwise one costs more than everything else on the ingest path
+ *  Author: Tinna Osk Traustadottir
+ */
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <unordered_map>
+#include <vector>
+#include <TelemetryFrame.h>
+
+const uint16_t FRAMEDECODER_REORDER_WINDOW = 64;   // Sequence numbers this far behind a node's are duplicates or late frames
+
+/// @brief CRC-16/CCITT-FALSE, identical to telemetryCrc()
+uint16_t ingestCrc(const uint8_t* data, size_t length);
+
+/// @brief Counters of one decoder, owned by the thread that feeds it
+struct FrameDecoder_STATS {
+    uint64_t frames = 0;        // Valid frames
+    uint64_t crc_errors = 0;    // Frames with a good header that failed the CRC
+    uint64_t skipped = 0;       // Bytes thrown away while looking for a sync word
+    uint64_t lost = 0;          // Frames missing according to the sequence numbers of each node
+    uint64_t reordered = 0;     // Frames behind their node's sequence, duplicates or late, still passed on
+};
+
+class FrameDecoder {
+public:
+    /// @brief Called for every valid frame, payload points at header.length bytes
+    template<typename OnFrame>
+    void feed(const uint8_t* data, size_t length, OnFrame on_frame);
+
+    const FrameDecoder_STATS& stats(void) const { return _stats; }
+
+private:
+    std::vector<uint8_t> _buffer;   // Bytes of an incomplete frame carried over to the next feed
+    FrameDecoder_STATS _stats;
+    std::unordered_map<uint16_t, uint16_t> _next_seq;  // By node
+    uint16_t _last_node = 0;
+    uint16_t* _last_seq = nullptr;  // Entry of _last_node, the lookup is skipped for runs of one node
+
+    template<typename OnFrame>
+    size_t parse(const uint8_t* data, size_t length, OnFrame& on_frame);
+};
+
+template<typename OnFrame>
+void FrameDecoder::feed(const uint8_t* data, size_t length, OnFrame on_frame) {
+    if(_buffer.empty()) {
+        // Fast path, parse straight out of the caller's bytes and only keep the tail
+        size_t used = parse(data, length, on_frame);
+        _buffer.assign(data + used, data + length);
+        return;
+    }
+    _buffer.insert(_buffer.end(), data, data + length);
+    size_t used = parse(_buffer.data(), _buffer.size(), on_frame);
+    _buffer.erase(_buffer.begin(), _buffer.begin() + used);
+}
+
+/// @return Number of bytes consumed, the rest is an incomplete frame
+template<typename OnFrame>
+size_t FrameDecoder::parse(const uint8_t* data, size_t length, OnFrame& on_frame) {
+    const uint8_t sync_lo = TELEMETRY_SYNC & 0xFF, sync_hi = TELEMETRY_SYNC >> 8;
+    size_t pos = 0;
+    while(length - pos >= sizeof(TelemetryFrame_HEADER)) {
+        if(data[pos] != sync_lo || data[pos + 1] != sync_hi) {
+            pos++;
+            _stats.skipped++;
+            continue;
+        }
+        TelemetryFrame_HEADER header;
+        memcpy(&header, data + pos, sizeof(header));
+        if(header.length > TELEMETRY_MAX_PAYLOAD) {
+            pos++;
+            _stats.skipped++;
+            continue;
+        }
+        size_t n = sizeof(TelemetryFrame_HEADER) + header.length;
+        if(length - pos < n + 2) break;
+        uint16_t crc = (uint16_t)data[pos + n] | ((uint16_t)data[pos + n + 1] << 8);
+        if(ingestCrc(data + pos, n) != crc) {
+            pos++;
+            _stats.crc_errors++;
+            continue;
+        }
+        if(_last_seq == nullptr || header.node != _last_node) {
+            uint16_t node = header.node, seq = header.seq;     // Packed fields
+            auto found = _next_seq.emplace(node, seq);
+            _last_node = node;
+            _last_seq = &found.first->second;
+        }
+        // A node restarts its count at 0 when it boots, that's not a gap. A frame a little behind
+        // the sequence is a duplicate or arrived late and doesn't move it, one far behind is a
+        // node that rebooted and lost its first frames
+        uint16_t seq = header.seq;
+        uint16_t ahead = seq - *_last_seq;
+        if((uint16_t)(*_last_seq - seq) <= FRAMEDECODER_REORDER_WINDOW && ahead != 0 && seq != 0) {
+            _stats.reordered++;
+        } else {
+            if(ahead < 0x8000 && seq != 0) _stats.lost += ahead;
+            *_last_seq = seq + 1;
+        }
+        _stats.frames++;
+        on_frame(header, data + pos + sizeof(TelemetryFrame_HEADER));
+        pos += n + 2;
+    }
+    return pos;
+}
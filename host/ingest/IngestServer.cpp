@@ -0,0 +1,516 @@
+/*
+ *  Title: IngestServer.cpp
+ *  Description: Collects telemetry from many nodes at once
+ *  Author: Tinna Osk Traustadottir
+ */
+#include "IngestServer.h"
+#include "FrameDecoder.h"
+#include <stdio.h>
+#include <string.h>
+#include <chrono>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <termios.h>
+#include <netinet/in.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+const size_t INGEST_READ_CHUNK = 64 * 1024;     // Largest single read() and ring pop
+const unsigned INGEST_BATCHES = 8;              // Batches in flight per worker
+const int INGEST_EPOLL_EVENTS = 64;
+
+struct IngestServer::Connection {
+    int fd;
+    std::string name;
+    SpscRing<uint8_t> ring;             // I/O thread to worker
+    std::atomic<bool> closed{false};    // Set by the I/O thread after its last push
+    FrameDecoder decoder;               // Worker only
+
+    Connection(int fd, const std::string& name, size_t ring_bytes) : fd(fd), name(name), ring(ring_bytes) {};
+};
+
+struct IngestServer::Batch {
+    size_t count = 0;
+    std::vector<IngestSample> samples;
+};
+
+struct IngestServer::Worker {
+    std::thread thread;
+    std::mutex lock;                    // Guards incoming
+    std::vector<std::shared_ptr<Connection>> incoming;
+    std::atomic<bool> has_incoming{false};
+    std::vector<std::shared_ptr<Connection>> connections;
+    std::vector<Batch> batches;
+    SpscRing<Batch*> full{INGEST_BATCHES};     // Worker to writer
+    SpscRing<Batch*> empty{INGEST_BATCHES};    // Writer back to worker
+    std::atomic<bool> done{false};
+};
+
+/// @brief Back off a thread that found no work: yield first, so a single core keeps moving,
+///        then sleep so an idle server doesn't burn a core
+struct Backoff {
+    unsigned idle = 0;
+    void reset(void) { idle = 0; }
+    void wait(void) {
+        if(++idle < 64) std::this_thread::yield();
+        else std::this_thread::sleep_for(std::chrono::microseconds(200));
+    }
+};
+
+/// @brief Microseconds since the Unix epoch
+static uint64_t nowUs(void) {
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+static bool setNonBlocking(int fd) {
+    int flags = fcntl(fd, F_GETFL, 0);
+    return flags >= 0 && fcntl(fd, F_SETFL, flags | O_NONBLOCK) == 0;
+}
+
+IngestServer::IngestServer(SampleStore& store, const IngestServer_OPTIONS& options) : _store(store), _options(options) {
+    if(_options.workers == 0) _options.workers = 1;
+    _epoll = epoll_create1(EPOLL_CLOEXEC);
+    _wake = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    epoll_event event = {};
+    event.events = EPOLLIN;
+    event.data.fd = _wake;
+    epoll_ctl(_epoll, EPOLL_CTL_ADD, _wake, &event);
+}
+
+IngestServer::~IngestServer() {
+    stop();
+    for(int fd : _listeners) close(fd);
+    for(auto& pending : _pending) close(pending.first);
+    if(_wake >= 0) close(_wake);
+    if(_epoll >= 0) close(_epoll);
+}
+
+/// @brief Accept gateway connections on a TCP port, on all interfaces
+/// @param port 
+///        Port number
+/// @return True if listening, false if not
+bool IngestServer::listenTcp(uint16_t port) {
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC | SOCK_NONBLOCK, 0);
+    if(fd < 0) return false;
+    int yes = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(yes));
+    sockaddr_in address = {};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_ANY);
+    address.sin_port = htons(port);
+    if(bind(fd, (sockaddr*)&address, sizeof(address)) != 0 || listen(fd, 64) != 0) {
+        close(fd);
+        return false;
+    }
+    _listeners.push_back(fd);
+    return true;
+}
+
+/// @brief Accept gateway connections on a Unix socket, replacing a stale socket file
+/// @param path 
+///        Socket path
+/// @return True if listening, false if not
+bool IngestServer::listenUnix(const char* path) {
+    sockaddr_un address = {};
+    if(strlen(path) >= sizeof(address.sun_path)) return false;
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC | SOCK_NONBLOCK, 0);
+    if(fd < 0) return false;
+    address.sun_family = AF_UNIX;
+    strcpy(address.sun_path, path);
+    unlink(path);
+    if(bind(fd, (sockaddr*)&address, sizeof(address)) != 0 || listen(fd, 64) != 0) {
+        close(fd);
+        return false;
+    }
+    _listeners.push_back(fd);
+    return true;
+}
+
+/// @brief Read a node on a serial or USB CDC device, raw 8N1 at 115200 baud
+/// @param device 
+///        Device path, e.g. /dev/ttyACM0
+/// @return True if opened, false if not
+bool IngestServer::openSerial(const char* device) {
+    int fd = open(device, O_RDONLY | O_NOCTTY | O_NONBLOCK | O_CLOEXEC);
+    if(fd < 0) return false;
+    termios tty;
+    if(tcgetattr(fd, &tty) != 0) {
+        close(fd);
+        return false;
+    }
+    cfmakeraw(&tty);
+    cfsetspeed(&tty, B115200);
+    tty.c_cflag |= CLOCAL | CREAD;
+    if(tcsetattr(fd, TCSANOW, &tty) != 0) {
+        close(fd);
+        return false;
+    }
+    return addFd(fd, device);
+}
+
+/// @brief Take over an open stream, e.g. one end of a socketpair. Safe from any thread
+/// @param fd 
+///        File descriptor, the server closes it
+/// @param name 
+///        Name for log messages
+/// @return True if queued for the I/O thread, false if not
+bool IngestServer::addFd(int fd, const char* name) {
+    if(!setNonBlocking(fd)) return false;
+    {
+        std::lock_guard<std::mutex> guard(_pending_lock);
+        _pending.emplace_back(fd, name);
+    }
+    uint64_t one = 1;
+    return ::write(_wake, &one, sizeof(one)) == sizeof(one);
+}
+
+/// @brief Start the I/O, decoder and writer threads
+/// @return True if started, false if already running
+bool IngestServer::start(void) {
+    if(_running.load()) return false;
+    for(int fd : _listeners) {
+        epoll_event event = {};
+        event.events = EPOLLIN;
+        event.data.fd = fd;
+        epoll_ctl(_epoll, EPOLL_CTL_ADD, fd, &event);
+        _endpoints[fd] = Endpoint{ENDPOINT::Listener, nullptr};
+    }
+
+    _running = true;
+    _decoding = true;
+    for(unsigned i = 0; i < _options.workers; i++) {
+        std::unique_ptr<Worker> worker(new Worker());
+        worker->batches.resize(INGEST_BATCHES);
+        for(Batch& batch : worker->batches) {
+            batch.samples.resize(_options.batch_samples);
+            Batch* pointer = &batch;
+            worker->empty.push(pointer);
+        }
+        _workers.push_back(std::move(worker));
+    }
+    for(auto& worker : _workers) worker->thread = std::thread(&IngestServer::runWorker, this, worker.get());
+    _writer = std::thread(&IngestServer::runWriter, this);
+    _io = std::thread(&IngestServer::runIo, this);
+    return true;
+}
+
+/// @brief Stop reading, decode what is already buffered, write it and join every thread
+void IngestServer::stop(void) {
+    if(!_running.exchange(false)) return;
+    uint64_t one = 1;
+    if(::write(_wake, &one, sizeof(one)) != sizeof(one)) {}
+    _io.join();
+    _decoding = false;
+    for(auto& worker : _workers) worker->thread.join();
+    _writer.join();
+    _store.flush();
+    _workers.clear();
+}
+
+IngestServer_STATS IngestServer::stats(void) const {
+    IngestServer_STATS stats;
+    stats.connections = _counters.connections.load(std::memory_order_relaxed);
+    stats.accepted = _counters.accepted.load(std::memory_order_relaxed);
+    stats.bytes = _counters.bytes.load(std::memory_order_relaxed);
+    stats.frames = _counters.frames.load(std::memory_order_relaxed);
+    stats.samples = _counters.samples.load(std::memory_order_relaxed);
+    stats.alerts = _counters.alerts.load(std::memory_order_relaxed);
+    stats.raw = _counters.raw.load(std::memory_order_relaxed);
+    stats.crc_errors = _counters.crc_errors.load(std::memory_order_relaxed);
+    stats.skipped = _counters.skipped.load(std::memory_order_relaxed);
+    stats.lost = _counters.lost.load(std::memory_order_relaxed);
+    stats.reordered = _counters.reordered.load(std::memory_order_relaxed);
+    stats.ignored = _counters.ignored.load(std::memory_order_relaxed);
+    stats.written = _counters.written.load(std::memory_order_relaxed);
+    stats.batches = _counters.batches.load(std::memory_order_relaxed);
+    stats.stalls = _counters.stalls.load(std::memory_order_relaxed);
+    return stats;
+}
+
+/// @brief I/O thread: edge triggered epoll over every listener and connection. A connection whose
+///        ring is full is left unread (and the kernel buffer pushes back on the sender) until the
+///        worker makes room, then retried
+void IngestServer::runIo(void) {
+    epoll_event events[INGEST_EPOLL_EVENTS];
+    registerPending();
+
+    while(_running.load(std::memory_order_relaxed)) {
+        int timeout = _stalled.empty() ? 100 : 1;
+        int count = epoll_wait(_epoll, events, INGEST_EPOLL_EVENTS, timeout);
+        for(int i = 0; i < count; i++) {
+            int fd = events[i].data.fd;
+            if(fd == _wake) {
+                uint64_t value;
+                while(read(_wake, &value, sizeof(value)) > 0) {}
+                registerPending();
+                continue;
+            }
+            auto found = _endpoints.find(fd);
+            if(found == _endpoints.end()) continue;
+            if(found->second.kind == ENDPOINT::Listener) {
+                acceptAll(fd);
+            } else {
+                std::shared_ptr<Connection> connection = found->second.connection;
+                if(!drain(connection)) stall(connection);
+            }
+        }
+
+        for(size_t i = 0; i < _stalled.size();) {
+            if(drain(_stalled[i])) {
+                _stalled[i] = _stalled.back();
+                _stalled.pop_back();
+            } else {
+                i++;
+            }
+        }
+    }
+
+    for(auto& entry : _endpoints) {
+        if(entry.second.kind == ENDPOINT::Stream) {
+            close(entry.first);
+            entry.second.connection->closed.store(true, std::memory_order_release);
+        }
+    }
+    _endpoints.clear();
+    _stalled.clear();
+}
+
+/// @brief Stop reading a connection until its worker has made room in the ring
+void IngestServer::stall(const std::shared_ptr<Connection>& connection) {
+    for(auto& stalled : _stalled) {
+        if(stalled == connection) return;
+    }
+    _stalled.push_back(connection);
+    _counters.stalls++;
+}
+
+/// @brief Register fds handed over by addFd()
+void IngestServer::registerPending(void) {
+    std::vector<std::pair<int, std::string>> pending;
+    {
+        std::lock_guard<std::mutex> guard(_pending_lock);
+        pending.swap(_pending);
+    }
+    for(auto& entry : pending) attach(entry.first, entry.second);
+}
+
+/// @brief Give a new stream a ring and a worker, then start reading it
+void IngestServer::attach(int fd, const std::string& name) {
+    std::shared_ptr<Connection> connection = std::make_shared<Connection>(fd, name, _options.ring_bytes);
+    Worker* worker = _workers[_next_worker++ % _workers.size()].get();
+    {
+        std::lock_guard<std::mutex> guard(worker->lock);
+        worker->incoming.push_back(connection);
+        worker->has_incoming.store(true, std::memory_order_release);
+    }
+    _endpoints[fd] = Endpoint{ENDPOINT::Stream, connection};
+
+    epoll_event event = {};
+    event.events = EPOLLIN | EPOLLRDHUP | EPOLLET;
+    event.data.fd = fd;
+    epoll_ctl(_epoll, EPOLL_CTL_ADD, fd, &event);
+    _counters.connections++;
+    _counters.accepted++;
+    printf("ingest: %s connected\n", name.c_str());
+    if(!drain(connection)) stall(connection); // Bytes may have arrived before registration
+}
+
+void IngestServer::acceptAll(int listener) {
+    while(true) {
+        int fd = accept4(listener, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if(fd < 0) return;
+        attach(fd, "socket " + std::to_string(fd));
+    }
+}
+
+/// @brief Read a connection until the kernel has nothing more or the ring is full
+/// @return True if the connection is drained or closed, false if it stalled on a full ring
+bool IngestServer::drain(const std::shared_ptr<Connection>& connection) {
+    static uint8_t buffer[INGEST_READ_CHUNK];
+    if(connection->closed.load(std::memory_order_relaxed)) return true;
+
+    while(true) {
+        size_t space = connection->ring.capacity() - connection->ring.size();
+        if(space == 0) return false;
+        ssize_t n = read(connection->fd, buffer, space < sizeof(buffer) ? space : sizeof(buffer));
+        if(n > 0) {
+            connection->ring.push(buffer, (size_t)n);
+            _counters.bytes.fetch_add(n, std::memory_order_relaxed);
+            continue;
+        }
+        if(n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) return true;
+        if(n < 0 && errno == EINTR) continue;
+        detach(connection);
+        return true;
+    }
+}
+
+/// @brief End of stream or read error, the worker finishes what is in the ring
+void IngestServer::detach(const std::shared_ptr<Connection>& connection) {
+    epoll_ctl(_epoll, EPOLL_CTL_DEL, connection->fd, nullptr);
+    _endpoints.erase(connection->fd);
+    close(connection->fd);
+    connection->closed.store(true, std::memory_order_release);
+    _counters.connections--;
+    printf("ingest: %s disconnected\n", connection->name.c_str());
+}
+
+/// @brief Decoder thread: split its connections' rings into frames and fill sample batches
+void IngestServer::runWorker(Worker* worker) {
+    static thread_local uint8_t buffer[INGEST_READ_CHUNK];
+    Batch* batch = nullptr;
+    auto batch_started = std::chrono::steady_clock::now();
+    Backoff backoff;
+
+    // Hand the current batch to the writer, waiting for it if every batch is in flight
+    auto handOff = [&]() {
+        while(!worker->full.push(batch)) std::this_thread::yield();
+        batch = nullptr;
+    };
+
+    while(true) {
+        if(worker->has_incoming.load(std::memory_order_acquire)) {
+            std::lock_guard<std::mutex> guard(worker->lock);
+            for(auto& connection : worker->incoming) worker->connections.push_back(connection);
+            worker->incoming.clear();
+            worker->has_incoming.store(false, std::memory_order_relaxed);
+        }
+
+        bool worked = false;
+        uint64_t received = nowUs();
+        for(size_t i = 0; i < worker->connections.size();) {
+            Connection* connection = worker->connections[i].get();
+            bool closed = connection->closed.load(std::memory_order_acquire);
+            size_t n = connection->ring.pop(buffer, sizeof(buffer));
+            if(n == 0) {
+                if(closed) {
+                    worker->connections[i] = worker->connections.back();
+                    worker->connections.pop_back();
+                    continue;
+                }
+                i++;
+                continue;
+            }
+            worked = true;
+
+            FrameDecoder_STATS before = connection->decoder.stats();
+            uint64_t samples = 0, alerts = 0, raw = 0, ignored = 0;
+            connection->decoder.feed(buffer, n, [&](const TelemetryFrame_HEADER& header, const uint8_t* payload) {
+                if(header.type == TELEMETRY_ALERT) {
+                    alerts++;
+                    return;
+                }
+                bool is_raw = header.type == TELEMETRY_RAW && header.length >= telemetryRawLength(0) &&
+                              header.length <= sizeof(TelemetryFrame_RAW);
+                if(!is_raw && (header.type != TELEMETRY_SAMPLE || header.length != sizeof(packet_t))) {
+                    ignored++;
+                    return;
+                }
+                while(batch == nullptr && !worker->empty.pop(&batch)) std::this_thread::yield();
+                if(batch->count == 0) batch_started = std::chrono::steady_clock::now();
+
+                IngestSample& sample = batch->samples[batch->count++];
+                sample.timestamp = header.timestamp;
+                sample.received = received;
+                sample.node = header.node;
+                sample.seq = header.seq;
+                sample.type = header.type;
+                if(is_raw) {
+                    TelemetryFrame_RAW frame = {};
+                    memcpy(&frame, payload, header.length);
+                    sample.source = frame.source;
+                    sample.count = frame.count <= TELEMETRY_RAW_CODES ? frame.count : TELEMETRY_RAW_CODES;
+                    sample.adc = (frame.gain & 0x0F) | frame.osr << 4;
+                    memcpy(sample.codes, frame.codes, sizeof(sample.codes));    // Past count, zeros
+                    raw++;
+                    if(batch->count == batch->samples.size()) handOff();
+                    return;
+                }
+
+                packet_t packet;
+                memcpy(packet.raw, payload, sizeof(packet.raw));
+                sample.source = 0;
+                sample.count = 0;
+                sample.adc = 0;
+                sample.values[0] = packet.temperature;
+                sample.values[1] = packet.no2;
+                sample.values[2] = packet.humidity;
+                sample.values[3] = packet.co2;
+                sample.values[4] = packet.pm10;
+                sample.values[5] = packet.pm4;
+                sample.values[6] = packet.pm2_5;
+                sample.values[7] = packet.pm1;
+                samples++;
+                if(batch->count == batch->samples.size()) handOff();
+            });
+            const FrameDecoder_STATS& after = connection->decoder.stats();
+            _counters.frames.fetch_add(after.frames - before.frames, std::memory_order_relaxed);
+            _counters.crc_errors.fetch_add(after.crc_errors - before.crc_errors, std::memory_order_relaxed);
+            _counters.skipped.fetch_add(after.skipped - before.skipped, std::memory_order_relaxed);
+            _counters.lost.fetch_add(after.lost - before.lost, std::memory_order_relaxed);
+            _counters.reordered.fetch_add(after.reordered - before.reordered, std::memory_order_relaxed);
+            _counters.ignored.fetch_add(ignored, std::memory_order_relaxed);
+            _counters.samples.fetch_add(samples, std::memory_order_relaxed);
+            _counters.alerts.fetch_add(alerts, std::memory_order_relaxed);
+            _counters.raw.fetch_add(raw, std::memory_order_relaxed);
+            i++;
+        }
+
+        if(batch != nullptr && batch->count > 0 &&
+           std::chrono::steady_clock::now() - batch_started > std::chrono::milliseconds(_options.flush_ms)) {
+            handOff();
+        }
+
+        if(worked) {
+            backoff.reset();
+            continue;
+        }
+        if(!_decoding.load(std::memory_order_acquire)) break;
+        backoff.wait();
+    }
+
+    if(batch != nullptr && batch->count > 0) handOff();
+    worker->done.store(true, std::memory_order_release);
+}
+
+/// @brief Writer thread: pass full batches to the store and return them to their worker
+void IngestServer::runWriter(void) {
+    Backoff backoff;
+    auto last_flush = std::chrono::steady_clock::now();
+
+    while(true) {
+        bool worked = false;
+        bool all_done = true;
+        for(auto& worker : _workers) {
+            bool done = worker->done.load(std::memory_order_acquire);
+            Batch* batch;
+            while(worker->full.pop(&batch)) {
+                if(_store.write(batch->samples.data(), batch->count)) {
+                    _counters.written.fetch_add(batch->count, std::memory_order_relaxed);
+                }
+                _counters.batches++;
+                batch->count = 0;
+                worker->empty.push(batch);
+                worked = true;
+            }
+            if(!done) all_done = false;
+        }
+
+        auto now = std::chrono::steady_clock::now();
+        if(now - last_flush > std::chrono::milliseconds(_options.flush_ms)) {
+            _store.flush();
+            last_flush = now;
+        }
+
+        if(worked) {
+            backoff.reset();
+            continue;
+        }
+        if(all_done) break;
+        backoff.wait();
+    }
+}
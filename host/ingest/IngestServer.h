@@ -0,0 +1,108 @@
+/*
+ *  Title: IngestServer.h
+ *  Description: Collects telemetry from many nodes at once. One I/O thread reads every serial
+ *               device and socket into a lock-free ring per connection, a pool of decoder threads
+ *               splits the rings into frames and fills sample batches, and one writer thread
+ *               hands the batches to the store
+ *  Author: Tinna Osk Traustadottir
+ */
+#pragma once
+#include <stdint.h>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include "SampleStore.h"
+#include "SpscRing.h"
+
+struct IngestServer_OPTIONS {
+    unsigned workers = 2;           // Decoder threads, connections are spread over them
+    size_t ring_bytes = 1 << 20;    // Per connection, the I/O thread stops reading a connection while its ring is full
+    size_t batch_samples = 4096;    // Samples per store write
+    uint32_t flush_ms = 200;        // Partial batches are written after this long
+};
+
+/// @brief Totals since start(). Rates are differences of two snapshots
+struct IngestServer_STATS {
+    uint64_t connections;   // Open now
+    uint64_t accepted;      // Opened since start
+    uint64_t bytes;         // Read from the connections
+    uint64_t frames;        // Valid frames of any type
+    uint64_t samples;       // TELEMETRY_SAMPLE frames decoded
+    uint64_t alerts;        // TELEMETRY_ALERT frames
+    uint64_t raw;           // TELEMETRY_RAW frames decoded
+    uint64_t crc_errors;
+    uint64_t skipped;       // Bytes dropped while resyncing
+    uint64_t lost;          // Frames missing from the sequence numbers
+    uint64_t reordered;     // Duplicate or late frames, behind their node's sequence
+    uint64_t ignored;       // Valid frames of a type or length that isn't stored, e.g. TELEMETRY_AQI
+    uint64_t written;       // Samples accepted by the store
+    uint64_t batches;       // Store writes
+    uint64_t stalls;        // Times a full ring made the I/O thread stop reading a connection
+};
+
+class IngestServer {
+public:
+    IngestServer(SampleStore& store, const IngestServer_OPTIONS& options = IngestServer_OPTIONS());
+    ~IngestServer();
+
+    bool listenTcp(uint16_t port);
+    bool listenUnix(const char* path);
+    bool openSerial(const char* device);
+    bool addFd(int fd, const char* name);
+
+    bool start(void);
+    void stop(void);
+
+    IngestServer_STATS stats(void) const;
+
+private:
+    struct Connection;
+    struct Batch;
+    struct Worker;
+
+    enum class ENDPOINT : uint8_t {Listener, Stream};
+
+    struct Endpoint {
+        ENDPOINT kind;
+        std::shared_ptr<Connection> connection;
+    };
+
+    SampleStore& _store;
+    IngestServer_OPTIONS _options;
+    int _epoll = -1;
+    int _wake = -1;                 // eventfd, wakes the I/O thread for new connections and stop
+    std::atomic<bool> _running{false};
+    std::atomic<bool> _decoding{false};
+
+    std::mutex _pending_lock;       // New fds from other threads, registered by the I/O thread
+    std::vector<std::pair<int, std::string>> _pending;
+    std::vector<int> _listeners;
+    std::unordered_map<int, Endpoint> _endpoints;   // I/O thread only
+    std::vector<std::shared_ptr<Connection>> _stalled;
+    unsigned _next_worker = 0;
+
+    std::vector<std::unique_ptr<Worker>> _workers;
+    std::thread _io;
+    std::thread _writer;
+
+    struct Counters {
+        std::atomic<uint64_t> connections{0}, accepted{0}, bytes{0}, frames{0}, samples{0}, alerts{0}, raw{0},
+                              crc_errors{0}, skipped{0}, lost{0}, reordered{0}, ignored{0}, written{0}, batches{0},
+                              stalls{0};
+    } _counters;
+
+    void runIo(void);
+    void runWorker(Worker* worker);
+    void runWriter(void);
+
+    void registerPending(void);
+    void attach(int fd, const std::string& name);
+    void acceptAll(int listener);
+    bool drain(const std::shared_ptr<Connection>& connection);
+    void stall(const std::shared_ptr<Connection>& connection);
+    void detach(const std::shared_ptr<Connection>& connection);
+};
@@ -0,0 +1,114 @@
+/*
+ *  Title: SampleStore.cpp
+ *  Description: Append-only sample log and the stores that wrap others
+ *  Author: Tinna Osk Traustadottir
+ */
+#include "SampleStore.h"
+#include <time.h>
+
+static_assert(INGEST_VALUES == TELEMETRY_RAW_CODES, "Raw codes share the sample values");
+
+const size_t LOGSTORE_BUFFER = 1 << 20;
+
+LogStore::~LogStore() {
+    if(_file != nullptr) fclose(_file);
+}
+
+/// @brief Open a log for appending, writing the header if the file is new
+/// @param path 
+///        File path
+/// @return True if successful, false if not or if the file is a log of another version
+bool LogStore::open(const char* path) {
+    _file = fopen(path, "a+b");
+    if(_file == nullptr) return false;
+    setvbuf(_file, nullptr, _IOFBF, LOGSTORE_BUFFER);
+
+    struct {
+        uint32_t magic;
+        uint16_t version;
+        uint16_t record;
+        uint64_t reserved;
+    } header;
+    fseek(_file, 0, SEEK_END);
+    if(ftell(_file) == 0) {
+        header = {LOGSTORE_MAGIC, LOGSTORE_VERSION, sizeof(IngestSample), 0};
+        return fwrite(&header, sizeof(header), 1, _file) == 1;
+    }
+    rewind(_file);
+    bool ok = fread(&header, sizeof(header), 1, _file) == 1 && header.magic == LOGSTORE_MAGIC &&
+              header.version == LOGSTORE_VERSION && header.record == sizeof(IngestSample);
+    fseek(_file, 0, SEEK_END);
+    return ok;
+}
+
+bool LogStore::write(const IngestSample* samples, size_t count) {
+    return fwrite(samples, sizeof(IngestSample), count, _file) == count;
+}
+
+void LogStore::flush(void) {
+    fflush(_file);
+}
+
+bool SplitStore::write(const IngestSample* samples, size_t count) {
+    size_t first_raw = 0;
+    while(first_raw < count && samples[first_raw].type != TELEMETRY_RAW) first_raw++;
+    if(first_raw == count) return _samples == nullptr || _samples->write(samples, count);  // No copies without raw capture
+
+    _split[0].clear();
+    _split[1].clear();
+    for(size_t i = 0; i < count; i++) _split[samples[i].type == TELEMETRY_RAW].push_back(samples[i]);
+    bool ok = true;
+    if(_samples != nullptr && !_split[0].empty()) ok &= _samples->write(_split[0].data(), _split[0].size());
+    if(_raw != nullptr && !_split[1].empty()) ok &= _raw->write(_split[1].data(), _split[1].size());
+    return ok;
+}
+
+void SplitStore::flush(void) {
+    if(_samples != nullptr) _samples->flush();
+    if(_raw != nullptr) _raw->flush();
+}
+
+/// @brief Log-linear bucket: exact below LATENCYSTORE_SUB us, then LATENCYSTORE_SUB per power of two
+static uint16_t bucketOf(uint64_t latency) {
+    if(latency < LATENCYSTORE_SUB) return (uint16_t)latency;
+    int shift = 63 - __builtin_clzll(latency) - 3;     // log2(LATENCYSTORE_SUB)
+    uint64_t bucket = LATENCYSTORE_SUB + shift * LATENCYSTORE_SUB + ((latency >> shift) - LATENCYSTORE_SUB);
+    return bucket < LATENCYSTORE_BUCKETS ? (uint16_t)bucket : LATENCYSTORE_BUCKETS - 1;
+}
+
+/// @brief Largest latency that falls in a bucket
+static uint64_t bucketTop(uint16_t bucket) {
+    if(bucket < LATENCYSTORE_SUB) return bucket;
+    int shift = (bucket - LATENCYSTORE_SUB) / LATENCYSTORE_SUB;
+    uint64_t mantissa = LATENCYSTORE_SUB + (bucket - LATENCYSTORE_SUB) % LATENCYSTORE_SUB;
+    return ((mantissa + 1) << shift) - 1;
+}
+
+bool LatencyStore::write(const IngestSample* samples, size_t count) {
+    // Measured when the batch reaches the store, so batching delay is included as it should be
+    struct timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+    uint64_t now_us = (uint64_t)now.tv_sec * 1000000ull + now.tv_nsec / 1000;
+    for(size_t i = 0; i < count; i++) {
+        if(samples[i].type != TELEMETRY_SAMPLE) continue;
+        uint64_t latency = now_us > samples[i].timestamp ? now_us - samples[i].timestamp : 0;
+        _buckets[bucketOf(latency)]++;
+        _count++;
+        if(latency > _max) _max = latency;
+    }
+    return _store.write(samples, count);
+}
+
+/// @brief Latency below which a fraction of the samples fall, to within 12.5 %
+/// @param p 
+///        Fraction, 0 to 1
+/// @return Upper edge of the bucket the percentile falls in, in microseconds
+uint64_t LatencyStore::percentile(double p) const {
+    uint64_t rank = (uint64_t)(p * _count);
+    uint64_t seen = 0;
+    for(uint16_t i = 0; i < LATENCYSTORE_BUCKETS; i++) {
+        seen += _buckets[i];
+        if(seen > rank) return bucketTop(i) < _max ? bucketTop(i) : _max;
+    }
+    return _max;
+}
@@ -0,0 +1,96 @@
+/*
+ *  Title: SampleStore.h
+ *  Description: Where the ingest server puts decoded samples. Stores get whole batches from a
+ *               single writer thread, so they need no locking of their own
+ *  Author: Tinna Osk Traustadottir
+ */
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <vector>
+#include <TelemetryFrame.h>
+
+const uint8_t INGEST_VALUES = 8;    // packet_t fields
+
+/// @brief One decoded TELEMETRY_SAMPLE or TELEMETRY_RAW frame
+struct IngestSample {
+    uint64_t timestamp;             // Node time of the data, microseconds since the node booted
+    uint64_t received;              // Host time the frame was decoded, microseconds since the Unix epoch
+    uint16_t node;                  // Node ID from the frame header
+    uint16_t seq;                   // Frame counter from the frame header
+    uint8_t type;                   // TELEMETRY_SAMPLE or TELEMETRY_RAW, the rest is for TELEMETRY_RAW
+    uint8_t source;                 // TelemetryFrame_RAW fields
+    uint8_t count;
+    uint8_t adc;                    // TelemetryFrame_RAW gain in the low nibble, osr in the high
+    union {
+        float values[INGEST_VALUES];    // TELEMETRY_SAMPLE: packet_t fields in packet order
+        int32_t codes[INGEST_VALUES];   // TELEMETRY_RAW: the codes, unused ones 0
+    };
+};
+
+class SampleStore {
+public:
+    virtual ~SampleStore() {};
+    virtual bool write(const IngestSample* samples, size_t count) = 0;
+    virtual void flush(void) {};
+};
+
+/// @brief Discards everything, for measuring the server on its own
+class NullStore : public SampleStore {
+public:
+    bool write(const IngestSample*, size_t) override { return true; }
+};
+
+const uint32_t LOGSTORE_MAGIC = 0x474C5141; // "AQLG"
+const uint16_t LOGSTORE_VERSION = 2;      // 2: raw frames, type and source fields
+
+/// @brief Passes samples to one store and raw frames to another, either can be nullptr to drop them
+class SplitStore : public SampleStore {
+public:
+    SplitStore(SampleStore* samples, SampleStore* raw) : _samples(samples), _raw(raw) {};
+    bool write(const IngestSample* samples, size_t count) override;
+    void flush(void) override;
+
+private:
+    SampleStore* _samples;
+    SampleStore* _raw;
+    std::vector<IngestSample> _split[2];
+};
+
+const uint8_t LATENCYSTORE_SUB = 8;         // Buckets per power of two of microseconds, 12.5 % resolution
+const uint16_t LATENCYSTORE_BUCKETS = 40 * LATENCYSTORE_SUB;  // Up to 2^42 us, longer goes in the last
+
+/// @brief Passes everything on and keeps a histogram of how long samples took from their
+///        timestamp to the store. Only meaningful when the sender stamps frames with its Unix
+///        time in microseconds instead of node time, as loadgen --wall-clock does
+class LatencyStore : public SampleStore {
+public:
+    LatencyStore(SampleStore& store) : _store(store) {};
+    bool write(const IngestSample* samples, size_t count) override;
+    void flush(void) override { _store.flush(); }
+
+    uint64_t count(void) const { return _count; }
+    uint64_t percentile(double p) const;
+    uint64_t max(void) const { return _max; }
+
+private:
+    SampleStore& _store;
+    uint64_t _buckets[LATENCYSTORE_BUCKETS] = {};
+    uint64_t _count = 0;
+    uint64_t _max = 0;
+};
+
+/// @brief Append-only file of IngestSample records behind a 16 byte header
+///        (magic, version, record size, reserved)
+class LogStore : public SampleStore {
+public:
+    LogStore() {};
+    ~LogStore();
+    bool open(const char* path);
+    bool write(const IngestSample* samples, size_t count) override;
+    void flush(void) override;
+
+private:
+    FILE* _file = nullptr;
+};
@@ -0,0 +1,70 @@
+/*
+ *  Title: SpscRing.h
+ *  Description: Lock-free single producer, single consumer ring buffer. One thread pushes, one
+ *               other thread pops, no locks and no allocation after construction
+ *  Author: Tinna Osk Traustadottir
+ */
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <atomic>
+#include <memory>
+#include <type_traits>
+
+/// @brief Bounded queue of trivially copyable elements, the capacity is rounded up to a power of two
+template<typename T>
+class SpscRing {
+    static_assert(std::is_trivially_copyable_v<T>, "SpscRing copies elements with memcpy");
+public:
+    explicit SpscRing(size_t capacity) {
+        _capacity = 1;
+        while(_capacity < capacity) _capacity <<= 1;
+        _mask = _capacity - 1;
+        _data.reset(new T[_capacity]);
+    }
+
+    /// @brief Producer side. Push up to count elements
+    /// @return Number of elements pushed, less than count if the ring filled up
+    size_t push(const T* items, size_t count) {
+        size_t head = _head.load(std::memory_order_relaxed);
+        size_t space = _capacity - (head - _tail.load(std::memory_order_acquire));
+        if(count > space) count = space;
+        size_t first = _capacity - (head & _mask);
+        if(first > count) first = count;
+        memcpy(&_data[head & _mask], items, first * sizeof(T));
+        memcpy(&_data[0], items + first, (count - first) * sizeof(T));
+        _head.store(head + count, std::memory_order_release);
+        return count;
+    }
+
+    bool push(const T& item) { return push(&item, 1) == 1; }
+
+    /// @brief Consumer side. Pop up to count elements
+    /// @return Number of elements popped, 0 if the ring was empty
+    size_t pop(T* items, size_t count) {
+        size_t tail = _tail.load(std::memory_order_relaxed);
+        size_t available = _head.load(std::memory_order_acquire) - tail;
+        if(count > available) count = available;
+        size_t first = _capacity - (tail & _mask);
+        if(first > count) first = count;
+        memcpy(items, &_data[tail & _mask], first * sizeof(T));
+        memcpy(items + first, &_data[0], (count - first) * sizeof(T));
+        _tail.store(tail + count, std::memory_order_release);
+        return count;
+    }
+
+    bool pop(T* item) { return pop(item, 1) == 1; }
+
+    /// @brief Either side, a snapshot
+    size_t size(void) const { return _head.load(std::memory_order_acquire) - _tail.load(std::memory_order_acquire); }
+    bool full(void) const { return size() == _capacity; }
+    size_t capacity(void) const { return _capacity; }
+
+private:
+    std::unique_ptr<T[]> _data;
+    size_t _capacity;
+    size_t _mask;
+    alignas(64) std::atomic<size_t> _head{0};   // Written by the producer only
+    alignas(64) std::atomic<size_t> _tail{0};   // Written by the consumer only
+};
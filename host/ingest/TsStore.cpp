@@ -0,0 +1,61 @@
+/*
+ *  Title: TsStore.cpp
+ *  Description: Sample store writing .aqts columnar files
+ *  Author: Tinna Osk Traustadottir
+ */
+#include "TsStore.h"
+#include <sys/stat.h>
+#include <History.h>
+
+static_assert(INGEST_VALUES == TS_COLUMNS, "Sample values and .aqts columns are both in packet order");
+
+TsStore::~TsStore() {
+    close();
+}
+
+/// @brief Open for appending, the rollup index of an existing file is loaded or rebuilt first
+bool TsStore::open(const char* path) {
+    _path = path;
+    return History::loadIndex(path, _rollups) && _writer.open(path);
+}
+
+/// @brief Rows are stamped with the host receive time, node time restarts at every reboot. Raw
+///        frames have no columns here and are skipped
+bool TsStore::write(const IngestSample* samples, size_t count) {
+    bool ok = true;
+    for(size_t i = 0; i < count; i++) {
+        if(samples[i].type != TELEMETRY_SAMPLE) continue;
+        TsRow row;
+        row.timestamp = samples[i].received;
+        row.node = samples[i].node;
+        memcpy(row.values, samples[i].values, sizeof(row.values));
+        ok &= _writer.append(row);
+        _rollups.add(row.node, row.timestamp, row.values);
+        if(_held++ == 0) _held_since = std::chrono::steady_clock::now();
+    }
+    return ok;
+}
+
+/// @brief Write and sync the partial blocks once the held rows are old or many enough. Every
+///        flush costs a short block per node, so a quiet interval is not flushed each time
+void TsStore::flush(void) {
+    if(_held == 0) return;
+    auto age = std::chrono::steady_clock::now() - _held_since;
+    if(_held < TSSTORE_FLUSH_ROWS && age < std::chrono::milliseconds(TSSTORE_FLUSH_MS)) return;
+    if(_writer.sync()) saveIndex();
+    _held = 0;
+}
+
+/// @brief Write the partial blocks, close the file and save the rollup index for its final size
+void TsStore::close(void) {
+    if(_path.empty()) return;
+    _held = 0;
+    if(_writer.close()) saveIndex();
+    _path.clear();
+}
+
+/// @brief Save the rollup index for the current file size, only valid with no rows held
+void TsStore::saveIndex(void) {
+    struct stat info;
+    if(stat(_path.c_str(), &info) == 0) _rollups.save(historyIndexPath(_path.c_str()).c_str(), info.st_size);
+}
@@ -0,0 +1,37 @@
+/*
+ *  Title: TsStore.h
+ *  Description: Sample store writing .aqts columnar files. Blocks are written as each node fills
+ *               one. Partial blocks are written and synced once the oldest held row is
+ *               TSSTORE_FLUSH_MS old or TSSTORE_FLUSH_ROWS rows are held, checked on the
+ *               server's periodic flush, and when the store is closed. Every sample also
+ *               updates the rollup index, saved next to the file with each sync so queries on
+ *               the open file only fold in the blocks written since
+ *  Author: Tinna Osk Traustadottir
+ */
+#pragma once
+#include <string>
+#include <chrono>
+#include <TsFile.h>
+#include <Rollup.h>
+#include "SampleStore.h"
+
+#define TSSTORE_FLUSH_MS 10000 // Longest a row is held in memory, lost if ingestd dies
+#define TSSTORE_FLUSH_ROWS 16384 // Most rows over all nodes not yet synced to disk
+
+class TsStore : public SampleStore {
+public:
+    ~TsStore();
+    bool open(const char* path);
+    bool write(const IngestSample* samples, size_t count) override;
+    void flush(void) override;
+    void close(void);
+
+private:
+    TsWriter _writer;
+    RollupIndex _rollups;
+    std::string _path;
+    size_t _held = 0;
+    std::chrono::steady_clock::time_point _held_since;
+
+    void saveIndex(void);
+};
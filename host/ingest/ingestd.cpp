@@ -0,0 +1,141 @@
+/*
+ *  Title: ingestd.cpp
+ *  Description: Fleet telemetry ingestion daemon. Collects packet_t streams from any number of
+ *               nodes on serial devices and from gateways on TCP or Unix sockets into one .aqts
+ *               history file (or a raw .aqlog sample log), printing ingest rates as it goes. The
+ *               .aqts rollup index is saved next to it on exit, for histquery. Raw capture frames
+ *               go to a separate sample log with --raw, for recal, and are dropped without it.
+ *               --stdin reads one more stream from a pipe and exits when it closes, e.g. behind
+ *               loadgen --stdout. --latency reports how long samples took from their timestamp to
+ *               the store on exit, for senders that stamp frames with their wall clock
+ *
+ *               ingestd [--serial DEVICE]... [--tcp PORT] [--unix PATH] [--stdin] [--out FILE]
+ *                       [--raw FILE.aqlog] [--workers N] [--stats SECONDS] [--latency]
+ *  Author: Tinna Osk Traustadottir
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <unistd.h>
+#include <string>
+#include <vector>
+#include "IngestServer.h"
+#include "TsStore.h"
+
+static volatile sig_atomic_t quit = 0;
+
+static void onSignal(int) {
+    quit = 1;
+}
+
+static void usage(void) {
+    fprintf(stderr, "usage: ingestd [--serial DEVICE]... [--tcp PORT] [--unix PATH] [--stdin] [--out FILE]\n"
+                    "               [--raw FILE.aqlog] [--workers N] [--stats SECONDS] [--latency]\n");
+}
+
+int main(int argc, char** argv) {
+    std::vector<std::string> serial;
+    int tcp_port = -1;
+    const char* unix_path = nullptr;
+    const char* out_path = "samples.aqts";
+    const char* raw_path = nullptr;
+    unsigned stats_s = 5;
+    bool from_stdin = false;
+    bool latency = false;
+    IngestServer_OPTIONS options;
+
+    for(int i = 1; i < argc; i++) {
+        bool has_value = i + 1 < argc;
+        if(!strcmp(argv[i], "--serial") && has_value) serial.push_back(argv[++i]);
+        else if(!strcmp(argv[i], "--tcp") && has_value) tcp_port = atoi(argv[++i]);
+        else if(!strcmp(argv[i], "--unix") && has_value) unix_path = argv[++i];
+        else if(!strcmp(argv[i], "--stdin")) from_stdin = true;
+        else if(!strcmp(argv[i], "--latency")) latency = true;
+        else if(!strcmp(argv[i], "--out") && has_value) out_path = argv[++i];
+        else if(!strcmp(argv[i], "--raw") && has_value) raw_path = argv[++i];
+        else if(!strcmp(argv[i], "--workers") && has_value) options.workers = atoi(argv[++i]);
+        else if(!strcmp(argv[i], "--stats") && has_value) stats_s = atoi(argv[++i]);
+        else {
+            usage();
+            return 2;
+        }
+    }
+    if(serial.empty() && tcp_port < 0 && unix_path == nullptr && !from_stdin) {
+        usage();
+        return 2;
+    }
+
+    // Columnar .aqts history by default, or the raw sample log for any other extension
+    size_t length = strlen(out_path);
+    bool columnar = length >= 5 && strcmp(out_path + length - 5, ".aqts") == 0;
+    TsStore ts_store;
+    LogStore log_store;
+    SampleStore* store = &log_store;
+    if(columnar) store = &ts_store;
+    if(columnar ? !ts_store.open(out_path) : !log_store.open(out_path)) {
+        fprintf(stderr, "ingestd: can't open %s as a sample store\n", out_path);
+        return 1;
+    }
+    LogStore raw_store;
+    if(raw_path != nullptr && !raw_store.open(raw_path)) {
+        fprintf(stderr, "ingestd: can't open %s as a sample store\n", raw_path);
+        return 1;
+    }
+    LatencyStore latency_store(*store);
+    if(latency) store = &latency_store;
+    SplitStore split(store, raw_path != nullptr ? &raw_store : nullptr);
+    IngestServer server(split, options);
+    for(const std::string& device : serial) {
+        if(!server.openSerial(device.c_str())) fprintf(stderr, "ingestd: can't open %s\n", device.c_str());
+    }
+    if(tcp_port >= 0 && !server.listenTcp(tcp_port)) {
+        fprintf(stderr, "ingestd: can't listen on TCP port %d\n", tcp_port);
+        return 1;
+    }
+    if(unix_path != nullptr && !server.listenUnix(unix_path)) {
+        fprintf(stderr, "ingestd: can't listen on %s\n", unix_path);
+        return 1;
+    }
+
+    if(from_stdin && !server.addFd(dup(STDIN_FILENO), "stdin")) {
+        fprintf(stderr, "ingestd: can't read stdin\n");
+        return 1;
+    }
+
+    signal(SIGINT, onSignal);
+    signal(SIGTERM, onSignal);
+    server.start();
+
+    IngestServer_STATS last = server.stats();
+    unsigned elapsed = 0;
+    while(!quit) {
+        sleep(1);
+        if(from_stdin && serial.empty() && tcp_port < 0 && unix_path == nullptr) {
+            IngestServer_STATS now = server.stats();
+            if(now.accepted > 0 && now.connections == 0) break;     // The pipe closed
+        }
+        if(stats_s == 0 || ++elapsed % stats_s != 0) continue;
+        IngestServer_STATS now = server.stats();
+        printf("ingestd: %llu connections, %.0f samples/s, %.0f raw/s, %.1f kB/s in, %.0f written/s, "
+               "%llu lost, %llu reordered, %llu ignored, %llu CRC errors, %llu alerts\n",
+               (unsigned long long)now.connections, (double)(now.samples - last.samples) / stats_s,
+               (double)(now.raw - last.raw) / stats_s,
+               (double)(now.bytes - last.bytes) / stats_s / 1000.0, (double)(now.written - last.written) / stats_s,
+               (unsigned long long)now.lost, (unsigned long long)now.reordered, (unsigned long long)now.ignored,
+               (unsigned long long)now.crc_errors, (unsigned long long)now.alerts);
+        fflush(stdout);
+        last = now;
+    }
+
+    server.stop();
+    IngestServer_STATS total = server.stats();
+    printf("ingestd: %llu samples written in %llu batches\n",
+           (unsigned long long)total.written, (unsigned long long)total.batches);
+    if(latency && latency_store.count() > 0) {
+        printf("ingestd: latency to store p50 %llu us, p99 %llu us, p99.9 %llu us, max %llu us\n",
+               (unsigned long long)latency_store.percentile(0.5), (unsigned long long)latency_store.percentile(0.99),
+               (unsigned long long)latency_store.percentile(0.999), (unsigned long long)latency_store.max());
+    }
+    return 0;
+}
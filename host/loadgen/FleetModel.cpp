@@ -0,0 +1,163 @@
+/*
+ *  Title: FleetModel.cpp
+ *  Description: Synthetic sensor nodes for load testing the host side
+ *  Author: Tinna Osk Traustadottir
+ */
+#include "FleetModel.h"
+#include <math.h>
+
+const float PI = 3.14159265f;
+const uint64_t DAY_US = 86400000000ull;
+const float CO2_OUTDOOR = 420.0f;
+const float CO2_ROOM_TAU_S = 1200.0f;           // Room air change time constant
+const float CO2_ALERT = 1500.0f;                // The firmware's CO2 warning rule
+const float CO2_ALERT_HYSTERESIS = 100.0f;
+
+/// @brief Smooth bump over the working day, 0 at night and 1 mid afternoon
+static float occupancy(float hour) {
+    if(hour < 8.0f || hour > 18.0f) return 0.0f;
+    float s = sinf(PI * (hour - 8.0f) / 10.0f);
+    return s * s;
+}
+
+static float gauss(float x, float mean, float sd) {
+    float z = (x - mean) / sd;
+    return expf(-0.5f * z * z);
+}
+
+/// @param node 
+///        Node ID, also picks the node's random stream
+FleetNode::FleetNode(uint16_t node, const FleetModel_OPTIONS& options) : _node(node), _options(options) {
+    std::seed_seq seed{options.seed, (uint32_t)node, 0x41515453u};
+    _random.seed(seed);
+    _time = options.start_us + (uint64_t)uniform(0.0f, (float)options.period_us);   // Nodes don't start in step
+    _boot = _time - (uint64_t)uniform(60.0f, 86400.0f) * 1000000ull;              // Some uptime already
+    _drift = uniform(-options.drift_ppm, options.drift_ppm) * 1e-6;
+    _seq = (uint16_t)_random();
+    _co2_amplitude = uniform(200.0f, 1600.0f);
+    _pm_background = uniform(2.0f, 12.0f);
+    _traffic = uniform(0.005f, 0.06f);
+    _warmth = uniform(-2.0f, 2.0f);
+    _co2 = CO2_OUTDOOR + 20.0f;
+    _pm = 0.0f;
+    _pm_tau_s = 600.0f;
+}
+
+float FleetNode::uniform(float low, float high) {
+    return low + (high - low) * (float)(_random() >> 8) / 16777216.0f;
+}
+
+float FleetNode::normal(float sd) {
+    // Sum of four uniforms, close enough to normal for noise and much cheaper than std::normal_distribution
+    float sum = 0.0f;
+    for(uint8_t i = 0; i < 4; i++) sum += uniform(-1.0f, 1.0f);
+    return sum * sd * 0.8660254f;
+}
+
+bool FleetNode::chance(float per_step) {
+    return per_step > 0.0f && uniform(0.0f, 1.0f) < per_step;
+}
+
+/// @brief Probability per output period of something that happens per_day times a day
+float FleetNode::perStep(float per_day) const {
+    return per_day * _options.period_us / (float)DAY_US;
+}
+
+size_t FleetNode::frame(uint8_t* out, uint8_t type, uint64_t timestamp, const void* payload, uint8_t length) {
+    size_t n = telemetryEncode(out, type, _seq++, _node, timestamp, payload, length);
+    if(chance(_options.loss)) {
+        _stats.lost++;
+        return 0;
+    }
+    if(chance(_options.crc_errors)) {
+        out[sizeof(TelemetryFrame_HEADER) + _random() % length] ^= 1 << (_random() % 8);
+        _stats.corrupted++;
+    }
+    _stats.frames++;
+    return n;
+}
+
+/// @brief Advance one output period and write what the node sends in it
+/// @param out 
+///        Buffer of at least FLEETNODE_MAX_STEP bytes
+/// @param stamp_us 
+///        0 to stamp frames with node time, anything else is used as the timestamp instead, e.g.
+///        the sender's wall clock to measure latency at the receiver
+/// @return Bytes written, 0 while the node is rebooting or the frame was lost
+size_t FleetNode::step(uint8_t* out, uint64_t stamp_us) {
+    uint64_t now = _time;
+    _time += _options.period_us;
+    float dt_s = _options.period_us / 1e6f;
+
+    if(now < _offline_until) return 0;
+    if(chance(perStep(_options.reboots_per_day))) {
+        // Off for the boot sequence, then node time and the sequence start over
+        _offline_until = now + (uint64_t)uniform(10.0f, 30.0f) * 1000000ull;
+        _boot = _offline_until;
+        _seq = 0;
+        _stats.reboots++;
+        return 0;
+    }
+
+    float hour = (float)((now % DAY_US) / 1e6 / 3600.0);
+    bool weekday = (now / DAY_US + 3) % 7 < 5;     // Day 0 of the Unix epoch was a Thursday
+    float occupied = weekday ? occupancy(hour) : 0.2f * occupancy(hour);
+
+    // Room CO2 relaxes towards what the occupancy drives it to
+    float co2_target = CO2_OUTDOOR + _co2_amplitude * occupied;
+    _co2 += (co2_target - _co2) * (1.0f - expf(-dt_s / CO2_ROOM_TAU_S)) + normal(2.0f);
+    if(_co2 < CO2_OUTDOOR - 20.0f) _co2 = CO2_OUTDOOR - 20.0f;
+
+    float temperature = 21.0f + _warmth + 2.0f * sinf(2.0f * PI * (hour - 9.0f) / 24.0f) + occupied + normal(0.05f);
+    float humidity = 45.0f - 2.5f * (temperature - 21.0f - _warmth) + normal(0.5f);
+    humidity = humidity < 5.0f ? 5.0f : humidity > 95.0f ? 95.0f : humidity;
+    float no2 = _traffic * (0.3f + gauss(hour, 8.0f, 1.0f) + 0.8f * gauss(hour, 17.5f, 1.5f)) + normal(0.001f);
+    if(no2 < 0.0f) no2 = 0.0f;
+
+    if(chance(perStep(_options.pm_events_per_day))) {
+        _pm += uniform(30.0f, 300.0f);
+        _pm_tau_s = uniform(300.0f, 1800.0f);
+    }
+    _pm *= expf(-dt_s / _pm_tau_s);
+    float pm2_5 = _pm_background + _pm + normal(0.5f);
+    if(pm2_5 < 0.0f) pm2_5 = 0.0f;
+
+    for(uint8_t s = 0; s < SENSOR_COUNT; s++) {
+        if(now >= _dropout_until[s] && chance(perStep(_options.dropouts_per_day))) {
+            _dropout_until[s] = now + (uint64_t)uniform(60.0f, 1800.0f) * 1000000ull;
+            _stats.dropouts++;
+        }
+    }
+
+    packet_t packet;
+    bool scd30 = now >= _dropout_until[SENSOR_SCD30];
+    bool sen55 = now >= _dropout_until[SENSOR_SEN55];
+    packet.temperature = scd30 ? temperature : 0.0f;
+    packet.no2 = now >= _dropout_until[SENSOR_NO2] ? no2 : 0.0f;
+    packetPutU16(packet.raw, offsetof(packet_t, humidity), scd30 ? humidity : 0.0f);
+    packetPutU16(packet.raw, offsetof(packet_t, co2), scd30 ? _co2 : 0.0f);
+    packetPutU16(packet.raw, offsetof(packet_t, pm10), sen55 ? 1.3f * pm2_5 : 0.0f);
+    packetPutU16(packet.raw, offsetof(packet_t, pm4), sen55 ? 1.1f * pm2_5 : 0.0f);
+    packetPutU16(packet.raw, offsetof(packet_t, pm2_5), sen55 ? pm2_5 : 0.0f);
+    packetPutU16(packet.raw, offsetof(packet_t, pm1), sen55 ? 0.6f * pm2_5 : 0.0f);
+
+    uint64_t node_time = (uint64_t)((double)(now - _boot) * (1.0 + _drift));
+    uint64_t timestamp = stamp_us ? stamp_us : node_time;
+    size_t n = frame(out, TELEMETRY_SAMPLE, timestamp, packet.raw, sizeof(packet.raw));
+
+    // Warning level CO2 alert on the way up and its clear on the way down, like AlertEngine
+    bool rising = !_co2_alert && scd30 && _co2 >= CO2_ALERT;
+    bool falling = _co2_alert && scd30 && _co2 < CO2_ALERT - CO2_ALERT_HYSTERESIS;
+    if(rising || falling) {
+        _co2_alert = rising;
+        TelemetryFrame_ALERT alert;
+        alert.metric = 3;   // CO2, packet order
+        alert.level = rising ? 1 : 0;
+        alert.value = _co2;
+        alert.threshold = CO2_ALERT;
+        alert.latency_us = 200 + _random() % 800;
+        n += frame(out + n, TELEMETRY_ALERT, timestamp, &alert, sizeof(alert));
+        _stats.alerts++;
+    }
+    return n;
+}
@@ -0,0 +1,92 @@
+/*
+ *  Title: FleetModel.h
+ *  Description: Synthetic sensor nodes for load testing the host side. Each node produces the
+ *               telemetry byte stream a real one would, one output period at a time:
+ *                 CO2        diurnal occupancy curve with a first order room response
+ *                 T, RH      diurnal swing, RH against temperature
+ *                 NO2        morning and evening traffic peaks
+ *                 PM         background plus random events (cooking, smoke) decaying over minutes
+ *               and the faults the server has to live with: sensor dropouts that read 0, frames
+ *               lost on the link, frames with a corrupted byte, reboots that restart node time and
+ *               the sequence number, and a clock drift of its own. CO2 alerts are sent like the
+ *               firmware does. Everything comes from one random generator per node seeded from
+ *               the fleet seed and the node ID, so a run is reproducible byte for byte
+ *  Author: Tinna Osk Traustadottir
+ */
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <random>
+#include <TelemetryFrame.h>
+
+const size_t FLEETNODE_MAX_STEP = 2 * TELEMETRY_MAX_FRAME;     // Sample and alert frame
+
+struct FleetModel_OPTIONS {
+    uint32_t seed = 1;
+    uint64_t start_us = 1759996800000000ull;    // Simulated Unix time of the first frame, a midnight
+    uint32_t period_us = 2500000;               // Output period, the firmware's
+    float drift_ppm = 50.0f;                    // Each node clock is off by up to this much
+    float loss = 0.001f;                        // Fraction of frames lost on the link
+    float crc_errors = 0.0005f;                 // Fraction of frames with a corrupted byte
+    float dropouts_per_day = 2.0f;              // Outages per sensor per day, each 1 to 30 minutes
+    float reboots_per_day = 0.1f;
+    float pm_events_per_day = 4.0f;
+};
+
+struct FleetNode_STATS {
+    uint64_t frames = 0;        // Written to the stream, corrupted ones included
+    uint64_t lost = 0;          // Never written, the sequence number still moved on
+    uint64_t corrupted = 0;
+    uint64_t alerts = 0;
+    uint64_t reboots = 0;
+    uint64_t dropouts = 0;      // Sensor outages started
+};
+
+class FleetNode {
+public:
+    FleetNode(uint16_t node, const FleetModel_OPTIONS& options);
+
+    size_t step(uint8_t* out, uint64_t stamp_us = 0);
+
+    uint16_t node(void) const { return _node; }
+    uint64_t time(void) const { return _time; }
+    const FleetNode_STATS& stats(void) const { return _stats; }
+
+private:
+    /// @brief Sensors that drop out on their own
+    enum SENSOR : uint8_t {
+        SENSOR_SCD30 = 0,
+        SENSOR_SEN55,
+        SENSOR_NO2,
+        SENSOR_COUNT,
+    };
+
+    uint16_t _node;
+    FleetModel_OPTIONS _options;
+    std::mt19937 _random;
+    FleetNode_STATS _stats;
+
+    uint64_t _time;             // Simulated Unix time of the next frame
+    uint64_t _boot;             // Simulated Unix time of the last boot
+    uint64_t _offline_until = 0;
+    double _drift;              // Node clock rate error, 1e-6 per ppm
+    uint16_t _seq = 0;
+
+    // Per node character, so the fleet doesn't move in lock step
+    float _co2_amplitude;
+    float _pm_background;
+    float _traffic;
+    float _warmth;
+
+    float _co2;
+    float _pm;                  // PM 2.5 above background from events
+    float _pm_tau_s;
+    bool _co2_alert = false;
+    uint64_t _dropout_until[SENSOR_COUNT] = {};
+
+    float uniform(float low, float high);
+    float normal(float sd);
+    bool chance(float per_step);
+    float perStep(float per_day) const;
+    size_t frame(uint8_t* out, uint8_t type, uint64_t timestamp, const void* payload, uint8_t length);
+};
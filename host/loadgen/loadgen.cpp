@@ -0,0 +1,215 @@
+/*
+ *  Title: loadgen.cpp
+ *  Description: Synthetic fleet load generator. Emulates N nodes (see FleetModel) and streams
+ *               their frames to ingestd over Unix or TCP sockets, or to stdout for a pipe, the
+ *               nodes spread over any number of gateway connections. The simulated fleet time
+ *               runs --speed times faster than real time, or flat out by default, and --rate sets
+ *               the speed from a total frame rate instead. The byte stream depends only on the
+ *               seed, the node count, the connection count and the duration, so runs can be
+ *               repeated exactly. --wall-clock stamps frames with the Unix time they were sent
+ *               instead of node time, for ingestd --latency
+ *
+ *               loadgen (--unix PATH | --tcp HOST:PORT | --stdout) [--nodes N] [--connections N]
+ *                       [--seed N] [--duration SECONDS] [--speed X | --rate FRAMES/S]
+ *                       [--loss F] [--crc F] [--drift PPM] [--wall-clock]
+ *  Author: Tinna Osk Traustadottir
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <unistd.h>
+#include <netdb.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+#include "FleetModel.h"
+
+const size_t LOADGEN_BUFFER = 64 * 1024;    // Bytes gathered before a write() when running flat out
+
+struct Gateway {
+    int fd = -1;
+    std::vector<FleetNode> nodes;
+    uint64_t bytes = 0;
+    bool failed = false;
+    std::thread thread;
+};
+
+struct LoadGen_OPTIONS {
+    double speed = 0.0;         // Simulated seconds per real second, 0 for flat out
+    uint64_t steps = 0;         // Output periods per node
+    uint32_t period_us = 0;
+    bool wall_clock = false;
+};
+
+static void usage(void) {
+    fprintf(stderr, "usage: loadgen (--unix PATH | --tcp HOST:PORT | --stdout) [--nodes N] [--connections N]\n"
+                    "               [--seed N] [--duration SECONDS] [--speed X | --rate FRAMES/S]\n"
+                    "               [--loss F] [--crc F] [--drift PPM] [--wall-clock]\n");
+}
+
+static uint64_t wallClockUs(void) {
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+static int connectUnix(const char* path) {
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    sockaddr_un address = {};
+    address.sun_family = AF_UNIX;
+    strncpy(address.sun_path, path, sizeof(address.sun_path) - 1);
+    if(fd >= 0 && connect(fd, (sockaddr*)&address, sizeof(address)) == 0) return fd;
+    if(fd >= 0) close(fd);
+    return -1;
+}
+
+static int connectTcp(const std::string& host_port) {
+    size_t colon = host_port.rfind(':');
+    if(colon == std::string::npos) return -1;
+    std::string host = host_port.substr(0, colon);
+    addrinfo hints = {};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    addrinfo* result = nullptr;
+    if(getaddrinfo(host.c_str(), host_port.c_str() + colon + 1, &hints, &result) != 0) return -1;
+    int fd = -1;
+    for(addrinfo* entry = result; entry != nullptr && fd < 0; entry = entry->ai_next) {
+        fd = socket(entry->ai_family, entry->ai_socktype, entry->ai_protocol);
+        if(fd >= 0 && connect(fd, entry->ai_addr, entry->ai_addrlen) != 0) {
+            close(fd);
+            fd = -1;
+        }
+    }
+    freeaddrinfo(result);
+    return fd;
+}
+
+static bool writeAll(int fd, const uint8_t* data, size_t length) {
+    while(length > 0) {
+        ssize_t n = write(fd, data, length);
+        if(n < 0 && errno == EINTR) continue;
+        if(n <= 0) return false;
+        data += n;
+        length -= n;
+    }
+    return true;
+}
+
+/// @brief One gateway: step its nodes in turn, period by period, and write what they send,
+///        holding each period back until its time when paced
+static void runGateway(Gateway* gateway, const LoadGen_OPTIONS& options) {
+    std::vector<uint8_t> buffer(LOADGEN_BUFFER + gateway->nodes.size() * FLEETNODE_MAX_STEP);
+    size_t used = 0;
+    auto start = std::chrono::steady_clock::now();
+    for(uint64_t step = 0; step < options.steps; step++) {
+        if(options.speed > 0.0) {
+            if(used > 0 && !writeAll(gateway->fd, buffer.data(), used)) break;
+            gateway->bytes += used;
+            used = 0;
+            auto due = start + std::chrono::microseconds((uint64_t)(step * options.period_us / options.speed));
+            std::this_thread::sleep_until(due);
+        }
+        uint64_t stamp = options.wall_clock ? wallClockUs() : 0;
+        for(FleetNode& node : gateway->nodes) used += node.step(buffer.data() + used, stamp);
+        if(used >= LOADGEN_BUFFER) {
+            if(!writeAll(gateway->fd, buffer.data(), used)) break;
+            gateway->bytes += used;
+            used = 0;
+        }
+    }
+    if(used > 0 && writeAll(gateway->fd, buffer.data(), used)) {
+        gateway->bytes += used;
+        used = 0;
+    }
+    gateway->failed = used > 0;
+    if(gateway->fd != STDOUT_FILENO) close(gateway->fd);
+}
+
+int main(int argc, char** argv) {
+    const char* unix_path = nullptr;
+    const char* tcp = nullptr;
+    bool to_stdout = false;
+    unsigned nodes = 100;
+    unsigned connections = 1;
+    double duration_s = 86400.0;
+    double rate = 0.0;
+    FleetModel_OPTIONS model;
+    LoadGen_OPTIONS options;
+
+    for(int i = 1; i < argc; i++) {
+        bool has_value = i + 1 < argc;
+        if(!strcmp(argv[i], "--unix") && has_value) unix_path = argv[++i];
+        else if(!strcmp(argv[i], "--tcp") && has_value) tcp = argv[++i];
+        else if(!strcmp(argv[i], "--stdout")) to_stdout = true;
+        else if(!strcmp(argv[i], "--nodes") && has_value) nodes = atoi(argv[++i]);
+        else if(!strcmp(argv[i], "--connections") && has_value) connections = atoi(argv[++i]);
+        else if(!strcmp(argv[i], "--seed") && has_value) model.seed = strtoul(argv[++i], nullptr, 0);
+        else if(!strcmp(argv[i], "--duration") && has_value) duration_s = atof(argv[++i]);
+        else if(!strcmp(argv[i], "--speed") && has_value) options.speed = atof(argv[++i]);
+        else if(!strcmp(argv[i], "--rate") && has_value) rate = atof(argv[++i]);
+        else if(!strcmp(argv[i], "--loss") && has_value) model.loss = atof(argv[++i]);
+        else if(!strcmp(argv[i], "--crc") && has_value) model.crc_errors = atof(argv[++i]);
+        else if(!strcmp(argv[i], "--drift") && has_value) model.drift_ppm = atof(argv[++i]);
+        else if(!strcmp(argv[i], "--wall-clock")) options.wall_clock = true;
+        else {
+            usage();
+            return 2;
+        }
+    }
+    if((unix_path != nullptr) + (tcp != nullptr) + to_stdout != 1 || nodes == 0 || nodes > 65535 ||
+       connections == 0 || connections > nodes || (to_stdout && connections != 1)) {
+        usage();
+        return 2;
+    }
+
+    // A total frame rate is a speed: every node sends one sample frame per period
+    if(rate > 0.0) options.speed = rate * model.period_us / 1e6 / nodes;
+    options.period_us = model.period_us;
+    options.steps = (uint64_t)(duration_s * 1e6 / model.period_us);
+
+    signal(SIGPIPE, SIG_IGN);
+    std::vector<Gateway> gateways(connections);
+    for(unsigned node = 0; node < nodes; node++) gateways[node % connections].nodes.emplace_back(node + 1, model);
+    for(Gateway& gateway : gateways) {
+        gateway.fd = to_stdout ? STDOUT_FILENO : unix_path != nullptr ? connectUnix(unix_path) : connectTcp(tcp);
+        if(gateway.fd < 0) {
+            fprintf(stderr, "loadgen: can't connect to %s\n", unix_path != nullptr ? unix_path : tcp);
+            return 1;
+        }
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    for(Gateway& gateway : gateways) gateway.thread = std::thread(runGateway, &gateway, std::cref(options));
+    for(Gateway& gateway : gateways) gateway.thread.join();
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    FleetNode_STATS total;
+    uint64_t bytes = 0;
+    bool failed = false;
+    for(const Gateway& gateway : gateways) {
+        for(const FleetNode& node : gateway.nodes) {
+            const FleetNode_STATS& stats = node.stats();
+            total.frames += stats.frames;
+            total.lost += stats.lost;
+            total.corrupted += stats.corrupted;
+            total.alerts += stats.alerts;
+            total.reboots += stats.reboots;
+            total.dropouts += stats.dropouts;
+        }
+        bytes += gateway.bytes;
+        failed |= gateway.failed;
+    }
+    fprintf(stderr, "loadgen: %u nodes, %.0f s simulated in %.2f s: %llu frames (%.0f/s, %.1f MB/s), "
+                    "%llu lost, %llu corrupted, %llu alerts, %llu reboots, %llu dropouts\n",
+            nodes, options.steps * model.period_us / 1e6, elapsed, (unsigned long long)total.frames,
+            total.frames / elapsed, bytes / elapsed / 1e6, (unsigned long long)total.lost,
+            (unsigned long long)total.corrupted, (unsigned long long)total.alerts,
+            (unsigned long long)total.reboots, (unsigned long long)total.dropouts);
+    if(failed) fprintf(stderr, "loadgen: the receiver closed a connection early\n");
+    return failed ? 1 : 0;
+}
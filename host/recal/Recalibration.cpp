@@ -0,0 +1,403 @@
+/*
+ *  Title: Recalibration.cpp
+ *  Description: Applies a new calibration to stored raw capture records
+ *  Author: Tinna Osk Traustadottir
+ */
+#include "Recalibration.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <math.h>
+#include <algorithm>
+#include <thread>
+#include <Bme280Batch.h>
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+const char* RECAL_SOURCE_NAMES[RAW_SOURCES] = {"mcp3564r", "sen55", "scd30", "bme280", "bme280_calib"};
+const uint8_t RECAL_SOURCE_CHANNELS[RAW_SOURCES] = {1, 8, 3, 3, 8};
+
+const size_t RECAL_NODES = 65536;               // Coefficient tables are indexed by node ID
+const size_t RECAL_TILE = 4096;                 // Rows per channel sweep, all channels of a tile stay in cache
+const size_t RECAL_MIN_THREAD_ROWS = 1 << 16;   // Fewer rows than this per thread run on the caller's thread
+
+// 1 over the MCP3564R gain for each gain setting: x1/3, x1, x2 ... x64. NO2 codes are scaled to
+// gain x1 so data taken at any gain shares one calibration
+const float MCP_GAIN_INVERSE[8] = {3.0f, 1.0f, 0.5f, 0.25f, 0.125f, 0.0625f, 0.03125f, 0.015625f};
+
+// Firmware defaults: no2_scale and no2_offset, SEN55_SCALE, SCD30 floats as they are
+const float DEFAULT_NO2_SCALE = 7.69042969e-10f;
+const float DEFAULT_SEN55_SCALE[8] = {0.1f, 0.1f, 0.1f, 0.1f, 0.01f, 0.005f, 0.1f, 0.1f};
+
+/// @brief How a column's codes become x
+enum class RECAL_DECODE : uint8_t {
+    Adc,        // Signed conversion result over the ADC gain
+    Unsigned,   // 16 bit word
+    Signed16,   // 16 bit word, two's complement
+    FloatBits,  // IEEE 754 bits
+};
+
+static RECAL_DECODE decodeOf(uint8_t source, uint8_t channel) {
+    if(source == RAW_MCP3564R) return RECAL_DECODE::Adc;
+    if(source == RAW_SCD30) return RECAL_DECODE::FloatBits;
+    return channel >= 4 ? RECAL_DECODE::Signed16 : RECAL_DECODE::Unsigned;     // SEN55 RH onwards are signed
+}
+
+RecalCalibration::RecalCalibration() {
+    _defaults[RAW_MCP3564R][0].c1 = DEFAULT_NO2_SCALE;
+    for(uint8_t c = 0; c < RECAL_CHANNELS; c++) _defaults[RAW_SEN55][c].c1 = DEFAULT_SEN55_SCALE[c];
+}
+
+/// @brief Read coefficients from a text file, one line each:
+///        [NODE] SOURCE CHANNEL C0 C1 C2
+///        Lines without a node set the default for every node, '#' starts a comment
+/// @return False if the file can't be read or a line doesn't parse
+bool RecalCalibration::load(const char* path) {
+    FILE* file = fopen(path, "r");
+    if(file == nullptr) return false;
+    char line[256];
+    size_t number = 0;
+    bool ok = true;
+    while(ok && fgets(line, sizeof(line), file) != nullptr) {
+        number++;
+        char* hash = strchr(line, '#');
+        if(hash != nullptr) *hash = '\0';
+        char words[6][32];
+        int n = sscanf(line, "%31s %31s %31s %31s %31s %31s", words[0], words[1], words[2], words[3], words[4], words[5]);
+        if(n <= 0) continue;
+        int32_t node = -1;
+        int w = 0;
+        if(n == 6) node = atoi(words[w++]);
+        else if(n != 5) ok = false;
+        uint8_t source = RAW_SOURCES;
+        for(uint8_t s = 0; ok && s < RAW_SOURCES; s++) {
+            if(!strcmp(words[w], RECAL_SOURCE_NAMES[s])) source = s;
+        }
+        uint8_t channel = ok ? atoi(words[w + 1]) : 0;
+        ok = ok && source < RAW_SOURCES && channel < RECAL_SOURCE_CHANNELS[source] && node < (int32_t)RECAL_NODES;
+        if(!ok) {
+            fprintf(stderr, "%s:%zu: expected [NODE] SOURCE CHANNEL C0 C1 C2\n", path, number);
+            break;
+        }
+        Recal_COEFFS coeffs;
+        coeffs.c0 = strtof(words[w + 2], nullptr);
+        coeffs.c1 = strtof(words[w + 3], nullptr);
+        coeffs.c2 = strtof(words[w + 4], nullptr);
+        set(node, source, channel, coeffs);
+    }
+    fclose(file);
+    return ok;
+}
+
+/// @param node 
+///        Node ID, -1 for the default of every node without its own
+void RecalCalibration::set(int32_t node, uint8_t source, uint8_t channel, const Recal_COEFFS& coeffs) {
+    if(source >= RAW_SOURCES || channel >= RECAL_CHANNELS) return;
+    if(node < 0) _defaults[source][channel] = coeffs;
+    else _nodes[(uint32_t)node << 16 | source << 8 | channel] = coeffs;
+}
+
+const Recal_COEFFS& RecalCalibration::get(uint16_t node, uint8_t source, uint8_t channel) const {
+    auto found = _nodes.find((uint32_t)node << 16 | source << 8 | channel);
+    return found != _nodes.end() ? found->second : _defaults[source][channel];
+}
+
+/// @brief Coefficients of one source and channel for every node ID
+/// @param out 
+///        Output, RECAL_NODES entries
+void RecalCalibration::table(uint8_t source, uint8_t channel, Recal_COEFFS* out) const {
+    std::fill(out, out + RECAL_NODES, _defaults[source][channel]);
+    for(auto& node : _nodes) {
+        if((node.first >> 8 & 0xFF) == source && (node.first & 0xFF) == channel) out[node.first >> 16] = node.second;
+    }
+}
+
+void RecalTable::add(const IngestSample& sample) {
+    timestamp.push_back(sample.timestamp);
+    received.push_back(sample.received);
+    node.push_back(sample.node);
+    count.push_back(sample.count);
+    gain.push_back(sample.adc & 0x0F);
+    if(sample.count > channels) channels = sample.count;
+    for(uint8_t c = 0; c < RECAL_SOURCE_CHANNELS[source]; c++) codes[c].push_back(sample.codes[c]);
+}
+
+/// @brief Read the raw records of an ingestd sample log into one table per source
+/// @return False if the file isn't a sample log this version can read
+bool recalLoad(const char* path, RecalTable tables[RAW_SOURCES]) {
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if(fd < 0) return false;
+    struct stat info;
+    struct {
+        uint32_t magic;
+        uint16_t version;
+        uint16_t record;
+        uint64_t reserved;
+    } header;
+    if(fstat(fd, &info) != 0 || (size_t)info.st_size < sizeof(header)) {
+        close(fd);
+        return false;
+    }
+    void* mapping = mmap(nullptr, info.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if(mapping == MAP_FAILED) return false;
+    madvise(mapping, info.st_size, MADV_SEQUENTIAL);
+
+    const uint8_t* data = (const uint8_t*)mapping;
+    memcpy(&header, data, sizeof(header));
+    bool ok = header.magic == LOGSTORE_MAGIC && header.version == LOGSTORE_VERSION && header.record == sizeof(IngestSample);
+    if(ok) {
+        for(uint8_t s = 0; s < RAW_SOURCES; s++) tables[s].source = s;
+        size_t records = (info.st_size - sizeof(header)) / sizeof(IngestSample);
+        const IngestSample* samples = (const IngestSample*)(data + sizeof(header));
+        for(size_t i = 0; i < records; i++) {
+            if(samples[i].type == TELEMETRY_RAW && samples[i].source < RAW_SOURCES) tables[samples[i].source].add(samples[i]);
+        }
+    }
+    munmap(mapping, info.st_size);
+    return ok;
+}
+
+/// @brief One column of a table, with the coefficient table of its channel
+struct RecalColumn {
+    const int32_t* codes;
+    const uint16_t* node;
+    const uint8_t* gain;
+    const Recal_COEFFS* coeffs;
+    float* out;
+};
+
+template<RECAL_DECODE Decode>
+static inline float decodeScalar(int32_t code, uint8_t gain) {
+    switch(Decode) {
+        case RECAL_DECODE::Adc:      return (float)code * MCP_GAIN_INVERSE[gain & 7];
+        case RECAL_DECODE::Unsigned: return (float)code;
+        case RECAL_DECODE::Signed16: return (float)(int16_t)code;
+        default: {
+            float x;
+            memcpy(&x, &code, sizeof(x));
+            return x;
+        }
+    }
+}
+
+template<RECAL_DECODE Decode>
+static void kernelScalar(const RecalColumn& column, size_t begin, size_t end) {
+    for(size_t i = begin; i < end; i++) {
+        float x = decodeScalar<Decode>(column.codes[i], column.gain[i]);
+        const Recal_COEFFS& k = column.coeffs[column.node[i]];
+        column.out[i] = k.c0 + x * (k.c1 + x * k.c2);
+    }
+}
+
+#if defined(__x86_64__)
+/// @brief Eight rows at a time. Same operations in the same order as kernelScalar and no FMA, so
+///        the results are bit identical
+template<RECAL_DECODE Decode>
+__attribute__((target("avx2"))) static void kernelAvx2(const RecalColumn& column, size_t begin, size_t end) {
+    const float* c0 = &column.coeffs[0].c0;
+    const float* c1 = &column.coeffs[0].c1;
+    const float* c2 = &column.coeffs[0].c2;
+    size_t i = begin;
+    for(; i + 8 <= end; i += 8) {
+        __m256i code = _mm256_loadu_si256((const __m256i*)(column.codes + i));
+        __m256 x;
+        switch(Decode) {
+            case RECAL_DECODE::Adc: {
+                __m256i gain = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)(column.gain + i)));
+                gain = _mm256_and_si256(gain, _mm256_set1_epi32(7));
+                x = _mm256_mul_ps(_mm256_cvtepi32_ps(code), _mm256_i32gather_ps(MCP_GAIN_INVERSE, gain, 4));
+                break;
+            }
+            case RECAL_DECODE::Unsigned: x = _mm256_cvtepi32_ps(code); break;
+            case RECAL_DECODE::Signed16: x = _mm256_cvtepi32_ps(_mm256_srai_epi32(_mm256_slli_epi32(code, 16), 16)); break;
+            default:                     x = _mm256_castsi256_ps(code); break;
+        }
+        // Recal_COEFFS is three floats, the node ID times 3 indexes each of them
+        __m256i node = _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i*)(column.node + i)));
+        node = _mm256_add_epi32(node, _mm256_slli_epi32(node, 1));
+        __m256 k0 = _mm256_i32gather_ps(c0, node, 4);
+        __m256 k1 = _mm256_i32gather_ps(c1, node, 4);
+        __m256 k2 = _mm256_i32gather_ps(c2, node, 4);
+        __m256 y = _mm256_add_ps(k0, _mm256_mul_ps(x, _mm256_add_ps(k1, _mm256_mul_ps(x, k2))));
+        _mm256_storeu_ps(column.out + i, y);
+    }
+    kernelScalar<Decode>(column, i, end);
+}
+#endif
+
+static_assert(sizeof(Recal_COEFFS) == 3 * sizeof(float), "The AVX2 kernel gathers from packed coefficients");
+
+/// @brief Run one column over a range of rows
+static void kernel(const RecalColumn& column, RECAL_DECODE decode, bool simd, size_t begin, size_t end) {
+#if defined(__x86_64__)
+    if(simd) {
+        switch(decode) {
+            case RECAL_DECODE::Adc:      kernelAvx2<RECAL_DECODE::Adc>(column, begin, end); return;
+            case RECAL_DECODE::Unsigned: kernelAvx2<RECAL_DECODE::Unsigned>(column, begin, end); return;
+            case RECAL_DECODE::Signed16: kernelAvx2<RECAL_DECODE::Signed16>(column, begin, end); return;
+            default:                     kernelAvx2<RECAL_DECODE::FloatBits>(column, begin, end); return;
+        }
+    }
+#endif
+    switch(decode) {
+        case RECAL_DECODE::Adc:      kernelScalar<RECAL_DECODE::Adc>(column, begin, end); return;
+        case RECAL_DECODE::Unsigned: kernelScalar<RECAL_DECODE::Unsigned>(column, begin, end); return;
+        case RECAL_DECODE::Signed16: kernelScalar<RECAL_DECODE::Signed16>(column, begin, end); return;
+        default:                     kernelScalar<RECAL_DECODE::FloatBits>(column, begin, end); return;
+    }
+}
+
+bool RecalEngine::haveAvx2(void) {
+#if defined(__x86_64__)
+    return __builtin_cpu_supports("avx2");
+#else
+    return false;
+#endif
+}
+
+/// @param threads 
+///        Worker threads, 0 for one per core
+/// @param simd 
+///        Use the AVX2 kernels if the CPU has them
+RecalEngine::RecalEngine(const RecalCalibration& calibration, unsigned threads, bool simd) : _calibration(calibration) {
+    _threads = threads ? threads : std::max(1u, std::thread::hardware_concurrency());
+    _simd = simd && haveAvx2();
+}
+
+/// @brief Fill the table's values from its codes with the current calibration
+/// @return False for sources that have no quadratic calibration: BME280 records go through
+///         runBme280() and calibration register records are its input
+bool RecalEngine::run(RecalTable& table) const {
+    if(table.source != RAW_MCP3564R && table.source != RAW_SEN55 && table.source != RAW_SCD30) return false;
+    size_t rows = table.size();
+    uint8_t channels = RECAL_SOURCE_CHANNELS[table.source];
+    std::vector<Recal_COEFFS> coeffs((size_t)channels * RECAL_NODES);
+    RecalColumn columns[RECAL_CHANNELS];
+    RECAL_DECODE decodes[RECAL_CHANNELS];
+    for(uint8_t c = 0; c < channels; c++) {
+        _calibration.table(table.source, c, &coeffs[(size_t)c * RECAL_NODES]);
+        table.values[c].resize(rows);
+        columns[c] = {table.codes[c].data(), table.node.data(), table.gain.data(), &coeffs[(size_t)c * RECAL_NODES],
+                      table.values[c].data()};
+        decodes[c] = decodeOf(table.source, c);
+    }
+
+    auto work = [&](size_t begin, size_t end) {
+        for(size_t tile = begin; tile < end; tile += RECAL_TILE) {
+            size_t tile_end = std::min(tile + RECAL_TILE, end);
+            for(uint8_t c = 0; c < channels; c++) kernel(columns[c], decodes[c], _simd, tile, tile_end);
+        }
+    };
+    unsigned threads = (unsigned)std::min<size_t>(_threads, rows / RECAL_MIN_THREAD_ROWS);
+    if(threads <= 1) {
+        work(0, rows);
+        return true;
+    }
+    std::vector<std::thread> pool;
+    size_t share = (rows + threads - 1) / threads;
+    share = (share + 7) & ~(size_t)7;   // Whole vectors per thread
+    for(unsigned t = 0; t < threads; t++) {
+        size_t begin = std::min(rows, t * share), end = std::min(rows, begin + share);
+        pool.emplace_back(work, begin, end);
+    }
+    for(std::thread& thread : pool) thread.join();
+    return true;
+}
+
+/// @brief Fill a RAW_BME280 table's values: Bosch compensation to °C, hPa and %RH, then the
+///        quadratic calibration. Each row uses its node's calibration registers as last sent
+///        before it, or first sent after it for rows from before the first one in the log. The
+///        registers are factory trimming, they only change when a sensor is replaced
+/// @param calibrations 
+///        The RAW_BME280_CALIB table of the same log
+/// @return Rows compensated, rows of nodes that never sent their registers are NaN
+size_t RecalEngine::runBme280(RecalTable& table, const RecalTable& calibrations) const {
+    if(table.source != RAW_BME280 || calibrations.source != RAW_BME280_CALIB) return 0;
+    size_t rows = table.size();
+
+    // Distinct register sets, and each node's in order of arrival
+    std::vector<BME280_COEFFS> sets;
+    std::unordered_map<uint16_t, std::vector<std::pair<uint64_t, uint32_t>>> history;    // Node: (received, set)
+    for(size_t i = 0; i < calibrations.size(); i++) {
+        if(calibrations.count[i] * sizeof(int32_t) < BME280_CALIB_BYTES) continue;
+        int32_t codes[RECAL_CHANNELS];
+        for(uint8_t c = 0; c < RECAL_CHANNELS; c++) codes[c] = calibrations.codes[c][i];
+        BME280_COEFFS coeffs;
+        bme280Coefficients((const uint8_t*)codes, &coeffs);
+        auto& node = history[calibrations.node[i]];
+        if(node.empty() || memcmp(&sets[node.back().second], &coeffs, sizeof(coeffs)) != 0) {
+            sets.push_back(coeffs);
+            node.emplace_back(calibrations.received[i], (uint32_t)sets.size() - 1);
+        }
+    }
+    for(auto& node : history) std::stable_sort(node.second.begin(), node.second.end());
+
+    // Rows by register set, so each set's rows go through one batch
+    const uint32_t NONE = UINT32_MAX;
+    std::vector<uint32_t> set_of(rows, NONE);
+    for(size_t i = 0; i < rows; i++) {
+        auto found = history.find(table.node[i]);
+        if(found == history.end()) continue;
+        auto& node = found->second;
+        auto after = std::upper_bound(node.begin(), node.end(), std::make_pair(table.received[i], UINT32_MAX));
+        set_of[i] = after == node.begin() ? after->second : (after - 1)->second;
+    }
+    std::vector<size_t> first(sets.size() + 1, 0);
+    for(uint32_t set : set_of) {
+        if(set != NONE) first[set + 1]++;
+    }
+    for(size_t s = 0; s < sets.size(); s++) first[s + 1] += first[s];
+    size_t compensated = first[sets.size()];
+    std::vector<size_t> order(compensated);
+    std::vector<size_t> fill(first.begin(), first.end() - 1);
+    for(size_t i = 0; i < rows; i++) {
+        if(set_of[i] != NONE) order[fill[set_of[i]]++] = i;
+    }
+
+    std::vector<int32_t> raw[3];
+    std::vector<float> out[3];
+    for(uint8_t c = 0; c < 3; c++) {
+        raw[c].resize(compensated);
+        out[c].resize(compensated);
+        for(size_t j = 0; j < compensated; j++) raw[c][j] = table.codes[c][order[j]];
+    }
+    Bme280_COLUMNS columns = {raw[0].data(), raw[1].data(), raw[2].data(), out[0].data(), out[1].data(), out[2].data()};
+    BME280_ISA isa = _simd ? Bme280Batch::bestIsa() : BME280_ISA::Scalar;
+    auto work = [&](size_t begin, size_t end) {
+        size_t s = std::upper_bound(first.begin(), first.end(), begin) - first.begin() - 1;
+        for(; begin < end; s++) {
+            size_t stop = std::min(end, first[s + 1]);
+            if(stop > begin) Bme280Batch(sets[s], isa).compensate(columns, begin, stop);
+            begin = stop;
+        }
+    };
+    unsigned threads = (unsigned)std::min<size_t>(_threads, compensated / RECAL_MIN_THREAD_ROWS);
+    if(threads <= 1) {
+        work(0, compensated);
+    } else {
+        std::vector<std::thread> pool;
+        size_t share = (compensated + threads - 1) / threads;
+        for(unsigned t = 0; t < threads; t++) {
+            size_t begin = std::min(compensated, t * share), end = std::min(compensated, begin + share);
+            pool.emplace_back(work, begin, end);
+        }
+        for(std::thread& thread : pool) thread.join();
+    }
+
+    for(uint8_t c = 0; c < 3; c++) {
+        table.values[c].assign(rows, NAN);
+        for(size_t j = 0; j < compensated; j++) {
+            size_t i = order[j];
+            const Recal_COEFFS& k = _calibration.get(table.node[i], RAW_BME280, c);
+            float x = out[c][j];
+            table.values[c][i] = k.c0 + x * (k.c1 + x * k.c2);
+        }
+    }
+    return compensated;
+}
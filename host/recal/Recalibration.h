@@ -0,0 +1,78 @@
+/*
+ *  Title: Recalibration.h
+ *  Description: Applies a new calibration to stored raw capture records. Records are split per
+ *               source into columns, and each column is converted from codes to the sensor's own
+ *               units and put through a per node quadratic, y = c0 + x (c1 + x c2). The column
+ *               kernel has an AVX2 version picked at run time, bit identical to the scalar one, and
+ *               the rows are spread over all cores. BME280 records get the Bosch compensation with
+ *               their node's calibration registers from its RAW_BME280_CALIB records first
+ *  Author: Tinna Osk Traustadottir
+ */
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <unordered_map>
+#include <vector>
+#include <SampleStore.h>
+
+const uint8_t RECAL_CHANNELS = TELEMETRY_RAW_CODES;
+
+extern const char* RECAL_SOURCE_NAMES[RAW_SOURCES];
+extern const uint8_t RECAL_SOURCE_CHANNELS[RAW_SOURCES];   // Codes a source can have
+
+/// @brief y = c0 + x (c1 + x c2), x in the units of RecalTable::decode
+struct Recal_COEFFS {
+    float c0 = 0.0f;
+    float c1 = 1.0f;
+    float c2 = 0.0f;
+};
+
+/// @brief Coefficients per source and channel, with per node overrides
+class RecalCalibration {
+public:
+    RecalCalibration();
+
+    bool load(const char* path);
+    void set(int32_t node, uint8_t source, uint8_t channel, const Recal_COEFFS& coeffs);
+    const Recal_COEFFS& get(uint16_t node, uint8_t source, uint8_t channel) const;
+    void table(uint8_t source, uint8_t channel, Recal_COEFFS* out) const;
+
+private:
+    Recal_COEFFS _defaults[RAW_SOURCES][RECAL_CHANNELS];
+    std::unordered_map<uint32_t, Recal_COEFFS> _nodes;     // node << 16 | source << 8 | channel
+};
+
+/// @brief Raw records of one source as columns, values filled in by RecalEngine::run
+struct RecalTable {
+    uint8_t source = 0;
+    uint8_t channels = 0;           // Most codes in any record
+    std::vector<uint64_t> timestamp;
+    std::vector<uint64_t> received;
+    std::vector<uint16_t> node;
+    std::vector<uint8_t> count;     // Codes in the record
+    std::vector<uint8_t> gain;      // RAW_MCP3564R ADC gain setting
+    std::vector<int32_t> codes[RECAL_CHANNELS];    // RECAL_SOURCE_CHANNELS of them
+    std::vector<float> values[RECAL_CHANNELS];
+
+    size_t size(void) const { return node.size(); }
+    void add(const IngestSample& sample);
+};
+
+bool recalLoad(const char* path, RecalTable tables[RAW_SOURCES]);
+
+class RecalEngine {
+public:
+    RecalEngine(const RecalCalibration& calibration, unsigned threads = 0, bool simd = true);
+
+    bool run(RecalTable& table) const;
+    size_t runBme280(RecalTable& table, const RecalTable& calibrations) const;
+
+    bool simd(void) const { return _simd; }
+    unsigned threads(void) const { return _threads; }
+    static bool haveAvx2(void);
+
+private:
+    const RecalCalibration& _calibration;
+    unsigned _threads;
+    bool _simd;
+};
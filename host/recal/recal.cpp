@@ -0,0 +1,93 @@
+/*
+ *  Title: recal.cpp
+ *  Description: Recalibrates the raw capture records of an ingestd sample log (ingestd --raw)
+ *               and writes the results as CSV, source by source in log order. Without a
+ *               calibration file the firmware's own defaults are applied. BME280 records are
+ *               compensated with their node's calibration registers first, so their x is in °C,
+ *               hPa and %RH
+ *
+ *               recal IN.aqlog OUT.csv [--calibration FILE] [--threads N] [--scalar]
+ *
+ *               Calibration lines: [NODE] SOURCE CHANNEL C0 C1 C2, y = C0 + x (C1 + x C2)
+ *               CSV columns: received,timestamp,node,source,value0,value1,...
+ *  Author: Tinna Osk Traustadottir
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <Bme280Batch.h>
+#include "Recalibration.h"
+
+static void usage(void) {
+    fprintf(stderr, "usage: recal IN.aqlog OUT.csv [--calibration FILE] [--threads N] [--scalar]\n");
+}
+
+int main(int argc, char** argv) {
+    if(argc < 3) {
+        usage();
+        return 2;
+    }
+    const char* calibration_path = nullptr;
+    unsigned threads = 0;
+    bool simd = true;
+    for(int i = 3; i < argc; i++) {
+        bool has_value = i + 1 < argc;
+        if(!strcmp(argv[i], "--calibration") && has_value) calibration_path = argv[++i];
+        else if(!strcmp(argv[i], "--threads") && has_value) threads = atoi(argv[++i]);
+        else if(!strcmp(argv[i], "--scalar")) simd = false;
+        else {
+            usage();
+            return 2;
+        }
+    }
+
+    RecalCalibration calibration;
+    if(calibration_path != nullptr && !calibration.load(calibration_path)) {
+        fprintf(stderr, "recal: can't read %s\n", calibration_path);
+        return 1;
+    }
+    static RecalTable tables[RAW_SOURCES];
+    if(!recalLoad(argv[1], tables)) {
+        fprintf(stderr, "recal: %s is not a sample log this version can read\n", argv[1]);
+        return 1;
+    }
+    FILE* out = fopen(argv[2], "w");
+    if(out == nullptr) {
+        fprintf(stderr, "recal: can't write %s\n", argv[2]);
+        return 1;
+    }
+
+    RecalEngine engine(calibration, threads, simd);
+    fprintf(out, "received,timestamp,node,source,values\n");
+    for(RecalTable& table : tables) {
+        if(table.size() == 0) continue;
+        if(table.source == RAW_BME280_CALIB) continue;     // Input of the BME280 compensation
+        auto start = std::chrono::steady_clock::now();
+        if(table.source == RAW_BME280) {
+            size_t compensated = engine.runBme280(table, tables[RAW_BME280_CALIB]);
+            if(compensated < table.size()) {
+                fprintf(stderr, "recal: %zu bme280 records without calibration registers, written as NaN\n",
+                        table.size() - compensated);
+            }
+        } else if(!engine.run(table)) {
+            fprintf(stderr, "recal: %zu %s records skipped, no recalibration for them\n", table.size(),
+                    RECAL_SOURCE_NAMES[table.source]);
+            continue;
+        }
+        double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        const char* isa = engine.simd() ? "AVX2" : "scalar";
+        if(table.source == RAW_BME280) isa = Bme280Batch::isaName(engine.simd() ? Bme280Batch::bestIsa() : BME280_ISA::Scalar);
+        fprintf(stderr, "recal: %zu %s records in %.2f ms (%s, %u threads)\n", table.size(),
+                RECAL_SOURCE_NAMES[table.source], ms, isa, engine.threads());
+        for(size_t i = 0; i < table.size(); i++) {
+            fprintf(out, "%llu,%llu,%u,%s", (unsigned long long)table.received[i], (unsigned long long)table.timestamp[i],
+                    table.node[i], RECAL_SOURCE_NAMES[table.source]);
+            for(uint8_t c = 0; c < table.count[i] && c < RECAL_SOURCE_CHANNELS[table.source]; c++) {
+                fprintf(out, ",%.9g", table.values[c][i]);
+            }
+            fprintf(out, "\n");
+        }
+    }
+    return fclose(out) == 0 ? 0 : 1;
+}
@@ -0,0 +1,88 @@
+/*
+ *  Title: BitStream.h
+ *  Description: MSB-first bit writer and reader for the column encodings. The reader works
+ *               straight on the mapped file and loads 8 bytes at a time, the writer pads every
+ *               column with 8 zero bytes so those loads never run past it
+ *  Author: Tinna Osk Traustadottir
+ */
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+
+class BitWriter {
+public:
+    explicit BitWriter(std::vector<uint8_t>& out) : _out(out) {};
+
+    /// @brief Append the low count bits of value, count up to 64
+    void write(uint64_t value, uint8_t count) {
+        if(count == 0) return;
+        if(count < 64) value &= (1ull << count) - 1;
+        while(count > 0) {
+            uint8_t free = 64 - _used;
+            uint8_t take = count < free ? count : free;
+            uint64_t part = (take == 64) ? value : (value >> (count - take)) & ((1ull << take) - 1);
+            _accumulator |= (take == 64) ? part : part << (free - take);
+            _used += take;
+            count -= take;
+            if(_used == 64) spill();
+        }
+    }
+
+    void writeBit(bool bit) { write(bit ? 1 : 0, 1); }
+
+    /// @brief Flush the partial word and pad so the reader can always load 8 bytes
+    void finish(void) {
+        for(uint8_t shift = 56; _used > 0; shift -= 8) {
+            _out.push_back((uint8_t)(_accumulator >> shift));
+            _used = _used > 8 ? _used - 8 : 0;
+        }
+        _accumulator = 0;
+        _out.insert(_out.end(), 8, 0);
+    }
+
+private:
+    std::vector<uint8_t>& _out;
+    uint64_t _accumulator = 0;
+    uint8_t _used = 0;
+
+    void spill(void) {
+        for(int shift = 56; shift >= 0; shift -= 8) _out.push_back((uint8_t)(_accumulator >> shift));
+        _accumulator = 0;
+        _used = 0;
+    }
+};
+
+class BitReader {
+public:
+    BitReader(const uint8_t* data) : _data(data) {};
+
+    /// @brief Read count bits, count up to 57
+    uint64_t read(uint8_t count) {
+        if(count == 0) return 0;
+        const uint8_t* p = _data + (_position >> 3);
+        uint64_t word = (uint64_t)p[0] << 56 | (uint64_t)p[1] << 48 | (uint64_t)p[2] << 40 | (uint64_t)p[3] << 32 |
+                        (uint64_t)p[4] << 24 | (uint64_t)p[5] << 16 | (uint64_t)p[6] << 8 | (uint64_t)p[7];
+        word <<= (_position & 7);
+        _position += count;
+        return word >> (64 - count);
+    }
+
+    uint64_t read64(void) {
+        uint64_t high = read(32);
+        return high << 32 | read(32);
+    }
+
+    bool readBit(void) { return read(1) != 0; }
+
+    /// @brief Count the 1 bits before the first 0, up to limit
+    uint8_t readOnes(uint8_t limit) {
+        uint8_t ones = 0;
+        while(ones < limit && readBit()) ones++;
+        return ones;
+    }
+
+private:
+    const uint8_t* _data;
+    size_t _position = 0;
+};
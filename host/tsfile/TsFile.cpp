@@ -0,0 +1,312 @@
+/*
+ *  Title: TsFile.cpp
+ *  Description: Columnar, compressed file format for packet history
+ *  Author: Tinna Osk Traustadottir
+ */
+#include "TsFile.h"
+#include "BitStream.h"
+#include <math.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+const char* TS_COLUMN_NAMES[TS_COLUMNS] = {"temperature", "no2", "humidity", "co2", "pm10", "pm4", "pm2_5", "pm1"};
+
+const uint8_t GORILLA_NO_WINDOW = 0xFF;
+
+static inline uint64_t zigzag(int64_t value) { return ((uint64_t)value << 1) ^ (uint64_t)(value >> 63); }
+static inline int64_t unzigzag(uint64_t value) { return (int64_t)(value >> 1) ^ -(int64_t)(value & 1); }
+
+static inline uint32_t floatBits(float value) {
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    return bits;
+}
+
+static inline uint16_t toCount(float value) {
+    if(!(value > 0.0f)) return 0;   // Also NaN
+    if(value >= 65535.0f) return 65535;
+    return (uint16_t)lrintf(value);
+}
+
+// Delta-of-delta buckets: '0' repeats the last delta, then '10', '110', '1110' with this many bits
+// of zigzagged delta-of-delta, and '1111' with all 64
+const uint8_t DOD_BITS[3] = {7, 12, 20};
+
+static void encodeTimestamps(BitWriter& bits, const std::vector<TsRow>& rows) {
+    bits.write(rows[0].timestamp >> 32, 32);
+    bits.write(rows[0].timestamp & 0xFFFFFFFF, 32);
+    int64_t previous_delta = 0;
+    for(size_t i = 1; i < rows.size(); i++) {
+        int64_t delta = (int64_t)(rows[i].timestamp - rows[i - 1].timestamp);
+        uint64_t dod = zigzag(delta - previous_delta);
+        previous_delta = delta;
+        if(dod == 0) {
+            bits.writeBit(false);
+            continue;
+        }
+        uint8_t bucket = 0;
+        while(bucket < 3 && dod >= (1ull << DOD_BITS[bucket])) bucket++;
+        bits.write((1u << (bucket + 1)) - 1, bucket + 1);   // bucket + 1 ones
+        if(bucket < 3) {
+            bits.writeBit(false);
+            bits.write(dod, DOD_BITS[bucket]);
+        } else {
+            bits.write(dod >> 32, 32);
+            bits.write(dod & 0xFFFFFFFF, 32);
+        }
+    }
+}
+
+static void encodeGorilla(BitWriter& bits, const std::vector<TsRow>& rows, uint8_t column) {
+    uint32_t previous = floatBits(rows[0].values[column]);
+    bits.write(previous, 32);
+    uint8_t window_leading = GORILLA_NO_WINDOW, window_trailing = 0;
+    for(size_t i = 1; i < rows.size(); i++) {
+        uint32_t value = floatBits(rows[i].values[column]);
+        uint32_t xored = value ^ previous;
+        previous = value;
+        if(xored == 0) {
+            bits.writeBit(false);
+            continue;
+        }
+        bits.writeBit(true);
+        uint8_t leading = __builtin_clz(xored);
+        uint8_t trailing = __builtin_ctz(xored);
+        if(leading > 31) leading = 31;
+        if(window_leading != GORILLA_NO_WINDOW && leading >= window_leading && trailing >= window_trailing) {
+            // Meaningful bits fit in the previous window
+            bits.writeBit(false);
+            bits.write(xored >> window_trailing, 32 - window_leading - window_trailing);
+        } else {
+            uint8_t significant = 32 - leading - trailing;
+            bits.writeBit(true);
+            bits.write(leading, 5);
+            bits.write(significant - 1, 5);
+            bits.write(xored >> trailing, significant);
+            window_leading = leading;
+            window_trailing = trailing;
+        }
+    }
+}
+
+static void encodeCounts(BitWriter& bits, const std::vector<TsRow>& rows, uint8_t column) {
+    uint16_t low = 65535, high = 0;
+    for(const TsRow& row : rows) {
+        uint16_t value = toCount(row.values[column]);
+        if(value < low) low = value;
+        if(value > high) high = value;
+    }
+    uint8_t width = 0;
+    while(width < 16 && (uint32_t)(high - low) >= (1u << width)) width++;
+    bits.write(low, 16);
+    bits.write(width, 5);
+    for(const TsRow& row : rows) bits.write(toCount(row.values[column]) - low, width);
+}
+
+TsWriter::~TsWriter() {
+    close();
+}
+
+/// @brief Open a file for appending, writing the file header if it is new
+/// @param path 
+///        File path
+/// @return True if successful, false if not or if the file is not an .aqts file of this version
+bool TsWriter::open(const char* path) {
+    _file = fopen(path, "a+b");
+    if(_file == nullptr) return false;
+    fseek(_file, 0, SEEK_END);
+    TsFile_HEADER header;
+    if(ftell(_file) == 0) {
+        header = {TSFILE_MAGIC, TSFILE_VERSION, TS_COLUMNS, _block_rows, 0};
+        return fwrite(&header, sizeof(header), 1, _file) == 1;
+    }
+    rewind(_file);
+    bool ok = fread(&header, sizeof(header), 1, _file) == 1 && header.magic == TSFILE_MAGIC &&
+              header.version == TSFILE_VERSION && header.columns == TS_COLUMNS;
+    fseek(_file, 0, SEEK_END);
+    return ok;
+}
+
+/// @brief Add a row, a block is written once its node has block_rows rows waiting.
+///        Rows of one node should come in time order, out of order rows cost space
+/// @return True if successful, false if a block write failed
+bool TsWriter::append(const TsRow& row) {
+    std::vector<TsRow>& rows = _pending[row.node];
+    if(rows.capacity() == 0) rows.reserve(_block_rows);
+    rows.push_back(row);
+    if(rows.size() < _block_rows) return true;
+    return writeBlock(row.node, rows);
+}
+
+/// @brief Write every node's partial block, e.g. before shutting down
+/// @return True if successful, false if not
+bool TsWriter::flushBlocks(void) {
+    bool ok = true;
+    for(auto& entry : _pending) {
+        if(!entry.second.empty()) ok &= writeBlock(entry.first, entry.second);
+    }
+    if(_file != nullptr) fflush(_file);
+    return ok;
+}
+
+/// @brief Write every node's partial block and make the file durable, a later crash loses
+///        nothing written so far. Readers see the partial blocks as ordinary blocks
+/// @return True if successful, false if not
+bool TsWriter::sync(void) {
+    if(_file == nullptr) return false;
+    bool ok = flushBlocks();
+    return ok && fsync(fileno(_file)) == 0;
+}
+
+/// @brief Write the partial blocks and close the file
+bool TsWriter::close(void) {
+    if(_file == nullptr) return true;
+    bool ok = flushBlocks();
+    ok &= fclose(_file) == 0;
+    _file = nullptr;
+    return ok;
+}
+
+bool TsWriter::writeBlock(uint16_t node, std::vector<TsRow>& rows) {
+    TsBlock_HEADER header = {};
+    header.magic = TSBLOCK_MAGIC;
+    header.node = node;
+    header.rows = rows.size();
+    header.t_min = std::numeric_limits<uint64_t>::max();
+    header.t_max = 0;
+    for(uint8_t c = 0; c < TS_COLUMNS; c++) {
+        header.min[c] = std::numeric_limits<float>::infinity();
+        header.max[c] = -std::numeric_limits<float>::infinity();
+    }
+    for(const TsRow& row : rows) {
+        if(row.timestamp < header.t_min) header.t_min = row.timestamp;
+        if(row.timestamp > header.t_max) header.t_max = row.timestamp;
+        for(uint8_t c = 0; c < TS_COLUMNS; c++) {
+            float value = tsColumnIsFloat(c) ? row.values[c] : (float)toCount(row.values[c]);
+            if(value < header.min[c]) header.min[c] = value;
+            if(value > header.max[c]) header.max[c] = value;
+        }
+    }
+
+    _buffer.assign(sizeof(header), 0);
+    header.offset[0] = _buffer.size();
+    {
+        BitWriter bits(_buffer);
+        encodeTimestamps(bits, rows);
+        bits.finish();
+    }
+    for(uint8_t c = 0; c < TS_COLUMNS; c++) {
+        header.offset[c + 1] = _buffer.size();
+        BitWriter bits(_buffer);
+        if(tsColumnIsFloat(c)) encodeGorilla(bits, rows, c);
+        else encodeCounts(bits, rows, c);
+        bits.finish();
+    }
+    header.bytes = _buffer.size();
+    memcpy(_buffer.data(), &header, sizeof(header));
+
+    rows.clear();
+    _blocks++;
+    return fwrite(_buffer.data(), 1, _buffer.size(), _file) == _buffer.size();
+}
+
+/// @brief Check the block header against a query
+/// @return False if no row of the block can match
+bool TsBlock::mayMatch(const TsQuery& query) const {
+    if(query.node >= 0 && _header.node != query.node) return false;
+    if(_header.t_max < query.t_from || _header.t_min > query.t_to) return false;
+    if(query.column >= 0 && query.column < TS_COLUMNS) {
+        if(_header.max[query.column] < query.min || _header.min[query.column] > query.max) return false;
+    }
+    return true;
+}
+
+/// @brief Decode the timestamp column
+/// @param out 
+///        header().rows timestamps
+void TsBlock::timestamps(uint64_t* out) const {
+    BitReader bits(_base + _header.offset[0]);
+    uint64_t timestamp = bits.read64();
+    int64_t delta = 0;
+    out[0] = timestamp;
+    for(uint16_t i = 1; i < _header.rows; i++) {
+        uint8_t bucket = bits.readOnes(4);
+        if(bucket > 0) {
+            uint64_t dod = (bucket < 4) ? bits.read(DOD_BITS[bucket - 1]) : bits.read64();
+            delta += unzigzag(dod);
+        }
+        timestamp += delta;
+        out[i] = timestamp;
+    }
+}
+
+/// @brief Decode one value column
+/// @param column 
+///        TS_COLUMN
+/// @param out 
+///        header().rows values
+void TsBlock::column(uint8_t column, float* out) const {
+    BitReader bits(_base + _header.offset[column + 1]);
+    if(!tsColumnIsFloat(column)) {
+        uint16_t low = bits.read(16);
+        uint8_t width = bits.read(5);
+        for(uint16_t i = 0; i < _header.rows; i++) out[i] = (float)(low + bits.read(width));
+        return;
+    }
+
+    uint32_t value = bits.read(32);
+    memcpy(&out[0], &value, sizeof(float));
+    uint8_t leading = 0, significant = 0, trailing = 0;
+    for(uint16_t i = 1; i < _header.rows; i++) {
+        if(bits.readBit()) {
+            if(bits.readBit()) {
+                leading = bits.read(5);
+                significant = bits.read(5) + 1;
+                trailing = 32 - leading - significant;
+            }
+            value ^= (uint32_t)bits.read(significant) << trailing;
+        }
+        memcpy(&out[i], &value, sizeof(float));
+    }
+}
+
+TsReader::~TsReader() {
+    close();
+}
+
+/// @brief Map a file for reading
+/// @param path 
+///        File path
+/// @return True if successful, false if not or if it is not an .aqts file of this version
+bool TsReader::open(const char* path) {
+    close();
+    int fd = ::open(path, O_RDONLY | O_CLOEXEC);
+    if(fd < 0) return false;
+    struct stat info;
+    if(fstat(fd, &info) != 0 || (size_t)info.st_size < sizeof(TsFile_HEADER)) {
+        ::close(fd);
+        return false;
+    }
+    void* mapping = mmap(nullptr, info.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if(mapping == MAP_FAILED) return false;
+    madvise(mapping, info.st_size, MADV_SEQUENTIAL);
+    _data = (const uint8_t*)mapping;
+    _size = info.st_size;
+
+    TsFile_HEADER header;
+    memcpy(&header, _data, sizeof(header));
+    if(header.magic != TSFILE_MAGIC || header.version != TSFILE_VERSION || header.columns != TS_COLUMNS) {
+        close();
+        return false;
+    }
+    return true;
+}
+
+void TsReader::close(void) {
+    if(_data != nullptr) munmap((void*)_data, _size);
+    _data = nullptr;
+    _size = 0;
+}
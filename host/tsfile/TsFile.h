@@ -0,0 +1,162 @@
+/*
+ *  Title: TsFile.h
+ *  Description: Columnar, compressed file format for packet history (.aqts). Rows are grouped per
+ *               node into blocks, and every block stores each packet_t field as its own column:
+ *                 timestamp                  delta-of-delta, variable length buckets
+ *                 temperature, NO2           Gorilla XOR floats
+ *                 humidity, CO2, PM 10..1    frame of reference, bit packed
+ *               Block headers carry the node, time range and per column min/max so a scan can
+ *               skip blocks without decoding them. The reader maps the file and decodes straight
+ *               out of the mapping
+ *
+ *               File:  TsFile_HEADER, then blocks back to back
+ *               Block: TsBlock_HEADER, then the columns at the offsets in the header
+ *               All integers little endian
+ *  Author: Tinna Osk Traustadottir
+ */
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+#include <limits>
+#include <unordered_map>
+#include <vector>
+
+const uint32_t TSFILE_MAGIC = 0x53545141;       // "AQTS"
+const uint16_t TSFILE_VERSION = 1;
+const uint32_t TSBLOCK_MAGIC = 0x4B4C4254;      // "TBLK"
+const uint16_t TSFILE_BLOCK_ROWS = 4096;        // Rows per block, per node
+
+/// @brief Value columns, in packet order
+enum TS_COLUMN : uint8_t {
+    TS_TEMPERATURE = 0,
+    TS_NO2,
+    TS_HUMIDITY,
+    TS_CO2,
+    TS_PM10,
+    TS_PM4,
+    TS_PM2_5,
+    TS_PM1,
+    TS_COLUMNS,
+};
+
+extern const char* TS_COLUMN_NAMES[TS_COLUMNS];
+
+/// @brief True for the packet_t float fields, the rest are 16 bit counts
+constexpr bool tsColumnIsFloat(uint8_t column) { return column <= TS_NO2; }
+
+/// @brief One packet
+struct TsRow {
+    uint64_t timestamp;         // Microseconds, node time or host time, whatever the source had
+    uint16_t node;
+    float values[TS_COLUMNS];   // Counts columns are rounded to uint16_t on write
+};
+
+struct TsFile_HEADER {
+    uint32_t magic;             // TSFILE_MAGIC
+    uint16_t version;           // TSFILE_VERSION
+    uint16_t columns;           // TS_COLUMNS
+    uint32_t block_rows;        // Rows per full block
+    uint32_t reserved;
+} __attribute__((packed));
+
+struct TsBlock_HEADER {
+    uint32_t magic;             // TSBLOCK_MAGIC
+    uint32_t bytes;             // Whole block including this header, the next block follows
+    uint16_t node;
+    uint16_t rows;
+    uint64_t t_min;
+    uint64_t t_max;
+    float min[TS_COLUMNS];
+    float max[TS_COLUMNS];
+    uint32_t offset[TS_COLUMNS + 1];    // From the start of the block, timestamp column first
+} __attribute__((packed));
+
+/// @brief Block filter for scans, a block is skipped if its header rules out every row
+struct TsQuery {
+    int32_t node = -1;                                          // -1 for any node
+    uint64_t t_from = 0;
+    uint64_t t_to = std::numeric_limits<uint64_t>::max();       // Inclusive
+    int8_t column = -1;                                         // Column the range applies to, -1 for none
+    float min = -std::numeric_limits<float>::infinity();
+    float max = std::numeric_limits<float>::infinity();
+};
+
+/// @brief Writes .aqts files. Rows are buffered per node and written a block at a time
+class TsWriter {
+public:
+    TsWriter(uint16_t block_rows = TSFILE_BLOCK_ROWS) : _block_rows(block_rows) {};
+    ~TsWriter();
+
+    bool open(const char* path);
+    bool append(const TsRow& row);
+    bool flushBlocks(void);
+    bool sync(void);
+    bool close(void);
+
+    uint64_t blocks(void) const { return _blocks; }
+
+private:
+    FILE* _file = nullptr;
+    uint16_t _block_rows;
+    uint64_t _blocks = 0;
+    std::unordered_map<uint16_t, std::vector<TsRow>> _pending;
+    std::vector<uint8_t> _buffer;
+
+    bool writeBlock(uint16_t node, std::vector<TsRow>& rows);
+};
+
+/// @brief One block in the mapped file. Decoding writes into caller buffers of header().rows
+///        elements, the compressed columns are read in place
+class TsBlock {
+public:
+    TsBlock(const uint8_t* base) : _base(base) { memcpy(&_header, base, sizeof(_header)); };
+
+    const TsBlock_HEADER& header(void) const { return _header; }
+    bool mayMatch(const TsQuery& query) const;
+
+    void timestamps(uint64_t* out) const;
+    void column(uint8_t column, float* out) const;
+
+private:
+    const uint8_t* _base;
+    TsBlock_HEADER _header;
+};
+
+/// @brief Reads .aqts files through a read-only mapping
+class TsReader {
+public:
+    ~TsReader();
+
+    bool open(const char* path);
+    void close(void);
+
+    /// @brief Call f(const TsBlock&) for each block that may match the query
+    /// @param from 
+    ///        File offset of the first block, a block boundary
+    /// @param end 
+    ///        Output if not null, offset just past the last whole block
+    /// @return Number of blocks skipped on their header
+    template<typename F>
+    size_t forEachBlock(const TsQuery& query, F f, size_t from = sizeof(TsFile_HEADER), size_t* end = nullptr) const {
+        size_t skipped = 0;
+        size_t position = from;
+        while(position + sizeof(TsBlock_HEADER) <= _size) {
+            TsBlock block(_data + position);
+            if(block.header().magic != TSBLOCK_MAGIC || block.header().bytes < sizeof(TsBlock_HEADER) ||
+               position + block.header().bytes > _size) break;    // Truncated tail of a file still being written
+            if(block.mayMatch(query)) f(block);
+            else skipped++;
+            position += block.header().bytes;
+        }
+        if(end != nullptr) *end = position;
+        return skipped;
+    }
+
+    size_t size(void) const { return _size; }
+
+private:
+    const uint8_t* _data = nullptr;
+    size_t _size = 0;
+};
@@ -0,0 +1,168 @@
+/*
+ *  Title: tsconvert.cpp
+ *  Description: Converts packet history between CSV logs, ingestd sample logs and .aqts files.
+ *               The formats are picked by file extension
+ *
+ *               tsconvert IN.{csv,aqlog,aqts} OUT.{csv,aqts}
+ *
+ *               CSV columns: timestamp,node,temperature,no2,humidity,co2,pm10,pm4,pm2_5,pm1
+ *  Author: Tinna Osk Traustadottir
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <functional>
+#include <SampleStore.h>
+#include "TsFile.h"
+
+static bool endsWith(const char* text, const char* suffix) {
+    size_t n = strlen(text), m = strlen(suffix);
+    return n >= m && strcmp(text + n - m, suffix) == 0;
+}
+
+/// @brief Read a CSV log, a header line is skipped
+static bool readCsv(const char* path, const std::function<bool(const TsRow&)>& out) {
+    FILE* file = fopen(path, "r");
+    if(file == nullptr) return false;
+    char line[512];
+    size_t number = 0;
+    bool ok = true;
+    while(ok && fgets(line, sizeof(line), file) != nullptr) {
+        number++;
+        if(line[0] < '0' || line[0] > '9') continue;    // Header or blank
+        TsRow row;
+        char* p = line;
+        row.timestamp = strtoull(p, &p, 10);
+        row.node = (uint16_t)strtoul(p + 1, &p, 10);
+        uint8_t c = 0;
+        for(; c < TS_COLUMNS && *p == ','; c++) row.values[c] = strtof(p + 1, &p);
+        if(c != TS_COLUMNS) {
+            fprintf(stderr, "tsconvert: %s:%zu: expected %d values\n", path, number, TS_COLUMNS);
+            ok = false;
+            break;
+        }
+        ok = out(row);
+    }
+    fclose(file);
+    return ok;
+}
+
+/// @brief Read the samples of an ingestd sample log. Rows get the host receive time, like ingestd's
+///        own .aqts output, node time restarts at every reboot
+static bool readLog(const char* path, const std::function<bool(const TsRow&)>& out) {
+    FILE* file = fopen(path, "rb");
+    if(file == nullptr) return false;
+    struct {
+        uint32_t magic;
+        uint16_t version;
+        uint16_t record;
+        uint64_t reserved;
+    } header;
+    if(fread(&header, sizeof(header), 1, file) != 1 || header.magic != LOGSTORE_MAGIC ||
+       header.version != LOGSTORE_VERSION || header.record != sizeof(IngestSample)) {
+        fprintf(stderr, "tsconvert: %s is not a sample log this version can read\n", path);
+        fclose(file);
+        return false;
+    }
+    IngestSample samples[1024];
+    size_t n;
+    bool ok = true;
+    while(ok && (n = fread(samples, sizeof(IngestSample), 1024, file)) > 0) {
+        for(size_t i = 0; ok && i < n; i++) {
+            if(samples[i].type != TELEMETRY_SAMPLE) continue;
+            TsRow row;
+            row.timestamp = samples[i].received;
+            row.node = samples[i].node;
+            memcpy(row.values, samples[i].values, sizeof(row.values));
+            ok = out(row);
+        }
+    }
+    fclose(file);
+    return ok;
+}
+
+/// @brief Read an .aqts file block by block
+static bool readTs(const char* path, const std::function<bool(const TsRow&)>& out) {
+    TsReader reader;
+    if(!reader.open(path)) return false;
+    static uint64_t timestamps[65536];
+    static float values[TS_COLUMNS][65536];
+    bool ok = true;
+    reader.forEachBlock(TsQuery(), [&](const TsBlock& block) {
+        if(!ok) return;
+        block.timestamps(timestamps);
+        for(uint8_t c = 0; c < TS_COLUMNS; c++) block.column(c, values[c]);
+        for(uint16_t i = 0; ok && i < block.header().rows; i++) {
+            TsRow row;
+            row.timestamp = timestamps[i];
+            row.node = block.header().node;
+            for(uint8_t c = 0; c < TS_COLUMNS; c++) row.values[c] = values[c][i];
+            ok = out(row);
+        }
+    });
+    return ok;
+}
+
+int main(int argc, char** argv) {
+    if(argc != 3) {
+        fprintf(stderr, "usage: tsconvert IN.{csv,aqlog,aqts} OUT.{csv,aqts}\n");
+        return 2;
+    }
+    const char* in = argv[1];
+    const char* out = argv[2];
+
+    TsWriter writer;
+    FILE* csv = nullptr;
+    std::function<bool(const TsRow&)> sink;
+    if(endsWith(out, ".aqts")) {
+        remove(out);
+        if(!writer.open(out)) {
+            fprintf(stderr, "tsconvert: can't create %s\n", out);
+            return 1;
+        }
+        sink = [&](const TsRow& row) { return writer.append(row); };
+    } else if(endsWith(out, ".csv")) {
+        csv = fopen(out, "w");
+        if(csv == nullptr) {
+            fprintf(stderr, "tsconvert: can't create %s\n", out);
+            return 1;
+        }
+        fprintf(csv, "timestamp,node");
+        for(uint8_t c = 0; c < TS_COLUMNS; c++) fprintf(csv, ",%s", TS_COLUMN_NAMES[c]);
+        fprintf(csv, "\n");
+        sink = [&](const TsRow& row) {
+            fprintf(csv, "%llu,%u", (unsigned long long)row.timestamp, row.node);
+            for(uint8_t c = 0; c < TS_COLUMNS; c++) {
+                if(tsColumnIsFloat(c)) fprintf(csv, ",%.9g", row.values[c]);
+                else fprintf(csv, ",%.0f", row.values[c]);
+            }
+            return fprintf(csv, "\n") > 0;
+        };
+    } else {
+        fprintf(stderr, "tsconvert: output has to be .csv or .aqts\n");
+        return 2;
+    }
+
+    uint64_t rows = 0;
+    auto counted = [&](const TsRow& row) {
+        rows++;
+        return sink(row);
+    };
+    bool ok;
+    if(endsWith(in, ".csv")) ok = readCsv(in, counted);
+    else if(endsWith(in, ".aqlog")) ok = readLog(in, counted);
+    else if(endsWith(in, ".aqts")) ok = readTs(in, counted);
+    else {
+        fprintf(stderr, "tsconvert: input has to be .csv, .aqlog or .aqts\n");
+        return 2;
+    }
+
+    if(csv != nullptr) ok &= fclose(csv) == 0;
+    else ok &= writer.close();
+    if(!ok) {
+        fprintf(stderr, "tsconvert: conversion failed after %llu rows\n", (unsigned long long)rows);
+        return 1;
+    }
+    printf("tsconvert: %llu rows\n", (unsigned long long)rows);
+    return 0;
+}
@@ -0,0 +1,130 @@
+/*
+ *  Title: AdaptiveSampler.cpp
+ *  Description: Per-stream acquisition periods that follow the signal rate of change
+ *  Author: Tinna Osk Traustadottir
+ */
+#include "AdaptiveSampler.h"
+#include <math.h>
+
+/// @brief Add a stream. It starts at its minimum period so nothing is missed after boot
+/// @param min_period 
+///        Shortest period, in ticks of the sample clock
+/// @param max_period 
+///        Longest period, in ticks
+/// @param fast_rate 
+///        Rate of change, in units per second, that drops the period straight to min_period
+/// @param slow_rate 
+///        Rate of change below which the period is doubled after the hold time
+/// @return Stream index, -1 if all streams are taken or the bounds are invalid
+int8_t AdaptiveSampler::addStream(uint16_t min_period, uint16_t max_period, float fast_rate, float slow_rate) {
+    if(_stream_count >= ADAPTIVE_MAX_STREAMS) return -1;
+    if(min_period == 0 || max_period < min_period || slow_rate > fast_rate) return -1;
+    Stream_t* s = &_streams[_stream_count];
+    s->min_period = min_period;
+    s->max_period = max_period;
+    s->fast_rate = fast_rate;
+    s->slow_rate = slow_rate;
+    s->period = min_period;
+    s->next_tick = 0;
+    s->stable_since = 0;
+    s->last_value = 0.0f;
+    s->last_timestamp = 0;
+    s->rate = 0.0f;
+    s->primed = false;
+    s->reads = 0;
+    s->skipped = 0;
+    s->transitions = 0;
+    return _stream_count++;
+}
+
+/// @brief Check if a stream should be read on this tick. Call once per stream per tick
+/// @param stream 
+///        Stream index
+/// @param tick 
+///        Sample clock tick
+/// @return True if the stream should be read
+bool AdaptiveSampler::due(uint8_t stream, uint32_t tick) {
+    Stream_t* s = &_streams[stream];
+    bool read = (int32_t)(tick - s->next_tick) >= 0;
+    if(read) {
+        s->next_tick = tick + s->period;
+        s->reads++;
+    }
+    // Reads a fixed min_period schedule would have done on this tick
+    if(!read && tick % s->min_period == 0) s->skipped++;
+    return read;
+}
+
+/// @brief The read found no new data, try again on the next tick instead of a full period later
+/// @param stream 
+///        Stream index
+/// @param tick 
+///        Sample clock tick of the read
+void AdaptiveSampler::retry(uint8_t stream, uint32_t tick) {
+    _streams[stream].next_tick = tick + 1;
+}
+
+/// @brief Feed a decoded sample. Fast changes shorten the period at once, the period
+///        only grows after the signal has been slow for the hold time
+/// @param stream 
+///        Stream index
+/// @param value 
+///        The sample
+/// @param timestamp 
+///        time_us_64() when the sample was read
+/// @param tick 
+///        Sample clock tick
+void AdaptiveSampler::update(uint8_t stream, float value, uint64_t timestamp, uint32_t tick) {
+    Stream_t* s = &_streams[stream];
+    if(s->primed && timestamp > s->last_timestamp) {
+        float dt = (float)(timestamp - s->last_timestamp) * 1e-6f;
+        float rate = fabsf(value - s->last_value) / dt;
+        s->rate += ADAPTIVE_RATE_SMOOTHING * (rate - s->rate);
+
+        if(s->rate >= s->fast_rate) {
+            if(s->period != s->min_period) setPeriod(s, stream, s->min_period, tick);
+            s->stable_since = tick;
+        } else if(s->rate >= s->slow_rate) {
+            s->stable_since = tick;
+        } else if(tick - s->stable_since >= _hold_ticks && s->period < s->max_period) {
+            uint32_t period = (uint32_t)s->period * 2;
+            setPeriod(s, stream, (period > s->max_period) ? s->max_period : (uint16_t)period, tick);
+        }
+    }
+    s->last_value = value;
+    s->last_timestamp = timestamp;
+    s->primed = true;
+}
+
+/// @brief Get the counters of one stream
+/// @param stream 
+///        Stream index
+/// @param stats 
+///        Pointer to a struct where the statistics will be inserted
+void AdaptiveSampler::getStats(uint8_t stream, AdaptiveSampler_STATS* stats) const {
+    const Stream_t* s = &_streams[stream];
+    stats->reads = s->reads;
+    stats->skipped = s->skipped;
+    stats->transitions = s->transitions;
+    stats->period = s->period;
+    stats->rate = s->rate;
+}
+
+/// @brief Clear the read, skip and transition counters of every stream
+void AdaptiveSampler::resetStats(void) {
+    for(uint8_t i = 0; i < _stream_count; i++) {
+        _streams[i].reads = 0;
+        _streams[i].skipped = 0;
+        _streams[i].transitions = 0;
+    }
+}
+
+void AdaptiveSampler::setPeriod(Stream_t* s, uint8_t stream, uint16_t period, uint32_t tick) {
+    uint16_t old_period = s->period;
+    s->period = period;
+    s->stable_since = tick;
+    s->transitions++;
+    // A shorter period takes effect on the next tick instead of waiting out the old one
+    if((int32_t)(s->next_tick - (tick + period)) > 0) s->next_tick = tick + period;
+    if(_callback != nullptr) _callback(stream, old_period, period, s->rate);
+}
@@ -0,0 +1,66 @@
+/*
+ *  Title: AdaptiveSampler.h
+ *  Description: Per-stream acquisition periods that follow the signal rate of change
+ *  Author: Tinna Osk Traustadottir
+ */
+#pragma once
+#include <pico/stdlib.h>
+
+const uint8_t ADAPTIVE_MAX_STREAMS = 4;
+const float ADAPTIVE_RATE_SMOOTHING = 0.3f;     // Weight of the newest derivative in the smoothed rate
+
+/// @brief Called every time a stream changes period
+/// @param stream The stream index returned by addStream()
+/// @param old_period Previous period, in ticks
+/// @param new_period New period, in ticks
+/// @param rate Smoothed absolute rate of change that caused the transition, in units per second
+typedef void (*adaptive_callback_t)(uint8_t stream, uint16_t old_period, uint16_t new_period, float rate);
+
+/// @brief Reads done and reads skipped compared to always running at the minimum period
+struct AdaptiveSampler_STATS {
+    uint32_t reads;
+    uint32_t skipped;
+    uint32_t transitions;
+    uint16_t period;        // Present period, in ticks
+    float rate;             // Smoothed absolute rate of change, in units per second
+};
+
+class AdaptiveSampler {
+public:
+    AdaptiveSampler(adaptive_callback_t callback, uint32_t hold_ticks) : _callback(callback), _hold_ticks(hold_ticks) {};
+
+    int8_t addStream(uint16_t min_period, uint16_t max_period, float fast_rate, float slow_rate);
+
+    bool due(uint8_t stream, uint32_t tick);
+    void retry(uint8_t stream, uint32_t tick);
+    void update(uint8_t stream, float value, uint64_t timestamp, uint32_t tick);
+
+    uint16_t period(uint8_t stream) const { return _streams[stream].period; };
+    void getStats(uint8_t stream, AdaptiveSampler_STATS* stats) const;
+    void resetStats(void);
+
+private:
+    struct Stream_t {
+        uint16_t min_period;
+        uint16_t max_period;
+        float fast_rate;        // At or above this the period drops straight to min_period
+        float slow_rate;        // Below this for hold_ticks the period doubles
+        uint16_t period;
+        uint32_t next_tick;     // First tick the stream is due again
+        uint32_t stable_since;  // Tick of the last sample at or above slow_rate, or of the last transition
+        float last_value;
+        uint64_t last_timestamp;
+        float rate;
+        bool primed;            // A previous sample exists to take the derivative against
+        uint32_t reads;
+        uint32_t skipped;
+        uint32_t transitions;
+    };
+
+    adaptive_callback_t _callback;
+    uint32_t _hold_ticks;
+    Stream_t _streams[ADAPTIVE_MAX_STREAMS];
+    uint8_t _stream_count = 0;
+
+    void setPeriod(Stream_t* s, uint8_t stream, uint16_t period, uint32_t tick);
+};
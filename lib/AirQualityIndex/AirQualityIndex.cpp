@@ -0,0 +1,230 @@
+/*
+ *  Title: AirQualityIndex.cpp
+ *  Description: Incremental 24 hour means, EPA NowCast and AQI for PM2.5, PM10 and NO2
+ *  Author: Tinna Osk Traustadottir
+ */
+#include "AirQualityIndex.h"
+#include <string.h>
+#include <math.h>
+
+static const uint64_t HOUR_US = 3600000000ull;
+
+/// @brief One row of an EPA breakpoint table
+struct AQI_BREAKPOINT {
+    float c_low, c_high;
+    int16_t i_low, i_high;
+};
+
+// EPA breakpoints, PM2.5 as revised in 2024. PM uses the NowCast, NO2 the 1 hour mean in ppb
+static const AQI_BREAKPOINT PM2_5_TABLE[] = {
+    {0.0f, 9.0f, 0, 50}, {9.1f, 35.4f, 51, 100}, {35.5f, 55.4f, 101, 150},
+    {55.5f, 125.4f, 151, 200}, {125.5f, 225.4f, 201, 300}, {225.5f, 325.4f, 301, 500},
+};
+static const AQI_BREAKPOINT PM10_TABLE[] = {
+    {0.0f, 54.0f, 0, 50}, {55.0f, 154.0f, 51, 100}, {155.0f, 254.0f, 101, 150},
+    {255.0f, 354.0f, 151, 200}, {355.0f, 424.0f, 201, 300}, {425.0f, 604.0f, 301, 500},
+};
+static const AQI_BREAKPOINT NO2_TABLE[] = {
+    {0.0f, 53.0f, 0, 50}, {54.0f, 100.0f, 51, 100}, {101.0f, 360.0f, 101, 150},
+    {361.0f, 649.0f, 151, 200}, {650.0f, 1249.0f, 201, 300}, {1250.0f, 2049.0f, 301, 500},
+};
+
+/// @brief Construct a new AirQualityIndex object with empty buckets
+AirQualityIndex::AirQualityIndex() {
+    memset(&_state, 0, sizeof(_state));
+    for(uint8_t p = 0; p < AQI_POLLUTANTS; p++) {
+        _state.pollutant[p].nowcast = -1.0f;
+        _acc_sum[p] = 0.0f;
+        _acc_count[p] = 0;
+    }
+}
+
+/// @brief Add a sample. O(1), except when an hour completes which costs O(AQI_HOURS)
+/// @param p 
+///        The pollutant (see AQI_POLLUTANT)
+/// @param value 
+///        The concentration, in ug/m3 for PM and ppm for NO2
+/// @param timestamp 
+///        Sample time in microseconds since boot
+void AirQualityIndex::add(AQI_POLLUTANT p, float value, uint64_t timestamp) {
+    if(p >= AQI_POLLUTANTS) return;
+    if(!_started) {
+        _started = true;
+        _hour_end_us = timestamp + HOUR_US;
+    }
+    // Close every hour that ended before this sample, an empty hour is recorded as missing
+    for(uint8_t i = 0; timestamp >= _hour_end_us && i <= AQI_HOURS; i++) {
+        closeHour();
+        _hour_end_us += HOUR_US;
+    }
+    if(timestamp >= _hour_end_us) {
+        // Gap longer than a day, realign to this sample
+        _hour_end_us = timestamp + HOUR_US;
+    }
+    _acc_sum[p] += value;
+    _acc_count[p]++;
+}
+
+/// @brief Check if an hour has completed since the last call, so the state can be persisted
+/// @return True if an hour completed
+bool AirQualityIndex::hourCompleted(void) {
+    bool completed = _completed;
+    _completed = false;
+    return completed;
+}
+
+/// @brief Mean of the most recent complete hour
+/// @param p The pollutant
+/// @return Mean concentration, negative if the hour has no data
+float AirQualityIndex::hourlyMean(AQI_POLLUTANT p) const {
+    const AQI_BUCKETS* b = &_state.pollutant[p];
+    if(!(b->valid & (1u << _state.head))) return -1.0f;
+    return b->hourly[_state.head];
+}
+
+/// @brief Rolling 24 hour mean over the hours that have data
+/// @param p The pollutant
+/// @return Mean concentration, negative if fewer than 18 of the last 24 hours have data
+float AirQualityIndex::dailyMean(AQI_POLLUTANT p) const {
+    const AQI_BUCKETS* b = &_state.pollutant[p];
+    if(b->count24 < 18) return -1.0f; // EPA requires 75% completeness
+    return b->sum24 / b->count24;
+}
+
+/// @brief NowCast concentration
+/// @param p The pollutant
+/// @return NowCast concentration, negative if not available
+float AirQualityIndex::nowCast(AQI_POLLUTANT p) const {
+    return _state.pollutant[p].nowcast;
+}
+
+/// @brief AQI for one pollutant. PM uses the NowCast, NO2 uses the 1 hour mean
+/// @param p The pollutant
+/// @return AQI, or -1 if not available
+int16_t AirQualityIndex::index(AQI_POLLUTANT p) const {
+    float c = (p == AQI_NO2) ? hourlyMean(p) : nowCast(p);
+    if(c < 0.0f) return -1;
+    return aqiFromConcentration(p, c);
+}
+
+/// @brief Overall AQI, the highest of the pollutant indices
+/// @return AQI, or -1 if no pollutant has one
+int16_t AirQualityIndex::index(void) const {
+    int16_t highest = -1;
+    for(uint8_t p = 0; p < AQI_POLLUTANTS; p++) {
+        int16_t i = index((AQI_POLLUTANT)p);
+        if(i > highest) highest = i;
+    }
+    return highest;
+}
+
+/// @brief Resume from a persisted state. The time the node was off is not known,
+///        so the stored hours are treated as directly preceding the current one
+/// @param state 
+///        Pointer to a state returned by state()
+void AirQualityIndex::restore(const AQI_STATE* state) {
+    memcpy(&_state, state, sizeof(_state));
+    if(_state.head >= AQI_HOURS) _state.head = 0;
+}
+
+/// @brief Move the current hour's mean into the buckets
+void AirQualityIndex::closeHour(void) {
+    uint8_t head = (_state.head + 1) % AQI_HOURS;
+    for(uint8_t p = 0; p < AQI_POLLUTANTS; p++) {
+        AQI_BUCKETS* b = &_state.pollutant[p];
+
+        // The bucket being overwritten leaves the 24 hour window
+        if(b->valid & (1u << head)) {
+            b->sum24 -= b->hourly[head];
+            b->count24--;
+        }
+        if(_acc_count[p] > 0) {
+            b->hourly[head] = _acc_sum[p] / _acc_count[p];
+            b->valid |= (1u << head);
+            b->sum24 += b->hourly[head];
+            b->count24++;
+        } else {
+            b->hourly[head] = 0.0f;
+            b->valid &= ~(1u << head);
+        }
+        _acc_sum[p] = 0.0f;
+        _acc_count[p] = 0;
+
+        // Resum once a day so rounding errors from the running sum don't build up
+        if(head == 0) {
+            b->sum24 = 0.0f;
+            for(uint8_t h = 0; h < AQI_HOURS; h++) {
+                if(b->valid & (1u << h)) b->sum24 += b->hourly[h];
+            }
+        }
+    }
+    _state.head = head;
+    _state.hours++;
+
+    for(uint8_t p = 0; p < AQI_POLLUTANTS; p++) {
+        updateNowCast(&_state.pollutant[p]);
+    }
+    _completed = true;
+}
+
+/// @brief Recalculate the EPA NowCast from the last 12 hourly means
+/// @param b 
+///        Buckets of the pollutant
+void AirQualityIndex::updateNowCast(AQI_BUCKETS* b) {
+    float c_min = 0.0f, c_max = 0.0f;
+    uint8_t recent = 0; // Valid hours among the last three
+    bool any = false;
+    for(uint8_t i = 0; i < AQI_NOWCAST_HOURS; i++) {
+        uint8_t h = (_state.head + AQI_HOURS - i) % AQI_HOURS;
+        if(!(b->valid & (1u << h))) continue;
+        if(i < 3) recent++;
+        if(!any || b->hourly[h] < c_min) c_min = b->hourly[h];
+        if(!any || b->hourly[h] > c_max) c_max = b->hourly[h];
+        any = true;
+    }
+    if(recent < 2) {
+        b->nowcast = -1.0f;
+        return;
+    }
+
+    float weight = (c_max > 0.0f) ? c_min / c_max : 1.0f;
+    if(weight < 0.5f) weight = 0.5f;
+
+    float factor = 1.0f, num = 0.0f, den = 0.0f;
+    for(uint8_t i = 0; i < AQI_NOWCAST_HOURS; i++) {
+        uint8_t h = (_state.head + AQI_HOURS - i) % AQI_HOURS;
+        if(b->valid & (1u << h)) {
+            num += factor * b->hourly[h];
+            den += factor;
+        }
+        factor *= weight;
+    }
+    b->nowcast = num / den;
+}
+
+/// @brief Convert a concentration to an AQI with the EPA breakpoint tables
+/// @param p 
+///        The pollutant
+/// @param concentration 
+///        Concentration in ug/m3 for PM and ppm for NO2
+/// @return AQI, 500 if above the highest breakpoint
+int16_t aqiFromConcentration(AQI_POLLUTANT p, float concentration) {
+    const AQI_BREAKPOINT* table;
+    float c;
+    switch(p) {
+        case AQI_PM2_5: table = PM2_5_TABLE; c = floorf(concentration * 10.0f) / 10.0f; break;
+        case AQI_PM10:  table = PM10_TABLE;  c = floorf(concentration);                 break;
+        case AQI_NO2:   table = NO2_TABLE;   c = floorf(concentration * 1000.0f);       break; // ppm to ppb
+        default: return -1;
+    }
+    if(c < 0.0f) c = 0.0f;
+
+    for(uint8_t i = 0; i < 6; i++) {
+        const AQI_BREAKPOINT* bp = &table[i];
+        if(c <= bp->c_high) {
+            if(c < bp->c_low) c = bp->c_low; // Falls between two truncated breakpoints
+            return (int16_t)lroundf((bp->i_high - bp->i_low) / (bp->c_high - bp->c_low) * (c - bp->c_low) + bp->i_low);
+        }
+    }
+    return 500;
+}
@@ -0,0 +1,65 @@
+/*
+ *  Title: AirQualityIndex.h
+ *  Description: Incremental 24 hour means, EPA NowCast and AQI for PM2.5, PM10 and NO2
+ *  Author: Tinna Osk Traustadottir
+ */
+#pragma once
+#include <stdint.h>
+
+const uint8_t AQI_HOURS = 24;           // Hourly buckets kept per pollutant
+const uint8_t AQI_NOWCAST_HOURS = 12;   // Hours weighed by NowCast
+const uint16_t AQI_STATE_VERSION = 1;   // Bump when AQI_STATE changes layout
+const uint16_t AQI_STATE_TAG = 0x0A01;  // FlashStore tag for AQI_STATE
+
+enum AQI_POLLUTANT : uint8_t {
+    AQI_PM2_5 = 0,  // ug/m3
+    AQI_PM10,       // ug/m3
+    AQI_NO2,        // ppm
+    AQI_POLLUTANTS,
+};
+
+/// @brief Hourly buckets for one pollutant
+struct AQI_BUCKETS {
+    float hourly[AQI_HOURS];    // Hourly means, hourly[head] is the most recent complete hour
+    uint32_t valid;             // Bit n set if hourly[n] holds data
+    float sum24;                // Sum of the valid hourly means
+    uint8_t count24;            // Number of valid hourly means
+    float nowcast;              // NowCast concentration, negative if not available
+};
+
+/// @brief Everything needed to resume after a reboot, persisted once an hour
+struct AQI_STATE {
+    uint32_t hours;             // Complete hours recorded so far
+    uint8_t head;               // Bucket of the most recent complete hour
+    AQI_BUCKETS pollutant[AQI_POLLUTANTS];
+};
+
+class AirQualityIndex {
+public:
+    AirQualityIndex();
+
+    void add(AQI_POLLUTANT p, float value, uint64_t timestamp);
+    bool hourCompleted(void);
+
+    float hourlyMean(AQI_POLLUTANT p) const;
+    float dailyMean(AQI_POLLUTANT p) const;
+    float nowCast(AQI_POLLUTANT p) const;
+    int16_t index(AQI_POLLUTANT p) const;
+    int16_t index(void) const;
+
+    const AQI_STATE* state(void) const { return &_state; };
+    void restore(const AQI_STATE* state);
+
+private:
+    AQI_STATE _state;
+    bool _started = false;
+    bool _completed = false;
+    uint64_t _hour_end_us = 0;              // End of the hour being accumulated
+    float _acc_sum[AQI_POLLUTANTS];         // Sum of samples in the current hour
+    uint32_t _acc_count[AQI_POLLUTANTS];    // Number of samples in the current hour
+
+    void closeHour(void);
+    void updateNowCast(AQI_BUCKETS* b);
+};
+
+int16_t aqiFromConcentration(AQI_POLLUTANT p, float concentration);
@@ -0,0 +1,99 @@
+/*
+ *  Title: AlertEngine.cpp
+ *  Description: Per-metric threshold alerts with hysteresis, evaluated as soon as a sample is decoded
+ *  Author: Tinna Osk Traustadottir
+ */
+#include "AlertEngine.h"
+
+/// @brief Watch a metric
+/// @param metric 
+///        Metric index, the same index is passed to evaluate()
+/// @param warning 
+///        Warning threshold
+/// @param danger 
+///        Danger threshold, at or above the warning threshold
+/// @param hysteresis 
+///        How far below a threshold the value has to drop before the level clears
+/// @return True if successful, false if all rules are taken
+bool AlertEngine::addRule(uint8_t metric, float warning, float danger, float hysteresis) {
+    if(_rule_count >= ALERT_MAX_RULES) return false;
+    Rule_t* rule = &_rules[_rule_count++];
+    rule->metric = metric;
+    rule->warning = warning;
+    rule->danger = danger;
+    rule->hysteresis = hysteresis;
+    rule->level = ALERT_LEVEL::Level_normal;
+    return true;
+}
+
+/// @brief Check a freshly decoded value against the rules for its metric. Call this directly
+///        after the read, before anything slow like display updates
+/// @param metric 
+///        Metric index
+/// @param value 
+///        The value
+/// @param sample_time 
+///        time_us_64() when the bus read of the value completed
+void AlertEngine::evaluate(uint8_t metric, float value, uint64_t sample_time) {
+    for(uint8_t i = 0; i < _rule_count; i++) {
+        Rule_t* rule = &_rules[i];
+        if(rule->metric != metric) continue;
+
+        // Rising edges use the thresholds, falling edges the thresholds minus the hysteresis
+        ALERT_LEVEL level = rule->level;
+        if(value >= rule->danger) {
+            level = ALERT_LEVEL::Level_danger;
+        } else if(value >= rule->warning) {
+            if(level != ALERT_LEVEL::Level_danger || value < rule->danger - rule->hysteresis) {
+                level = ALERT_LEVEL::Level_warning;
+            }
+        } else if(value < rule->warning - rule->hysteresis) {
+            level = ALERT_LEVEL::Level_normal;
+        } else if(level == ALERT_LEVEL::Level_danger) {
+            level = ALERT_LEVEL::Level_warning;
+        }
+        if(level == rule->level) continue;
+
+        float threshold = (level > rule->level)
+            ? ((level == ALERT_LEVEL::Level_danger) ? rule->danger : rule->warning)
+            : ((rule->level == ALERT_LEVEL::Level_danger) ? rule->danger : rule->warning);
+        rule->level = level;
+        _callback(metric, level, value, threshold, sample_time);
+
+        uint32_t latency = (uint32_t)(time_us_64() - sample_time);
+        _alerts++;
+        _sum_us += latency;
+        if(latency > _max_us) _max_us = latency;
+        if(latency > ALERT_LATENCY_TARGET_US) _late++;
+    }
+}
+
+/// @brief Current level of a metric, the highest of its rules
+/// @param metric 
+///        Metric index
+/// @return The level
+ALERT_LEVEL AlertEngine::level(uint8_t metric) const {
+    ALERT_LEVEL highest = ALERT_LEVEL::Level_normal;
+    for(uint8_t i = 0; i < _rule_count; i++) {
+        if(_rules[i].metric == metric && _rules[i].level > highest) highest = _rules[i].level;
+    }
+    return highest;
+}
+
+/// @brief Get the latency statistics
+/// @param stats 
+///        Pointer to a struct where the statistics will be inserted
+void AlertEngine::getStats(AlertEngine_STATS* stats) const {
+    stats->alerts = _alerts;
+    stats->late = _late;
+    stats->max_us = _max_us;
+    stats->mean_us = (_alerts > 0) ? (uint32_t)(_sum_us / _alerts) : 0;
+}
+
+/// @brief Start new latency statistics, the rule levels are kept
+void AlertEngine::resetStats(void) {
+    _alerts = 0;
+    _late = 0;
+    _max_us = 0;
+    _sum_us = 0;
+}
@@ -0,0 +1,62 @@
+/*
+ *  Title: AlertEngine.h
+ *  Description: Per-metric threshold alerts with hysteresis, evaluated as soon as a sample is decoded
+ *  Author: Tinna Osk Traustadottir
+ */
+#pragma once
+#include <pico/stdlib.h>
+
+const uint8_t ALERT_MAX_RULES = 8;
+const uint32_t ALERT_LATENCY_TARGET_US = 5000;  // Alerts slower than this are counted as late
+
+enum class ALERT_LEVEL : uint8_t {
+    Level_normal = 0,
+    Level_warning,
+    Level_danger,
+};
+
+/// @brief Measurement-to-alert latency, from the end of the bus read to the callback returning
+struct AlertEngine_STATS {
+    uint32_t alerts;        // Level transitions raised
+    uint32_t late;          // Transitions slower than ALERT_LATENCY_TARGET_US
+    uint32_t max_us;        // Slowest transition
+    uint32_t mean_us;       // Mean latency
+};
+
+/// @brief Called on every level transition
+/// @param metric The metric the rule watches
+/// @param level The new level
+/// @param value The value that caused the transition
+/// @param threshold The threshold that was crossed
+/// @param sample_time time_us_64() when the bus read of the value completed
+typedef void (*alert_callback_t)(uint8_t metric, ALERT_LEVEL level, float value, float threshold, uint64_t sample_time);
+
+class AlertEngine {
+public:
+    AlertEngine(alert_callback_t callback) : _callback(callback) {};
+
+    bool addRule(uint8_t metric, float warning, float danger, float hysteresis);
+    void evaluate(uint8_t metric, float value, uint64_t sample_time);
+
+    ALERT_LEVEL level(uint8_t metric) const;
+    void getStats(AlertEngine_STATS* stats) const;
+    void resetStats(void);
+
+private:
+    struct Rule_t {
+        uint8_t metric;
+        float warning;      // Raise warning at or above this
+        float danger;       // Raise danger at or above this
+        float hysteresis;   // A level clears once the value drops this far below its threshold
+        ALERT_LEVEL level;
+    };
+
+    alert_callback_t _callback;
+    Rule_t _rules[ALERT_MAX_RULES];
+    uint8_t _rule_count = 0;
+
+    uint32_t _alerts = 0;
+    uint32_t _late = 0;
+    uint32_t _max_us = 0;
+    uint64_t _sum_us = 0;
+};
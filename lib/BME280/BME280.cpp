@@ -1,30 +1,54 @@
 #include "BME280.h"
 #include <string.h> // Used for memcpy
+#include <math.h>
 
-/// @brief Initialize communications for the BME280 sensor
+/// @brief Initialize communications for the BME280 sensor and start it in normal mode
+/// @param settings 
+///        Oversampling, filter and standby time, one of BME280_PRESETS or custom
 /// @return True if successful, false if not
-bool BME280::init(void) {
+bool BME280::init(const BME280_SETTINGS& settings) {
     reset();
+    sleep_ms(BME280_STARTUP_MS);
+    return setup(settings);
+}
+
+/// @brief Check the chip, fetch the calibration and start normal mode, for a sensor that has
+///        had BME280_STARTUP_MS since power-up or reset()
+/// @param settings 
+///        Oversampling, filter and standby time
+/// @return True if successful, false if not
+bool BME280::setup(const BME280_SETTINGS& settings) {
+    if(!checkConnected()) return false;
+    return fetchCompensationData() && configure(settings);
+}
 
-    bool successful = true;
-    successful &= checkConnected(); // If it is connected then it is successful
-    sleep_us(250);
-    successful &= fetchCompensationData(); // If fetching worked then successful stays true, otherwise it's set to false
-    sleep_us(250); // Wait a bit to allow the sensor to finish processing
-
-    uint8_t buffer[3];
-    readRegister(BME280_ctrl_hum, buffer, sizeof(buffer));
-    buffer[0] = buffer[0] | 0b00000101; // Here we want to check the oversampling on ctrl_hum, binary 00000101
-    buffer[2] = buffer[2] | 0b10110111; // Here we want to check the oversampling for ctrl_meas (press and temp) and setting mode
-    writeRegister(BME280_ctrl_hum, buffer[0]); // Here we need to write on ctl_hum before writing on ctrl_meas
-    writeRegister(BME280_ctrl_meas, buffer[2]);
-    return successful;
+/// @brief Write the measurement settings and (re)start normal mode. ctrl_hum only takes effect
+///        with the ctrl_meas write after it and config writes can be ignored in normal mode, so
+///        the sensor goes to sleep first and every register is written in full
+/// @param settings 
+///        Oversampling, filter and standby time
+/// @return True if successful, false if not
+bool BME280::configure(const BME280_SETTINGS& settings) {
+    if((uint8_t)settings.osr_temperature > (uint8_t)BME280_OSR::Osr_x16 ||
+       (uint8_t)settings.osr_pressure > (uint8_t)BME280_OSR::Osr_x16 ||
+       (uint8_t)settings.osr_humidity > (uint8_t)BME280_OSR::Osr_x16 ||
+       (uint8_t)settings.filter > (uint8_t)BME280_FILTER::Filter_16 ||
+       (uint8_t)settings.standby > (uint8_t)BME280_STANDBY::Standby_20ms) return false;
+
+    uint8_t ctrl_meas = ((uint8_t)settings.osr_temperature << 5) | ((uint8_t)settings.osr_pressure << 2);
+    uint8_t config = ((uint8_t)settings.standby << 5) | ((uint8_t)settings.filter << 2);   // spi3w_en stays 0
+
+    if(!writeRegister(BME280_ctrl_meas, ctrl_meas | (uint8_t)BME280_MODE::Mode_sleep)) return false;
+    if(!writeRegister(BME280_ctrl_hum, (uint8_t)settings.osr_humidity)) return false;
+    if(!writeRegister(BME280_config, config)) return false;
+    if(!writeRegister(BME280_ctrl_meas, ctrl_meas | (uint8_t)BME280_MODE::Mode_normal)) return false;
+    _settings = settings;
+    return true;
 }
 
-/// @brief Soft reset the BME280 sensor
+/// @brief Soft reset the BME280 sensor, it takes BME280_STARTUP_MS to come back
 void BME280::reset(void){
     writeRegister(BME280_reset, 0xB6);
-    sleep_ms(10);
 }
 /// @brief Check to see if it is connected
 /// @param  
@@ -35,26 +59,80 @@ bool BME280::checkConnected(void){
     return buffer[0] == BME_chip_id;
 }
 
+/// @brief Check that no conversion is running, the data registers then hold one complete
+///        measurement. Costs one register read
+/// @return True if the data can be read, false while measuring or if the read failed
+bool BME280::dataReady(void) {
+    uint8_t status;
+    if(!readRegister(BME280_status, &status)) return false;
+    return (status & BME280_status_measuring) == 0;
+}
+
 /// @brief Read temperature, pressure and relative humidity from the BME280
-/// @return True if successful, false if not
+/// @return True if successful, false if not or if a conversion was running
 bool BME280::read() {
+    BME280_RAW raw;
+    if(!readRaw(&raw)) return false;
+
+    compensate(raw);
+    return true;
+}
+
+/// @brief Read the ADC values without compensating them, timestamp is still updated. The burst
+///        read is only started when the status register shows no conversion running, otherwise
+///        measuring is set and nothing is read. In normal mode a read succeeds in the standby
+///        window, so reads at a fixed interval miss about measurement / period of the time
+/// @param raw 
+///        Output, the ADC values
+/// @return True if successful, false if not or if a conversion was running
+bool BME280::readRaw(BME280_RAW* raw) {
+    uint8_t status;
     uint8_t buffer[8];
 
+    if(!readRegister(BME280_status, &status)) return false;
+    measuring = (status & BME280_status_measuring) != 0;
+    if(measuring) return false;
+
     if(!readRegister(BME280_press_msb, buffer, sizeof(buffer))) return false;
+    timestamp = time_us_64();
 
-    int32_t raw_t, raw_p, raw_h;
     /* We have 8 bits in each register, temp and press both have xlsb that have 0 in the bits 3-0
     *  We shift the bits around, we have 32 int in each register, so we shift it around so the bits fit
        at the right space. */
-    raw_p = ((int32_t)buffer[0]<<12 | (int32_t)buffer[1]<<4 | (int32_t)buffer[2]>>4);
-    raw_t = ((int32_t)buffer[3]<<12 | (int32_t)buffer[4]<<4 | (int32_t)buffer[5]>>4);
-    raw_h = ((int32_t)buffer[6]<<8 | (int32_t)buffer[7]);
-
-    compensateValues(&temperature, &pressure, &humidity, raw_t, raw_p, raw_h);
-
+    raw->pressure = ((int32_t)buffer[0]<<12 | (int32_t)buffer[1]<<4 | (int32_t)buffer[2]>>4);
+    raw->temperature = ((int32_t)buffer[3]<<12 | (int32_t)buffer[4]<<4 | (int32_t)buffer[5]>>4);
+    raw->humidity = ((int32_t)buffer[6]<<8 | (int32_t)buffer[7]);
     return true;
 }
 
+/// @brief Compensate ADC values with the calibration fetched at init into temperature (°C),
+///        pressure (hPa) and humidity (%RH). Values that aren't measured are NaN
+/// @param raw 
+///        The ADC values, from readRaw()
+void BME280::compensate(const BME280_RAW& raw) {
+    if(_compensation == BME280_COMPENSATION::Compensation_fast) {
+        BME280_FIXED fixed;
+        bme280CompensateFast(fast_coeffs, raw, &fixed);
+        temperature = (float)fixed.temperature / 100.0f;
+        pressure = (float)fixed.pressure / 25600.0f;
+        humidity = (float)fixed.humidity / 1024.0f;
+    } else {
+        bme280Compensate(comp_coeffs, raw, &temperature, &pressure, &humidity);
+    }
+    if(_settings.osr_pressure == BME280_OSR::Osr_skip) pressure = NAN;
+    if(_settings.osr_humidity == BME280_OSR::Osr_skip) humidity = NAN;
+}
+
+/// @brief Compensate ADC values to integers with the selected routine, no float math at all.
+///        Values that aren't measured are left as the routine computes them
+/// @param raw 
+///        The ADC values, from readRaw()
+/// @param fixed 
+///        Output, 0.01 °C, Q24.8 Pa and Q22.10 %RH
+void BME280::compensateFixed(const BME280_RAW& raw, BME280_FIXED* fixed) const {
+    if(_compensation == BME280_COMPENSATION::Compensation_fast) bme280CompensateFast(fast_coeffs, raw, fixed);
+    else bme280CompensateFixed(comp_coeffs, raw, fixed);
+}
 
 /********** Private methods **********/
 
@@ -90,20 +168,6 @@ bool BME280::readRegister(uint8_t reg, uint8_t* data, uint8_t length){
 
 
 
-/// @brief Type pun a uint16_t variable to an int16_t variable
-/// @param x Input value in uint16_t format
-/// @return A reinterpreted value containing the original data in int16_t format
-[[nodiscard]] int16_t uint16_t_to_int16_t(uint16_t x) noexcept {
-    return *reinterpret_cast<int16_t*>(&x);
-}
-
-/// @brief Type pun a uint8_t variable to an int8_t variable
-/// @param x Input value in uint8_t format
-/// @return A reinterpreted value containing the original data in int8_t format
-[[nodiscard]] int8_t uint8_t_to_int8_t(uint8_t x) noexcept {
-    return *reinterpret_cast<int8_t*>(&x);
-}
-
 /// @brief Fetch the compensation data from the BME280
 /// @return True of fetching successful, false if not
 bool BME280::fetchCompensationData(void) {
@@ -119,81 +183,12 @@ bool BME280::fetchCompensationData(void) {
     if (i2c_write_timeout_us(_i2c, BME280_ADDRESS, &compensation_reg_second, 1, false, 10000) != 1) return false;
     if (i2c_read_timeout_us(_i2c, BME280_ADDRESS, buffer + 26, 7, false, 10000) != 7) return false;
 
-    // Zero-initialize the comp_coeffs struct
-    memset(&comp_coeffs, 0, sizeof(comp_coeffs));
+    // Kept as read for raw capture, without the unused 0xA0
+    memcpy(_calibration, buffer, 24);
+    memcpy(_calibration + 24, buffer + 25, 8);
 
     // Insert the compensation data into the struct for it
-    comp_coeffs.dig_T1 = ((uint16_t)buffer[1] << 8) | (uint16_t)buffer[0];
-    comp_coeffs.dig_T2 = uint16_t_to_int16_t(((uint16_t)buffer[3] << 8) | (uint16_t)buffer[2]);
-    comp_coeffs.dig_T3 = uint16_t_to_int16_t(((uint16_t)buffer[5] << 8) | (uint16_t)buffer[4]);
-    comp_coeffs.dig_P1 = ((uint16_t)buffer[7] << 8) | (uint16_t)buffer[6];
-    comp_coeffs.dig_P2 = uint16_t_to_int16_t(((uint16_t)buffer[9] << 8) | (uint16_t)buffer[8]);
-    comp_coeffs.dig_P3 = uint16_t_to_int16_t(((uint16_t)buffer[11] << 8) | (uint16_t)buffer[10]);
-    comp_coeffs.dig_P4 = uint16_t_to_int16_t(((uint16_t)buffer[13] << 8) | (uint16_t)buffer[12]);
-    comp_coeffs.dig_P5 = uint16_t_to_int16_t(((uint16_t)buffer[15] << 8) | (uint16_t)buffer[14]);
-    comp_coeffs.dig_P6 = uint16_t_to_int16_t(((uint16_t)buffer[17] << 8) | (uint16_t)buffer[16]);
-    comp_coeffs.dig_P7 = uint16_t_to_int16_t(((uint16_t)buffer[19] << 8) | (uint16_t)buffer[18]);
-    comp_coeffs.dig_P8 = uint16_t_to_int16_t(((uint16_t)buffer[21] << 8) | (uint16_t)buffer[20]);
-    comp_coeffs.dig_P9 = uint16_t_to_int16_t(((uint16_t)buffer[23] << 8) | (uint16_t)buffer[22]);
-    comp_coeffs.dig_H1 = buffer[25];
-    comp_coeffs.dig_H2 = uint16_t_to_int16_t(((uint16_t)buffer[27] << 8) | (uint16_t)buffer[26]);
-    comp_coeffs.dig_H3 = buffer[28];
-    comp_coeffs.dig_H4 = uint16_t_to_int16_t(((uint16_t)buffer[29] << 4) | (uint16_t)buffer[30] & 0x0F);
-    comp_coeffs.dig_H5 = uint16_t_to_int16_t((((uint16_t)buffer[30] & 0xF0 ) >> 4) | ((uint16_t)buffer[31] << 4));
-    comp_coeffs.dig_H6 = uint8_t_to_int8_t(buffer[32]);
+    bme280Coefficients(_calibration, &comp_coeffs);
+    bme280FastCoefficients(comp_coeffs, &fast_coeffs);
     return true;
 }
-
-/// @brief Do the compensation calculation for temperature, pressure and humidity.
-/// Note that pressure and humidity rely on temperature to stay accurate.
-/// @param temperature Pointer to a float where the temperature value will be inserted (in °C)
-/// @param pressure Pointer to a float where the pressure value will be inserted (in hPa)
-/// @param humidity Pointer to a float where the humidity value will be inserted (in %RH)
-/// @param raw_temperature Raw temperature reading from BME280 sensor
-/// @param raw_pressure Raw pressure reading from BME280 sensor
-/// @param raw_humidity Raw humidity reading from BME280 sensor
-void BME280::compensateValues(  float* temperature,
-                                float* pressure,
-                                float* humidity,
-                                int32_t raw_temperature,
-                                int32_t raw_pressure,
-                                int32_t raw_humidity) {
-    // Temperature compensation
-    int32_t t_fine;
-    int32_t var1, var2, T;
-    var1 = ((((raw_temperature >> 3) - ((int32_t)comp_coeffs.dig_T1 << 1))) * ((int32_t)comp_coeffs.dig_T2)) >> 11;
-    var2 = (((((raw_temperature >> 4) - ((int32_t)comp_coeffs.dig_T1)) * ((raw_temperature >> 4) - ((int32_t)comp_coeffs.dig_T1))) >> 12) * ((int32_t)comp_coeffs.dig_T3)) >> 14;
-    t_fine = var1 + var2;
-    T = (t_fine * 5 + 128) >> 8;
-    *temperature = (float)T / 100.0f;
-
-    // Pressure compensation
-    int64_t p;
-    var1 = 0;
-    var2 = 0;
-    var1 = ((int64_t)t_fine) - 128000;
-    var2 = var1 * var1 * (int64_t)comp_coeffs.dig_P6;
-    var2 = var2 + ((var1 * (int64_t)comp_coeffs.dig_P5) << 17);
-    var2 = var2 + (((int64_t)comp_coeffs.dig_P4) << 35);
-    var1 = ((var1 * var1 * (int64_t)comp_coeffs.dig_P3) >> 8) + ((var1 * (int64_t)comp_coeffs.dig_P2) << 12);
-    var1 = (((((int64_t)1) << 47) + var1)) * ((int64_t)comp_coeffs.dig_P1) >> 33;
-    if (var1 == 0) {
-        *pressure = 0.0f;
-    } else {
-        p = 1048576 - raw_pressure;
-        p = (((p << 31) - var2) * 3125) / var1;
-        var1 = (((int64_t)comp_coeffs.dig_P9) * (p >> 13) * (p >> 13)) >> 25;
-        var2 = (((int64_t)comp_coeffs.dig_P8) * p) >> 19;
-        p = ((p + var1 + var2) >> 8) + (((int64_t)comp_coeffs.dig_P7) << 4);
-        *pressure = (float)((uint32_t)p) / 25600.0f;
-    }
-
-    // Humidity compensation
-    int32_t h_temp;
-    h_temp = (t_fine - ((int32_t)76800));
-    h_temp = (((((raw_humidity << 14) - (((int32_t)comp_coeffs.dig_H4) << 20) - (((int32_t)comp_coeffs.dig_H5) * h_temp)) + ((int32_t)16384)) >> 15) * (((((((h_temp * ((int32_t)comp_coeffs.dig_H6)) >> 10) * (((h_temp * ((int32_t)comp_coeffs.dig_H3)) >> 11) + ((int32_t)32768))) >> 10) + ((int32_t)2097152)) * ((int32_t)comp_coeffs.dig_H2) + 8192) >> 14));
-    h_temp = (h_temp - (((((h_temp >> 15) * (h_temp >> 15)) >> 7) * ((int32_t)comp_coeffs.dig_H1)) >> 4));
-    h_temp = (h_temp < 0 ? 0 : h_temp);
-    h_temp = (h_temp > 419430400 ? 419430400 : h_temp);
-    *humidity = (float)((uint32_t)(h_temp >> 12)) / 1024.0f;
-}
\ No newline at end of file
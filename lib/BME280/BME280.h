@@ -1,9 +1,11 @@
 #pragma once
 #include <hardware/i2c.h>
+#include "BME280Compensation.h"
 
 const uint8_t BME280_default_I2Caddr = 0x76;
 const uint8_t BME280_alt_I2Caddr = 0x77;
 const uint8_t BME_chip_id = 0x60;
+const uint16_t BME280_STARTUP_MS = 2;   // From power-up or soft reset until the first transaction, datasheet start-up time
 
 const uint8_t BME280_hum_lsb = 0xFE;
 const uint8_t BME280_hum_msb = 0xFD;
@@ -22,36 +24,150 @@ const uint8_t BME280_reset = 0xE0;
 const uint8_t BME280_id = 0xD0;
 const uint8_t BME280_calib00 = 0x88;
 
+const uint8_t BME280_status_measuring = 0x08;   // Set while a conversion runs, results are copied when it clears
+const uint8_t BME280_status_im_update = 0x01;   // Set while the NVM calibration is copied to the image registers
+
+/// @brief Oversampling of one measurement, osrs_t, osrs_p and osrs_h
+enum class BME280_OSR : uint8_t {
+    Osr_skip = 0,   // Not measured, the output stays 0x80000 (0x8000 for humidity)
+    Osr_x1,
+    Osr_x2,
+    Osr_x4,
+    Osr_x8,
+    Osr_x16,
+};
+
+/// @brief Inactive time between measurements in normal mode, t_sb
+enum class BME280_STANDBY : uint8_t {
+    Standby_0_5ms = 0,
+    Standby_62_5ms,
+    Standby_125ms,
+    Standby_250ms,
+    Standby_500ms,
+    Standby_1000ms,
+    Standby_10ms,
+    Standby_20ms,
+};
+
+/// @brief IIR filter coefficient on temperature and pressure
+enum class BME280_FILTER : uint8_t {
+    Filter_off = 0,
+    Filter_2,
+    Filter_4,
+    Filter_8,
+    Filter_16,
+};
+
+enum class BME280_MODE : uint8_t {
+    Mode_sleep = 0,
+    Mode_forced = 1,
+    Mode_normal = 3,
+};
+
+/// @brief Compensation routine, see BME280Compensation.h
+enum class BME280_COMPENSATION : uint8_t {
+    Compensation_reference = 0, // Bosch 64 bit pressure, Q24.8 Pa
+    Compensation_fast,          // 32 bit pressure with folded coefficients, whole Pa
+};
+
+/// @brief Everything configure() writes
+struct BME280_SETTINGS {
+    BME280_OSR osr_temperature;
+    BME280_OSR osr_pressure;
+    BME280_OSR osr_humidity;
+    BME280_FILTER filter;
+    BME280_STANDBY standby;
+};
+
+/// @brief Datasheet recommended settings, run in normal mode so reads never trigger a conversion
+enum BME280_PRESET : uint8_t {
+    BME280_PRESET_WEATHER = 0,  // x1 all, no filter, a fresh sample for every 1 s read
+    BME280_PRESET_HUMIDITY,     // No pressure, x1 temperature and humidity
+    BME280_PRESET_INDOOR,       // x16 pressure, x2 temperature, x1 humidity, filter 16 at 1.8 Hz
+    BME280_PRESET_COUNT,
+};
+
+const BME280_SETTINGS BME280_PRESETS[BME280_PRESET_COUNT] = {
+    {BME280_OSR::Osr_x1, BME280_OSR::Osr_x1,   BME280_OSR::Osr_x1, BME280_FILTER::Filter_off, BME280_STANDBY::Standby_500ms},
+    {BME280_OSR::Osr_x1, BME280_OSR::Osr_skip, BME280_OSR::Osr_x1, BME280_FILTER::Filter_off, BME280_STANDBY::Standby_500ms},
+    // The datasheet's 0.5 ms standby gives 25 Hz but leaves the sensor measuring 99% of the time,
+    // almost every read would find a conversion running
+    {BME280_OSR::Osr_x2, BME280_OSR::Osr_x16,  BME280_OSR::Osr_x1, BME280_FILTER::Filter_16,  BME280_STANDBY::Standby_500ms},
+};
+
+/// @brief Longest time one measurement takes with these settings, datasheet appendix B:
+///        1.25 ms + 2.3 ms per temperature sample + 2.3 ms per pressure and per humidity
+///        sample plus 0.575 ms for each of the two when measured
+/// @param settings 
+///        The settings
+/// @return Maximum measurement time in us
+constexpr uint32_t bme280MeasurementTimeUs(const BME280_SETTINGS& settings) {
+    // Samples per oversampling setting, Osr_skip to Osr_x16
+    constexpr uint8_t samples[6] = {0, 1, 2, 4, 8, 16};
+    uint8_t t = samples[(uint8_t)settings.osr_temperature];
+    uint8_t p = samples[(uint8_t)settings.osr_pressure];
+    uint8_t h = samples[(uint8_t)settings.osr_humidity];
+    return 1250 + 2300 * t + (p ? 2300 * p + 575 : 0) + (h ? 2300 * h + 575 : 0);
+}
+
+/// @brief Idle time between two measurements in normal mode, the only window a read succeeds in
+/// @param settings 
+///        The settings
+/// @return Standby time in us
+constexpr uint32_t bme280StandbyUs(const BME280_SETTINGS& settings) {
+    constexpr uint32_t standby_us[8] = {500, 62500, 125000, 250000, 500000, 1000000, 10000, 20000};
+    return standby_us[(uint8_t)settings.standby];
+}
+
+/// @brief Time between two results in normal mode, a measurement plus the standby time
+/// @param settings 
+///        The settings
+/// @return Output data period in us, longest case
+constexpr uint32_t bme280PeriodUs(const BME280_SETTINGS& settings) {
+    return bme280MeasurementTimeUs(settings) + bme280StandbyUs(settings);
+}
+
 class BME280 {
 public: 
     BME280(i2c_inst_t* i2c, uint8_t addr = BME280_default_I2Caddr) : _i2c(i2c), BME280_ADDRESS(addr) {};
     BME280() {};
 
-    bool init(void);
+    bool init(const BME280_SETTINGS& settings = BME280_PRESETS[BME280_PRESET_WEATHER]);
     void reset(void);
+    bool setup(const BME280_SETTINGS& settings);
+    bool configure(const BME280_SETTINGS& settings);
+    bool dataReady(void);
     bool read(void);
+    bool readRaw(BME280_RAW* raw);
+    void compensate(const BME280_RAW& raw);
+    void compensateFixed(const BME280_RAW& raw, BME280_FIXED* fixed) const;
+    void setCompensation(BME280_COMPENSATION compensation) { _compensation = compensation; }
     bool checkConnected(void);
 
-    float temperature, pressure, humidity;
+    /// @brief Settings last written by configure()
+    const BME280_SETTINGS& settings(void) const { return _settings; }
+
+    /// @brief Longest measurement time with the current settings, for scheduling reads
+    uint32_t measurementTimeUs(void) const { return bme280MeasurementTimeUs(_settings); }
+
+    float temperature, pressure, humidity;  // NaN for a measurement that is skipped
+    uint64_t timestamp; // time_us_64() when the last successful read completed
+    bool measuring = false; // The last read was skipped because a conversion was running
+
+    /// @brief Calibration registers as fetched at init, BME280_CALIB_BYTES, for raw capture
+    const uint8_t* calibration(void) const { return _calibration; }
 
 private:
     i2c_inst_t* _i2c;
     uint8_t BME280_ADDRESS;
+    uint8_t _calibration[BME280_CALIB_BYTES];
+    BME280_SETTINGS _settings = BME280_PRESETS[BME280_PRESET_WEATHER];
 
     /// @brief We need this to get proper values
-    struct BME_Comp_Coeff_t {
-      uint16_t dig_T1, dig_P1;
-        int16_t dig_T2, dig_T3, dig_P2, dig_P3, dig_P4, dig_P5, dig_P6, dig_P7, dig_P8, dig_P9, dig_H2, dig_H4, dig_H5;
-        uint8_t dig_H1, dig_H3;
-        int8_t dig_H6;  
-    } comp_coeffs;
+    BME280_COEFFS comp_coeffs;
+    BME280_FAST_COEFFS fast_coeffs;     // Folded from comp_coeffs for the 32 bit path
+    BME280_COMPENSATION _compensation = BME280_COMPENSATION::Compensation_reference;
     bool fetchCompensationData(void);
-    void compensateValues(  float* temperature,
-                            float* pressure,
-                            float* humidity,
-                            int32_t raw_temperature,
-                            int32_t raw_pressure,
-                            int32_t raw_humidity);
 
     bool readRegister(uint8_t reg, uint8_t* data, uint8_t length = 1);
     bool writeRegister(uint8_t reg, uint8_t data);
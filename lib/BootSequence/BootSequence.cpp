@@ -0,0 +1,128 @@
+/*
+ *  Title: BootSequence.cpp
+ *  Description: Overlapped device bring-up
+ *  Author: Tinna Osk Traustadottir
+ */
+#include "BootSequence.h"
+
+/// @brief Add a device. Devices are stepped in the order they are added, so ones sharing a bus
+///        with a slow step should come after the quick ones
+/// @param name 
+///        Name for the report
+/// @param start 
+///        Reset or start command, run once the device has powered up. nullptr if there is none
+/// @param finish 
+///        Check and configuration, run once the device has warmed up and retried until it is done
+///        or fails. nullptr if there is nothing to do
+/// @param power_up_us 
+///        Time from power-up before the device accepts its first command
+/// @param warm_up_us 
+///        Time from the start command to the finish
+/// @param timeout_us 
+///        Time from power-up after which the device has failed
+/// @param sensor 
+///        The device produces samples, as opposed to a front end, display or console
+/// @return Device index, -1 if all devices are taken
+int8_t BootSequence::addDevice(const char* name, boot_step_t start, boot_step_t finish, uint32_t power_up_us,
+                               uint32_t warm_up_us, uint32_t timeout_us, bool sensor) {
+    if(_device_count >= BOOT_MAX_DEVICES) return -1;
+    BootSequence_DEVICE* d = &_devices[_device_count];
+    d->name = name;
+    d->start = start;
+    d->finish = finish;
+    d->power_up_us = power_up_us;
+    d->warm_up_us = warm_up_us;
+    d->timeout_us = timeout_us;
+    d->sensor = sensor;
+    d->state = BOOT_STATE::State_power_up;
+    d->due_us = power_up_us;
+    d->ready_us = 0;
+    d->first_sample_us = 0;
+    d->attempts = 0;
+    return _device_count++;
+}
+
+/// @brief Run every step that is due. Never waits, call again at nextDue()
+/// @param now 
+///        time_us_64()
+void BootSequence::poll(uint64_t now) {
+    for(uint8_t i = 0; i < _device_count; i++) {
+        BootSequence_DEVICE* d = &_devices[i];
+        if(d->state == BOOT_STATE::State_ready || d->state == BOOT_STATE::State_failed) continue;
+        if(now >= d->timeout_us) {
+            d->state = BOOT_STATE::State_failed;
+            continue;
+        }
+        if(now >= d->due_us) step(i, now);
+    }
+}
+
+/// @brief When the next step is due, for sleeping until then
+/// @return time_us_64() of the earliest step or timeout, UINT64_MAX once every device has settled
+uint64_t BootSequence::nextDue(void) const {
+    uint64_t due = UINT64_MAX;
+    for(uint8_t i = 0; i < _device_count; i++) {
+        const BootSequence_DEVICE* d = &_devices[i];
+        if(d->state == BOOT_STATE::State_ready || d->state == BOOT_STATE::State_failed) continue;
+        if(d->due_us < due) due = d->due_us;
+        if(d->timeout_us < due) due = d->timeout_us;
+    }
+    return due;
+}
+
+/// @brief Record a sample from a device, the first one gives its time to first sample
+/// @param device 
+///        Device index
+/// @param timestamp 
+///        time_us_64() of the sample
+void BootSequence::sampled(uint8_t device, uint64_t timestamp) {
+    if(_devices[device].first_sample_us == 0) _devices[device].first_sample_us = timestamp;
+}
+
+/// @brief Check if any sensor has finished booting, the acquisition can start then
+bool BootSequence::sensorReady(void) const {
+    for(uint8_t i = 0; i < _device_count; i++) {
+        if(_devices[i].sensor && _devices[i].state == BOOT_STATE::State_ready) return true;
+    }
+    return false;
+}
+
+/// @brief Check if every device is either ready or has failed, nothing is left to step
+bool BootSequence::settled(void) const {
+    return nextDue() == UINT64_MAX;
+}
+
+/// @brief Check if boot is over for the report: settled, and every ready sensor has sampled
+bool BootSequence::complete(void) const {
+    if(!settled()) return false;
+    for(uint8_t i = 0; i < _device_count; i++) {
+        const BootSequence_DEVICE* d = &_devices[i];
+        if(d->sensor && d->state == BOOT_STATE::State_ready && d->first_sample_us == 0) return false;
+    }
+    return true;
+}
+
+/********** Private methods **********/
+
+/// @brief Run a device's start or finish step and move it on
+void BootSequence::step(uint8_t device, uint64_t now) {
+    BootSequence_DEVICE* d = &_devices[device];
+    bool starting = d->state == BOOT_STATE::State_power_up;
+    boot_step_t run = starting ? d->start : d->finish;
+    BOOT_STEP result = (run == nullptr) ? BOOT_STEP::Step_done : run();
+    d->attempts++;
+
+    if(result == BOOT_STEP::Step_failed) {
+        d->state = BOOT_STATE::State_failed;
+    } else if(result == BOOT_STEP::Step_retry) {
+        d->due_us = now + _retry_us;
+    } else if(starting) {
+        d->state = BOOT_STATE::State_warm_up;
+        d->due_us = now + d->warm_up_us;
+        if(d->warm_up_us == 0) step(device, now);   // Nothing to wait for, finish right away
+    } else {
+        d->state = BOOT_STATE::State_ready;
+        d->ready_us = time_us_64();
+        if(_callback != nullptr) _callback(device);
+    }
+}
@@ -0,0 +1,75 @@
+/*
+ *  Title: BootSequence.h
+ *  Description: Overlapped device bring-up. Every device is reset as soon as it has powered up,
+ *               its warm-up runs alongside the others' and it is configured once warm. Steps are
+ *               short bus transactions, the waiting is done by the sequence instead of sleeps
+ *  Author: Tinna Osk Traustadottir
+ */
+#pragma once
+#include <pico/stdlib.h>
+
+const uint8_t BOOT_MAX_DEVICES = 8;
+
+/// @brief What a boot step returns
+enum class BOOT_STEP : uint8_t {
+    Step_retry = 0,     // Not yet, try again after the retry time
+    Step_done,
+    Step_failed,        // Give up on the device
+};
+
+typedef BOOT_STEP (*boot_step_t)(void);
+
+/// @brief Called once when a device has finished booting
+/// @param device The device index returned by addDevice()
+typedef void (*boot_callback_t)(uint8_t device);
+
+enum class BOOT_STATE : uint8_t {
+    State_power_up = 0,     // Waiting for its power-up time
+    State_warm_up,          // Started, waiting for its warm-up time
+    State_ready,
+    State_failed,
+};
+
+/// @brief One device's steps, timing and progress. Times are time_us_64(), which counts from power-up
+struct BootSequence_DEVICE {
+    const char* name;
+    boot_step_t start;      // Reset or start command, nullptr if there is none
+    boot_step_t finish;     // Check and configure once warm, nullptr if there is nothing to do
+    uint32_t power_up_us;   // Earliest start, from power-up
+    uint32_t warm_up_us;    // From a successful start to the first finish
+    uint32_t timeout_us;    // From power-up, a device still not ready then has failed
+    bool sensor;            // Produces samples, the device can start the acquisition
+    BOOT_STATE state;
+    uint64_t due_us;        // Next step
+    uint64_t ready_us;      // Finished booting, 0 if not yet
+    uint64_t first_sample_us;   // First sample acquired, 0 if none yet
+    uint16_t attempts;      // Steps run, retries included
+};
+
+class BootSequence {
+public:
+    BootSequence(boot_callback_t callback, uint32_t retry_us) : _callback(callback), _retry_us(retry_us) {};
+
+    int8_t addDevice(const char* name, boot_step_t start, boot_step_t finish, uint32_t power_up_us,
+                     uint32_t warm_up_us, uint32_t timeout_us, bool sensor = true);
+
+    void poll(uint64_t now);
+    uint64_t nextDue(void) const;
+    void sampled(uint8_t device, uint64_t timestamp);
+
+    bool ready(uint8_t device) const { return _devices[device].state == BOOT_STATE::State_ready; };
+    bool sensorReady(void) const;
+    bool settled(void) const;
+    bool complete(void) const;
+
+    const BootSequence_DEVICE* device(uint8_t device) const { return &_devices[device]; };
+    uint8_t devices(void) const { return _device_count; };
+
+private:
+    BootSequence_DEVICE _devices[BOOT_MAX_DEVICES];
+    uint8_t _device_count = 0;
+    boot_callback_t _callback;
+    uint32_t _retry_us;
+
+    void step(uint8_t device, uint64_t now);
+};
@@ -0,0 +1,266 @@
+/*
+ *  Title: ConfigStore.cpp
+ *  Description: Calibration and configuration values kept in flash, read in place and
+ *               changed at runtime over the USB console
+ *  Author: Tinna Osk Traustadottir
+ */
+#include "ConfigStore.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/// @brief Construct a new ConfigStore object
+/// @param keys 
+///        Key table, the index of a key in the table is used to get and set it
+/// @param count 
+///        Number of keys in the table, at most CONFIG_MAX_KEYS
+/// @param version 
+///        Layout version. Bump it when keys are renumbered or change meaning, adding keys
+///        at the end of the table doesn't need a new version
+/// @param sector_a 
+///        First sector, counted back from the end of flash
+/// @param sector_b 
+///        Second sector, commits alternate between the two
+ConfigStore::ConfigStore(const ConfigStore_KEY* keys, uint8_t count, uint16_t version, uint32_t sector_a, uint32_t sector_b)
+    : _keys(keys), _count((count > CONFIG_MAX_KEYS) ? CONFIG_MAX_KEYS : count), _version(version),
+      _stores{FlashStore(sector_a), FlashStore(sector_b)} {
+    useActive();
+}
+
+/// @brief Find the newest valid record. Values are then read straight from flash through XIP,
+///        nothing is parsed or copied unless the record holds fewer keys than the table
+/// @return True if a record was found, false if running on defaults
+bool ConfigStore::load(void) {
+    const ConfigStore_RECORD* records[2];
+    for(uint8_t i = 0; i < 2; i++) {
+        records[i] = (const ConfigStore_RECORD*)_stores[i].load(CONFIG_TAG, _version, sizeof(ConfigStore_RECORD));
+    }
+
+    _active = nullptr;
+    for(uint8_t i = 0; i < 2; i++) {
+        if(records[i] == nullptr) continue;
+        if(_active == nullptr || (int32_t)(records[i]->sequence - _active->sequence) > 0) {
+            _active = records[i];
+            _active_store = i;
+        }
+    }
+    useActive();
+    return _active != nullptr;
+}
+
+/// @brief Write the changed values to the sector not holding the current record. The current
+///        record stays valid until the new one is written and verified, so a power cut during
+///        the write loses only the change. Interrupts are off for tens of milliseconds
+/// @return True if successful or if there was nothing to write
+bool ConfigStore::commit(void) {
+    if(!dirty()) return true;
+
+    uint8_t target = (_active != nullptr) ? 1 - _active_store : 0;
+    _shadow.sequence = sequence() + 1;
+    _shadow.count = _count;
+    _shadow.reserved = 0;
+    if(!_stores[target].save(CONFIG_TAG, _version, &_shadow, sizeof(_shadow))) return false;
+
+    _active = (const ConfigStore_RECORD*)_stores[target].load(CONFIG_TAG, _version, sizeof(ConfigStore_RECORD));
+    _active_store = target;
+    useActive();
+    return true;
+}
+
+/// @brief Throw away uncommitted changes. Keys that change back are passed to the callback
+void ConfigStore::revert(void) {
+    if(!dirty()) return;
+    uint32_t changed[CONFIG_MAX_KEYS];
+    memcpy(changed, _values, _count * sizeof(uint32_t));
+    useActive();
+    for(uint8_t i = 0; i < _count; i++) {
+        if(changed[i] != _values[i] && _callback != nullptr) _callback(i);
+    }
+}
+
+/// @brief Set every key to its default. Changed keys are passed to the callback, commit()
+///        makes it permanent
+void ConfigStore::defaults(void) {
+    for(uint8_t i = 0; i < _count; i++) {
+        if(_keys[i].type == CONFIG_TYPE::Type_int) {
+            setInt(i, (int32_t)_keys[i].default_value);
+        } else {
+            setFloat(i, _keys[i].default_value);
+        }
+    }
+}
+
+/// @brief Get a float key
+/// @param key 
+///        Key index
+/// @return The value
+float ConfigStore::getFloat(uint8_t key) const {
+    float value;
+    memcpy(&value, &_values[key], sizeof(value));
+    return value;
+}
+
+/// @brief Change an integer key. The change is kept in RAM until commit()
+/// @param key 
+///        Key index
+/// @param value 
+///        The new value
+/// @return True if successful, false if the key doesn't exist or isn't an integer
+bool ConfigStore::setInt(uint8_t key, int32_t value) {
+    if(key >= _count || _keys[key].type != CONFIG_TYPE::Type_int) return false;
+    if(getInt(key) == value) return true;
+    memcpy(&edit()[key], &value, sizeof(value));
+    if(_callback != nullptr) _callback(key);
+    return true;
+}
+
+/// @brief Change a float key. The change is kept in RAM until commit()
+/// @param key 
+///        Key index
+/// @param value 
+///        The new value
+/// @return True if successful, false if the key doesn't exist or isn't a float
+bool ConfigStore::setFloat(uint8_t key, float value) {
+    if(key >= _count || _keys[key].type != CONFIG_TYPE::Type_float) return false;
+    if(getFloat(key) == value) return true;
+    memcpy(&edit()[key], &value, sizeof(value));
+    if(_callback != nullptr) _callback(key);
+    return true;
+}
+
+/// @brief Look a key up by name, only the console needs this
+/// @param name 
+///        Key name
+/// @return Key index, -1 if there is no such key
+int8_t ConfigStore::find(const char* name) const {
+    for(uint8_t i = 0; i < _count; i++) {
+        if(strcmp(_keys[i].name, name) == 0) return i;
+    }
+    return -1;
+}
+
+/// @brief Read whatever has arrived on the USB console without blocking and run complete lines
+void ConfigStore::poll(void) {
+    int c;
+    while((c = getchar_timeout_us(0)) != PICO_ERROR_TIMEOUT) {
+        if(c == '\r' || c == '\n') {
+            if(_line_length > 0) {
+                _line[_line_length] = '\0';
+                command(_line);
+            }
+            _line_length = 0;
+        } else if(_line_length < CONFIG_LINE_LENGTH - 1) {
+            _line[_line_length++] = (char)c;
+        }
+    }
+}
+
+/// @brief Run one console command. Commands:
+///        list, get <key>, set <key> <value>, commit, revert, defaults
+/// @param line 
+///        The command line, it is modified while it is split up
+/// @return True if the command succeeded
+bool ConfigStore::command(char* line) {
+    const char* verb = strtok(line, " \t");
+    const char* name = strtok(nullptr, " \t");
+    const char* value = strtok(nullptr, " \t");
+    if(verb == nullptr) return false;
+
+    if(strcmp(verb, "list") == 0) {
+        for(uint8_t i = 0; i < _count; i++) print(i);
+        printf("config: sequence %lu%s\n", sequence(), dirty() ? ", uncommitted changes" : "");
+        return true;
+    }
+    if(strcmp(verb, "commit") == 0) {
+        bool ok = commit();
+        printf(ok ? "config: committed, sequence %lu\n" : "config: commit failed\n", sequence());
+        return ok;
+    }
+    if(strcmp(verb, "revert") == 0) {
+        revert();
+        printf("config: reverted\n");
+        return true;
+    }
+    if(strcmp(verb, "defaults") == 0) {
+        defaults();
+        printf("config: defaults set, commit to keep them\n");
+        return true;
+    }
+    if(strcmp(verb, "get") != 0 && strcmp(verb, "set") != 0) {
+        printf("config: unknown command %s\n", verb);
+        return false;
+    }
+
+    int8_t key = (name != nullptr) ? find(name) : -1;
+    if(key < 0) {
+        printf("config: unknown key %s\n", (name != nullptr) ? name : "");
+        return false;
+    }
+    if(strcmp(verb, "set") == 0) {
+        if(value == nullptr) {
+            printf("config: set %s needs a value\n", name);
+            return false;
+        }
+        char* end;
+        int32_t integer = 0;
+        float real = 0.0f;
+        if(_keys[key].type == CONFIG_TYPE::Type_int) {
+            integer = (int32_t)strtol(value, &end, 0);
+        } else {
+            real = strtof(value, &end);
+        }
+        if(*end != '\0') {
+            printf("config: bad value %s\n", value);
+            return false;
+        }
+        if(_keys[key].type == CONFIG_TYPE::Type_int) {
+            setInt(key, integer);
+        } else {
+            setFloat(key, real);
+        }
+    }
+    print(key);
+    return true;
+}
+
+/// @brief Copy the committed values to the shadow the first time something changes
+/// @return The shadow values
+uint32_t* ConfigStore::edit(void) {
+    if(!dirty()) {
+        if(_values != _shadow.values) memcpy(_shadow.values, _values, _count * sizeof(uint32_t));
+        _values = _shadow.values;
+        _dirty = true;
+    }
+    return _shadow.values;
+}
+
+/// @brief Read the committed values: straight from the active record when it covers every key,
+///        otherwise from the shadow holding what the record has and the defaults of the rest.
+///        Without a record that is every default
+void ConfigStore::useActive(void) {
+    _dirty = false;
+    if(_active != nullptr && _active->count >= _count) {
+        _values = _active->values;
+        return;
+    }
+    for(uint8_t i = 0; i < _count; i++) {
+        float value = _keys[i].default_value;
+        if(_keys[i].type == CONFIG_TYPE::Type_int) {
+            int32_t integer = (int32_t)value;
+            memcpy(&_shadow.values[i], &integer, sizeof(integer));
+        } else {
+            memcpy(&_shadow.values[i], &value, sizeof(value));
+        }
+    }
+    // Older record, keep the defaults of the keys it doesn't have
+    if(_active != nullptr) memcpy(_shadow.values, _active->values, _active->count * sizeof(uint32_t));
+    _values = _shadow.values;
+}
+
+void ConfigStore::print(uint8_t key) const {
+    if(_keys[key].type == CONFIG_TYPE::Type_int) {
+        printf("%s = %ld\n", _keys[key].name, getInt(key));
+    } else {
+        printf("%s = %g\n", _keys[key].name, getFloat(key));
+    }
+}
@@ -0,0 +1,80 @@
+/*
+ *  Title: ConfigStore.h
+ *  Description: Calibration and configuration values kept in flash, read in place and
+ *               changed at runtime over the USB console
+ *  Author: Tinna Osk Traustadottir
+ */
+#pragma once
+#include <pico/stdlib.h>
+#include <FlashStore.h>
+
+const uint8_t CONFIG_MAX_KEYS = 32;
+const uint8_t CONFIG_LINE_LENGTH = 64;
+const uint16_t CONFIG_TAG = 0x0C01;
+
+enum class CONFIG_TYPE : uint8_t {
+    Type_int = 0,
+    Type_float,
+};
+
+/// @brief One key. The index in the key table is the key, so lookups are a single array access
+struct ConfigStore_KEY {
+    const char* name;
+    CONFIG_TYPE type;
+    float default_value;    // Integer keys are converted, keep them below 2^24
+};
+
+/// @brief Record written to flash. Values are raw 32 bit words, int32_t or float by key type
+struct ConfigStore_RECORD {
+    uint32_t sequence;      // Increments on every commit, the newer of the two sectors wins
+    uint16_t count;         // Keys stored, keys added by newer firmware fall back to defaults
+    uint16_t reserved;
+    uint32_t values[CONFIG_MAX_KEYS];
+};
+
+/// @brief Called after a key changes at runtime, so the new value can be applied
+/// @param key The key index
+typedef void (*config_callback_t)(uint8_t key);
+
+class ConfigStore {
+public:
+    ConfigStore(const ConfigStore_KEY* keys, uint8_t count, uint16_t version, uint32_t sector_a, uint32_t sector_b);
+
+    bool load(void);
+    bool commit(void);
+    void revert(void);
+    void defaults(void);
+
+    int32_t getInt(uint8_t key) const { return (int32_t)_values[key]; };
+    float getFloat(uint8_t key) const;
+    bool setInt(uint8_t key, int32_t value);
+    bool setFloat(uint8_t key, float value);
+    int8_t find(const char* name) const;
+
+    void onChange(config_callback_t callback) { _callback = callback; };
+    void poll(void);
+    bool command(char* line);
+
+    bool dirty(void) const { return _dirty; };
+    uint32_t sequence(void) const { return (_active != nullptr) ? _active->sequence : 0; };
+
+private:
+    const ConfigStore_KEY* _keys;
+    uint8_t _count;
+    uint16_t _version;
+    FlashStore _stores[2];
+
+    const ConfigStore_RECORD* _active = nullptr;    // Committed record in flash, nullptr if there is none
+    uint8_t _active_store = 1;
+    const uint32_t* _values;                        // Points into flash, or to the shadow for changes and older records
+    ConfigStore_RECORD _shadow;
+    bool _dirty = false;                            // The shadow holds changes that aren't committed
+    config_callback_t _callback = nullptr;
+
+    char _line[CONFIG_LINE_LENGTH];
+    uint8_t _line_length = 0;
+
+    uint32_t* edit(void);
+    void useActive(void);
+    void print(uint8_t key) const;
+};
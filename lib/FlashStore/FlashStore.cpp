@@ -0,0 +1,102 @@
+/*
+ *  Title: FlashStore.cpp
+ *  Description: Keeps one versioned, CRC protected record in a dedicated flash sector
+ *  Author: Tinna Osk Traustadottir
+ */
+#include "FlashStore.h"
+#include <string.h>
+#include <hardware/sync.h>
+#include <hardware/address_mapped.h>
+
+/// @brief Construct a new FlashStore object
+/// @param sector 
+///        Which sector to use, counted back from the end of flash (see FLASHSTORE_SECTOR_AQI)
+FlashStore::FlashStore(uint32_t sector) {
+    _offset = PICO_FLASH_SIZE_BYTES - sector * FLASH_SECTOR_SIZE;
+}
+
+/// @brief Find the stored record. The record is read in place through XIP, nothing is copied
+/// @param tag 
+///        Tag the record was saved with
+/// @param version 
+///        Layout version the caller expects
+/// @param length 
+///        Length the caller expects, in bytes
+/// @return Pointer to the record in flash, or nullptr if there is no valid record
+const void* FlashStore::load(uint16_t tag, uint16_t version, uint32_t length) const {
+    const FlashStore_HEADER* header = (const FlashStore_HEADER*)(XIP_BASE + _offset);
+    if(header->magic != FLASHSTORE_MAGIC) return nullptr;
+    if(header->tag != tag || header->version != version || header->length != length) return nullptr;
+    if(length > FLASH_SECTOR_SIZE - sizeof(FlashStore_HEADER)) return nullptr;
+
+    const uint8_t* data = (const uint8_t*)(header + 1);
+    if(crc32(data, length) != header->crc) return nullptr;
+    return data;
+}
+
+/// @brief Erase the sector and write a new record. Interrupts are disabled while flash is busy,
+///        which takes tens of milliseconds, so don't call this from a timing critical path
+/// @param tag 
+///        Identifies what the record holds
+/// @param version 
+///        Layout version of the record
+/// @param data 
+///        Pointer to the record
+/// @param length 
+///        Length of the record in bytes
+/// @return True if successful, false if the record doesn't fit in one sector
+bool FlashStore::save(uint16_t tag, uint16_t version, const void* data, uint32_t length) {
+    if(length > FLASH_SECTOR_SIZE - sizeof(FlashStore_HEADER)) return false;
+
+    FlashStore_HEADER header;
+    header.magic = FLASHSTORE_MAGIC;
+    header.tag = tag;
+    header.version = version;
+    header.length = length;
+    header.crc = crc32((const uint8_t*)data, length);
+
+    // Flash is programmed a page at a time, so stage each page in RAM
+    uint8_t page[FLASH_PAGE_SIZE];
+    uint32_t total = sizeof(header) + length;
+    const uint8_t* src = (const uint8_t*)data;
+
+    uint32_t interrupts = save_and_disable_interrupts();
+    flash_range_erase(_offset, FLASH_SECTOR_SIZE);
+    for(uint32_t written = 0; written < total; written += FLASH_PAGE_SIZE) {
+        memset(page, 0xFF, sizeof(page));
+        for(uint32_t i = 0; i < FLASH_PAGE_SIZE && written + i < total; i++) {
+            uint32_t pos = written + i;
+            page[i] = (pos < sizeof(header)) ? ((const uint8_t*)&header)[pos] : src[pos - sizeof(header)];
+        }
+        flash_range_program(_offset + written, page, FLASH_PAGE_SIZE);
+    }
+    restore_interrupts(interrupts);
+
+    return load(tag, version, length) != nullptr;
+}
+
+/// @brief Erase the sector, removing any stored record
+void FlashStore::erase(void) {
+    uint32_t interrupts = save_and_disable_interrupts();
+    flash_range_erase(_offset, FLASH_SECTOR_SIZE);
+    restore_interrupts(interrupts);
+}
+
+/// @brief Calculate CRC-32 (IEEE 802.3) checksum
+/// @param data 
+///        Pointer to data to calculate checksum for
+/// @param length 
+///        Length of data in bytes
+/// @param crc 
+///        Checksum of the preceding data, to continue a running checksum
+/// @return Checksum
+uint32_t crc32(const uint8_t* data, uint32_t length, uint32_t crc) {
+    crc = ~crc;
+    for(uint32_t i = 0; i < length; i++) {
+        crc ^= data[i];
+        for(uint8_t bit = 8; bit > 0; --bit) {
+            crc = (crc & 1) ? (crc >> 1) ^ 0xEDB88320u : (crc >> 1);
+        }
+    }
+    return ~crc;
+}
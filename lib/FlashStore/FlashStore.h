@@ -0,0 +1,41 @@
+/*
+ *  Title: FlashStore.h
+ *  Description: Keeps one versioned, CRC protected record in a dedicated flash sector
+ *  Author: Tinna Osk Traustadottir
+ */
+#pragma once
+#include <pico/stdlib.h>
+#include <hardware/flash.h>
+
+// Sectors are counted back from the end of flash, so they stay clear of the program image
+const uint32_t FLASHSTORE_SECTOR_AQI = 1;   // Air quality index buckets
+const uint32_t FLASHSTORE_SECTOR_CONFIG_A = 2;  // Configuration, first of two alternating sectors
+const uint32_t FLASHSTORE_SECTOR_CONFIG_B = 3;
+const uint32_t FLASHSTORE_SECTOR_SEN55 = 4; // SEN55 VOC algorithm state and gas index tuning
+
+const uint32_t FLASHSTORE_MAGIC = 0x53514941;   // "AIQS"
+
+/// @brief Header written in front of the record
+struct FlashStore_HEADER {
+    uint32_t magic;
+    uint16_t tag;       // Identifies what the record holds
+    uint16_t version;   // Layout version of the record, a mismatch means the record is ignored
+    uint32_t length;    // Length of the record in bytes, not including the header
+    uint32_t crc;       // CRC-32 of the record
+};
+
+class FlashStore {
+public:
+    FlashStore(uint32_t sector);
+
+    const void* load(uint16_t tag, uint16_t version, uint32_t length) const;
+    bool save(uint16_t tag, uint16_t version, const void* data, uint32_t length);
+    void erase(void);
+
+    uint32_t offset(void) const { return _offset; };
+
+private:
+    uint32_t _offset;   // Offset of the sector from the start of flash
+};
+
+uint32_t crc32(const uint8_t* data, uint32_t length, uint32_t crc = 0);
@@ -1,6 +1,6 @@
 /*
  *  Title: LMP91.cpp
- *  Description:
+ *  Description: Configures the LMP91000 potentiostat front end of the NO2 sensor
  *  Author: Tinna Osk Traustadottir
  */
 
@@ -13,143 +13,123 @@
 /// @param i2c 
 ///        The I2C hardware instance to be used
 /// @param addr 
-///        The I2C address for the sensor, defaulted to 0x90
+///        The 7 bit I2C address for the sensor, defaulted to 0x48
 LMP91::LMP91(i2c_inst_t *i2c, uint8_t addr){
     _i2c = i2c;
     LMP91_ADDRESS = addr;
 }
 
-/// @brief 
-/// @param  
-/// @return  
+/// @brief Check that the device is out of power-on reset and unlock TIACN and REFCN so the
+///        configuration can be written. Call LMP91_STARTUP_MS after power-up at the earliest
+/// @return True if successful, false if the device isn't ready yet
 bool LMP91::init(void){
-//    write_register();
-    sleep_ms(30);
-    return true;
+    STATUS status;
+    if(!get_STATUS(&status) || status != STATUS::Status_ready) return false;
+    return set_LOCK(LOCK::Lock_reg_write_mode);
 }
 
-/// @brief Check if on or off
-/// @param status 
-/// @return true
-bool LMP91::set_STATUS(STATUS status){
-    uint8_t bits = read_register(LMP91_STATUS);
-    bits = (bits & 0b11111110) | ((uint8_t)status & 0b00000001);
-    write_register(LMP91_STATUS, bits);
-    return true;
+/// @brief Write the whole configuration. Every bit of TIACN, REFCN and MODE is given, so this is
+///        three register writes and no reads
+/// @return True if successful
+bool LMP91::configure(TIA_GAIN gain, R_LOAD load, REF_SOURCE source, INT_Z internal,
+                      BIAS_SIGN sign, BIAS bias, FET_SHORT shorting, OP_MODE mode){
+    return modify(LMP91_FIELD::TIA_GAIN(gain), LMP91_FIELD::R_LOAD(load),
+                  LMP91_FIELD::REF_SOURCE(source), LMP91_FIELD::INT_Z(internal),
+                  LMP91_FIELD::BIAS_SIGN(sign), LMP91_FIELD::BIAS(bias),
+                  LMP91_FIELD::FET_SHORT(shorting), LMP91_FIELD::OP_MODE(mode));
+}
+
+/// @brief Check if the device is ready to accept I2C commands
+/// @param status Pointer to where the status will go (see STATUS)
+/// @return True if successful
+bool LMP91::get_STATUS(STATUS* status){
+    return read<LMP91_FIELD::STATUS>(status);
 }
 
 /// @brief Enables and disables writing of the TIACN and REFCN
 ///        registers
 /// @param lock The lock chosen, (see LOCK)
-/// @return true
+/// @return True if successful
 bool LMP91::set_LOCK(LOCK lock){
-    uint8_t bits = read_register(LMP91_STATUS);
-    bits = (bits & 0b11111110) | ((uint8_t)lock & 0b00000001);
-    write_register(LMP91_LOCK, bits);
-    return true;
+    return modify(LMP91_FIELD::LOCK(lock));
 }
 
 /// @brief Transimpedance Gain
 /// @param gain The gain chosen (see TIA_GAIN) 
-/// @return true
+/// @return True if successful
 bool LMP91::set_TIA_GAIN(TIA_GAIN gain){
-    uint8_t bits = read_register(LMP91_TIACN);
-    bits  = (bits & 0b11100011) | (((uint8_t)gain << 2) & 0b00011100);
-    write_register(LMP91_TIACN, bits);
-    return true;
+    return modify(LMP91_FIELD::TIA_GAIN(gain));
 }
 
 /// @brief Load resistance
 /// @param load The load chosen (see R_LOAD)
-/// @return true
+/// @return True if successful
 bool LMP91::set_R_LOAD(R_LOAD load){
-    uint8_t bits = read_register(LMP91_TIACN);
-    bits = (bits & 0b11111100) | ((uint8_t)load & 0b00000011);
-    write_register(LMP91_TIACN, bits);
-    return true;
+    return modify(LMP91_FIELD::R_LOAD(load));
 }
 
 /// @brief Reference voltage source 
 /// @param source the voltage source chosen, (see REF_SOURCE)
-/// @return true
+/// @return True if successful
 bool LMP91::set_REF_SOURCE(REF_SOURCE source){
-    uint8_t bits = read_register(LMP91_REFCN);
-    bits = (bits & 0b01111111) | (((uint8_t)source << 7) & 0b10000000);
-    write_register(LMP91_REFCN, bits);
-    return true;
+    return modify(LMP91_FIELD::REF_SOURCE(source));
 }
 
 /// @brief Internal zero selection (percentage of the source reference)
 /// @param internal the internal zero chosen (see INT_Z)
-/// @return true
+/// @return True if successful
 bool LMP91::set_INT_Z(INT_Z internal){
-    uint8_t bits = read_register(LMP91_REFCN);
-    bits = (bits & 0b01100000) | (((uint8_t)internal << 5) & 0b10011111);
-    write_register(LMP91_REFCN, bits);
-    return true;
+    return modify(LMP91_FIELD::INT_Z(internal));
 }
 
 /// @brief Selection of the bias polarity
-/// @param signal The signal chosen (see BIAL_SIGN)
-/// @return True
+/// @param signal The signal chosen (see BIAS_SIGN)
+/// @return True if successful
 bool LMP91::set_BIAS_SIGN(BIAS_SIGN signal){
-    uint8_t bits = read_register(LMP91_REFCN);
-    bits = (bits & 0b00010000) | (((uint8_t)signal << 4) & 0b11101111);
-    write_register(LMP91_REFCN, bits);
-    return true;
+    return modify(LMP91_FIELD::BIAS_SIGN(signal));
 }
 
 /// @brief Bias selection (Percentage of the source reference)
 /// @param bias The bias chosen (see BIAS)
-/// @return True
+/// @return True if successful
 bool LMP91::set_BIAS(BIAS bias){
-    uint8_t bits = read_register(LMP91_REFCN);
-    bits = (bits & 0b00001111) | ((uint8_t)bias& 0b11110000);
-    write_register(LMP91_REFCN, bits);
-    return true;
+    return LMP91_FIELD::BIAS::valid(bias) && modify(LMP91_FIELD::BIAS(bias));
 }
 
 /// @brief Shorting FET feature
 /// @param shorting the shorting chosen (see FET_SHORT)
-/// @return True
+/// @return True if successful
 bool LMP91::set_FET_SHORT(FET_SHORT shorting){
-    uint8_t bits = read_register(LMP91_MODE);
-    bits = (bits & 0b01111111) | (((uint8_t)shorting << 7) & 0b1111111);
-    write_register(LMP91_MODE, bits);
-    return true;
+    return modify(LMP91_FIELD::FET_SHORT(shorting));
 }
 
 /// @brief Mode of operation selection
 /// @param mode The mode chosen (see OP_MODE)
-/// @return True
+/// @return True if successful
 bool LMP91::set_OP_MODE(OP_MODE mode){
-    uint8_t bits = read_register(LMP91_MODE);
-    bits = (bits & 0b11111000) | ((uint8_t)mode & 0b00000111);
-    write_register(LMP91_MODE, bits);
-    return true;
+    return modify(LMP91_FIELD::OP_MODE(mode));
 }
 
-/// @brief Write to the register
-/// @param reg  register
-/// @param data  data written
-/// @return the data written to the register?
-bool LMP91::write_register(uint8_t reg, uint8_t data){
-    uint8_t buffer[2] {0};
-
-    buffer[0] = reg;
-    return (i2c_write_timeout_us(_i2c, LMP91_ADDRESS, buffer, 1, false, 10000) == 1);
+/// @brief Write to registers
+/// @param address First register address
+/// @param data Data to write
+/// @param len Number of bytes
+/// @return True if successful
+bool LMP91::write_register(uint8_t address, uint8_t* data, uint8_t len){
+    uint8_t buffer[5];
+    if(len > sizeof(buffer) - 1) return false;
+
+    buffer[0] = address;
+    memcpy(buffer + 1, data, len);
+    return (i2c_write_timeout_us(_i2c, LMP91_ADDRESS, buffer, len + 1, false, 10000) == len + 1);
 }
 
-/// @brief Read the register address
-/// @param reg_address 
-/// @return buffer?
-uint8_t LMP91::read_register(uint8_t reg_address){
-    uint8_t buffer[1];
-
-    buffer[0] = reg_address;
-
-    i2c_write_timeout_us(_i2c, LMP91_ADDRESS, buffer, 1, true, 10000);
-    //sleep_ms(1); // Ef ekki virka unkommenta
-    i2c_read_timeout_us(_i2c, LMP91_ADDRESS, buffer, 1, false, 10000);
-    return (uint8_t)(buffer[0]);
-}
\ No newline at end of file
+/// @brief Read from registers
+/// @param address First register address
+/// @param data Buffer the data will go to
+/// @param len Number of bytes
+/// @return True if successful
+bool LMP91::read_register(uint8_t address, uint8_t* data, uint8_t len){
+    if(i2c_write_timeout_us(_i2c, LMP91_ADDRESS, &address, 1, true, 10000) != 1) return false;
+    return (i2c_read_timeout_us(_i2c, LMP91_ADDRESS, data, len, false, 10000) == len);
+}
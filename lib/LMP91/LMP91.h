@@ -1,18 +1,21 @@
 /*
  *  Title: LMP91.h
- *  Description:
+ *  Description: Configures the LMP91000 potentiostat front end of the NO2 sensor
  *  Author: Tinna Osk Traustadottir
  */
 #pragma once
 #include <hardware/i2c.h>
 #include "LMP91_regs.h"
 
-class LMP91 {
+class LMP91 : public RegisterDevice<LMP91> {
 public:
     LMP91(i2c_inst_t* i2c, uint8_t addr = LMP91_DEFAULT_I2CADDR);
     bool init(void);
 
-    bool set_STATUS(STATUS status);
+    bool configure(TIA_GAIN gain, R_LOAD load, REF_SOURCE source, INT_Z internal,
+                   BIAS_SIGN sign, BIAS bias, FET_SHORT shorting, OP_MODE mode);
+
+    bool get_STATUS(STATUS* status);
     bool set_LOCK(LOCK lock);
     bool set_TIA_GAIN(TIA_GAIN gain);
     bool set_R_LOAD(R_LOAD load);
@@ -24,9 +27,11 @@ public:
     bool set_OP_MODE(OP_MODE mode);
 
 private:
+    friend class RegisterDevice<LMP91>;
+
     i2c_inst_t* _i2c;
     uint8_t LMP91_ADDRESS;
 
-    bool write_register(uint8_t reg, uint8_t data);
-    uint8_t read_register(uint8_t reg_address);
+    bool write_register(uint8_t address, uint8_t* data, uint8_t len);
+    bool read_register(uint8_t address, uint8_t* data, uint8_t len);
 };
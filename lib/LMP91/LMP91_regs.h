@@ -1,13 +1,8 @@
 #pragma once
+#include <RegisterMap.h>
 
-
-const uint8_t LMP91_DEFAULT_I2CADDR = 0x90;
-
-const uint8_t LMP91_STATUS = 0x00;  // Power-on status 
-const uint8_t LMP91_LOCK = 0x01;    // Enables and disables writing of the TIACN and REFCN
-const uint8_t LMP91_TIACN = 0x10;   // Transimpedance gaind and the load resistance
-const uint8_t LMP91_REFCN = 0x11;   // Reference control register
-const uint8_t LMP91_MODE = 0x12;    // Mode register, configures the operation modes
+const uint8_t LMP91_DEFAULT_I2CADDR = 0x48;   // 7 bit address, 0x90 on the wire
+const uint16_t LMP91_STARTUP_MS = 30;          // From power-up until the status register reads ready
 
 /// @brief Status of device
 enum class STATUS : uint8_t {
@@ -63,7 +58,8 @@ enum class BIAS_SIGN : uint8_t {
 
 /// @brief BIAS selection (Percentage of the source reference)
 enum class BIAS : uint8_t {
-    Bias_1 = 0, // Default
+    Bias_0 = 0, // Default
+    Bias_1,
     Bias_2,
     Bias_4,
     Bias_6,
@@ -90,6 +86,29 @@ enum class OP_MODE : uint8_t {
     Mode_2_Lead_Ground,
     Mode_Standby,
     Mode_3_Lead_Amperpmetric,
-    Mode_Temp_TIA_Off,
+    Mode_Temp_TIA_Off = 6,
     Mode_Temp_TIA_On,
-};
\ No newline at end of file
+};
+
+/// @brief Register map
+namespace LMP91_REG {
+    typedef Register<0x00, 1, REG_ACCESS::Read_only> STATUS;               // Power-on status
+    typedef Register<0x01, 1, REG_ACCESS::Read_write, 0xFE> LOCK;          // Enables and disables writing of the TIACN and REFCN
+    typedef Register<0x10, 1, REG_ACCESS::Read_write, 0xE0> TIACN;         // Transimpedance gain and the load resistance
+    typedef Register<0x11> REFCN;                                          // Reference control register
+    typedef Register<0x12, 1, REG_ACCESS::Read_write, 0x78> MODE;          // Mode register, configures the operation modes
+};
+
+/// @brief Fields of each register
+namespace LMP91_FIELD {
+    typedef Field<LMP91_REG::STATUS, 0, 1, ::STATUS> STATUS;
+    typedef Field<LMP91_REG::LOCK, 0, 1, ::LOCK> LOCK;
+    typedef Field<LMP91_REG::TIACN, 2, 3, ::TIA_GAIN> TIA_GAIN;
+    typedef Field<LMP91_REG::TIACN, 0, 2, ::R_LOAD> R_LOAD;
+    typedef Field<LMP91_REG::REFCN, 7, 1, ::REF_SOURCE> REF_SOURCE;
+    typedef Field<LMP91_REG::REFCN, 5, 2, ::INT_Z> INT_Z;
+    typedef Field<LMP91_REG::REFCN, 4, 1, ::BIAS_SIGN> BIAS_SIGN;
+    typedef Field<LMP91_REG::REFCN, 0, 4, ::BIAS> BIAS;
+    typedef Field<LMP91_REG::MODE, 7, 1, ::FET_SHORT> FET_SHORT;
+    typedef Field<LMP91_REG::MODE, 0, 3, ::OP_MODE> OP_MODE;
+};
@@ -44,68 +44,47 @@ void MCP3564R::init(void) {
  * @return True if successful, false if not
 */
 bool MCP3564R::read_data(int32_t* data, uint8_t* channel) {
-    uint8_t selected_channel = 255u;
-    uint8_t message_length = 0; // Length of the message in bytes
-    if(data_format == 0) {
-        message_length = 3;
-    } else {
-        message_length = 4;
-    }
-
-    uint8_t buffer[message_length];
-    if(!read_register(MCP3564R_REG::ADCDATA, buffer, message_length)) return false;
-
-    int32_t output_data = 0;
-    int32_t temp = 0x00000000;
-    switch(data_format) {
-        case 0:
-            output_data = ((buffer[0] & 0x80) == 1) ? 0xFF800000 : 0x00000000;
-            temp |= buffer[0];
-            temp <<= 8;
-            temp |= buffer[1];
-            temp <<= 8;
-            temp |= buffer[2] & 0x7F;
-            output_data |= temp;
-            break;
-        case 1:
-            output_data = ((buffer[0] & 0x80) == 1) ? 0xFF800000 : 0x00000000;
-            temp |= buffer[0];
-            temp <<= 8;
-            temp |= buffer[1];
-            temp <<= 8;
-            temp |= buffer[2] & 0x7F;
-            output_data |= temp;
-            break;
-        case 2:
-            output_data = ((buffer[0]) == 0xFF) ? 0xFF000000 : 0x00000000;
-            temp |= buffer[1];
-            temp <<= 8;
-            temp |= buffer[2];
-            temp <<= 8;
-            temp |= buffer[3];
-            output_data |= temp;
-            break;
-        case 3:
-            output_data = (buffer[0] & 0x08) ? 0xFF000000 : 0x00000000;
-            temp <<= 8;
-            temp |= buffer[1];
-            temp <<= 8;
-            temp |= buffer[2];
-            temp <<= 8;
-            temp |= buffer[3];
-            output_data |= temp;
-            selected_channel = (buffer[0] & 0xF0) >> 4;
-            break;
-        default:
-            return false;
-            break;
-    }
+    uint8_t buffer[4];
+    if(!read_register(MCP3564R_REG::ADCDATA::address, buffer, data_length())) return false;
+    return decode_data(buffer, data, channel);
+}
 
-    *channel = selected_channel;
-    *data = output_data;
+/**
+ * @brief Read measurement from ADC and tag it with the time the SPI transaction completed
+ * @param data
+ *          Pointer to a variable where the data will go
+ * @param channel
+ *          Pointer to a variable where the number of the channel read will go, see read_data(int32_t*, uint8_t*)
+ * @param timestamp
+ *          Pointer to a variable where time_us_64() at the end of the transaction will go
+ * @return True if successful, false if not
+*/
+bool MCP3564R::read_data(int32_t* data, uint8_t* channel, uint64_t* timestamp) {
+    if(!read_data(data, channel)) return false;
+    *timestamp = time_us_64();
     return true;
 }
 
+/**
+ * @brief Read measurement from ADC if a conversion has finished since the last read. The status
+ *        byte clocked out with the command says so, reading the data clears it
+ * @param data
+ *          Pointer to a variable where the data will go, untouched if there is no new data
+ * @param channel
+ *          Pointer to a variable where the number of the channel read will go, see read_data(int32_t*, uint8_t*)
+ * @param fresh
+ *          Pointer to a variable set true if the data is a new conversion
+ * @return True if successful, false if not
+*/
+bool MCP3564R::read_new_data(int32_t* data, uint8_t* channel, bool* fresh) {
+    uint8_t buffer[4];
+    uint8_t status = 0xFF;
+    if(!read_register(MCP3564R_REG::ADCDATA::address, buffer, data_length(), &status)) return false;
+    *fresh = !(status & MCP3564R_STATUS_DR);     // Active low
+    if(!*fresh) return true;
+    return decode_data(buffer, data, channel);
+}
+
 /**
  * @brief Select a voltage reference source
  * @param internal
@@ -113,15 +92,7 @@ bool MCP3564R::read_data(int32_t* data, uint8_t* channel) {
  * @return True if successful, false if not
 */
 bool MCP3564R::select_vref_source(bool internal) {
-    uint8_t buffer[1];
-    if(!read_register(MCP3564R_REG::CONFIG0, buffer, 1)) return false;
-    if(internal) {
-        buffer[0] |= MCP3564R_CONFIG0_REG::VREF_SEL_INTERNAL;
-    } else {
-        buffer[0] &= ~MCP3564R_CONFIG0_REG_MASK::VREF_SEL;
-    }
-    if(!write_register(MCP3564R_REG::CONFIG0, buffer, 1)) return false;
-    return true;
+    return modify(MCP3564R_FIELD::VREF_SEL(internal));
 }
 
 /**
@@ -131,32 +102,7 @@ bool MCP3564R::select_vref_source(bool internal) {
  * @return True if successful, false if not
 */
 bool MCP3564R::set_clock_source(uint8_t source) {
-    uint8_t buffer[1];
-    if(!read_register(MCP3564R_REG::CONFIG0, buffer, 1)) return false;
-
-    // Set the bits for the CLK_SEL to 0, keeping the rest
-    buffer[0] = buffer[0] & ~MCP3564R_CONFIG0_REG_MASK::CLK_SEL;
-
-    switch(source) {
-        case 0:
-            buffer[0] |= MCP3564R_CONFIG0_REG::CLK_SEL_DEFAULT;
-            break;
-        case 1:
-            buffer[0] |= MCP3564R_CONFIG0_REG::CLK_SEL_EXTERNAL;
-            break;
-        case 2:
-            buffer[0] |= MCP3564R_CONFIG0_REG::CLK_SEL_INTERNAL_NO_OUT;
-            break;
-        case 3:
-            buffer[0] |= MCP3564R_CONFIG0_REG::CLK_SEL_INTERNAL_OUTPUT;
-            break;
-        default:
-            return false;
-            break;
-    }
-
-    if(!write_register(MCP3564R_REG::CONFIG0, buffer, 1)) return false;
-    return true;
+    return MCP3564R_FIELD::CLK_SEL::valid(source) && modify(MCP3564R_FIELD::CLK_SEL(source));
 }
 
 /**
@@ -166,32 +112,7 @@ bool MCP3564R::set_clock_source(uint8_t source) {
  * @return True if successful, false if not
 */
 bool MCP3564R::set_current_source_sink(uint8_t config) {
-    uint8_t buffer[1];
-    if(!read_register(MCP3564R_REG::CONFIG0, buffer, 1)) return false;
-
-    // Set the bits for the CLK_SEL to 0, keeping the rest
-    buffer[0] = buffer[0] & ~MCP3564R_CONFIG0_REG_MASK::CS_SEL;
-
-    switch(config) {
-        case 0:
-            buffer[0] |= MCP3564R_CONFIG0_REG::CS_SEL_NO_SOURCE;
-            break;
-        case 1:
-            buffer[0] |= MCP3564R_CONFIG0_REG::CS_SEL_0_9_UA;
-            break;
-        case 2:
-            buffer[0] |= MCP3564R_CONFIG0_REG::CS_SEL_3_7_UA;
-            break;
-        case 3:
-            buffer[0] |= MCP3564R_CONFIG0_REG::CS_SEL_15_UA;
-            break;
-        default:
-            return false;
-            break;
-    }
-
-    if(!write_register(MCP3564R_REG::CONFIG0, buffer, 1)) return false;
-    return true;
+    return MCP3564R_FIELD::CS_SEL::valid(config) && modify(MCP3564R_FIELD::CS_SEL(config));
 }
 
 /**
@@ -201,32 +122,7 @@ bool MCP3564R::set_current_source_sink(uint8_t config) {
  * @return True if successful, false if not
 */
 bool MCP3564R::set_adc_mode(uint8_t mode) {
-    uint8_t buffer[1];
-    if(!read_register(MCP3564R_REG::CONFIG0, buffer, 1)) return false;
-
-    // Set the bits for the CLK_SEL to 0, keeping the rest
-    buffer[0] = buffer[0] & ~MCP3564R_CONFIG0_REG_MASK::ADC_MODE;
-
-    switch(mode) {
-        case 0:
-            buffer[0] |= MCP3564R_CONFIG0_REG::ADC_MODE_DEFAULT;
-            break;
-        case 1:
-            buffer[0] |= MCP3564R_CONFIG0_REG::ADC_MODE_SHUTDOWN;
-            break;
-        case 2:
-            buffer[0] |= MCP3564R_CONFIG0_REG::ADC_MODE_STANDBY;
-            break;
-        case 3:
-            buffer[0] |= MCP3564R_CONFIG0_REG::ADC_MODE_CONVERSION;
-            break;
-        default:
-            return false;
-            break;
-    }
-
-    if(!write_register(MCP3564R_REG::CONFIG0, buffer, 1)) return false;
-    return true;
+    return MCP3564R_FIELD::ADC_MODE::valid(mode) && modify(MCP3564R_FIELD::ADC_MODE(mode));
 }
 
 /**
@@ -236,32 +132,7 @@ bool MCP3564R::set_adc_mode(uint8_t mode) {
  * @return True if successful, false if not
 */
 bool MCP3564R::set_clock_prescaler(uint8_t value) {
-    uint8_t buffer[1];
-    if(!read_register(MCP3564R_REG::CONFIG1, buffer, 1)) return false;
-
-    // Set the bits for the CLK_SEL to 0, keeping the rest
-    buffer[0] = buffer[0] & ~MCP3564R_CONFIG1_REG_MASK::PRE;
-
-    switch(value) {
-        case 0:
-            buffer[0] |= MCP3564R_CONFIG1_REG::AMCLK_MCLK;
-            break;
-        case 1:
-            buffer[0] |= MCP3564R_CONFIG1_REG::AMCLK_MCLK_2;
-            break;
-        case 2:
-            buffer[0] |= MCP3564R_CONFIG1_REG::AMCLK_MCLK_4;
-            break;
-        case 3:
-            buffer[0] |= MCP3564R_CONFIG1_REG::AMCLK_MCLK_8;
-            break;
-        default:
-            return false;
-            break;
-    }
-
-    if(!write_register(MCP3564R_REG::CONFIG1, buffer, 1)) return false;
-    return true;
+    return MCP3564R_FIELD::PRE::valid(value) && modify(MCP3564R_FIELD::PRE(value));
 }
 
 /**
@@ -272,34 +143,7 @@ bool MCP3564R::set_clock_prescaler(uint8_t value) {
  * @return True if successful, false if not
 */
 bool MCP3564R::set_oversample_ratio(uint8_t ratio) {
-    uint8_t buffer[1];
-    if(!read_register(MCP3564R_REG::CONFIG1, buffer, 1)) return false;
-
-    // Set the bits for the CLK_SEL to 0, keeping the rest
-    buffer[0] = buffer[0] & ~MCP3564R_CONFIG1_REG_MASK::OSR;
-
-    switch(ratio) {
-        case 0:  buffer[0] |= MCP3564R_CONFIG1_REG::OSR_32;     break;
-        case 1:  buffer[0] |= MCP3564R_CONFIG1_REG::OSR_64;     break;
-        case 2:  buffer[0] |= MCP3564R_CONFIG1_REG::OSR_128;    break;
-        case 3:  buffer[0] |= MCP3564R_CONFIG1_REG::OSR_256;    break;
-        case 4:  buffer[0] |= MCP3564R_CONFIG1_REG::OSR_512;    break;
-        case 5:  buffer[0] |= MCP3564R_CONFIG1_REG::OSR_1024;   break;
-        case 6:  buffer[0] |= MCP3564R_CONFIG1_REG::OSR_2048;   break;
-        case 7:  buffer[0] |= MCP3564R_CONFIG1_REG::OSR_4096;   break;
-        case 8:  buffer[0] |= MCP3564R_CONFIG1_REG::OSR_8192;   break;
-        case 9:  buffer[0] |= MCP3564R_CONFIG1_REG::OSR_16384;  break;
-        case 10: buffer[0] |= MCP3564R_CONFIG1_REG::OSR_20480;  break;
-        case 11: buffer[0] |= MCP3564R_CONFIG1_REG::OSR_24576;  break;
-        case 12: buffer[0] |= MCP3564R_CONFIG1_REG::OSR_40960;  break;
-        case 13: buffer[0] |= MCP3564R_CONFIG1_REG::OSR_49152;  break;
-        case 14: buffer[0] |= MCP3564R_CONFIG1_REG::OSR_81920;  break;
-        case 15: buffer[0] |= MCP3564R_CONFIG1_REG::OSR_98304;  break;
-        default: return false; break;
-    }
-
-    if(!write_register(MCP3564R_REG::CONFIG1, buffer, 1)) return false;
-    return true;
+    return MCP3564R_FIELD::OSR::valid(ratio) && modify(MCP3564R_FIELD::OSR(ratio));
 }
 
 /**
@@ -309,22 +153,7 @@ bool MCP3564R::set_oversample_ratio(uint8_t ratio) {
  * @return True if successful, false if not
 */
 bool MCP3564R::set_adc_bias_current(uint8_t selection) {
-    uint8_t buffer[1];
-    if(!read_register(MCP3564R_REG::CONFIG2, buffer, 1)) return false;
-
-    // Set the bits for the CLK_SEL to 0, keeping the rest
-    buffer[0] = buffer[0] & ~MCP3564R_CONFIG2_REG_MASK::BOOST;
-
-    switch(selection) {
-        case 0:  buffer[0] |= MCP3564R_CONFIG2_REG::BOOST_X_0_5;    break;
-        case 1:  buffer[0] |= MCP3564R_CONFIG2_REG::BOOST_X_0_66;   break;
-        case 2:  buffer[0] |= MCP3564R_CONFIG2_REG::BOOST_X_1;      break;
-        case 3:  buffer[0] |= MCP3564R_CONFIG2_REG::BOOST_X_2;      break;
-        default: return false; break;
-    }
-
-    if(!write_register(MCP3564R_REG::CONFIG2, buffer, 1)) return false;
-    return true;
+    return MCP3564R_FIELD::BOOST::valid(selection) && modify(MCP3564R_FIELD::BOOST(selection));
 }
 
 /**
@@ -335,26 +164,7 @@ bool MCP3564R::set_adc_bias_current(uint8_t selection) {
  * @return True if successful, false if not
 */
 bool MCP3564R::set_adc_gain(uint8_t gain) {
-    uint8_t buffer[1];
-    if(!read_register(MCP3564R_REG::CONFIG2, buffer, 1)) return false;
-
-    // Set the bits for the CLK_SEL to 0, keeping the rest
-    buffer[0] = buffer[0] & ~MCP3564R_CONFIG2_REG_MASK::GAIN;
-
-    switch(gain) {
-        case 0:  buffer[0] |= MCP3564R_CONFIG2_REG::GAIN_X_0_3; break;
-        case 1:  buffer[0] |= MCP3564R_CONFIG2_REG::GAIN_X_1;   break;
-        case 2:  buffer[0] |= MCP3564R_CONFIG2_REG::GAIN_X_2;   break;
-        case 3:  buffer[0] |= MCP3564R_CONFIG2_REG::GAIN_X_4;   break;
-        case 4:  buffer[0] |= MCP3564R_CONFIG2_REG::GAIN_X_8;   break;
-        case 5:  buffer[0] |= MCP3564R_CONFIG2_REG::GAIN_X_16;  break;
-        case 6:  buffer[0] |= MCP3564R_CONFIG2_REG::GAIN_X_32;  break;
-        case 7:  buffer[0] |= MCP3564R_CONFIG2_REG::GAIN_X_64;  break;
-        default: return false; break;
-    }
-
-    if(!write_register(MCP3564R_REG::CONFIG2, buffer, 1)) return false;
-    return true;
+    return MCP3564R_FIELD::GAIN::valid(gain) && modify(MCP3564R_FIELD::GAIN(gain));
 }
 
 /**
@@ -364,15 +174,7 @@ bool MCP3564R::set_adc_gain(uint8_t gain) {
  * @return True if successful, false if not
 */
 bool MCP3564R::set_auto_zero_mux(bool enable) {
-    uint8_t buffer[1];
-    if(!read_register(MCP3564R_REG::CONFIG2, buffer, 1)) return false;
-    if(enable) {
-        buffer[0] |= MCP3564R_CONFIG2_REG::AZ_MUX_ENABLED;
-    } else {
-        buffer[0] &= ~MCP3564R_CONFIG2_REG_MASK::AZ_MUX;
-    }
-    if(!write_register(MCP3564R_REG::CONFIG2, buffer, 1)) return false;
-    return true;
+    return modify(MCP3564R_FIELD::AZ_MUX(enable));
 }
 
 /**
@@ -382,15 +184,7 @@ bool MCP3564R::set_auto_zero_mux(bool enable) {
  * @return True if successful, false if not
 */
 bool MCP3564R::set_auto_zero_ref_buffer(bool enabled) {
-    uint8_t buffer[1];
-    if(!read_register(MCP3564R_REG::CONFIG2, buffer, 1)) return false;
-    if(enabled) {
-        buffer[0] |= MCP3564R_CONFIG2_REG::AZ_REF_ENABLED;
-    } else {
-        buffer[0] &= ~MCP3564R_CONFIG2_REG_MASK::AZ_REF;
-    }
-    if(!write_register(MCP3564R_REG::CONFIG2, buffer, 1)) return false;
-    return true;
+    return modify(MCP3564R_FIELD::AZ_REF(enabled));
 }
 
 /**
@@ -400,21 +194,8 @@ bool MCP3564R::set_auto_zero_ref_buffer(bool enabled) {
  * @return True if successful, false if not
 */
 bool MCP3564R::set_conv_mode(uint8_t mode) {
-    uint8_t buffer[1];
-    if(!read_register(MCP3564R_REG::CONFIG3, buffer, 1)) return false;
-
-    // Set the bits for the CLK_SEL to 0, keeping the rest
-    buffer[0] = buffer[0] & ~MCP3564R_CONFIG3_REG_MASK::CONV_MODE;
-
-    switch(mode) {
-        case 1: buffer[0] |= MCP3564R_CONFIG3_REG::CONV_MODE_ONE_SHOT_SHUTDOWN; break;
-        case 2: buffer[0] |= MCP3564R_CONFIG3_REG::CONV_MODE_ONE_SHOT_STANDBY;  break;
-        case 3: buffer[0] |= MCP3564R_CONFIG3_REG::CONV_MODE_CONTINUOUS;        break;
-        default: return false; break;
-    }
-
-    if(!write_register(MCP3564R_REG::CONFIG3, buffer, 1)) return false;
-    return true;
+    if(mode == 0) return false;
+    return MCP3564R_FIELD::CONV_MODE::valid(mode) && modify(MCP3564R_FIELD::CONV_MODE(mode));
 }
 
 /**
@@ -424,21 +205,7 @@ bool MCP3564R::set_conv_mode(uint8_t mode) {
  * @return True if successful, false if not
 */
 bool MCP3564R::set_data_format(uint8_t format) {
-    uint8_t buffer[1];
-    if(!read_register(MCP3564R_REG::CONFIG3, buffer, 1)) return false;
-
-    // Set the bits for the CLK_SEL to 0, keeping the rest
-    buffer[0] = buffer[0] & ~MCP3564R_CONFIG3_REG_MASK::DATA_FORMAT;
-
-    switch(format) {
-        case 0:  buffer[0] |= MCP3564R_CONFIG3_REG::DATA_FORMAT_0;  break;
-        case 1:  buffer[0] |= MCP3564R_CONFIG3_REG::DATA_FORMAT_1;  break;
-        case 2:  buffer[0] |= MCP3564R_CONFIG3_REG::DATA_FORMAT_2;  break;
-        case 3:  buffer[0] |= MCP3564R_CONFIG3_REG::DATA_FORMAT_3;  break;
-        default: return false; break;
-    }
-
-    if(!write_register(MCP3564R_REG::CONFIG3, buffer, 1)) return false;
+    if(!MCP3564R_FIELD::DATA_FORMAT::valid(format) || !modify(MCP3564R_FIELD::DATA_FORMAT(format))) return false;
     data_format = format; // Update internal value for the data format
     return true;
 }
@@ -450,15 +217,7 @@ bool MCP3564R::set_data_format(uint8_t format) {
  * @return True if successful, false if not
 */
 bool MCP3564R::set_crc_format(bool trailing_zeros) {
-    uint8_t buffer[1];
-    if(!read_register(MCP3564R_REG::CONFIG3, buffer, 1)) return false;
-    if(trailing_zeros) {
-        buffer[0] |= MCP3564R_CONFIG3_REG::CRC_FORMAT_32_BIT;
-    } else {
-        buffer[0] &= ~MCP3564R_CONFIG3_REG_MASK::CRC_FORMAT;
-    }
-    if(!write_register(MCP3564R_REG::CONFIG3, buffer, 1)) return false;
-    return true;
+    return modify(MCP3564R_FIELD::CRC_FORMAT(trailing_zeros));
 }
 
 /**
@@ -468,15 +227,7 @@ bool MCP3564R::set_crc_format(bool trailing_zeros) {
  * @return True if successful, false if not
 */
 bool MCP3564R::set_en_crccom(bool enabled) {
-    uint8_t buffer[1];
-    if(!read_register(MCP3564R_REG::CONFIG3, buffer, 1)) return false;
-    if(enabled) {
-        buffer[0] |= MCP3564R_CONFIG3_REG::CRCCOM_ENABLED;
-    } else {
-        buffer[0] &= ~MCP3564R_CONFIG3_REG_MASK::EN_CRCCOM;
-    }
-    if(!write_register(MCP3564R_REG::CONFIG3, buffer, 1)) return false;
-    return true;
+    return modify(MCP3564R_FIELD::EN_CRCCOM(enabled));
 }
 
 /**
@@ -486,15 +237,7 @@ bool MCP3564R::set_en_crccom(bool enabled) {
  * @return True if successful, false if not
 */
 bool MCP3564R::set_en_offcal(bool enabled) {
-    uint8_t buffer[1];
-    if(!read_register(MCP3564R_REG::CONFIG3, buffer, 1)) return false;
-    if(enabled) {
-        buffer[0] |= MCP3564R_CONFIG3_REG::OFFCAL_ENABLED;
-    } else {
-        buffer[0] &= ~MCP3564R_CONFIG3_REG_MASK::EN_OFFCAL;
-    }
-    if(!write_register(MCP3564R_REG::CONFIG3, buffer, 1)) return false;
-    return true;
+    return modify(MCP3564R_FIELD::EN_OFFCAL(enabled));
 }
 
 /**
@@ -504,15 +247,7 @@ bool MCP3564R::set_en_offcal(bool enabled) {
  * @return True if successful, false if not
 */
 bool MCP3564R::set_en_gaincal(bool enabled) {
-    uint8_t buffer[1];
-    if(!read_register(MCP3564R_REG::CONFIG3, buffer, 1)) return false;
-    if(enabled) {
-        buffer[0] |= MCP3564R_CONFIG3_REG::GAINCAL_ENABLED;
-    } else {
-        buffer[0] &= ~MCP3564R_CONFIG3_REG_MASK::EN_GAINCAL;
-    }
-    if(!write_register(MCP3564R_REG::CONFIG3, buffer, 1)) return false;
-    return true;
+    return modify(MCP3564R_FIELD::EN_GAINCAL(enabled));
 }
 
 /**
@@ -522,15 +257,7 @@ bool MCP3564R::set_en_gaincal(bool enabled) {
  * @return True if successful, false if not
 */
 bool MCP3564R::set_irq_mode_mdat(bool mdat) {
-    uint8_t buffer[1];
-    if(!read_register(MCP3564R_REG::IRQ, buffer, 1)) return false;
-    if(mdat) {
-        buffer[0] |= MCP3564R_IRQ_REG::IRQ_MODE_MDAT_OUT;
-    } else {
-        buffer[0] &= ~MCP3564R_IRQ_REG_MASK::IRQ_MODE_1;
-    }
-    if(!write_register(MCP3564R_REG::IRQ, buffer, 1)) return false;
-    return true;
+    return modify(MCP3564R_FIELD::IRQ_MODE_MDAT(mdat));
 }
 
 /**
@@ -540,15 +267,7 @@ bool MCP3564R::set_irq_mode_mdat(bool mdat) {
  * @return True if successful, false if not
 */
 bool MCP3564R::set_irq_mode_hiz(bool hiz) {
-    uint8_t buffer[1];
-    if(!read_register(MCP3564R_REG::IRQ, buffer, 1)) return false;
-    if(hiz) {
-        buffer[0] &= ~MCP3564R_IRQ_REG_MASK::IRQ_MODE_0;
-    } else {
-        buffer[0] |= MCP3564R_IRQ_REG::IRQ_MODE_HIGH;
-    }
-    if(!write_register(MCP3564R_REG::IRQ, buffer, 1)) return false;
-    return true;
+    return modify(MCP3564R_FIELD::IRQ_MODE_HIGH(!hiz));
 }
 
 /**
@@ -558,39 +277,11 @@ bool MCP3564R::set_irq_mode_hiz(bool hiz) {
  * @return True if successful, false if not
 */
 bool MCP3564R::enable_scan_channel(uint8_t channel) {
-    uint8_t buffer[3] = {0};
-    // Read the current state of the register
-    if(!read_register(MCP3564R_REG::SCAN, buffer, 3)) return false;
-    // Copy channels content into a variable to work with
-    uint16_t channels = 0;
-    channels |= buffer[1];
-    channels <<= 8;
-    channels |= buffer[2];
-
-    switch (channel) {
-        case 0:  channels |= MCP3564R_SCAN_REG::SINGLE_CH_0;    break;
-        case 1:  channels |= MCP3564R_SCAN_REG::SINGLE_CH_1;    break;
-        case 2:  channels |= MCP3564R_SCAN_REG::SINGLE_CH_2;    break;
-        case 3:  channels |= MCP3564R_SCAN_REG::SINGLE_CH_3;    break;
-        case 4:  channels |= MCP3564R_SCAN_REG::SINGLE_CH_4;    break;
-        case 5:  channels |= MCP3564R_SCAN_REG::SINGLE_CH_5;    break;
-        case 6:  channels |= MCP3564R_SCAN_REG::SINGLE_CH_6;    break;
-        case 7:  channels |= MCP3564R_SCAN_REG::SINGLE_CH_7;    break;
-        case 8:  channels |= MCP3564R_SCAN_REG::DIFF_CH_A;      break;
-        case 9:  channels |= MCP3564R_SCAN_REG::DIFF_CH_B;      break;
-        case 10: channels |= MCP3564R_SCAN_REG::DIFF_CH_C;      break;
-        case 11: channels |= MCP3564R_SCAN_REG::DIFF_CH_D;      break;
-        case 12: channels |= MCP3564R_SCAN_REG::TEMP;           break;
-        case 13: channels |= MCP3564R_SCAN_REG::AVDD;           break;
-        case 14: channels |= MCP3564R_SCAN_REG::VCM;            break;
-        case 15: channels |= MCP3564R_SCAN_REG::OFFSET;         break;
-        default: return false;
-    }
-    buffer[1] = (channels & 0xFF00) >> 8;
-    buffer[2] = channels & 0x00FF;
-    //memcpy(buffer+1, &channels, sizeof(channels));
-    if(!write_register(MCP3564R_REG::SCAN, buffer, 3)) return false;
-    return true;
+    if(channel > 15) return false;
+    uint32_t scan;
+    if(!readRegister<MCP3564R_REG::SCAN>(&scan)) return false;
+    uint16_t channels = MCP3564R_FIELD::CHANNELS::decode(scan) | (1u << channel);
+    return writeRegister<MCP3564R_REG::SCAN>((scan & ~MCP3564R_FIELD::CHANNELS::mask) | MCP3564R_FIELD::CHANNELS(channels).bits);
 }
 
 /**
@@ -600,35 +291,25 @@ bool MCP3564R::enable_scan_channel(uint8_t channel) {
  * @return True if successful, false if not
 */
 bool MCP3564R::disable_scan_channel(uint8_t channel) {
-    uint8_t buffer[3] = {0};
-    // Read the current state of the register
-    if(!read_register(MCP3564R_REG::SCAN, buffer, 3)) return false;
-    // Copy channels content into a variable to work with
-    uint16_t channels = 0;
-    memcpy(&channels, buffer+1, sizeof(channels));
+    if(channel > 15) return false;
+    uint32_t scan;
+    if(!readRegister<MCP3564R_REG::SCAN>(&scan)) return false;
+    uint16_t channels = MCP3564R_FIELD::CHANNELS::decode(scan) & ~(1u << channel);
+    return writeRegister<MCP3564R_REG::SCAN>((scan & ~MCP3564R_FIELD::CHANNELS::mask) | MCP3564R_FIELD::CHANNELS(channels).bits);
+}
 
-    switch (channel) {
-        case 0:  channels &= ~MCP3564R_SCAN_REG::SINGLE_CH_0;    break;
-        case 1:  channels &= ~MCP3564R_SCAN_REG::SINGLE_CH_1;    break;
-        case 2:  channels &= ~MCP3564R_SCAN_REG::SINGLE_CH_2;    break;
-        case 3:  channels &= ~MCP3564R_SCAN_REG::SINGLE_CH_3;    break;
-        case 4:  channels &= ~MCP3564R_SCAN_REG::SINGLE_CH_4;    break;
-        case 5:  channels &= ~MCP3564R_SCAN_REG::SINGLE_CH_5;    break;
-        case 6:  channels &= ~MCP3564R_SCAN_REG::SINGLE_CH_6;    break;
-        case 7:  channels &= ~MCP3564R_SCAN_REG::SINGLE_CH_7;    break;
-        case 8:  channels &= ~MCP3564R_SCAN_REG::DIFF_CH_A;      break;
-        case 9:  channels &= ~MCP3564R_SCAN_REG::DIFF_CH_B;      break;
-        case 10: channels &= ~MCP3564R_SCAN_REG::DIFF_CH_C;      break;
-        case 11: channels &= ~MCP3564R_SCAN_REG::DIFF_CH_D;      break;
-        case 12: channels &= ~MCP3564R_SCAN_REG::TEMP;           break;
-        case 13: channels &= ~MCP3564R_SCAN_REG::AVDD;           break;
-        case 14: channels &= ~MCP3564R_SCAN_REG::VCM;            break;
-        case 15: channels &= ~MCP3564R_SCAN_REG::OFFSET;         break;
-        default: return false;
-    }
-    memcpy(buffer+1, &channels, sizeof(channels));
-    if(!write_register(MCP3564R_REG::SCAN, buffer, 3)) return false;
-    return true;
+/**
+ * @brief Set the channels to scan in one write, replacing the ones enabled before
+ * @param channels
+ *          Bit n enables channel n, see enable_scan_channel
+ * @param multiplier
+ *          Delay time between conversions, see set_scan_delay_multiplier
+ * @return True if successful, false if not
+*/
+bool MCP3564R::set_scan_channels(uint16_t channels, uint8_t multiplier) {
+    // Every field of SCAN is given, so it is written without reading it first
+    return MCP3564R_FIELD::DLY::valid(multiplier) &&
+           configure(MCP3564R_FIELD::DLY(multiplier), MCP3564R_FIELD::CHANNELS(channels));
 }
 
 /**
@@ -639,26 +320,7 @@ bool MCP3564R::disable_scan_channel(uint8_t channel) {
  * @return True if successful, false if not
 */
 bool MCP3564R::set_scan_delay_multiplier(uint8_t multiplier) {
-    uint8_t buffer[3];
-    if(!read_register(MCP3564R_REG::SCAN, buffer, 3)) return false;
-
-    // Set the bits for the CLK_SEL to 0, keeping the rest
-    buffer[0] = buffer[0] & ~MCP3564R_SCAN_REG_MASK::DLY;
-
-    switch(multiplier) {
-        case 0:  buffer[0] |= MCP3564R_SCAN_REG::DMCLK_0;   break;
-        case 1:  buffer[0] |= MCP3564R_SCAN_REG::DMCLK_8;   break;
-        case 2:  buffer[0] |= MCP3564R_SCAN_REG::DMCLK_16;  break;
-        case 3:  buffer[0] |= MCP3564R_SCAN_REG::DMCLK_32;  break;
-        case 4:  buffer[0] |= MCP3564R_SCAN_REG::DMCLK_64;  break;
-        case 5:  buffer[0] |= MCP3564R_SCAN_REG::DMCLK_128; break;
-        case 6:  buffer[0] |= MCP3564R_SCAN_REG::DMCLK_256; break;
-        case 7:  buffer[0] |= MCP3564R_SCAN_REG::DMCLK_512; break;
-        default: return false; break;
-    }
-
-    if(!write_register(MCP3564R_REG::SCAN, buffer, 3)) return false;
-    return true;
+    return MCP3564R_FIELD::DLY::valid(multiplier) && modify(MCP3564R_FIELD::DLY(multiplier));
 }
 
 /**
@@ -666,8 +328,7 @@ bool MCP3564R::set_scan_delay_multiplier(uint8_t multiplier) {
  * @return True if successful, false if not
 */
 bool MCP3564R::lock_write_access(void) {
-    uint8_t lock[1] = {0x00};
-    if(!write_register(MCP3564R_REG::LOCK, lock, 1)) return false;
+    if(!modify(MCP3564R_FIELD::LOCK(0x00))) return false;
     locked = true;
     return true;
 }
@@ -677,8 +338,7 @@ bool MCP3564R::lock_write_access(void) {
  * @return True if successful, false if not
 */
 bool MCP3564R::unlock_write_access(void) {
-    uint8_t lock[1] = {LOCK_CODE};
-    if(!write_register(MCP3564R_REG::LOCK, lock, 1)) return false;
+    if(!modify(MCP3564R_FIELD::LOCK(LOCK_CODE))) return false;
     locked = false;
     return true;
 }
@@ -726,8 +386,9 @@ void MCP3564R::debug(void) {
             printf("    SGN - 0x%X\n", buf[0]);
             printf("    DATA - 0x%X%X%X\n", buf[1], buf[2], buf[3]);
             n = 4;
+            break;
         case 3:
-            printf("    CH_ID - %d\n", buf[0] & 0xF0);
+            printf("    CH_ID - %d\n", (buf[0] & 0xF0) >> 4);
             printf("    SGN - 0x%X\n", buf[0] & 0x0F);
             printf("    DATA - 0x%X%X%X\n", buf[1], buf[2], buf[3]);
             n = 4;
@@ -852,8 +513,8 @@ void MCP3564R::debug(void) {
     printf("    EN_STP (Conversion Start Interrupt Output) - ");
     if(buf[n+4] & 0x01) {printf("Enabled\n");} else {printf("Disabled\n");}
     printf("MUX Register:\n");
-    printf("    MUX_VIN+ - %d\n", buf[n+5] & 0xF0);
-    printf("    MUX_VIN- - %d\n", buf[n+5] & 0xF0);
+    printf("    MUX_VIN+ - %d\n", (buf[n+5] & 0xF0) >> 4);
+    printf("    MUX_VIN- - %d\n", buf[n+5] & 0x0F);
     printf("SCAN Register:\n");
     printf("    DLY - ");
     switch (buf[n+6] & 0xE0) {
@@ -973,7 +634,7 @@ bool MCP3564R::read_register(uint8_t address, uint8_t* data, uint8_t len) {
     spi_set_baudrate(_spi, 1000000u);
     uint8_t header = 0x00;
     header |= (_addr & 0x03) << 6;
-    header |= (address & 0x07) << 2;
+    header |= (address & 0x0F) << 2;
     header |= 0x03;
     
     gpio_put(_csn_pin, false);
@@ -1013,7 +674,7 @@ bool MCP3564R::read_register(uint8_t address, uint8_t* data, uint8_t len, uint8_
     spi_set_baudrate(_spi, 1000000u);
     uint8_t header = 0x00;
     header |= (_addr & 0x03) << 6;
-    header |= (address & 0x07) << 2;
+    header |= (address & 0x0F) << 2;
     header |= 0x03;
     
     gpio_put(_csn_pin, false);
@@ -1036,6 +697,77 @@ bool MCP3564R::read_register(uint8_t address, uint8_t* data, uint8_t len, uint8_
    return true;
 }
 
+/**
+ * @brief Length of an ADCDATA read in the current data format
+ * @return 3 for 24 bit data, 4 for the 32 bit formats
+*/
+uint8_t MCP3564R::data_length(void) {
+    return (data_format == 0) ? 3 : 4;
+}
+
+/**
+ * @brief Decode an ADCDATA read in the current data format
+ * @param buffer
+ *          The bytes read, data_length() of them
+ * @param data
+ *          Pointer to a variable where the data will go
+ * @param channel
+ *          Pointer to a variable where the channel ID will go, 255 if the format has none
+ * @return True if successful, false if not
+*/
+bool MCP3564R::decode_data(const uint8_t* buffer, int32_t* data, uint8_t* channel) {
+    uint8_t selected_channel = 255u;
+    int32_t output_data = 0;
+    int32_t temp = 0x00000000;
+    switch(data_format) {
+        case 0:
+            output_data = (buffer[0] & 0x80) ? 0xFF800000 : 0x00000000;
+            temp |= buffer[0] & 0x7F;
+            temp <<= 8;
+            temp |= buffer[1];
+            temp <<= 8;
+            temp |= buffer[2];
+            output_data |= temp;
+            break;
+        case 1:
+            output_data = (buffer[0] & 0x80) ? 0xFF800000 : 0x00000000;
+            temp |= buffer[0] & 0x7F;
+            temp <<= 8;
+            temp |= buffer[1];
+            temp <<= 8;
+            temp |= buffer[2];
+            output_data |= temp;
+            break;
+        case 2:
+            output_data = ((buffer[0]) == 0xFF) ? 0xFF000000 : 0x00000000;
+            temp |= buffer[1];
+            temp <<= 8;
+            temp |= buffer[2];
+            temp <<= 8;
+            temp |= buffer[3];
+            output_data |= temp;
+            break;
+        case 3:
+            output_data = (buffer[0] & 0x08) ? 0xFF000000 : 0x00000000;
+            temp <<= 8;
+            temp |= buffer[1];
+            temp <<= 8;
+            temp |= buffer[2];
+            temp <<= 8;
+            temp |= buffer[3];
+            output_data |= temp;
+            selected_channel = (buffer[0] & 0xF0) >> 4;
+            break;
+        default:
+            return false;
+            break;
+    }
+
+    *channel = selected_channel;
+    *data = output_data;
+    return true;
+}
+
 /**
  * @brief Write data to register
  * @param address
@@ -1051,7 +783,7 @@ bool MCP3564R::write_register(uint8_t address, uint8_t* data, uint8_t len) {
     spi_set_baudrate(_spi, 1000000u);
     uint8_t header = 0x00;
     header |= (_addr & 0x03) << 6;
-    header |= (address & 0x07) << 2;
+    header |= (address & 0x0F) << 2;
     header |= 0x02;
 
     gpio_put(_csn_pin, false);
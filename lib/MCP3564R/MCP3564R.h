@@ -8,18 +8,21 @@
 
 #pragma once
 #include <hardware/spi.h>
+#include <type_traits>
 #include "MCP3564R_regs.h"
 
 /* TODO:
  - Add everything
 */
 
-class MCP3564R {
+class MCP3564R : public RegisterDevice<MCP3564R> {
 public:
     MCP3564R(spi_inst_t* spi, uint csn_pin, uint8_t addr = 0x1);
     void init(void);
 
     bool read_data(int32_t* data, uint8_t* channel);
+    bool read_data(int32_t* data, uint8_t* channel, uint64_t* timestamp);
+    bool read_new_data(int32_t* data, uint8_t* channel, bool* fresh);
 
     bool select_vref_source(bool internal);
     bool set_clock_source(uint8_t source);
@@ -46,6 +49,7 @@ public:
 
     bool enable_scan_channel(uint8_t channel);
     bool disable_scan_channel(uint8_t channel);
+    bool set_scan_channels(uint16_t channels, uint8_t multiplier = 0);
     bool set_scan_delay_multiplier(uint8_t multiplier);
 
     bool lock_write_access(void);
@@ -53,13 +57,31 @@ public:
 
     void debug(void);
     //bool quick_setup(void);
+
+    /**
+     * @brief Set several fields at once, see MCP3564R_FIELD. Fields are grouped per register at
+     *        compile time, a register whose fields are all given is written without reading it
+     * @return True if successful, false if not
+    */
+    template<typename... Fields>
+    bool configure(Fields... fields) {
+        if(!modify(fields...)) return false;
+        // read_data needs to know the frame length
+        ((std::is_same_v<Fields, MCP3564R_FIELD::DATA_FORMAT> ? (data_format = fields.value(), 0) : 0), ...);
+        return true;
+    }
 private:
+    friend class RegisterDevice<MCP3564R>;
+
     spi_inst_t* _spi;
     uint _csn_pin;
     uint8_t _addr;
     uint8_t data_format = 0;
     bool locked = false;
 
+    uint8_t data_length(void);
+    bool decode_data(const uint8_t* buffer, int32_t* data, uint8_t* channel);
+
     bool read_register(uint8_t address, uint8_t* data, uint8_t len);
     bool read_register(uint8_t address, uint8_t* data, uint8_t len, uint8_t* status_byte);
     bool write_register(uint8_t address, uint8_t* data, uint8_t len);
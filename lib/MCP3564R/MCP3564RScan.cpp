@@ -0,0 +1,121 @@
+/*
+ *  Title: MCP3564RScan.cpp
+ *  Description: Scan acquisition on the MCP3564R, conversions demultiplexed by their channel ID
+ *               into per channel ring buffers
+ *  Author: Tinna Osk Traustadottir
+ */
+#include "MCP3564RScan.h"
+#include <string.h>
+
+/// @brief Construct a new MCP3564RScan object
+/// @param adc 
+///        The ADC, set up for continuous conversion with data format 3 so each conversion
+///        carries its channel ID
+MCP3564RScan::MCP3564RScan(MCP3564R& adc) : _adc(adc) {
+    memset(_head, 0, sizeof(_head));
+    memset(_count, 0, sizeof(_count));
+    resetStats();
+}
+
+/// @brief Program the channel set in one SCAN write and start over with empty rings
+/// @param channels 
+///        Bit n scans channel n, see MCP3564R_SCAN_CHANNEL
+/// @param delay 
+///        Delay between conversions, see MCP3564R::set_scan_delay_multiplier
+/// @return True if successful, false if not
+bool MCP3564RScan::start(uint16_t channels, uint8_t delay) {
+    if(!_adc.set_scan_channels(channels, delay)) return false;
+    _channels = channels;
+    _last = SCAN_CHANNEL_COUNT;
+    memset(_head, 0, sizeof(_head));
+    memset(_count, 0, sizeof(_count));
+    resetStats();
+    return true;
+}
+
+/// @brief Read the ADC once and file a new conversion under its channel. The ADC only holds
+///        the latest conversion, poll more often than it converts to keep every one
+/// @param fresh 
+///        Set true if there was a new conversion, can be left out
+/// @return True if successful, false if the read failed
+bool MCP3564RScan::poll(bool* fresh) {
+    int32_t code;
+    uint8_t channel;
+    bool is_new;
+    if(!_adc.read_new_data(&code, &channel, &is_new)) return false;
+    _stat_polls++;
+    if(fresh != nullptr) *fresh = is_new;
+    if(!is_new) {
+        _stat_empty++;
+        return true;
+    }
+    if(channel >= SCAN_CHANNEL_COUNT || !(_channels & (1u << channel))) return true;  // Not ours, from before start()
+
+    if(_last < SCAN_CHANNEL_COUNT) _stat_missed += skipped(channel);
+    _last = channel;
+    push(channel, code, time_us_64());
+    return true;
+}
+
+/// @brief Number of samples waiting on a channel
+uint8_t MCP3564RScan::available(uint8_t channel) const {
+    return (channel < SCAN_CHANNEL_COUNT) ? _count[channel] : 0;
+}
+
+/// @brief Take the oldest waiting sample of a channel
+/// @param channel 
+///        The channel, see MCP3564R_SCAN_CHANNEL
+/// @param sample 
+///        Where the sample goes
+/// @return True if there was one, false if the channel's ring is empty
+bool MCP3564RScan::pop(uint8_t channel, MCP3564R_SCAN_SAMPLE* sample) {
+    if(available(channel) == 0) return false;
+    uint8_t tail = (_head[channel] + MCP3564R_SCAN_DEPTH - _count[channel]) % MCP3564R_SCAN_DEPTH;
+    *sample = _ring[channel][tail];
+    _count[channel]--;
+    return true;
+}
+
+/// @brief Get the counts since the last reset and the per channel rates they give
+void MCP3564RScan::getStats(MCP3564RScan_STATS* stats) const {
+    stats->elapsed_us = time_us_64() - _stat_start_us;
+    for(uint8_t i = 0; i < SCAN_CHANNEL_COUNT; i++) {
+        stats->samples[i] = _stat_samples[i];
+        stats->rate_hz[i] = (stats->elapsed_us > 0) ? _stat_samples[i] * 1e6f / stats->elapsed_us : 0.0f;
+    }
+    stats->missed = _stat_missed;
+    stats->overwritten = _stat_overwritten;
+    stats->polls = _stat_polls;
+    stats->empty = _stat_empty;
+}
+
+/// @brief Start new counts from now
+void MCP3564RScan::resetStats(void) {
+    memset(_stat_samples, 0, sizeof(_stat_samples));
+    _stat_missed = 0;
+    _stat_overwritten = 0;
+    _stat_polls = 0;
+    _stat_empty = 0;
+    _stat_start_us = time_us_64();
+}
+
+/// @brief Add a sample to a channel's ring, dropping the oldest if it is full
+void MCP3564RScan::push(uint8_t channel, int32_t code, uint64_t timestamp) {
+    _ring[channel][_head[channel]] = {code, timestamp};
+    _head[channel] = (_head[channel] + 1) % MCP3564R_SCAN_DEPTH;
+    if(_count[channel] < MCP3564R_SCAN_DEPTH) _count[channel]++;
+    else _stat_overwritten++;
+    _stat_samples[channel]++;
+}
+
+/// @brief Conversions between the previous one and this channel's, in scan order, that were
+///        never read
+uint8_t MCP3564RScan::skipped(uint8_t channel) const {
+    uint8_t gaps = 0;
+    uint8_t next = _last;
+    while(true) {
+        next = (next + 1) % SCAN_CHANNEL_COUNT;
+        if(next == channel) return gaps;
+        if(_channels & (1u << next)) gaps++;
+    }
+}
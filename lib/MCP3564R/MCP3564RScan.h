@@ -0,0 +1,62 @@
+/*
+ *  Title: MCP3564RScan.h
+ *  Description: Scan acquisition on the MCP3564R, conversions demultiplexed by their channel ID
+ *               into per channel ring buffers
+ *  Author: Tinna Osk Traustadottir
+ */
+#pragma once
+#include <pico/stdlib.h>
+#include "MCP3564R.h"
+
+const uint8_t MCP3564R_SCAN_DEPTH = 32;     // Conversions kept per channel, a full ring drops its oldest
+
+/// @brief One conversion of a scan channel
+struct MCP3564R_SCAN_SAMPLE {
+    int32_t code;           // Signed 24 bit conversion
+    uint64_t timestamp;     // time_us_64() when it was read, at most one poll interval after it finished
+};
+
+/// @brief Scan throughput since the last reset
+struct MCP3564RScan_STATS {
+    uint32_t samples[SCAN_CHANNEL_COUNT];   // Conversions read per channel
+    float rate_hz[SCAN_CHANNEL_COUNT];      // Effective sample rate per channel
+    uint32_t missed;        // Conversions replaced by the next one before they were read, from gaps in the scan order
+    uint32_t overwritten;   // Samples dropped from a full ring before they were taken
+    uint32_t polls;         // Reads of the ADC
+    uint32_t empty;         // Reads that found no new conversion
+    uint64_t elapsed_us;    // Time the counts cover
+};
+
+class MCP3564RScan {
+public:
+    MCP3564RScan(MCP3564R& adc);
+    bool start(uint16_t channels, uint8_t delay = 0);
+    uint16_t channels(void) const { return _channels; };
+
+    bool poll(bool* fresh = nullptr);
+
+    uint8_t available(uint8_t channel) const;
+    bool pop(uint8_t channel, MCP3564R_SCAN_SAMPLE* sample);
+
+    void getStats(MCP3564RScan_STATS* stats) const;
+    void resetStats(void);
+
+private:
+    MCP3564R& _adc;
+    uint16_t _channels = 0;
+    uint8_t _last = SCAN_CHANNEL_COUNT;     // Channel of the previous conversion, none yet
+
+    MCP3564R_SCAN_SAMPLE _ring[SCAN_CHANNEL_COUNT][MCP3564R_SCAN_DEPTH];
+    uint8_t _head[SCAN_CHANNEL_COUNT];      // Next slot written
+    uint8_t _count[SCAN_CHANNEL_COUNT];     // Samples waiting
+
+    uint32_t _stat_samples[SCAN_CHANNEL_COUNT];
+    uint32_t _stat_missed = 0;
+    uint32_t _stat_overwritten = 0;
+    uint32_t _stat_polls = 0;
+    uint32_t _stat_empty = 0;
+    uint64_t _stat_start_us = 0;
+
+    void push(uint8_t channel, int32_t code, uint64_t timestamp);
+    uint8_t skipped(uint8_t channel) const;
+};
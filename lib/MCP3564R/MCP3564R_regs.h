@@ -7,6 +7,7 @@
  */
 
 #pragma once
+#include <RegisterMap.h>
 
 /**
  * @brief The unlock code to write to registers
@@ -14,22 +15,22 @@
 const uint8_t LOCK_CODE = (0xA5);
 
 /**
- * @brief Register map of the MCP3564R
+ * @brief Register map of the MCP3564R. CONFIG1 bits 1:0 are reserved as 0, CONFIG2 bit 0 as 1
 */
 namespace MCP3564R_REG {
-    const uint8_t ADCDATA   = (0x00); // Read
-    const uint8_t CONFIG0   = (0x01); // Read/write
-    const uint8_t CONFIG1   = (0x02); // Read/write
-    const uint8_t CONFIG2   = (0x03); // Read/write
-    const uint8_t CONFIG3   = (0x04); // Read/write
-    const uint8_t IRQ       = (0x05); // Read/write
-    const uint8_t MUX       = (0x06); // Read/write
-    const uint8_t SCAN      = (0x07); // Read/write
-    const uint8_t TIMER     = (0x08); // Read/write
-    const uint8_t OFFSETCAL = (0x09); // Read/write
-    const uint8_t GAINCAL   = (0x0A); // Read/write
-    const uint8_t LOCK      = (0x0D); // Read/write
-    const uint8_t CRCCFG    = (0x0F); // Read
+    typedef Register<0x00, 4, REG_ACCESS::Read_only> ADCDATA;                 // Read, 3 or 4 bytes by data format
+    typedef Register<0x01> CONFIG0;                                             // Read/write
+    typedef Register<0x02, 1, REG_ACCESS::Read_write, 0x03, 0x00> CONFIG1;     // Read/write
+    typedef Register<0x03, 1, REG_ACCESS::Read_write, 0x01, 0x01> CONFIG2;     // Read/write
+    typedef Register<0x04> CONFIG3;                                             // Read/write
+    typedef Register<0x05, 1, REG_ACCESS::Read_write, 0xF0, 0x00> IRQ;         // Read/write, bits 7:4 are read-only status
+    typedef Register<0x06> MUX;                                                 // Read/write
+    typedef Register<0x07, 3, REG_ACCESS::Read_write, 0x1F0000> SCAN;          // Read/write
+    typedef Register<0x08, 3> TIMER;                                            // Read/write
+    typedef Register<0x09, 3> OFFSETCAL;                                        // Read/write
+    typedef Register<0x0A, 3> GAINCAL;                                          // Read/write
+    typedef Register<0x0D> LOCK;                                                // Read/write
+    typedef Register<0x0F, 2, REG_ACCESS::Read_only> CRCCFG;                   // Read
 };
 
 /**
@@ -55,193 +56,41 @@ namespace MCP3564R_ADCDATA_REG_MASK {
 };
 
 /**
- * @brief Masks for the CONFIG0 register
+ * @brief Oversampling ratio of each OSR setting. Doubling up to 16384, then in smaller steps
 */
-namespace MCP3564R_CONFIG0_REG_MASK {
-    const uint8_t VREF_SEL  = (0x80);
-    const uint8_t CONFIG    = (0x40);
-    const uint8_t CLK_SEL   = (0x30);
-    const uint8_t CS_SEL    = (0x0C);
-    const uint8_t ADC_MODE  = (0x03);
+const uint32_t MCP3564R_OSR_RATIO[16] = {
+    32, 64, 128, 256, 512, 1024, 2048, 4096, 8192, 16384, 20480, 24576, 40960, 49152, 81920, 98304,
 };
 
 /**
- * @brief Map of CONFIG0 register
-*/
-namespace MCP3564R_CONFIG0_REG {
-    const uint8_t DEFAULT                   = (0xC0);
-
-    const uint8_t VREF_SEL_INTERNAL         = (0x80);
-    const uint8_t VREF_SEL_EXTERNAL         = (0x00);
-
-    const uint8_t CONFIG_NORMAL             = (0x40);
-    const uint8_t CONFIG_PARTIAL_SHUTDOWN   = (0x00);
-
-    const uint8_t CLK_SEL_INTERNAL_OUTPUT   = (0x30);
-    const uint8_t CLK_SEL_INTERNAL_NO_OUT   = (0x20);
-    const uint8_t CLK_SEL_EXTERNAL          = (0x10);
-    const uint8_t CLK_SEL_DEFAULT           = (0x00);
-
-    const uint8_t CS_SEL_15_UA              = (0x0C);
-    const uint8_t CS_SEL_3_7_UA             = (0x08);
-    const uint8_t CS_SEL_0_9_UA             = (0x04);
-    const uint8_t CS_SEL_NO_SOURCE          = (0x00);
-
-    const uint8_t ADC_MODE_CONVERSION       = (0x03);
-    const uint8_t ADC_MODE_STANDBY          = (0x02);
-    const uint8_t ADC_MODE_SHUTDOWN         = (0x01);
-    const uint8_t ADC_MODE_DEFAULT          = (0x00);
-};
-
-/**
- * @brief Masks for the CONFIG1 register
-*/
-namespace MCP3564R_CONFIG1_REG_MASK {
-    const uint8_t PRE   = (0xC0);
-    const uint8_t OSR   = (0x3C);
-};
-
-/**
- * @brief Map of CONFIG1 register
-*/
-namespace MCP3564R_CONFIG1_REG {
-    const uint8_t DEFAULT       = (0x0C);
-
-    const uint8_t AMCLK_MCLK_8  = (0xC0);
-    const uint8_t AMCLK_MCLK_4  = (0x08);
-    const uint8_t AMCLK_MCLK_2  = (0x04);
-    const uint8_t AMCLK_MCLK    = (0x00);
-    
-    const uint8_t OSR_98304     = (0x3C);
-    const uint8_t OSR_81920     = (0x38);
-    const uint8_t OSR_49152     = (0x34);
-    const uint8_t OSR_40960     = (0x30);
-    const uint8_t OSR_24576     = (0x2C);
-    const uint8_t OSR_20480     = (0x28);
-    const uint8_t OSR_16384     = (0x24);
-    const uint8_t OSR_8192      = (0x20);
-    const uint8_t OSR_4096      = (0x1C);
-    const uint8_t OSR_2048      = (0x18);
-    const uint8_t OSR_1024      = (0x14);
-    const uint8_t OSR_512       = (0x10);
-    const uint8_t OSR_256       = (0x0C);
-    const uint8_t OSR_128       = (0x08);
-    const uint8_t OSR_64        = (0x04);
-    const uint8_t OSR_32        = (0x00);
-};
-
-/**
- * @brief Masks for CONFIG2 register
-*/
-namespace MCP3564R_CONFIG2_REG_MASK {
-    const uint8_t BOOST     = (0xC0);
-    const uint8_t GAIN      = (0x30);
-    const uint8_t AZ_MUX    = (0x04);
-    const uint8_t AZ_REF    = (0x02);
-};
-
-/**
- * @brief Map of CONFIG2 register
-*/
-namespace MCP3564R_CONFIG2_REG {
-    const uint8_t DEFAULT           = (0x8B);
-
-    const uint8_t BOOST_X_2         = (0xC0);
-    const uint8_t BOOST_X_1         = (0x80);
-    const uint8_t BOOST_X_0_66      = (0x40);
-    const uint8_t BOOST_X_0_5       = (0x00);
-
-    const uint8_t GAIN_X_64         = (0x38);
-    const uint8_t GAIN_X_32         = (0x30);
-    const uint8_t GAIN_X_16         = (0x28);
-    const uint8_t GAIN_X_8          = (0x20);
-    const uint8_t GAIN_X_4          = (0x18);
-    const uint8_t GAIN_X_2          = (0x10);
-    const uint8_t GAIN_X_1          = (0x08);
-    const uint8_t GAIN_X_0_3        = (0x00);
-
-    const uint8_t AZ_MUX_ENABLED    = (0x04);
-    const uint8_t AZ_MUX_DISABLED   = (0x00);
-
-    const uint8_t AZ_REF_ENABLED    = (0x02);
-    const uint8_t AZ_REF_DISABLED   = (0x00);
-};
-
-/**
- * @brief Masks for CONFIG3 register
-*/
-namespace MCP3564R_CONFIG3_REG_MASK {
-    const uint8_t CONV_MODE     = (0xC0);
-    const uint8_t DATA_FORMAT   = (0x30);
-    const uint8_t CRC_FORMAT    = (0x08);
-    const uint8_t EN_CRCCOM     = (0x04);
-    const uint8_t EN_OFFCAL     = (0x02);
-    const uint8_t EN_GAINCAL    = (0x01);
-};
-
-/**
- * @brief Map of CONFIG3 register
-*/
-namespace MCP3564R_CONFIG3_REG {
-    const uint8_t DEFAULT                       = (0x00);
-
-    const uint8_t CONV_MODE_CONTINUOUS          = (0xC0);
-    const uint8_t CONV_MODE_ONE_SHOT_STANDBY    = (0x80);
-    const uint8_t CONV_MODE_ONE_SHOT_SHUTDOWN   = (0x00);
-
-    const uint8_t DATA_FORMAT_3                 = (0x30);
-    const uint8_t DATA_FORMAT_2                 = (0x20);
-    const uint8_t DATA_FORMAT_1                 = (0x10);
-    const uint8_t DATA_FORMAT_0                 = (0x00);
-
-    const uint8_t CRC_FORMAT_32_BIT             = (0x08);
-    const uint8_t CRC_FORMAT_16_BIT             = (0x00);
-
-    const uint8_t CRCCOM_ENABLED                = (0x04);
-    const uint8_t CRCCOM_DISABLED               = (0x00);
-
-    const uint8_t OFFCAL_ENABLED                = (0x02);
-    const uint8_t OFFCAL_DISABLED               = (0x00);
-
-    const uint8_t GAINCAL_ENABLED               = (0x01);
-    const uint8_t GAINCAL_DISABLED              = (0x00);
-};
-
-/**
- * @brief Masks for the IRQ register to check set bit fields
-*/
-namespace MCP3564R_IRQ_REG_MASK {
-    const uint8_t DR_STATUS     = (0x40);
-    const uint8_t CRCCFG_STATUS = (0x20);
-    const uint8_t POR_STATUS    = (0x10);
-    const uint8_t IRQ_MODE_1    = (0x08);
-    const uint8_t IRQ_MODE_0    = (0x04);
-    const uint8_t EN_FASTCMD    = (0x02);
-    const uint8_t EN_STP        = (0x01);
-};
-
-/**
- * @brief Settable bits in the IRQ register
-*/
-namespace MCP3564R_IRQ_REG {
-    const uint8_t DEFAULT           = (0x03);
-
-    const uint8_t DISABLE_STP       = (0x00);
-    const uint8_t ENABLE_STP        = (0x01);
-    const uint8_t DISABLE_FASTCMD   = (0x00);
-    const uint8_t ENABLE_FASTCMD    = (0x02);
-    const uint8_t IRQ_MODE_HI_Z     = (0x00);
-    const uint8_t IRQ_MODE_HIGH     = (0x04);
-    const uint8_t IRQ_MODE_IRQ_OUT  = (0x00);
-    const uint8_t IRQ_MODE_MDAT_OUT = (0x08);
-};
-
-/**
- * @brief Masks for the MUX register
-*/
-namespace MCP3564R_MUX_REG_MASK {
-    const uint8_t MUX_VIN_P = (0xF0);
-    const uint8_t MUX_VIN_N = (0x0F);
+ * @brief Status byte, clocked out on SDO while the command byte is clocked in
+*/
+const uint8_t MCP3564R_STATUS_DR = (0x04);     // Data ready, active low, cleared by reading ADCDATA
+const uint8_t MCP3564R_STATUS_CRCCFG = (0x02); // CRC error on the configuration registers, active low
+const uint8_t MCP3564R_STATUS_POR = (0x01);    // Power-on reset happened, active low
+
+/**
+ * @brief Scan channel IDs, the bit in SCAN CHANNELS and the ID data format 3 tags a conversion with.
+ *        A scan converts the enabled channels in this order
+*/
+enum MCP3564R_SCAN_CHANNEL : uint8_t {
+    SCAN_CH_0 = 0,          // Single ended CH0 to CH7
+    SCAN_CH_1,
+    SCAN_CH_2,
+    SCAN_CH_3,
+    SCAN_CH_4,
+    SCAN_CH_5,
+    SCAN_CH_6,
+    SCAN_CH_7,
+    SCAN_DIFF_A,            // CH0 - CH1
+    SCAN_DIFF_B,            // CH2 - CH3
+    SCAN_DIFF_C,            // CH4 - CH5
+    SCAN_DIFF_D,            // CH6 - CH7
+    SCAN_TEMP,              // Internal temperature diode
+    SCAN_AVDD,              // AVDD / 3 against AGND
+    SCAN_VCM,               // Internal common mode voltage
+    SCAN_OFFSET,            // Shorted inputs, the ADC offset
+    SCAN_CHANNEL_COUNT,
 };
 
 /**
@@ -267,43 +116,41 @@ enum class MCP3564R_MUX_VIN : uint8_t {
 };
 
 /**
- * @brief Mask for the SCAN register
+ * @brief Fields of each register. Values are the datasheet bit patterns, which are also the
+ *        numbers the MCP3564R setters take
 */
-namespace MCP3564R_SCAN_REG_MASK {
-    const uint8_t DLY = (0xE0);
-};
+namespace MCP3564R_FIELD {
+    typedef Field<MCP3564R_REG::CONFIG0, 7, 1, bool> VREF_SEL;         // 1: internal, 0: external
+    typedef Field<MCP3564R_REG::CONFIG0, 6, 1, bool> CONFIG;           // 1: normal, 0: partial shutdown
+    typedef Field<MCP3564R_REG::CONFIG0, 4, 2> CLK_SEL;                // 0/1: external, 2: internal, 3: internal with output
+    typedef Field<MCP3564R_REG::CONFIG0, 2, 2> CS_SEL;                 // 0: none, 1: 0.9 uA, 2: 3.7 uA, 3: 15 uA
+    typedef Field<MCP3564R_REG::CONFIG0, 0, 2> ADC_MODE;               // 0/1: shutdown, 2: standby, 3: conversion
 
-/**
- * @brief Map of SCAN register - SCAN register is total 24 bits split into 8 bits setting, 16 bits channel select
-*/
-namespace MCP3564R_SCAN_REG {
-    // MSB of SCAN register
-    const uint8_t DEFAULT_MSB   = (0x00);
-    const uint8_t DMCLK_0       = (0x00);
-    const uint8_t DMCLK_8       = (0x20);
-    const uint8_t DMCLK_16      = (0x40);
-    const uint8_t DMCLK_32      = (0x60);
-    const uint8_t DMCLK_64      = (0x80);
-    const uint8_t DMCLK_128     = (0xA0);
-    const uint8_t DMCLK_256     = (0xC0);
-    const uint8_t DMCLK_512     = (0xE0);
+    typedef Field<MCP3564R_REG::CONFIG1, 6, 2> PRE;                    // AMCLK = MCLK / 2^PRE
+    typedef Field<MCP3564R_REG::CONFIG1, 2, 4> OSR;                    // 0: 32 ... 15: 98304
+
+    typedef Field<MCP3564R_REG::CONFIG2, 6, 2> BOOST;                  // 0: x0.5, 1: x0.66, 2: x1, 3: x2
+    typedef Field<MCP3564R_REG::CONFIG2, 3, 3> GAIN;                   // 0: x1/3, 1: x1 ... 7: x64
+    typedef Field<MCP3564R_REG::CONFIG2, 2, 1, bool> AZ_MUX;
+    typedef Field<MCP3564R_REG::CONFIG2, 1, 1, bool> AZ_REF;
+
+    typedef Field<MCP3564R_REG::CONFIG3, 6, 2> CONV_MODE;              // 0/1: one shot shutdown, 2: one shot standby, 3: continuous
+    typedef Field<MCP3564R_REG::CONFIG3, 4, 2> DATA_FORMAT;
+    typedef Field<MCP3564R_REG::CONFIG3, 3, 1, bool> CRC_FORMAT;       // 1: CRC-16 with 16 trailing zeros
+    typedef Field<MCP3564R_REG::CONFIG3, 2, 1, bool> EN_CRCCOM;
+    typedef Field<MCP3564R_REG::CONFIG3, 1, 1, bool> EN_OFFCAL;
+    typedef Field<MCP3564R_REG::CONFIG3, 0, 1, bool> EN_GAINCAL;
+
+    typedef Field<MCP3564R_REG::IRQ, 3, 1, bool> IRQ_MODE_MDAT;        // 1: MDAT output, 0: IRQ output
+    typedef Field<MCP3564R_REG::IRQ, 2, 1, bool> IRQ_MODE_HIGH;        // Inactive state, 1: logic high, 0: high-z
+    typedef Field<MCP3564R_REG::IRQ, 1, 1, bool> EN_FASTCMD;
+    typedef Field<MCP3564R_REG::IRQ, 0, 1, bool> EN_STP;
 
-    // LSB of SCAN register
-    const uint16_t DEFAULT_LSB  = (0x0000);
-    const uint16_t SINGLE_CH_0  = (0x0001);
-    const uint16_t SINGLE_CH_1  = (0x0002);
-    const uint16_t SINGLE_CH_2  = (0x0004);
-    const uint16_t SINGLE_CH_3  = (0x0008);
-    const uint16_t SINGLE_CH_4  = (0x0010);
-    const uint16_t SINGLE_CH_5  = (0x0020);
-    const uint16_t SINGLE_CH_6  = (0x0040);
-    const uint16_t SINGLE_CH_7  = (0x0080);
-    const uint16_t DIFF_CH_A    = (0x0100);
-    const uint16_t DIFF_CH_B    = (0x0200);
-    const uint16_t DIFF_CH_C    = (0x0400);
-    const uint16_t DIFF_CH_D    = (0x0800);
-    const uint16_t TEMP         = (0x1000);
-    const uint16_t AVDD         = (0x2000);
-    const uint16_t VCM          = (0x4000);
-    const uint16_t OFFSET       = (0x8000);
-};
\ No newline at end of file
+    typedef Field<MCP3564R_REG::MUX, 4, 4, MCP3564R_MUX_VIN> MUX_VIN_P;
+    typedef Field<MCP3564R_REG::MUX, 0, 4, MCP3564R_MUX_VIN> MUX_VIN_N;
+
+    typedef Field<MCP3564R_REG::SCAN, 21, 3> DLY;                      // 0: none, 1: 8 ... 7: 512 DMCLK periods
+    typedef Field<MCP3564R_REG::SCAN, 0, 16, uint16_t> CHANNELS;       // Bit n is channel n, see enable_scan_channel
+
+    typedef Field<MCP3564R_REG::LOCK, 0, 8> LOCK;
+};
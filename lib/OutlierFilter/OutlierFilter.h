@@ -0,0 +1,173 @@
+/*
+ *  Title: OutlierFilter.h
+ *  Description: Streaming median and Hampel filters with O(log w) updates and no allocation
+ *  Author: Tinna Osk Traustadottir
+ */
+#pragma once
+#include <stdint.h>
+#include <math.h>
+
+/// @brief Running median over the last W samples. Samples are kept in a double heap around the
+///        median, a max-heap below it and a min-heap above it, with an index from each sample
+///        to its heap position so the oldest sample can be replaced in O(log W)
+/// @tparam W Window length, odd, 3 to 255
+template<uint8_t W>
+class MedianFilter {
+public:
+    static_assert(W % 2 == 1, "Window length must be odd");
+    static_assert(W >= 3, "Window must hold at least three samples");
+
+    MedianFilter() {
+        reset();
+    }
+
+    /// @brief Add a sample, replacing the oldest one once the window is full
+    /// @param x The sample
+    /// @return Median of the window
+    float add(float x) {
+        bool is_new = _count < W;
+        int16_t p = _pos[_idx];
+        float old = _data[_idx];
+        _data[_idx] = x;
+        _idx = (_idx + 1) % W;
+        if(is_new) _count++;
+
+        if(p > 0) {
+            // Slot is in the min-heap
+            if(!is_new && old < x) minSortDown(p * 2);
+            else if(minSortUp(p)) maxSortDown(-1);
+        } else if(p < 0) {
+            // Slot is in the max-heap
+            if(!is_new && x < old) maxSortDown(p * 2);
+            else if(maxSortUp(p)) minSortDown(1);
+        } else {
+            // Slot is the median
+            if(maxCount() > 0) maxSortDown(-1);
+            if(minCount() > 0) minSortDown(1);
+        }
+        return median();
+    }
+
+    /// @brief Median of the window, the mean of the two middle samples while the window holds an
+    ///        even count, 0 while it is empty
+    float median(void) const {
+        if(_count == 0) return 0.0f;
+        float v = _data[heap(0)];
+        if((_count & 1) == 0) v = (v + _data[heap(-1)]) / 2.0f;
+        return v;
+    }
+
+    uint8_t count(void) const { return _count; };
+
+    /// @brief Clear the window
+    void reset(void) {
+        _count = 0;
+        _idx = 0;
+        for(int16_t i = 0; i < W; i++) {
+            _data[i] = 0.0f;
+            _pos[i] = ((i + 1) / 2) * ((i & 1) ? -1 : 1);
+            heap(_pos[i]) = i;
+        }
+    }
+
+private:
+    float _data[W];         // Samples in arrival order, a ring buffer
+    int16_t _pos[W];        // Heap position of each sample, negative in the max-heap, 0 for the median
+    int16_t _heap[W];       // Sample index at each heap position, offset by W / 2
+    uint8_t _count;
+    uint8_t _idx;           // Slot the next sample goes into
+
+    int16_t& heap(int16_t i) { return _heap[i + W / 2]; };
+    int16_t heap(int16_t i) const { return _heap[i + W / 2]; };
+    // Capped at W / 2 though _count never passes W, so the compiler can bound every heap position
+    int16_t minCount(void) const { return _count > 1 ? ((_count - 1) / 2 < W / 2 ? (_count - 1) / 2 : W / 2) : 0; };
+    int16_t maxCount(void) const { return _count / 2 < W / 2 ? _count / 2 : W / 2; };
+
+    bool less(int16_t i, int16_t j) const { return _data[heap(i)] < _data[heap(j)]; };
+
+    void exchange(int16_t i, int16_t j) {
+        int16_t t = heap(i);
+        heap(i) = heap(j);
+        heap(j) = t;
+        _pos[heap(i)] = i;
+        _pos[heap(j)] = j;
+    }
+
+    // Swaps i and j if i is less than j, returns true if swapped
+    bool compareExchange(int16_t i, int16_t j) {
+        if(!less(i, j)) return false;
+        exchange(i, j);
+        return true;
+    }
+
+    // Sorts down starting at position i. Positions 1 and -1 are the only children of the median
+    void minSortDown(int16_t i) {
+        for(; i <= minCount(); i *= 2) {
+            if(i > 1 && i < minCount() && less(i + 1, i)) i++;
+            if(!compareExchange(i, i / 2)) break;
+        }
+    }
+
+    void maxSortDown(int16_t i) {
+        for(; i >= -maxCount(); i *= 2) {
+            if(i < -1 && i > -maxCount() && less(i, i - 1)) i--;
+            if(!compareExchange(i / 2, i)) break;
+        }
+    }
+
+    // Returns true if the sample moved all the way up to the median
+    bool minSortUp(int16_t i) {
+        while(i > 0 && compareExchange(i, i / 2)) i /= 2;
+        return i == 0;
+    }
+
+    bool maxSortUp(int16_t i) {
+        while(i < 0 && compareExchange(i / 2, i)) i /= 2;
+        return i == 0;
+    }
+};
+
+/// @brief Hampel filter, replaces a sample with the window median when it is more than
+///        threshold scaled MADs away from it. The MAD is the running median of each sample's
+///        absolute deviation from the median at the time it arrived, which keeps the update
+///        at O(log W) instead of recomputing every deviation against the current median
+/// @tparam W Window length, odd, 3 to 255
+template<uint8_t W>
+class HampelFilter {
+public:
+    /// @brief Construct a new HampelFilter object
+    /// @param threshold Number of scaled MADs a sample may deviate before it is rejected, 3 is typical
+    HampelFilter(float threshold = 3.0f) : _threshold(threshold) {};
+
+    /// @brief Filter a sample
+    /// @param x The sample
+    /// @return The sample, or the window median if the sample was rejected
+    float filter(float x) {
+        float med = _median.add(x);
+        float mad = _deviation.add(fabsf(x - med));
+        // 1.4826 scales the MAD to a standard deviation for normally distributed data
+        _rejected = (_median.count() >= 3) && (fabsf(x - med) > _threshold * 1.4826f * mad);
+        if(_rejected) {
+            _rejections++;
+            return med;
+        }
+        return x;
+    }
+
+    bool rejected(void) const { return _rejected; };
+    uint32_t rejections(void) const { return _rejections; };
+    float median(void) const { return _median.median(); };
+
+    void reset(void) {
+        _median.reset();
+        _deviation.reset();
+        _rejected = false;
+    }
+
+private:
+    MedianFilter<W> _median;
+    MedianFilter<W> _deviation;
+    float _threshold;
+    bool _rejected = false;
+    uint32_t _rejections = 0;
+};
@@ -0,0 +1,129 @@
+/*
+ *  Title: Pipeline.h
+ *  Description: Sensor pipelines composed at compile time from stage types. Stages are
+ *               called through fold expressions, no virtual calls and no heap
+ *  Author: Tinna Osk Traustadottir
+ */
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <tuple>
+#include <OutlierFilter.h>
+
+/// @brief One acquisition travelling down a node. Sized by the node, lives on the stack
+template<uint8_t Channels>
+struct Pipeline_SAMPLE {
+    static const uint8_t channels = Channels;
+    uint32_t tick;          // Sample clock tick the acquisition runs in
+    uint64_t timestamp;     // time_us_64() when the bus read completed
+    int32_t raw[Channels];  // Raw readings, for stages that decode them
+    float values[Channels];
+};
+
+/// @brief A sensor node: a chain of stages run in order on one sample. A stage is any type with
+///        bool process(Sample& sample, Context& context)
+///        Returning false ends the chain for this tick (not due, no data, read failed)
+/// @tparam Sample Pipeline_SAMPLE sized for the node
+/// @tparam Stages Stage types, typically acquire, decode, calibrate, filter and sinks
+template<typename Sample, typename... Stages>
+class PipelineNode {
+public:
+    template<typename Context>
+    bool run(Context& context, uint32_t tick) {
+        Sample sample;
+        sample.tick = tick;
+        return std::apply([&](Stages&... stage) { return (stage.process(sample, context) && ...); }, _stages);
+    }
+
+    template<size_t I>
+    auto& stage(void) { return std::get<I>(_stages); }
+
+private:
+    std::tuple<Stages...> _stages;
+};
+
+/// @brief Every node of the device, run one after the other each tick. Adding a sensor is
+///        adding its node type to the list
+/// @tparam Nodes PipelineNode types
+template<typename... Nodes>
+class Pipeline {
+public:
+    template<typename Context>
+    void run(Context& context, uint32_t tick) {
+        std::apply([&](Nodes&... node) { (node.run(context, tick), ...); }, _nodes);
+    }
+
+    template<size_t I>
+    auto& node(void) { return std::get<I>(_nodes); }
+
+private:
+    std::tuple<Nodes...> _nodes;
+};
+
+// Common stages. Sinks and gates reach the rest of the application through the context, which
+// has to provide the members they use: resampler, alerts, adaptive and adaptive_sampling
+
+/// @brief Convert a raw reading to float, for calibrate stages to scale
+template<uint8_t Channel>
+struct DecodeStage {
+    template<typename Sample, typename Context>
+    bool process(Sample& sample, Context&) {
+        sample.values[Channel] = (float)sample.raw[Channel];
+        return true;
+    }
+};
+
+/// @brief Hampel outlier rejection on one channel
+/// @tparam Window Window length, odd
+/// @tparam ThresholdTenths Rejection threshold in tenths of a scaled MAD, 30 for 3.0
+template<uint8_t Channel, uint8_t Window, uint8_t ThresholdTenths>
+struct HampelStage {
+    HampelFilter<Window> filter{ThresholdTenths / 10.0f};
+
+    template<typename Sample, typename Context>
+    bool process(Sample& sample, Context&) {
+        sample.values[Channel] = filter.filter(sample.values[Channel]);
+        return true;
+    }
+};
+
+/// @brief Check one channel against the alert rules of a metric, put it before the slower sinks
+template<uint8_t Channel, uint8_t Metric>
+struct AlertSink {
+    template<typename Sample, typename Context>
+    bool process(Sample& sample, Context& context) {
+        context.alerts.evaluate(Metric, sample.values[Channel], sample.timestamp);
+        return true;
+    }
+};
+
+/// @brief Push channels to the resampler, channel i to the i-th metric
+template<uint8_t... Metrics>
+struct ResamplerSink {
+    template<typename Sample, typename Context>
+    bool process(Sample& sample, Context& context) {
+        static_assert(sizeof...(Metrics) <= Sample::channels, "More metrics than channels");
+        uint8_t channel = 0;
+        (context.resampler.push(Metrics, sample.timestamp, sample.values[channel++]), ...);
+        return true;
+    }
+};
+
+/// @brief Stop the chain unless the adaptive sampler says the stream is due this tick
+template<uint8_t Stream>
+struct AdaptiveGate {
+    template<typename Sample, typename Context>
+    bool process(Sample& sample, Context& context) {
+        return !context.adaptive_sampling || context.adaptive.due(Stream, sample.tick);
+    }
+};
+
+/// @brief Feed one channel to the adaptive sampler as the rate of change of a stream
+template<uint8_t Channel, uint8_t Stream>
+struct AdaptiveSink {
+    template<typename Sample, typename Context>
+    bool process(Sample& sample, Context& context) {
+        if(context.adaptive_sampling) context.adaptive.update(Stream, sample.values[Channel], sample.timestamp, sample.tick);
+        return true;
+    }
+};
@@ -0,0 +1,139 @@
+/*
+ *  Title: PoolList.h
+ *  Description: Fixed capacity doubly linked list backed by a static node pool. Push and pop at
+ *               both ends are O(1), nodes are recycled through a free list, nothing is allocated
+ *               from the heap. Meant for buffering pending samples
+ *  Author: Tinna Osk Traustadottir
+ */
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+
+/// @brief Deque of up to Capacity elements
+/// @tparam T Element type, copied in and out
+/// @tparam Capacity Number of nodes in the pool
+template<typename T, uint16_t Capacity>
+class PoolList {
+public:
+    struct Node {
+        T data;
+        Node* prev;
+        Node* next;
+    };
+
+    PoolList() { clear(); }
+
+    /// @brief Remove every element and put all nodes back in the pool
+    void clear(void) {
+        _head = nullptr;
+        _tail = nullptr;
+        _size = 0;
+        _free = &_pool[0];
+        for(uint16_t i = 0; i < Capacity; i++) {
+            _pool[i].next = (i + 1 < Capacity) ? &_pool[i + 1] : nullptr;
+        }
+    }
+
+    /// @brief Add an element in front of the first one
+    /// @param data 
+    ///        The element
+    /// @return True if added, false if the pool is exhausted
+    bool pushFront(const T& data) {
+        Node* node = take(data);
+        if(node == nullptr) return false;
+        node->prev = nullptr;
+        node->next = _head;
+        if(_head != nullptr) _head->prev = node;
+        else _tail = node;
+        _head = node;
+        return true;
+    }
+
+    /// @brief Add an element after the last one
+    /// @param data 
+    ///        The element
+    /// @return True if added, false if the pool is exhausted
+    bool pushBack(const T& data) {
+        Node* node = take(data);
+        if(node == nullptr) return false;
+        node->next = nullptr;
+        node->prev = _tail;
+        if(_tail != nullptr) _tail->next = node;
+        else _head = node;
+        _tail = node;
+        return true;
+    }
+
+    /// @brief Remove the first element
+    /// @param data 
+    ///        Output, the element, may be nullptr to discard it
+    /// @return True if an element was removed, false if the list is empty
+    bool popFront(T* data = nullptr) {
+        Node* node = _head;
+        if(node == nullptr) return false;
+        _head = node->next;
+        if(_head != nullptr) _head->prev = nullptr;
+        else _tail = nullptr;
+        give(node, data);
+        return true;
+    }
+
+    /// @brief Remove the last element
+    /// @param data 
+    ///        Output, the element, may be nullptr to discard it
+    /// @return True if an element was removed, false if the list is empty
+    bool popBack(T* data = nullptr) {
+        Node* node = _tail;
+        if(node == nullptr) return false;
+        _tail = node->prev;
+        if(_tail != nullptr) _tail->next = nullptr;
+        else _head = nullptr;
+        give(node, data);
+        return true;
+    }
+
+    /// @brief Unlink a node found by walking the list, for dropping an element from the middle
+    /// @param node 
+    ///        A node of this list
+    void remove(Node* node) {
+        if(node->prev != nullptr) node->prev->next = node->next;
+        else _head = node->next;
+        if(node->next != nullptr) node->next->prev = node->prev;
+        else _tail = node->prev;
+        give(node, nullptr);
+    }
+
+    // Walk with for(auto* n = list.first(); n != nullptr; n = n->next)
+    Node* first(void) const { return _head; }
+    Node* last(void) const { return _tail; }
+    T& front(void) { return _head->data; }
+    T& back(void) { return _tail->data; }
+
+    uint16_t size(void) const { return _size; }
+    bool empty(void) const { return _size == 0; }
+    bool full(void) const { return _free == nullptr; }
+    static constexpr uint16_t capacity(void) { return Capacity; }
+
+private:
+    Node _pool[Capacity];
+    Node* _free;            // Free nodes, singly linked through next
+    Node* _head;
+    Node* _tail;
+    uint16_t _size;
+
+    Node* take(const T& data) {
+        Node* node = _free;
+        if(node == nullptr) return nullptr;
+        _free = node->next;
+        node->data = data;
+        _size++;
+        return node;
+    }
+
+    void give(Node* node, T* data) {
+        if(data != nullptr) *data = node->data;
+        node->next = _free;
+        _free = node;
+        _size--;
+    }
+};
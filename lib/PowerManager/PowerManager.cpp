@@ -0,0 +1,127 @@
+/*
+ *  Title: PowerManager.cpp
+ *  Description: Clock gated sleep between samples and energy accounting per load
+ *  Author: Tinna Osk Traustadottir
+ */
+#include "PowerManager.h"
+#include <hardware/structs/clocks.h>
+#include <hardware/structs/scb.h>
+
+/// @brief Construct a new PowerManager object. The MCU itself is always the first load
+PowerManager::PowerManager() {
+    _start_us = time_us_64();
+    _mcu = addLoad("MCU", POWER_MCU_ACTIVE_MA);
+}
+
+/// @brief Gate every clock that isn't needed while the core waits for an interrupt. After
+///        this every __wfe()/__wfi(), including the one in SampleClock::wait(), is a deep
+///        sleep that the timer alarm wakes up from. Dormant mode would save more, but it
+///        stops the crystal and with it the USB connection and the hardware timer
+/// @param keep_usb 
+///        True to keep USB clocked so the host stays connected
+void PowerManager::enableClockGating(bool keep_usb) {
+    clocks_hw->sleep_en0 = CLOCKS_SLEEP_EN0_CLK_SYS_SRAM3_BITS |
+                           CLOCKS_SLEEP_EN0_CLK_SYS_SRAM2_BITS |
+                           CLOCKS_SLEEP_EN0_CLK_SYS_SRAM1_BITS |
+                           CLOCKS_SLEEP_EN0_CLK_SYS_SRAM0_BITS |
+                           CLOCKS_SLEEP_EN0_CLK_SYS_PLL_SYS_BITS |
+                           CLOCKS_SLEEP_EN0_CLK_SYS_BUSFABRIC_BITS |
+                           CLOCKS_SLEEP_EN0_CLK_SYS_BUSCTRL_BITS |
+                           CLOCKS_SLEEP_EN0_CLK_SYS_CLOCKS_BITS |
+                           (keep_usb ? CLOCKS_SLEEP_EN0_CLK_SYS_PLL_USB_BITS : 0);
+    clocks_hw->sleep_en1 = CLOCKS_SLEEP_EN1_CLK_SYS_XIP_BITS |
+                           CLOCKS_SLEEP_EN1_CLK_SYS_TIMER_BITS |
+                           CLOCKS_SLEEP_EN1_CLK_SYS_WATCHDOG_BITS | // Generates the timer tick
+                           CLOCKS_SLEEP_EN1_CLK_SYS_SRAM4_BITS |
+                           CLOCKS_SLEEP_EN1_CLK_SYS_SRAM5_BITS |
+                           CLOCKS_SLEEP_EN1_CLK_SYS_XOSC_BITS |
+                           (keep_usb ? (CLOCKS_SLEEP_EN1_CLK_SYS_USBCTRL_BITS | CLOCKS_SLEEP_EN1_CLK_USB_USBCTRL_BITS) : 0);
+    scb_hw->scr |= M0PLUS_SCR_SLEEPDEEP_BITS;
+}
+
+/// @brief Keep every clock running while the core sleeps, the reset state
+void PowerManager::disableClockGating(void) {
+    scb_hw->scr &= ~M0PLUS_SCR_SLEEPDEEP_BITS;
+    clocks_hw->sleep_en0 = 0xFFFFFFFF;
+    clocks_hw->sleep_en1 = 0xFFFFFFFF;
+}
+
+/// @brief Add a load to the energy accounting
+/// @param name 
+///        Name used in reports
+/// @param current_ma 
+///        Present current draw in mA
+/// @return Index of the load, or -1 if all loads are taken
+int8_t PowerManager::addLoad(const char* name, float current_ma) {
+    if(_load_count >= POWER_MAX_LOADS) return -1;
+    PowerManager_LOAD* l = &_loads[_load_count];
+    l->name = name;
+    l->current_ma = current_ma;
+    l->since_us = time_us_64();
+    l->charge_mc = 0.0;
+    return _load_count++;
+}
+
+/// @brief Change the current draw of a load, for example when a sensor changes mode
+/// @param load 
+///        Index returned by addLoad
+/// @param current_ma 
+///        New current draw in mA
+void PowerManager::setLoad(int8_t load, float current_ma) {
+    if(load < 0 || load >= _load_count) return;
+    account(&_loads[load], time_us_64());
+    _loads[load].current_ma = current_ma;
+}
+
+/// @brief Mark the start of a sleep, call right before any wait, for the next sample or between ticks
+void PowerManager::beginSleep(void) {
+    _sleep_start_us = time_us_64();
+    setLoad(_mcu, POWER_MCU_SLEEP_MA);
+}
+
+/// @brief Mark the end of a sleep, call right after waking up
+void PowerManager::endSleep(void) {
+    _sleep_us += time_us_64() - _sleep_start_us;
+    setLoad(_mcu, POWER_MCU_ACTIVE_MA);
+}
+
+/// @brief Get the energy budget since the last reset
+/// @param budget 
+///        Pointer to a struct where the budget will be inserted
+void PowerManager::getBudget(PowerManager_BUDGET* budget) {
+    uint64_t now = time_us_64();
+    double charge = 0.0;
+    for(uint8_t i = 0; i < _load_count; i++) {
+        account(&_loads[i], now);
+        charge += _loads[i].charge_mc;
+    }
+    uint64_t elapsed = now - _start_us;
+    budget->sleep_us = _sleep_us;
+    budget->active_us = elapsed - _sleep_us;
+    budget->samples = _samples;
+    budget->energy_mj = (float)(charge * POWER_SUPPLY_V);
+    budget->energy_per_sample_mj = (_samples > 0) ? budget->energy_mj / _samples : 0.0f;
+    budget->average_ma = (elapsed > 0) ? (float)(charge / (elapsed / 1e6)) : 0.0f;
+}
+
+/// @brief Clear the accumulated time, charge and sample count
+void PowerManager::resetBudget(void) {
+    uint64_t now = time_us_64();
+    for(uint8_t i = 0; i < _load_count; i++) {
+        _loads[i].since_us = now;
+        _loads[i].charge_mc = 0.0;
+    }
+    _start_us = now;
+    _sleep_us = 0;
+    _samples = 0;
+}
+
+/// @brief Add the charge drawn by a load since it was last accounted
+/// @param l 
+///        The load
+/// @param now 
+///        Current time in microseconds since boot
+void PowerManager::account(PowerManager_LOAD* l, uint64_t now) {
+    l->charge_mc += l->current_ma * (double)(now - l->since_us) / 1e6;
+    l->since_us = now;
+}
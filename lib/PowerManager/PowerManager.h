@@ -0,0 +1,81 @@
+/*
+ *  Title: PowerManager.h
+ *  Description: Clock gated sleep between samples and energy accounting per load
+ *  Author: Tinna Osk Traustadottir
+ */
+#pragma once
+#include <pico/stdlib.h>
+
+const uint8_t POWER_MAX_LOADS = 8;
+const float POWER_SUPPLY_V = 3.3f;
+
+// Typical supply currents in mA, from the datasheets. Used for the energy estimate only
+const float POWER_MCU_ACTIVE_MA = 25.0f;        // RP2040 at 125 MHz running from flash
+const float POWER_MCU_SLEEP_MA = 2.0f;          // RP2040 in WFE with unused clocks gated, USB kept alive
+const float POWER_SEN55_PM_MA = 70.0f;          // SEN55 in measurement mode, fan running
+const float POWER_SEN55_RHT_MA = 6.5f;          // SEN55 in RHT/gas only mode
+const float POWER_SEN55_IDLE_MA = 2.6f;         // SEN55 idle
+const float POWER_SCD30_2S_MA = 19.0f;          // SCD30 measuring every 2 s
+const float POWER_SCD30_30S_MA = 6.5f;          // SCD30 measuring every 30 s
+const float POWER_ANALOG_MA = 1.5f;             // LMP91000 and MCP3564R converting
+
+/// @brief SCD30 supply current at any measurement interval, modelled as a fixed idle current
+///        plus a fixed charge per measurement fitted to the 2 s and 30 s figures
+/// @param interval_s 
+///        Measurement interval in seconds
+/// @return Average current in mA
+inline float powerScd30Ma(uint16_t interval_s) {
+    const float per_measurement_mc = (POWER_SCD30_2S_MA - POWER_SCD30_30S_MA) / (1.0f / 2.0f - 1.0f / 30.0f);
+    const float idle_ma = POWER_SCD30_2S_MA - per_measurement_mc / 2.0f;
+    return idle_ma + per_measurement_mc / (float)interval_s;
+}
+
+/// @brief Accumulated charge of one load
+struct PowerManager_LOAD {
+    const char* name;
+    float current_ma;       // Present current draw
+    uint64_t since_us;      // When current_ma was last changed or accounted
+    double charge_mc;       // Charge drawn since the last reset, in millicoulomb
+};
+
+/// @brief Active and sleep time of the MCU and the resulting energy per sample
+struct PowerManager_BUDGET {
+    uint64_t active_us;
+    uint64_t sleep_us;
+    uint32_t samples;
+    float energy_mj;            // Energy of every load since the last reset
+    float energy_per_sample_mj;
+    float average_ma;           // Average total current
+};
+
+class PowerManager {
+public:
+    PowerManager();
+
+    void enableClockGating(bool keep_usb);
+    void disableClockGating(void);
+
+    int8_t addLoad(const char* name, float current_ma);
+    void setLoad(int8_t load, float current_ma);
+
+    void beginSleep(void);
+    void endSleep(void);
+    void countSample(void) { _samples++; };
+
+    void getBudget(PowerManager_BUDGET* budget);
+    const PowerManager_LOAD* load(int8_t load) const { return &_loads[load]; };
+    uint8_t loads(void) const { return _load_count; };
+    void resetBudget(void);
+
+private:
+    PowerManager_LOAD _loads[POWER_MAX_LOADS];
+    uint8_t _load_count = 0;
+    int8_t _mcu;                // Load index of the MCU itself
+
+    uint64_t _start_us;
+    uint64_t _sleep_start_us = 0;
+    uint64_t _sleep_us = 0;
+    uint32_t _samples = 0;
+
+    void account(PowerManager_LOAD* l, uint64_t now);
+};
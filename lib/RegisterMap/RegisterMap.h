@@ -0,0 +1,158 @@
+/*
+ *  Title: RegisterMap.h
+ *  Description: Registers and bit fields as types. Masks and shifts are compile-time constants and
+ *               updates of several fields are folded into one write per register
+ *  Author: Tinna Osk Traustadottir
+ */
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+enum class REG_ACCESS : uint8_t {
+    Read_write = 0,
+    Read_only,
+};
+
+/// @brief A device register
+/// @tparam Address Register address on the device
+/// @tparam Bytes Register width in bytes, sent most significant byte first
+/// @tparam Access Read-only registers can't be modified
+/// @tparam ReservedMask Bits that aren't fields
+/// @tparam ReservedValue What the reserved bits must be written as
+template<uint8_t Address, uint8_t Bytes = 1, REG_ACCESS Access = REG_ACCESS::Read_write,
+         uint32_t ReservedMask = 0, uint32_t ReservedValue = 0>
+struct Register {
+    static constexpr uint8_t address = Address;
+    static constexpr uint8_t bytes = Bytes;
+    static constexpr REG_ACCESS access = Access;
+    static constexpr uint32_t mask = (Bytes >= 4) ? 0xFFFFFFFFu : ((1u << (8 * Bytes)) - 1);
+    static constexpr uint32_t reserved_mask = ReservedMask;
+    static constexpr uint32_t reserved_value = ReservedValue;
+    static_assert(Bytes >= 1 && Bytes <= 4, "Registers are 1 to 4 bytes");
+};
+
+/// @brief A bit field in a register. An object of the type is a value for the field, already
+///        shifted into place, e.g. LMP91_FIELD::TIA_GAIN(TIA_GAIN::Gain_350k)
+/// @tparam Reg The Register the field is in
+/// @tparam Offset Position of the least significant bit
+/// @tparam Width Number of bits
+/// @tparam T Value type, usually an enum class
+template<typename Reg, uint8_t Offset, uint8_t Width, typename T = uint8_t>
+struct Field {
+    typedef Reg reg;
+    typedef T type;
+    static constexpr uint8_t offset = Offset;
+    static constexpr uint8_t width = Width;
+    static constexpr uint32_t mask = ((Width >= 32) ? 0xFFFFFFFFu : ((1u << Width) - 1)) << Offset;
+    static_assert((mask & ~Reg::mask) == 0, "Field doesn't fit in its register");
+    static_assert((mask & Reg::reserved_mask) == 0, "Field overlaps reserved bits");
+
+    uint32_t bits;
+
+    constexpr explicit Field(T value) : bits(((uint32_t)value << Offset) & mask) {}
+    constexpr T value(void) const { return (T)(bits >> Offset); }
+
+    /// @brief Check that a value fits in the field before it gets truncated
+    static constexpr bool valid(T value) { return Width >= 32 || ((uint32_t)value >> Width) == 0; }
+    static constexpr T decode(uint32_t raw) { return (T)((raw & mask) >> Offset); }
+};
+
+/// @brief Register access for a driver. The driver derives from RegisterDevice<Driver>, makes it
+///        a friend and provides
+///        bool read_register(uint8_t address, uint8_t* data, uint8_t len)
+///        bool write_register(uint8_t address, uint8_t* data, uint8_t len)
+template<typename Device>
+class RegisterDevice {
+protected:
+    /// @brief Set any number of fields, in any registers. Fields are grouped per register at
+    ///        compile time and each register gets one write. A register is only read first when
+    ///        the fields don't cover all its bits
+    /// @return True if successful, false if a bus transfer failed
+    template<typename... Fields>
+    bool modify(Fields... fields) {
+        return modifyAll(std::index_sequence_for<Fields...>{}, std::tuple<Fields...>(fields...));
+    }
+
+    /// @brief Read one field
+    template<typename F>
+    bool read(typename F::type* value) {
+        uint32_t raw;
+        if(!readRegister<typename F::reg>(&raw)) return false;
+        *value = F::decode(raw);
+        return true;
+    }
+
+    template<typename Reg>
+    bool readRegister(uint32_t* raw) {
+        uint8_t buffer[Reg::bytes];
+        if(!static_cast<Device*>(this)->read_register(Reg::address, buffer, Reg::bytes)) return false;
+        uint32_t value = 0;
+        for(uint8_t i = 0; i < Reg::bytes; i++) value = (value << 8) | buffer[i];
+        *raw = value;
+        return true;
+    }
+
+    template<typename Reg>
+    bool writeRegister(uint32_t raw) {
+        static_assert(Reg::access == REG_ACCESS::Read_write, "Register is read-only");
+        uint8_t buffer[Reg::bytes];
+        for(uint8_t i = 0; i < Reg::bytes; i++) buffer[i] = (uint8_t)(raw >> (8 * (Reg::bytes - 1 - i)));
+        return static_cast<Device*>(this)->write_register(Reg::address, buffer, Reg::bytes);
+    }
+
+private:
+    template<size_t I, typename Tuple>
+    using RegisterOf = typename std::tuple_element_t<I, Tuple>::reg;
+
+    template<typename Reg, typename Tuple, size_t... J>
+    static constexpr uint32_t maskOf(std::index_sequence<J...>) {
+        return ((std::is_same_v<RegisterOf<J, Tuple>, Reg> ? std::tuple_element_t<J, Tuple>::mask : 0u) | ... | 0u);
+    }
+
+    template<typename Reg, typename Tuple, size_t... J>
+    static constexpr uint32_t maskSum(std::index_sequence<J...>) {
+        return ((std::is_same_v<RegisterOf<J, Tuple>, Reg> ? std::tuple_element_t<J, Tuple>::mask : 0u) ^ ... ^ 0u);
+    }
+
+    template<typename Reg, typename Tuple, size_t... J>
+    static uint32_t bitsOf(const Tuple& fields, std::index_sequence<J...>) {
+        return ((std::is_same_v<RegisterOf<J, Tuple>, Reg> ? std::get<J>(fields).bits : 0u) | ... | 0u);
+    }
+
+    /// @brief True if field I is the first field of its register, that field writes the register
+    template<size_t I, typename Tuple, size_t... J>
+    static constexpr bool firstOf(std::index_sequence<J...>) {
+        return !((J < I && std::is_same_v<RegisterOf<J, Tuple>, RegisterOf<I, Tuple>>) || ...);
+    }
+
+    template<size_t... I, typename Tuple>
+    bool modifyAll(std::index_sequence<I...> indices, const Tuple& fields) {
+        bool ok = true;
+        ((ok = ok && modifyRegister<I>(fields, indices)), ...);
+        return ok;
+    }
+
+    template<size_t I, typename Tuple, typename Indices>
+    bool modifyRegister(const Tuple& fields, Indices indices) {
+        if constexpr(!firstOf<I, Tuple>(Indices{})) {
+            return true;
+        } else {
+            typedef RegisterOf<I, Tuple> Reg;
+            constexpr uint32_t mask = maskOf<Reg, Tuple>(Indices{});
+            constexpr uint32_t writable = Reg::mask & ~Reg::reserved_mask;
+            static_assert(maskSum<Reg, Tuple>(Indices{}) == mask, "A field is given twice or fields overlap");
+
+            uint32_t raw;
+            if constexpr((mask & writable) == writable) {
+                raw = Reg::reserved_value;  // Every bit is known, skip the read
+            } else {
+                if(!readRegister<Reg>(&raw)) return false;
+                raw &= ~mask;
+            }
+            return writeRegister<Reg>(raw | bitsOf<Reg, Tuple>(fields, indices));
+        }
+    }
+};
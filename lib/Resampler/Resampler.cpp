@@ -0,0 +1,176 @@
+/*
+ *  Title: Resampler.cpp
+ *  Description: Aligns timestamped sensor streams with different native rates onto a common output grid
+ *  Author: Tinna Osk Traustadottir
+ */
+#include "Resampler.h"
+#include <string.h>
+
+/// @brief Construct a new Resampler object
+/// @param period_us 
+///        Time between output frames, in microseconds
+/// @param delay_us 
+///        How long after its frame time a frame is produced. Must be at least the native
+///        period of the slowest linearly interpolated channel, and shorter than
+///        (RESAMPLER_BINS - 1) * period_us
+Resampler::Resampler(uint32_t period_us, uint32_t delay_us) {
+    _period_us = period_us;
+    _delay_us = delay_us;
+    memset(_channel, 0, sizeof(_channel));
+}
+
+/// @brief Add a channel to the resampler
+/// @param mode 
+///        How the channel is reduced to one value per frame (see RESAMPLE_MODE)
+/// @param max_age_us 
+///        Oldest sample, relative to the frame time, that is still considered valid
+/// @return Index of the channel, or -1 if all channels are taken
+int8_t Resampler::addChannel(RESAMPLE_MODE mode, uint32_t max_age_us) {
+    if(_channels >= RESAMPLER_MAX_CHANNELS) return -1;
+    Channel_t* ch = &_channel[_channels];
+    ch->mode = mode;
+    ch->max_age_us = max_age_us;
+    ch->has_last = false;
+    for(uint8_t i = 0; i < RESAMPLER_BINS; i++) ch->bins[i].bin = -1;
+    return _channels++;
+}
+
+/// @brief Set the origin of the output grid. The first frame is one period after the epoch
+/// @param epoch_us 
+///        Grid origin in microseconds since boot, normally a sample clock tick
+void Resampler::start(uint64_t epoch_us) {
+    _epoch_us = epoch_us;
+    _next_bin = 1;
+    for(uint8_t c = 0; c < _channels; c++) {
+        _channel[c].has_last = false;
+        for(uint8_t i = 0; i < RESAMPLER_BINS; i++) _channel[c].bins[i].bin = -1;
+    }
+}
+
+/// @brief Add a sample to a channel. Samples on one channel must arrive in time order
+/// @param channel 
+///        Index returned by addChannel
+/// @param timestamp 
+///        Time the sample was taken, in microseconds since boot
+/// @param value 
+///        The sample
+void Resampler::push(uint8_t channel, uint64_t timestamp, float value) {
+    if(channel >= _channels) return;
+    Channel_t* ch = &_channel[channel];
+    if(ch->has_last && timestamp < ch->last_time) return; // Out of order
+
+    int64_t bin = binOf(timestamp);
+
+    // Every frame time between the previous sample and this one is now bracketed.
+    // Only the newest RESAMPLER_BINS frames can still be produced, so the loop is bounded
+    if(ch->has_last) {
+        int64_t first = binOf(ch->last_time);
+        if(first < bin - RESAMPLER_BINS) first = bin - RESAMPLER_BINS;
+        if(first < _next_bin) first = _next_bin;
+        for(int64_t b = first; b < bin; b++) {
+            Bin_t* s = slot(ch, b);
+            s->bracketed = true;
+            s->before_time = ch->last_time;
+            s->before_value = ch->last_value;
+            s->after_time = timestamp;
+            s->after_value = value;
+        }
+    }
+
+    if(bin >= _next_bin) {
+        Bin_t* s = slot(ch, bin);
+        s->sum += value;
+        s->count++;
+    }
+
+    ch->has_last = true;
+    ch->last_time = timestamp;
+    ch->last_value = value;
+}
+
+/// @brief Produce the next output frame if it is due. Runs in fixed time per frame
+/// @param now 
+///        Current time in microseconds since boot
+/// @param frame 
+///        Pointer to a struct where the frame will be inserted
+/// @return True if a frame was produced, false if the next frame is not due yet
+bool Resampler::next(uint64_t now, Resampler_FRAME* frame) {
+    uint64_t frame_time = _epoch_us + (uint64_t)_next_bin * _period_us;
+    if(now < frame_time + _delay_us) return false;
+
+    frame->timestamp = frame_time;
+    frame->valid = 0;
+    frame->channels = _channels;
+
+    for(uint8_t c = 0; c < _channels; c++) {
+        Channel_t* ch = &_channel[c];
+        Bin_t* s = &ch->bins[_next_bin % RESAMPLER_BINS];
+        bool in_bin = (s->bin == _next_bin);
+
+        // Latest sample at or before the frame time, used by hold and as the fallback
+        bool has_before = false;
+        uint64_t before_time = 0;
+        float before_value = 0.0f;
+        if(in_bin && s->bracketed) {
+            has_before = true;
+            before_time = s->before_time;
+            before_value = s->before_value;
+        } else if(ch->has_last && ch->last_time <= frame_time) {
+            has_before = true;
+            before_time = ch->last_time;
+            before_value = ch->last_value;
+        }
+
+        float value = before_value;
+        bool valid = has_before && (frame_time - before_time <= ch->max_age_us);
+
+        switch(ch->mode) {
+            case RESAMPLE_MODE::Sample_hold:
+                break;
+            case RESAMPLE_MODE::Linear:
+                if(valid && in_bin && s->bracketed && s->after_time > s->before_time) {
+                    float fraction = (float)(frame_time - s->before_time) / (float)(s->after_time - s->before_time);
+                    value = s->before_value + (s->after_value - s->before_value) * fraction;
+                }
+                break;
+            case RESAMPLE_MODE::Average:
+                if(in_bin && s->count > 0) {
+                    value = s->sum / s->count;
+                    valid = true;
+                }
+                break;
+        }
+
+        frame->values[c] = value;
+        if(valid) frame->valid |= (1u << c);
+        if(in_bin) s->bin = -1;
+    }
+
+    _next_bin++;
+    return true;
+}
+
+/// @brief Find the output frame a sample belongs to when averaging. Frame n
+///        covers the period (epoch + (n-1) * period, epoch + n * period]
+/// @param timestamp 
+///        Sample time in microseconds since boot
+/// @return Frame number
+int64_t Resampler::binOf(uint64_t timestamp) const {
+    if(timestamp <= _epoch_us) return 0;
+    return (int64_t)((timestamp - _epoch_us + _period_us - 1) / _period_us);
+}
+
+/// @brief Get the slot for a frame, clearing it if it still holds an older frame
+/// @param ch 
+///        The channel
+/// @param bin 
+///        Frame number
+/// @return Pointer to the slot
+Resampler::Bin_t* Resampler::slot(Channel_t* ch, int64_t bin) {
+    Bin_t* s = &ch->bins[bin % RESAMPLER_BINS];
+    if(s->bin != bin) {
+        memset(s, 0, sizeof(Bin_t));
+        s->bin = bin;
+    }
+    return s;
+}
@@ -0,0 +1,70 @@
+/*
+ *  Title: Resampler.h
+ *  Description: Aligns timestamped sensor streams with different native rates onto a common output grid
+ *  Author: Tinna Osk Traustadottir
+ */
+#pragma once
+#include <stdint.h>
+
+const uint8_t RESAMPLER_MAX_CHANNELS = 16;  // Channels one resampler can hold
+const uint8_t RESAMPLER_BINS = 4;           // Output frames tracked at once, the output delay must be shorter than RESAMPLER_BINS - 1 periods
+
+/// @brief How a channel is reduced to one value per output frame
+enum class RESAMPLE_MODE : uint8_t {
+    Sample_hold = 0,    // Latest sample at or before the frame time
+    Linear,             // Interpolated between the samples on either side of the frame time
+    Average,            // Mean of all samples in the period ending at the frame time
+};
+
+/// @brief One aligned output frame
+struct Resampler_FRAME {
+    uint64_t timestamp;                     // Frame time in microseconds since boot
+    float values[RESAMPLER_MAX_CHANNELS];   // One value per channel, in the order the channels were added
+    uint16_t valid;                         // Bit n is set if values[n] is valid
+    uint8_t channels;                       // Number of channels in the frame
+};
+
+class Resampler {
+public:
+    Resampler(uint32_t period_us, uint32_t delay_us);
+
+    int8_t addChannel(RESAMPLE_MODE mode, uint32_t max_age_us);
+    void start(uint64_t epoch_us);
+
+    void push(uint8_t channel, uint64_t timestamp, float value);
+    bool next(uint64_t now, Resampler_FRAME* frame);
+
+    uint32_t period(void) const { return _period_us; };
+
+private:
+    /// @brief State kept for one channel in one output bin
+    struct Bin_t {
+        int64_t bin;            // Output frame this slot belongs to, -1 when unused
+        float sum;              // Sum of samples inside the bin, for averaging
+        uint32_t count;         // Number of samples inside the bin
+        bool bracketed;         // True once samples on both sides of the frame time are known
+        uint64_t before_time;   // Latest sample at or before the frame time
+        float before_value;
+        uint64_t after_time;    // First sample after the frame time
+        float after_value;
+    };
+
+    struct Channel_t {
+        RESAMPLE_MODE mode;
+        uint32_t max_age_us;    // Samples older than this at the frame time are reported invalid
+        bool has_last;
+        uint64_t last_time;
+        float last_value;
+        Bin_t bins[RESAMPLER_BINS];
+    };
+
+    uint32_t _period_us;
+    uint32_t _delay_us;
+    uint64_t _epoch_us = 0;
+    int64_t _next_bin = 1;      // Next frame to produce, frame n is at _epoch_us + n * _period_us
+    uint8_t _channels = 0;
+    Channel_t _channel[RESAMPLER_MAX_CHANNELS];
+
+    int64_t binOf(uint64_t timestamp) const;
+    Bin_t* slot(Channel_t* ch, int64_t bin);
+};
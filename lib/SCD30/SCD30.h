@@ -5,32 +5,44 @@
  */
 #pragma once
 #include <hardware/i2c.h>
+#include "Sensirion.h"
 
 #define SCD30_DEFAULT_I2CADDR 0x61
-#define SCD30_CHIP_ID 0x60
-
-#define SCD30_WHOAMI 0xD100                             // Chip ID register
-#define SCD30_CMD_READ_MEASUREMENT 0x0300               // Main data register
-#define SCD30_CMD_CONTINUOUS_MEASUREMENT 0x0010         // Command to start continuous measurement
-#define SCD30_CMD_STOP_MEASUREMENTS 0x0104              // Command to stop measurements
-#define SCD30_CMD_SET_MEASUREMENT_INTERVAL 0x4600       // Command to set measurement interval
-#define SCD30_CMD_GET_DATA_READY 0x0202                 // Data ready register
-#define SCD30_CMD_AUTOMATIC_SELF_CALIBRATION 0x5306     // Enable/disable auto calibration
-#define SCD30_CMD_SET_FORCED_RECALIBRATION_REF 0x5204   // Force calibration with given value as reference
-#define SCD30_CMD_SET_TEMPERATURE_OFFSET 0x5403         // Set temperature offset
-#define SCD30_CMD_SET_ALTITUDE_COMPENSATION 0x5102      // Specify altitude compensation
-#define SCD30_CMD_SOFT_RESET 0xD304                     // Soft reset
-#define SCD30_CMD_READ_REVISION 0xD100                  // Firmware revision number
+const uint16_t SCD30_BOOT_MS = 2000;   // From power-up until the sensor answers, datasheet boot-up time
+
+/// @brief Command table: code, argument words, response words, execution time in ms.
+///        Parameters are read by sending their set command without an argument
+namespace SCD30_CMD {
+    constexpr Sensirion_COMMAND READ_MEASUREMENT                {0x0300, 0, 6, 4};  // Main data register
+    constexpr Sensirion_COMMAND CONTINUOUS_MEASUREMENT          {0x0010, 1, 0, 0};  // Command to start continuous measurement
+    constexpr Sensirion_COMMAND GET_CONTINUOUS_MEASUREMENT      {0x0010, 0, 1, 4};
+    constexpr Sensirion_COMMAND STOP_MEASUREMENTS               {0x0104, 0, 0, 0};  // Command to stop measurements
+    constexpr Sensirion_COMMAND SET_MEASUREMENT_INTERVAL        {0x4600, 1, 0, 0};  // Command to set measurement interval
+    constexpr Sensirion_COMMAND GET_MEASUREMENT_INTERVAL        {0x4600, 0, 1, 4};
+    constexpr Sensirion_COMMAND GET_DATA_READY                  {0x0202, 0, 1, 4};  // Data ready register
+    constexpr Sensirion_COMMAND SET_AUTOMATIC_SELF_CALIBRATION  {0x5306, 1, 0, 0};  // Enable/disable auto calibration
+    constexpr Sensirion_COMMAND GET_AUTOMATIC_SELF_CALIBRATION  {0x5306, 0, 1, 4};
+    constexpr Sensirion_COMMAND SET_FORCED_RECALIBRATION_REF    {0x5204, 1, 0, 0};  // Force calibration with given value as reference
+    constexpr Sensirion_COMMAND GET_FORCED_RECALIBRATION_REF    {0x5204, 0, 1, 4};
+    constexpr Sensirion_COMMAND SET_TEMPERATURE_OFFSET          {0x5403, 1, 0, 0};  // Set temperature offset
+    constexpr Sensirion_COMMAND GET_TEMPERATURE_OFFSET          {0x5403, 0, 1, 4};
+    constexpr Sensirion_COMMAND SET_ALTITUDE_COMPENSATION       {0x5102, 1, 0, 0};  // Specify altitude compensation
+    constexpr Sensirion_COMMAND GET_ALTITUDE_COMPENSATION       {0x5102, 0, 1, 4};
+    constexpr Sensirion_COMMAND SOFT_RESET                      {0xD304, 0, 0, 30}; // Soft reset
+    constexpr Sensirion_COMMAND READ_REVISION                   {0xD100, 0, 1, 4};  // Firmware revision number
+}
 
 class SCD30 {
 public:
     SCD30() {};
     SCD30(i2c_inst_t* i2c, uint8_t addr = SCD30_DEFAULT_I2CADDR);
     bool init(void);
+    bool start(void);
 
     void reset(void);
     bool dataReady(void);
     bool read(void);
+    bool readInto(float* slots, uint64_t* timestamp, uint32_t* bits = nullptr);
 
     bool setMeasurementInterval(uint16_t interval);
     uint16_t getMeasurementInterval(void);
@@ -48,11 +60,13 @@ public:
     uint16_t getForcedCalibrationWithReference(void);
 
     float co2, temp, hum;
+    uint64_t timestamp; // time_us_64() when the last successful read completed
+
+    /// @brief Time until the sensor accepts the next command, time_us_64() base
+    uint64_t readyAt(void) const { return _bus.readyAt(); }
 private:
-    i2c_inst_t* _i2c;
-    uint8_t SCD30_ADDRESS;
+    SensirionI2C _bus;
 
-    bool sendCommand(uint16_t command, uint16_t argument);
-    bool sendCommand(uint16_t command);
-    uint16_t readRegister(uint16_t reg_address);
+    bool sendCommand(const Sensirion_COMMAND& command, uint16_t argument);
+    uint16_t readRegister(const Sensirion_COMMAND& command);
 };
\ No newline at end of file
@@ -8,136 +8,181 @@
 #include <hardware/i2c.h>
 #include <stdio.h>
 
-/// @brief 
-/// @param data 
-/// @return
-uint8_t CalcCrc(uint8_t data[2]) {
-    uint8_t crc = 0xFF;
-    for(int i = 0; i < 2; i++) {
-        crc ^= data[i];
-        for(uint8_t bit = 8; bit > 0; --bit) {
-            if(crc & 0x80) {
-            crc = (crc << 1) ^ 0x31u;
-            } else {
-                 crc = (crc << 1);
-             }
-         }
-      }
-    return crc;
-}
-
 bool SEN55::init(void){
     reset();
-    sendCommand(SEN55_START_MEAS);
-    sleep_ms(30);
-    return true;
+    return startMeasurement();
 }
 
-/// @brief Reset the SEN55 sensor
+/// @brief Reset the SEN55 sensor. The next command waits out the reset time
 /// @param  
 void SEN55::reset(void) {
-    sendCommand(SEN55_RESET);
-    sleep_ms(30);
+    _bus.send(SEN55_CMD::RESET);
+}
+
+/// @brief Start continuous measurement of everything, including PM with the fan running
+/// @return True if successful, false if not
+bool SEN55::startMeasurement(void) {
+    return _bus.send(SEN55_CMD::START_MEAS);
+}
+
+/// @brief Start continuous measurement of humidity, temperature, VOC and NOx only.
+///        The fan and laser are off, so the PM fields read as unknown
+/// @return True if successful, false if not
+bool SEN55::startMeasurementRHT(void) {
+    return _bus.send(SEN55_CMD::START_MEAS_RHT);
+}
+
+/// @brief Stop measuring and return to idle
+/// @return True if successful, false if not
+bool SEN55::stopMeasurement(void) {
+    return _bus.send(SEN55_CMD::STOP_MEAS);
 }
 
 /// @brief Ask the sensor if new data is ready to be read
 /// @param  
 /// @return True id data is ready to be read, false if not
 bool SEN55::dataReady(void) {
-    return(readRegister(SEN55_READ_DATA_READY) == 1);
+    uint16_t ready;
+    return _bus.execute(SEN55_CMD::READ_DATA_READY, nullptr, &ready) && (ready & 0x00FF) == 1;
 }
 
-/// @brief 
+// Scale of each measured value, PM are unsigned and the rest signed
+const float SEN55_SCALE[SEN55_FIELD_COUNT] = {0.1f, 0.1f, 0.1f, 0.1f, 0.01f, 0.005f, 0.1f, 0.1f};
+
+/// @brief Read all measured values
 /// @param values 
-/// @return 
+///        Output, the values and the time of the read
+/// @return True if successful, false if not
 bool SEN55::read(SEN55_VALUES* values) {
-    uint8_t buffer[24]{0};
+    float slots[SEN55_FIELD_COUNT];
 
-    buffer[0] = (SEN55_READ_MEAS_VALUES & 0xFF00) >> 8;
-    buffer[1] = SEN55_READ_MEAS_VALUES & 0x00FF;
+    if(!readInto(slots, SEN55_FIELD_COUNT, &(*values).timestamp)) return false;
 
-    i2c_write_timeout_us(_i2c, SEN55_ADDRESS, buffer, 2, false, 10000);
-    
-    sleep_ms(20); // Delay between write and read specified by the datasheet as 10 ms
+    (*values).pm1 = slots[SEN55_PM1];
+    (*values).pm2_5 = slots[SEN55_PM2_5];
+    (*values).pm4 = slots[SEN55_PM4];
+    (*values).pm10 = slots[SEN55_PM10];
+    (*values).RH = slots[SEN55_RH];
+    (*values).temp = slots[SEN55_TEMP];
+    (*values).VOC = slots[SEN55_VOC];
+    (*values).NOx = slots[SEN55_NOx];
 
-    i2c_read_timeout_us(_i2c, SEN55_ADDRESS, buffer, 24, false, 10000);
+    return true;
+}
 
-    for(uint16_t i = 0; i < 24; i += 3) {
-        if(CalcCrc(buffer + i) != buffer[i+2]) {
-            return false;
-        }
+/// @brief Decode the leading measured values straight into the caller's slots. The read stops
+///        after the last value asked for, PM only is 12 bytes on the bus instead of 24
+/// @param slots 
+///        Output, count scaled values in SEN55_FIELD order
+/// @param count 
+///        Number of values, from SEN55_PM1
+/// @param timestamp 
+///        Output, time_us_64() when the bus read completed
+/// @param words 
+///        Optional output, the count words as read, for raw capture
+/// @return True if successful, false if not
+bool SEN55::readInto(float* slots, uint8_t count, uint64_t* timestamp, uint16_t* words) {
+    uint16_t buffer[SEN55_FIELD_COUNT];
+
+    if(count > SEN55_FIELD_COUNT) return false;
+    if(words == nullptr) words = buffer;
+    if(!_bus.execute(SEN55_CMD::READ_MEAS_VALUES, nullptr, words, count)) return false;
+    *timestamp = time_us_64();
+
+    for(uint8_t i = 0; i < count; i++) {
+        float raw = (i <= SEN55_PM10) ? (float)words[i] : (float)(int16_t)words[i];
+        slots[i] = raw * SEN55_SCALE[i];
     }
-    
-    uint16_t _pm1 = 0, _pm2_5 = 0, _pm4 = 0, _pm10 = 0;
-    int16_t _rh = 0, _temp = 0, _voc = 0, _nox = 0;
-
-    _pm1 |= buffer[0];
-    _pm1 <<= 8;
-    _pm1 |= buffer[1];
-
-    _pm2_5 |= buffer[3];
-    _pm2_5 <<= 8;
-    _pm2_5 |= buffer[4];
-
-    _pm4 |= buffer[6];
-    _pm4 <<= 8;
-    _pm4 |= buffer[7];
-
-    _pm10 |= buffer[9];
-    _pm10 <<= 8;
-    _pm10 |= buffer[10];
-
-    _rh |= buffer[12];
-    _rh <<= 8;
-    _rh |= buffer[13];
-
-    _temp |= buffer[15];
-    _temp <<= 8;
-    _temp |= buffer[16];
-
-    _voc |= buffer[18];
-    _voc <<= 8;
-    _voc |= buffer[19];
-
-    _nox |= buffer[21];
-    _nox <<= 8;
-    _nox |= buffer[22];
-
-    (*values).pm1 = _pm1/10.0f;
-    (*values).pm2_5 = _pm2_5/10.0f;
-    (*values).pm4 = _pm4/10.0f;
-    (*values).pm10 = _pm10/10.0f;
-    (*values).RH = _rh/100.0f;
-    (*values).temp = _temp/200.0f;
-    (*values).VOC = _voc/10.0f;
-    (*values).NOx = _nox/10.0f;
-
     return true;
 }
 
-/// @brief 
-/// @param command 
-/// @return 
-bool SEN55::sendCommand(uint16_t command){
-    uint8_t buffer[2]{0};
+/// @brief Read the VOC algorithm state, in measurement or idle mode
+/// @param state 
+///        Output, SEN55_VOC_STATE_WORDS words
+/// @return True if successful, false if not
+bool SEN55::getVocState(uint16_t* state) {
+    return _bus.execute(SEN55_CMD::READ_VOC_STATE, nullptr, state);
+}
+
+/// @brief Write a VOC algorithm state saved by getVocState(). Idle mode only, the algorithm
+///        picks it up at the next start of measurement instead of learning from scratch
+/// @param state 
+///        SEN55_VOC_STATE_WORDS words
+/// @return True if successful, false if not
+bool SEN55::setVocState(const uint16_t* state) {
+    return _bus.send(SEN55_CMD::WRITE_VOC_STATE, state);
+}
+
+/// @brief Read the VOC index algorithm tuning. Idle mode only
+/// @return True if successful, false if not
+bool SEN55::getVocTuning(SEN55_TUNING* tuning) {
+    return getTuning(SEN55_CMD::READ_VOC_TUNING_PARAM, tuning);
+}
+
+/// @brief Write the VOC index algorithm tuning. Idle mode only
+/// @return True if successful, false if not
+bool SEN55::setVocTuning(const SEN55_TUNING* tuning) {
+    return setTuning(SEN55_CMD::WRITE_VOC_TUNING_PARAM, tuning);
+}
 
-    buffer[0] = (command >> 8) & 0xFF00;
-    buffer[1] = command & 0x00FF;
-    return (i2c_write_timeout_us(_i2c, SEN55_ADDRESS, buffer, 2, false, 10000) == 2);
+/// @brief Read the NOx index algorithm tuning. Idle mode only
+/// @return True if successful, false if not
+bool SEN55::getNoxTuning(SEN55_TUNING* tuning) {
+    return getTuning(SEN55_CMD::READ_NOx_TUNING_PARAM, tuning);
 }
 
-/// @brief 
-/// @param reg_address 
-/// @return 
-uint16_t SEN55::readRegister(uint16_t reg_address){
-    uint8_t buffer[2];
-    
-    buffer[0] = (reg_address >> 8) & 0xFF00;
-    buffer[1] = reg_address & 0x00FF;
+/// @brief Write the NOx index algorithm tuning. Idle mode only
+/// @return True if successful, false if not
+bool SEN55::setNoxTuning(const SEN55_TUNING* tuning) {
+    return setTuning(SEN55_CMD::WRITE_NOx_TUNING_PARAM, tuning);
+}
 
-    i2c_write_timeout_us(_i2c, SEN55_ADDRESS, buffer, 2, false, 10000);
-    sleep_ms(10);
-    i2c_read_timeout_us(_i2c, SEN55_ADDRESS, buffer, 2, false, 10000);
+/// @brief Tell the temperature compensation whether the sensor is already warm. Idle mode only,
+///        it applies to the next start of measurement
+/// @param warm_start 
+///        SEN55_COLD_START to SEN55_WARM_START
+/// @return True if successful, false if not
+bool SEN55::setWarmStart(uint16_t warm_start) {
+    return _bus.send(SEN55_CMD::WRITE_WARM_START_PARAM, &warm_start);
+}
 
-    return (uint16_t)(buffer[0] << 8 | (buffer[1] & 0xFF));
-}
\ No newline at end of file
+/// @brief Set the RH/T acceleration for how the sensor is mounted. Idle mode only
+/// @param mode 
+///        The mode
+/// @return True if successful, false if not
+bool SEN55::setRhtAcceleration(SEN55_RHT_ACC mode) {
+    uint16_t word = (uint16_t)mode;
+    return _bus.send(SEN55_CMD::WRITE_RHT_ACC_MODE, &word);
+}
+
+/// @brief Write back a saved state: tuning first, then the VOC state so the algorithm resumes
+///        with it at the next start of measurement. Idle mode only
+/// @param state 
+///        The state
+/// @return True if successful, false if not
+bool SEN55::restore(const SEN55_STATE* state) {
+    return setVocTuning(&state->voc_tuning) && setNoxTuning(&state->nox_tuning) && setVocState(state->voc_state);
+}
+
+/********** Private methods **********/
+
+bool SEN55::getTuning(const Sensirion_COMMAND& command, SEN55_TUNING* tuning) {
+    uint16_t words[6];
+    if(!_bus.execute(command, nullptr, words)) return false;
+    tuning->index_offset = (int16_t)words[0];
+    tuning->learning_time_offset_hours = (int16_t)words[1];
+    tuning->learning_time_gain_hours = (int16_t)words[2];
+    tuning->gating_max_duration_minutes = (int16_t)words[3];
+    tuning->std_initial = (int16_t)words[4];
+    tuning->gain_factor = (int16_t)words[5];
+    return true;
+}
+
+bool SEN55::setTuning(const Sensirion_COMMAND& command, const SEN55_TUNING* tuning) {
+    uint16_t words[6] = {
+        (uint16_t)tuning->index_offset, (uint16_t)tuning->learning_time_offset_hours,
+        (uint16_t)tuning->learning_time_gain_hours, (uint16_t)tuning->gating_max_duration_minutes,
+        (uint16_t)tuning->std_initial, (uint16_t)tuning->gain_factor,
+    };
+    return _bus.send(command, words);
+}
@@ -5,28 +5,86 @@
  */
 #pragma once
 #include <hardware/i2c.h>
+#include "Sensirion.h"
 
 const uint16_t SEN55_DEFAULT_I2CADDR = 0x69;    
+const uint16_t SEN55_POWER_UP_MS = 50;     // From power-up until the first command, datasheet power-up time
 
-const uint16_t SEN55_START_MEAS = 0x0021;           // Starts measurement,
-const uint16_t SEN55_START_MEAS_RHT = 0x0037;       // Starts a continous measurement without PM, only humidity, temperature, VOC and NOx
-const uint16_t SEN55_STOP_MEAS = 0x0104;            // Stops measurement, return to initial stage
-const uint16_t SEN55_READ_DATA_READY = 0x0202;      // Find out when new meas is available
-const uint16_t SEN55_READ_MEAS_VALUES = 0x03C4;     // Reads meas values and resets data ready flag
-const uint16_t SEN55_RW_TEMP_COMP_PARAM = 0x60B2;   // Compensate temperature
-const uint16_t SEN55_RW_WARM_START_PARAM = 0x60C2;  // Optimized for cold start by default
-const uint16_t SEN55_RW_VOC_TUNING_PARAM = 0x60D0;  // VOC algorithm tuning parameters
-const uint16_t SEN55_RW_NOx_TUNING_PARAM = 0x60E1;  // VOx algorithm tuning parameters
-const uint16_t SEN55_RW_RHT_ACC_MODE = 0x60F7;      // Read/write RH/T acceleration mode
-const uint16_t SEN55_RW_VOC_STATE = 0x6181;         // Read/write VOC algorithm state
-const uint16_t SEN55_START_FAN_CLEANING = 0x5607;   // Starts the fan cleaning manually
-const uint16_t SEN55_RW_AUTO_CLEAN_INTER = 0x8004;  // Read/writes the interval of the periodic fan cleaning
-const uint16_t SEN55_READ_PRODUCT_NAME = 0xD014;    // Returns the product name
-const uint16_t SEN55_READ_SERIAL = 0xD033;          // Returns the serial number
-const uint16_t SEN55_READ_FIRMWARE = 0xD100;        // Returns the firmware version
-const uint16_t SEN55_READ_DEVICE_STATUS = 0xD206;   // Reads the device status register
-const uint16_t SEN55_CLEAR_DEVICE_STATUS = 0xD210;  // Clears all flags in device status register
-const uint16_t SEN55_RESET = 0xD304;                // Software reset cmd
+/// @brief Command table: code, argument words, response words, execution time in ms
+namespace SEN55_CMD {
+    constexpr Sensirion_COMMAND START_MEAS              {0x0021, 0, 0, 50};     // Starts measurement
+    constexpr Sensirion_COMMAND START_MEAS_RHT          {0x0037, 0, 0, 50};     // Starts a continous measurement without PM, only humidity, temperature, VOC and NOx
+    constexpr Sensirion_COMMAND STOP_MEAS               {0x0104, 0, 0, 200};    // Stops measurement, return to initial stage
+    constexpr Sensirion_COMMAND READ_DATA_READY         {0x0202, 0, 1, 10};     // Find out when new meas is available
+    constexpr Sensirion_COMMAND READ_MEAS_VALUES        {0x03C4, 0, 8, 10};     // Reads meas values and resets data ready flag
+    constexpr Sensirion_COMMAND READ_TEMP_COMP_PARAM    {0x60B2, 0, 3, 20};     // Compensate temperature
+    constexpr Sensirion_COMMAND WRITE_TEMP_COMP_PARAM   {0x60B2, 3, 0, 20};
+    constexpr Sensirion_COMMAND READ_WARM_START_PARAM   {0x60C6, 0, 1, 20};     // Optimized for cold start by default
+    constexpr Sensirion_COMMAND WRITE_WARM_START_PARAM  {0x60C6, 1, 0, 20};
+    constexpr Sensirion_COMMAND READ_VOC_TUNING_PARAM   {0x60D0, 0, 6, 20};     // VOC algorithm tuning parameters
+    constexpr Sensirion_COMMAND WRITE_VOC_TUNING_PARAM  {0x60D0, 6, 0, 20};
+    constexpr Sensirion_COMMAND READ_NOx_TUNING_PARAM   {0x60E1, 0, 6, 20};     // NOx algorithm tuning parameters
+    constexpr Sensirion_COMMAND WRITE_NOx_TUNING_PARAM  {0x60E1, 6, 0, 20};
+    constexpr Sensirion_COMMAND READ_RHT_ACC_MODE       {0x60F7, 0, 1, 20};     // Read/write RH/T acceleration mode
+    constexpr Sensirion_COMMAND WRITE_RHT_ACC_MODE      {0x60F7, 1, 0, 20};
+    constexpr Sensirion_COMMAND READ_VOC_STATE          {0x6181, 0, 4, 20};     // Read/write VOC algorithm state
+    constexpr Sensirion_COMMAND WRITE_VOC_STATE         {0x6181, 4, 0, 20};
+    constexpr Sensirion_COMMAND START_FAN_CLEANING      {0x5607, 0, 0, 20};     // Starts the fan cleaning manually
+    constexpr Sensirion_COMMAND READ_AUTO_CLEAN_INTER   {0x8004, 0, 2, 20};     // Read/writes the interval of the periodic fan cleaning
+    constexpr Sensirion_COMMAND WRITE_AUTO_CLEAN_INTER  {0x8004, 2, 0, 20};
+    constexpr Sensirion_COMMAND READ_PRODUCT_NAME       {0xD014, 0, 16, 20};    // Returns the product name
+    constexpr Sensirion_COMMAND READ_SERIAL             {0xD033, 0, 16, 20};    // Returns the serial number
+    constexpr Sensirion_COMMAND READ_FIRMWARE           {0xD100, 0, 1, 20};     // Returns the firmware version
+    constexpr Sensirion_COMMAND READ_DEVICE_STATUS      {0xD206, 0, 2, 20};     // Reads the device status register
+    constexpr Sensirion_COMMAND CLEAR_DEVICE_STATUS     {0xD210, 0, 0, 20};     // Clears all flags in device status register
+    constexpr Sensirion_COMMAND RESET                   {0xD304, 0, 0, 100};    // Software reset cmd
+}
+
+/// @brief Word order of the measured values response, for readInto()
+enum SEN55_FIELD : uint8_t {
+    SEN55_PM1 = 0,
+    SEN55_PM2_5,
+    SEN55_PM4,
+    SEN55_PM10,
+    SEN55_RH,
+    SEN55_TEMP,
+    SEN55_VOC,
+    SEN55_NOx,
+    SEN55_FIELD_COUNT,
+};
+
+const uint8_t SEN55_VOC_STATE_WORDS = 4;       // Opaque VOC algorithm state, 8 bytes
+const uint16_t SEN55_STATE_VERSION = 1;         // Bump when SEN55_STATE changes layout
+const uint16_t SEN55_STATE_TAG = 0x0A02;        // FlashStore tag for SEN55_STATE
+
+/// @brief Warm start parameter of the temperature compensation, anything in between blends the two
+const uint16_t SEN55_COLD_START = 0;            // Default, the sensor is assumed to start cold
+const uint16_t SEN55_WARM_START = 65535;        // The sensor was running just before this start
+
+/// @brief RH/T acceleration, how the RH/T outputs correct for the sensor's own heating
+enum class SEN55_RHT_ACC : uint16_t {
+    Acc_low = 0,    // Default, sensor in free air
+    Acc_high,
+    Acc_medium,
+};
+
+/// @brief VOC or NOx index algorithm tuning, in command word order
+struct SEN55_TUNING {
+    int16_t index_offset;
+    int16_t learning_time_offset_hours;
+    int16_t learning_time_gain_hours;
+    int16_t gating_max_duration_minutes;
+    int16_t std_initial;
+    int16_t gain_factor;
+};
+
+/// @brief What a restart needs to pick up where the gas index algorithms left off. The NOx
+///        algorithm has no state to save, only its tuning
+struct SEN55_STATE {
+    uint16_t voc_state[SEN55_VOC_STATE_WORDS];
+    SEN55_TUNING voc_tuning;
+    SEN55_TUNING nox_tuning;
+};
 
 struct SEN55_VALUES {
     float pm1;
@@ -37,23 +95,39 @@ struct SEN55_VALUES {
     float temp;
     float NOx;
     float VOC;
+    uint64_t timestamp; // time_us_64() when the bus read completed
 };
 
 class SEN55 {
 public:
     SEN55() {};
-    SEN55(i2c_inst_t *i2c, uint16_t addr = SEN55_DEFAULT_I2CADDR) : _i2c(i2c), SEN55_ADDRESS(addr) {};
+    SEN55(i2c_inst_t *i2c, uint16_t addr = SEN55_DEFAULT_I2CADDR) : _bus(i2c, addr) {};
     bool init(void);
 
     void reset(void);
+    bool startMeasurement(void);
+    bool startMeasurementRHT(void);
+    bool stopMeasurement(void);
     bool dataReady(void);
     bool read(SEN55_VALUES* values);
+    bool readInto(float* slots, uint8_t count, uint64_t* timestamp, uint16_t* words = nullptr);
+
+    bool getVocState(uint16_t* state);
+    bool setVocState(const uint16_t* state);
+    bool getVocTuning(SEN55_TUNING* tuning);
+    bool setVocTuning(const SEN55_TUNING* tuning);
+    bool getNoxTuning(SEN55_TUNING* tuning);
+    bool setNoxTuning(const SEN55_TUNING* tuning);
+    bool setWarmStart(uint16_t warm_start);
+    bool setRhtAcceleration(SEN55_RHT_ACC mode);
+    bool restore(const SEN55_STATE* state);
 
+    /// @brief Time until the sensor accepts the next command, time_us_64() base
+    uint64_t readyAt(void) const { return _bus.readyAt(); }
 
 private:
-    i2c_inst_t* _i2c;
-    uint16_t SEN55_ADDRESS;
-    
-    bool sendCommand(uint16_t command);
-    uint16_t readRegister(uint16_t reg_address);
+    SensirionI2C _bus;
+
+    bool getTuning(const Sensirion_COMMAND& command, SEN55_TUNING* tuning);
+    bool setTuning(const Sensirion_COMMAND& command, const SEN55_TUNING* tuning);
 };
\ No newline at end of file
@@ -0,0 +1,101 @@
+/*
+ *  Title: SampleClock.cpp
+ *  Description: Drift-free acquisition clock driven by a hardware repeating timer
+ *  Author: Tinna Osk Traustadottir
+ */
+#include "SampleClock.h"
+#include <math.h>
+#include <hardware/sync.h>
+
+/// @brief Construct a new SampleClock object
+/// @param period_us 
+///        Time between samples, in microseconds
+SampleClock::SampleClock(uint32_t period_us) {
+    _period_us = period_us;
+    resetStats();
+}
+
+/// @brief Start the hardware timer. The first tick fires one period from now
+/// @return True if the timer was started, false if no alarm slot was free
+bool SampleClock::start(void) {
+    _fired = 0;
+    _taken = 0;
+    _epoch_us = time_us_64();
+    // A negative delay makes the alarm pool schedule each tick from the previous
+    // target time instead of from when the callback returned, so the period is
+    // phase locked to the epoch and never accumulates drift
+    return add_repeating_timer_us(-(int64_t)_period_us, onTimer, this, &_timer);
+}
+
+/// @brief Stop the hardware timer
+void SampleClock::stop(void) {
+    cancel_repeating_timer(&_timer);
+}
+
+/// @brief Block until the next sample is due
+/// @return The ideal time of the tick in microseconds since boot. Consecutive
+///         return values are spaced exactly one period apart, apart from skipped ticks
+uint64_t SampleClock::wait(void) {
+    while(_fired == _taken) {
+        __wfe(); // The timer IRQ wakes us up
+    }
+    uint64_t now = time_us_64();
+
+    // If the previous loop overran, skip straight to the most recent tick
+    uint32_t fired = _fired;
+    if(fired - _taken > 1) {
+        _stat_overruns += fired - _taken - 1;
+    }
+    _taken = fired;
+
+    uint64_t ideal = _epoch_us + (uint64_t)_taken * _period_us;
+    int32_t late = (int32_t)(now - ideal);
+
+    if(_stat_ticks == 0 || late < _stat_min) _stat_min = late;
+    if(_stat_ticks == 0 || late > _stat_max) _stat_max = late;
+    _stat_sum += late;
+    _stat_sum_sq += (uint64_t)((int64_t)late * late);
+    _stat_ticks++;
+
+    return ideal;
+}
+
+/// @brief Get the jitter statistics gathered since the last reset
+/// @param stats 
+///        Pointer to a struct where the statistics will be inserted
+void SampleClock::getStats(SampleClock_STATS* stats) {
+    stats->ticks = _stat_ticks;
+    stats->overruns = _stat_overruns;
+    stats->min_us = _stat_min;
+    stats->max_us = _stat_max;
+    if(_stat_ticks == 0) {
+        stats->mean_us = 0.0f;
+        stats->stddev_us = 0.0f;
+        return;
+    }
+    float mean = (float)_stat_sum / _stat_ticks;
+    float variance = (float)_stat_sum_sq / _stat_ticks - mean * mean;
+    stats->mean_us = mean;
+    stats->stddev_us = (variance > 0.0f) ? sqrtf(variance) : 0.0f;
+}
+
+/// @brief Clear the jitter statistics
+void SampleClock::resetStats(void) {
+    _stat_ticks = 0;
+    _stat_overruns = 0;
+    _stat_min = 0;
+    _stat_max = 0;
+    _stat_sum = 0;
+    _stat_sum_sq = 0;
+}
+
+/// @brief Timer callback, runs in IRQ context
+/// @param rt 
+///        The repeating timer that fired
+/// @return True to keep the timer running
+bool SampleClock::onTimer(repeating_timer_t* rt) {
+    SampleClock* clock = (SampleClock*)rt->user_data;
+    clock->_fired = clock->_fired + 1;
+    __sev(); // Wake up wait() if it is sleeping in __wfe()
+    return true;
+}
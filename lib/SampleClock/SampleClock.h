@@ -0,0 +1,49 @@
+/*
+ *  Title: SampleClock.h
+ *  Description: Drift-free acquisition clock driven by a hardware repeating timer
+ *  Author: Tinna Osk Traustadottir
+ */
+#pragma once
+#include <pico/stdlib.h>
+
+/// @brief Jitter of the acquisition start relative to the ideal sample grid
+struct SampleClock_STATS {
+    uint32_t ticks;     // Number of samples taken since the last reset
+    uint32_t overruns;  // Number of ticks skipped because the loop ran longer than one period
+    int32_t min_us;     // Smallest lateness seen, in microseconds
+    int32_t max_us;     // Largest lateness seen, in microseconds
+    float mean_us;      // Mean lateness, in microseconds
+    float stddev_us;    // Standard deviation of the lateness, in microseconds
+};
+
+class SampleClock {
+public:
+    SampleClock(uint32_t period_us);
+    bool start(void);
+    void stop(void);
+
+    uint64_t wait(void);
+    uint32_t period(void) const { return _period_us; };
+
+    /// @brief Ideal time of the next tick wait() returns, for fitting other work in before it
+    uint64_t nextTick(void) const { return _epoch_us + (uint64_t)(_taken + 1) * _period_us; };
+
+    void getStats(SampleClock_STATS* stats);
+    void resetStats(void);
+
+private:
+    repeating_timer_t _timer;
+    uint32_t _period_us;
+    uint64_t _epoch_us = 0;         // Ideal time of tick 0
+    volatile uint32_t _fired = 0;   // Ticks fired by the timer, written from IRQ context
+    uint32_t _taken = 0;            // Ticks consumed by wait()
+
+    uint32_t _stat_ticks = 0;
+    uint32_t _stat_overruns = 0;
+    int32_t _stat_min = 0;
+    int32_t _stat_max = 0;
+    int64_t _stat_sum = 0;
+    uint64_t _stat_sum_sq = 0;
+
+    static bool onTimer(repeating_timer_t* rt);
+};
@@ -0,0 +1,90 @@
+/*
+ *  Title: Sensirion.cpp
+ *  Description: Command table driven I2C engine shared by the Sensirion sensors
+ *  Author: Tinna Osk Traustadottir
+ */
+#include "Sensirion.h"
+#include <pico/time.h>
+
+const uint32_t SENSIRION_I2C_TIMEOUT_US = 10000;
+
+/// @brief Write a command and its arguments. Blocks only if the previous command has not
+///        finished executing yet
+/// @param command 
+///        The command, from the device command table
+/// @param args 
+///        command.args argument words, may be nullptr if the command has none
+/// @return True if successful, false if not
+bool SensirionI2C::send(const Sensirion_COMMAND& command, const uint16_t* args) {
+    uint8_t buffer[2 + 3 * SENSIRION_MAX_WORDS];
+    uint8_t length = 2;
+
+    if(command.args > SENSIRION_MAX_WORDS || (command.args && !args)) return false;
+
+    buffer[0] = command.code >> 8;
+    buffer[1] = command.code & 0xFF;
+    for(uint8_t i = 0; i < command.args; i++) {
+        buffer[length] = args[i] >> 8;
+        buffer[length + 1] = args[i] & 0xFF;
+        buffer[length + 2] = sensirionCrc(buffer + length);
+        length += 3;
+    }
+
+    waitReady();
+    bool ok = (i2c_write_timeout_us(_i2c, _addr, buffer, length, false, SENSIRION_I2C_TIMEOUT_US) == length);
+    _ready_at = time_us_64() + waitUs(command);
+    return ok;
+}
+
+/// @brief Read the response of the last command sent. Blocks until its execution time has passed
+/// @param command 
+///        The command that was sent
+/// @param words 
+///        Output, count response words
+/// @param count 
+///        Number of words to read, the sensor allows stopping the read after any word so
+///        callers that only need the leading words don't pay for the rest on the bus
+/// @return True if the read succeeded and every word passed its CRC, false if not
+bool SensirionI2C::fetch(const Sensirion_COMMAND& command, uint16_t* words, uint8_t count) {
+    uint8_t buffer[3 * SENSIRION_MAX_WORDS];
+    uint8_t length = 3 * count;
+
+    if(count > command.words) return false;
+
+    waitReady();
+    if(i2c_read_timeout_us(_i2c, _addr, buffer, length, false, SENSIRION_I2C_TIMEOUT_US) != length) return false;
+
+    for(uint8_t i = 0; i < count; i++) {
+        if(sensirionCrc(buffer + 3 * i) != buffer[3 * i + 2]) return false;
+        words[i] = (uint16_t)(buffer[3 * i] << 8 | buffer[3 * i + 1]);
+    }
+    return true;
+}
+
+/// @brief Send a command and read its response, if it has one
+/// @param command 
+///        The command, from the device command table
+/// @param args 
+///        command.args argument words, may be nullptr if the command has none
+/// @param words 
+///        Output, count response words, may be nullptr if the command has none
+/// @param count 
+///        Number of leading response words to read
+/// @return True if successful, false if not
+bool SensirionI2C::execute(const Sensirion_COMMAND& command, const uint16_t* args, uint16_t* words, uint8_t count) {
+    if(!send(command, args)) return false;
+    if(count == 0) return true;
+    return words && fetch(command, words, count);
+}
+
+/// @brief Check if the last command has finished executing
+/// @return True if the sensor can be read or sent a new command
+bool SensirionI2C::ready(void) const {
+    return time_us_64() >= _ready_at;
+}
+
+/// @brief Sleep out whatever is left of the last command's execution time
+void SensirionI2C::waitReady(void) {
+    uint64_t now = time_us_64();
+    if(now < _ready_at) sleep_us(_ready_at - now);
+}
@@ -0,0 +1,65 @@
+/*
+ *  Title: Sensirion.h
+ *  Description: Command table driven I2C engine shared by the Sensirion sensors (SEN55, SCD30).
+ *               Every command is a 16 bit code followed by CRC protected argument words, after which
+ *               the sensor is busy for the command's execution time before it can be read or sent
+ *               the next command
+ *  Author: Tinna Osk Traustadottir
+ */
+#pragma once
+#include <hardware/i2c.h>
+
+const uint8_t SENSIRION_MAX_WORDS = 16; // Longest response, product name and serial number
+
+/// @brief One entry of a device command table
+struct Sensirion_COMMAND {
+    uint16_t code;      // Command code, sent MSB first
+    uint8_t args;       // Argument words written after the code
+    uint8_t words;      // Response words to read, 0 if the command has no response
+    uint16_t exec_ms;   // Maximum execution time from the datasheet, the sensor ignores the bus until it has passed
+};
+
+/// @brief Calculate the CRC-8 of one Sensirion data word
+/// @param data 
+///        The two bytes of the word
+/// @return The checksum byte
+constexpr uint8_t sensirionCrc(const uint8_t data[2]) {
+    uint8_t crc = 0xFF;
+    for(int i = 0; i < 2; i++) {
+        crc ^= data[i];
+        for(int bit = 8; bit > 0; --bit) {
+            crc = (crc & 0x80) ? (uint8_t)((crc << 1) ^ 0x31u) : (uint8_t)(crc << 1);
+        }
+    }
+    return crc;
+}
+
+class SensirionI2C {
+public:
+    SensirionI2C() {};
+    SensirionI2C(i2c_inst_t* i2c, uint8_t addr) : _i2c(i2c), _addr(addr) {};
+
+    bool send(const Sensirion_COMMAND& command, const uint16_t* args = nullptr);
+    bool fetch(const Sensirion_COMMAND& command, uint16_t* words, uint8_t count);
+    bool fetch(const Sensirion_COMMAND& command, uint16_t* words) { return fetch(command, words, command.words); }
+    bool execute(const Sensirion_COMMAND& command, const uint16_t* args, uint16_t* words, uint8_t count);
+    bool execute(const Sensirion_COMMAND& command, const uint16_t* args, uint16_t* words) { return execute(command, args, words, command.words); }
+
+    /// @brief Wait from the end of a command write until its response can be read, for schedulers
+    ///        that want to do something else in the meantime instead of blocking in fetch
+    /// @param command 
+    ///        The command
+    /// @return Wait in microseconds
+    static constexpr uint32_t waitUs(const Sensirion_COMMAND& command) { return command.exec_ms * 1000u; }
+
+    /// @brief Time when the last command has finished executing, time_us_64() base
+    uint64_t readyAt(void) const { return _ready_at; }
+    bool ready(void) const;
+
+private:
+    i2c_inst_t* _i2c = nullptr;
+    uint8_t _addr = 0;
+    uint64_t _ready_at = 0;
+
+    void waitReady(void);
+};
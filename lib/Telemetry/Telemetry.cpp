@@ -0,0 +1,93 @@
+/*
+ *  Title: Telemetry.cpp
+ *  Description: Sends telemetry frames over stdio, with a priority path that bypasses the queue
+ *  Author: Tinna Osk Traustadottir
+ */
+#include "Telemetry.h"
+
+/// @brief Queue a frame to be sent on the next flush()
+/// @param type 
+///        Frame type (see TELEMETRY_TYPE)
+/// @param timestamp 
+///        Time of the data in microseconds since boot
+/// @param payload 
+///        Pointer to the payload
+/// @param length 
+///        Length of the payload in bytes
+/// @return True if queued, false if the queue was full and the frame was dropped
+bool Telemetry::enqueue(uint8_t type, uint64_t timestamp, const void* payload, uint8_t length) {
+    if(_count >= TELEMETRY_QUEUE_LENGTH) {
+        _dropped++;
+        return false;
+    }
+    Slot_t* slot = &_queue[(_head + _count) % TELEMETRY_QUEUE_LENGTH];
+    slot->length = telemetryEncode(slot->data, type, _seq++, _node, timestamp, payload, length);
+    if(slot->length == 0) return false;
+    _count++;
+    return true;
+}
+
+/// @brief Queue a frame whose payload the caller writes in place, instead of building it
+///        somewhere else and having it copied in. Call commit() once the payload is written
+/// @param type 
+///        Frame type (see TELEMETRY_TYPE)
+/// @param timestamp 
+///        Time of the data in microseconds since boot
+/// @param length 
+///        Length of the payload in bytes
+/// @return Pointer to the payload in the queue, not aligned. nullptr if the queue was full
+uint8_t* Telemetry::reserve(uint8_t type, uint64_t timestamp, uint8_t length) {
+    if(_count >= TELEMETRY_QUEUE_LENGTH) {
+        _dropped++;
+        return nullptr;
+    }
+    Slot_t* slot = &_queue[(_head + _count) % TELEMETRY_QUEUE_LENGTH];
+    if(!telemetryBegin(slot->data, type, _seq++, _node, timestamp, length)) return nullptr;
+    slot->length = length;
+    _reserved = slot;
+    return slot->data + sizeof(TelemetryFrame_HEADER);
+}
+
+/// @brief Seal and queue the frame from reserve()
+void Telemetry::commit(void) {
+    if(_reserved == nullptr) return;
+    _reserved->length = telemetryEnd(_reserved->data, _reserved->length);
+    _reserved = nullptr;
+    _count++;
+}
+
+/// @brief Send a frame right away, ahead of anything in the queue
+/// @param type 
+///        Frame type (see TELEMETRY_TYPE)
+/// @param timestamp 
+///        Time of the data in microseconds since boot
+/// @param payload 
+///        Pointer to the payload
+/// @param length 
+///        Length of the payload in bytes
+void Telemetry::sendPriority(uint8_t type, uint64_t timestamp, const void* payload, uint8_t length) {
+    uint8_t frame[TELEMETRY_MAX_FRAME];
+    size_t n = telemetryEncode(frame, type, _seq++, _node, timestamp, payload, length);
+    write(frame, n);
+}
+
+/// @brief Send every queued frame
+void Telemetry::flush(void) {
+    while(_count > 0) {
+        Slot_t* slot = &_queue[_head];
+        write(slot->data, slot->length);
+        _head = (_head + 1) % TELEMETRY_QUEUE_LENGTH;
+        _count--;
+    }
+}
+
+/// @brief Write raw bytes to stdio, without newline translation
+/// @param data 
+///        Pointer to the bytes
+/// @param length 
+///        Number of bytes
+void Telemetry::write(const uint8_t* data, size_t length) {
+    for(size_t i = 0; i < length; i++) {
+        putchar_raw(data[i]);
+    }
+}
@@ -0,0 +1,40 @@
+/*
+ *  Title: Telemetry.h
+ *  Description: Sends telemetry frames over stdio, with a priority path that bypasses the queue
+ *  Author: Tinna Osk Traustadottir
+ */
+#pragma once
+#include <pico/stdlib.h>
+#include "TelemetryFrame.h"
+
+const uint8_t TELEMETRY_QUEUE_LENGTH = 8;   // Normal frames waiting to be sent
+
+class Telemetry {
+public:
+    Telemetry(uint16_t node = 0) : _node(node) {};
+
+    void setNode(uint16_t node) { _node = node; };
+    bool enqueue(uint8_t type, uint64_t timestamp, const void* payload, uint8_t length);
+    uint8_t* reserve(uint8_t type, uint64_t timestamp, uint8_t length);
+    void commit(void);
+    void sendPriority(uint8_t type, uint64_t timestamp, const void* payload, uint8_t length);
+    void flush(void);
+
+    uint32_t dropped(void) const { return _dropped; };
+
+private:
+    struct Slot_t {
+        uint8_t length;
+        uint8_t data[TELEMETRY_MAX_FRAME];
+    };
+
+    uint16_t _node;
+    uint16_t _seq = 0;
+    Slot_t _queue[TELEMETRY_QUEUE_LENGTH];
+    uint8_t _head = 0;
+    uint8_t _count = 0;
+    uint32_t _dropped = 0;
+    Slot_t* _reserved = nullptr;
+
+    void write(const uint8_t* data, size_t length);
+};
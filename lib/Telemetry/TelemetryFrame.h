@@ -0,0 +1,181 @@
+/*
+ *  Title: TelemetryFrame.h
+ *  Description: Wire format of telemetry frames, shared by the firmware and host tools
+ *  Author: Tinna Osk Traustadottir
+ */
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+const uint16_t TELEMETRY_SYNC = 0xA55A;         // First two bytes of every frame, little endian
+const uint8_t TELEMETRY_MAX_PAYLOAD = 64;       // Largest payload in bytes
+
+/// @brief Frame types
+enum TELEMETRY_TYPE : uint8_t {
+    TELEMETRY_SAMPLE = 1,   // packet_t payload
+    TELEMETRY_ALERT,        // TelemetryFrame_ALERT payload
+    TELEMETRY_RAW,          // TelemetryFrame_RAW payload, cut after the codes used
+    TELEMETRY_AQI,          // TelemetryFrame_AQI payload
+};
+
+/// @brief Sensor a TELEMETRY_RAW frame comes from, and what its codes hold
+enum TELEMETRY_RAW_SOURCE : uint8_t {
+    RAW_MCP3564R = 0,       // codes[0]: signed 24 bit NO2 conversion, gain and osr: ADC settings it was taken with
+    RAW_SEN55,              // codes[0..count): measured value words as read, SEN55_FIELD order
+    RAW_SCD30,              // codes[0..2]: CO2, temperature and humidity float bits as read
+    RAW_BME280,             // codes[0..2]: 20 bit temperature, 20 bit pressure and 16 bit humidity ADC values
+    RAW_BME280_CALIB,       // codes[0..7]: calibration registers 0x88-0x9F, 0xA1 and 0xE1-0xE7, as bytes
+    RAW_SOURCES,
+};
+
+/// @brief Measurement record sent in TELEMETRY_SAMPLE frames
+union packet_t {
+    struct {
+        float temperature;
+        float no2;
+        uint16_t humidity;
+        uint16_t co2;
+        uint16_t pm10;
+        uint16_t pm4;
+        uint16_t pm2_5;
+        uint16_t pm1;
+    };
+    uint8_t raw[20];
+} __attribute__((packed, aligned(sizeof(uint32_t))));
+
+/// @brief Write one field of a packet_t in place, for payloads that are built inside a frame
+///        buffer where the fields are not aligned. Counts fields are rounded and saturated
+/// @param payload Start of the packet_t payload
+/// @param offset offsetof() the field
+/// @param value Value of the field
+inline void packetPutFloat(uint8_t* payload, size_t offset, float value) {
+    memcpy(payload + offset, &value, sizeof(value));
+}
+
+inline void packetPutU16(uint8_t* payload, size_t offset, float value) {
+    uint16_t count = value <= 0.0f ? 0 : value >= 65535.0f ? 65535 : (uint16_t)(value + 0.5f);
+    memcpy(payload + offset, &count, sizeof(count));
+}
+
+/// @brief Header in front of every payload. Frames are
+///        header, payload, then CRC-16 of header and payload, all little endian
+struct TelemetryFrame_HEADER {
+    uint16_t sync;          // TELEMETRY_SYNC
+    uint8_t type;           // See TELEMETRY_TYPE
+    uint8_t length;         // Payload length in bytes
+    uint16_t seq;           // Frame counter, lets the receiver detect lost frames
+    uint16_t node;          // Node ID
+    uint64_t timestamp;     // Time of the data in microseconds since the node booted
+} __attribute__((packed));
+
+/// @brief Payload of TELEMETRY_ALERT frames
+struct TelemetryFrame_ALERT {
+    uint8_t metric;         // Metric index, packet order
+    uint8_t level;          // 0: cleared, 1: warning, 2: danger
+    float value;            // Value that triggered the transition
+    float threshold;        // Threshold that was crossed
+    uint32_t latency_us;    // Time from the end of the bus read to the alert being raised
+} __attribute__((packed));
+
+/// @brief Payload of TELEMETRY_AQI frames: the node's air quality index as of the frame time.
+///        Pollutants are in AQI_POLLUTANT order, PM 2.5, PM 10 and NO2. Indices are -1 and
+///        concentrations negative while there isn't enough data
+struct TelemetryFrame_AQI {
+    int16_t index;          // Overall AQI, the highest of the pollutant indices
+    int16_t indices[3];     // Per pollutant, PM from the NowCast and NO2 from the 1 hour mean
+    float nowcast[2];       // PM 2.5 and PM 10 NowCast, ug/m3
+    float daily[2];         // PM 2.5 and PM 10 rolling 24 hour means, ug/m3
+    float no2_hourly;       // NO2 mean of the last complete hour, ppm
+    uint32_t hours;         // Complete hours recorded
+} __attribute__((packed));
+
+const uint8_t TELEMETRY_RAW_CODES = 8;
+
+/// @brief Payload of TELEMETRY_RAW frames: the sensor's own codes from one read, before any
+///        scaling or calibration, so stored history can be recalibrated later. The frame
+///        timestamp is the time of the read
+struct TelemetryFrame_RAW {
+    uint8_t source;         // See TELEMETRY_RAW_SOURCE
+    uint8_t count;          // Codes used
+    uint8_t gain;           // RAW_MCP3564R: ADC gain setting, 0 otherwise
+    uint8_t osr;            // RAW_MCP3564R: oversampling ratio setting, 0 otherwise
+    int32_t codes[TELEMETRY_RAW_CODES];
+} __attribute__((packed));
+
+/// @brief Payload length of a TELEMETRY_RAW frame with count codes
+constexpr uint8_t telemetryRawLength(uint8_t count) {
+    return offsetof(TelemetryFrame_RAW, codes) + count * sizeof(int32_t);
+}
+
+const size_t TELEMETRY_MAX_FRAME = sizeof(TelemetryFrame_HEADER) + TELEMETRY_MAX_PAYLOAD + 2;
+
+/// @brief Calculate CRC-16/CCITT-FALSE checksum
+/// @param data Pointer to data to calculate checksum for
+/// @param length Length of data in bytes
+/// @return Checksum
+inline uint16_t telemetryCrc(const uint8_t* data, size_t length) {
+    uint16_t crc = 0xFFFF;
+    for(size_t i = 0; i < length; i++) {
+        crc ^= (uint16_t)data[i] << 8;
+        for(uint8_t bit = 8; bit > 0; --bit) {
+            crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : (crc << 1);
+        }
+    }
+    return crc;
+}
+
+/// @brief Write a frame header, the payload goes right after it at out + sizeof(TelemetryFrame_HEADER)
+/// @param out Buffer of at least TELEMETRY_MAX_FRAME bytes
+/// @return False if the payload is too long
+inline bool telemetryBegin(uint8_t* out, uint8_t type, uint16_t seq, uint16_t node, uint64_t timestamp, uint8_t length) {
+    if(length > TELEMETRY_MAX_PAYLOAD) return false;
+    TelemetryFrame_HEADER header;
+    header.sync = TELEMETRY_SYNC;
+    header.type = type;
+    header.length = length;
+    header.seq = seq;
+    header.node = node;
+    header.timestamp = timestamp;
+    memcpy(out, &header, sizeof(header));
+    return true;
+}
+
+/// @brief Append the CRC once the header and payload are in place
+/// @param out Frame started with telemetryBegin()
+/// @param length Length of the payload in bytes
+/// @return Length of the frame in bytes
+inline size_t telemetryEnd(uint8_t* out, uint8_t length) {
+    size_t n = sizeof(TelemetryFrame_HEADER) + length;
+    uint16_t crc = telemetryCrc(out, n);
+    out[n] = crc & 0xFF;
+    out[n + 1] = crc >> 8;
+    return n + 2;
+}
+
+/// @brief Build a frame
+/// @param out Buffer of at least TELEMETRY_MAX_FRAME bytes
+/// @return Length of the frame in bytes, 0 if the payload is too long
+inline size_t telemetryEncode(uint8_t* out, uint8_t type, uint16_t seq, uint16_t node, uint64_t timestamp,
+                              const void* payload, uint8_t length) {
+    if(!telemetryBegin(out, type, seq, node, timestamp, length)) return 0;
+    memcpy(out + sizeof(TelemetryFrame_HEADER), payload, length);
+    return telemetryEnd(out, length);
+}
+
+/// @brief Check a frame at the start of a buffer
+/// @param data Received bytes, starting at a sync word
+/// @param available Number of bytes available
+/// @param header Pointer to a header the frame header is copied into
+/// @return Frame length if a complete valid frame is present, 0 if more bytes are needed,
+///         -1 if the bytes at data are not a valid frame and the receiver should resync
+inline int telemetryDecode(const uint8_t* data, size_t available, TelemetryFrame_HEADER* header) {
+    if(available < sizeof(TelemetryFrame_HEADER)) return 0;
+    memcpy(header, data, sizeof(TelemetryFrame_HEADER));
+    if(header->sync != TELEMETRY_SYNC || header->length > TELEMETRY_MAX_PAYLOAD) return -1;
+    size_t n = sizeof(TelemetryFrame_HEADER) + header->length;
+    if(available < n + 2) return 0;
+    uint16_t crc = (uint16_t)data[n] | ((uint16_t)data[n + 1] << 8);
+    if(telemetryCrc(data, n) != crc) return -1;
+    return (int)(n + 2);
+}
@@ -0,0 +1,120 @@
+/*
+ *  Title: WindowStats.h
+ *  Description: Sliding-window mean, variance, min and max with O(1) updates
+ *  Author: Tinna Osk Traustadottir
+ */
+#pragma once
+#include <stdint.h>
+#include <math.h>
+
+/// @brief Statistics over the last WindowMs milliseconds of a stream sampled every SamplePeriodMs.
+///        All storage is sized at compile time, one float and two indices per sample in the window
+/// @tparam WindowMs Length of the window, in milliseconds
+/// @tparam SamplePeriodMs Time between samples added to the window, in milliseconds
+template<uint32_t WindowMs, uint32_t SamplePeriodMs>
+class WindowStats {
+public:
+    static_assert(WindowMs % SamplePeriodMs == 0, "Window length must be a whole number of sample periods");
+    static constexpr uint16_t SIZE = WindowMs / SamplePeriodMs;
+    static_assert(SIZE >= 2, "Window must hold at least two samples");
+
+    /// @brief Add a sample, dropping the oldest one once the window is full
+    /// @param x The sample
+    void add(float x) {
+        uint16_t slot = _seq % SIZE;
+        if(_count < SIZE) {
+            // Welford's update
+            _count++;
+            float delta = x - _mean;
+            _mean += delta / _count;
+            _m2 += delta * (x - _mean);
+        } else {
+            // Welford's update with the oldest sample replaced by the newest one
+            float old = _ring[slot];
+            float delta = x - old;
+            float mean = _mean + delta / SIZE;
+            _m2 += delta * (x - mean + old - _mean);
+            _mean = mean;
+            if(_m2 < 0.0f) _m2 = 0.0f;
+        }
+        _ring[slot] = x;
+
+        // Drop the sample that just left the window first, a full deque has no slot for the new one
+        uint32_t oldest = _seq + 1 - _count;
+        if(_min_count > 0 && _min_q[_min_head] < oldest) popFront(_min_head, _min_count);
+        if(_max_count > 0 && _max_q[_max_head] < oldest) popFront(_max_head, _max_count);
+
+        // Monotonic deques, the front always holds the current extreme
+        while(_min_count > 0 && _ring[back(_min_q, _min_head, _min_count) % SIZE] >= x) _min_count--;
+        pushBack(_min_q, _min_head, _min_count, _seq);
+        while(_max_count > 0 && _ring[back(_max_q, _max_head, _max_count) % SIZE] <= x) _max_count--;
+        pushBack(_max_q, _max_head, _max_count, _seq);
+
+        _seq++;
+    }
+
+    /// @brief Clear the window
+    void reset(void) {
+        _seq = 0;
+        _count = 0;
+        _mean = 0.0f;
+        _m2 = 0.0f;
+        _min_head = _min_count = 0;
+        _max_head = _max_count = 0;
+    }
+
+    uint16_t count(void) const { return _count; };
+    bool full(void) const { return _count == SIZE; };
+    float mean(void) const { return _mean; };
+    float variance(void) const { return (_count > 1) ? _m2 / (_count - 1) : 0.0f; };
+    float stddev(void) const { return sqrtf(variance()); };
+    float min(void) const { return (_count > 0) ? _ring[_min_q[_min_head] % SIZE] : 0.0f; };
+    float max(void) const { return (_count > 0) ? _ring[_max_q[_max_head] % SIZE] : 0.0f; };
+
+private:
+    float _ring[SIZE];
+    uint32_t _seq = 0;      // Sequence number of the next sample, its slot in _ring is _seq % SIZE
+    uint16_t _count = 0;
+    float _mean = 0.0f;
+    float _m2 = 0.0f;       // Sum of squared deviations from the mean
+
+    uint32_t _min_q[SIZE];  // Sequence numbers with increasing values
+    uint16_t _min_head = 0, _min_count = 0;
+    uint32_t _max_q[SIZE];  // Sequence numbers with decreasing values
+    uint16_t _max_head = 0, _max_count = 0;
+
+    static uint32_t back(const uint32_t* q, uint16_t head, uint16_t count) {
+        return q[(head + count - 1) % SIZE];
+    }
+    static void pushBack(uint32_t* q, uint16_t head, uint16_t& count, uint32_t seq) {
+        q[(head + count) % SIZE] = seq;
+        count++;
+    }
+    static void popFront(uint16_t& head, uint16_t& count) {
+        head = (head + 1) % SIZE;
+        count--;
+    }
+};
+
+/// @brief Reduces a stream by averaging blocks of Factor samples, used to feed long windows at a lower rate
+/// @tparam Factor Number of samples per block
+template<uint16_t Factor>
+class BlockMean {
+public:
+    /// @brief Add a sample
+    /// @param x The sample
+    /// @param out Pointer to a float where the block mean is inserted when a block completes
+    /// @return True if a block completed
+    bool add(float x, float* out) {
+        _sum += x;
+        if(++_count < Factor) return false;
+        *out = _sum / Factor;
+        _sum = 0.0f;
+        _count = 0;
+        return true;
+    }
+
+private:
+    float _sum = 0.0f;
+    uint16_t _count = 0;
+};
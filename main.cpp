@@ -7,28 +7,218 @@
 #include <stdio.h>
 #include <pico/stdlib.h>
 #include <hardware/i2c.h>
+#include <hardware/structs/systick.h>
+#include <hardware/structs/vreg_and_chip_reset.h>
+#include <hardware/watchdog.h>
 #include <SEN55.h>
 #include <SCD30.h>
+#include <BME280.h>
 #include <LMP91.h>
 #include <MCP3564R.h>
+#include <MCP3564RScan.h>
 #include <SevSeg.h>
+#include <SampleClock.h>
+#include <Resampler.h>
+#include <WindowStats.h>
+#include <AirQualityIndex.h>
+#include <FlashStore.h>
+#include <OutlierFilter.h>
+#include <Telemetry.h>
+#include <AlertEngine.h>
+#include <PowerManager.h>
+#include <AdaptiveSampler.h>
+#include <ConfigStore.h>
+#include <Pipeline.h>
+#include <BootSequence.h>
+#include <pico/unique_id.h>
+#include <pico/stdio_usb.h>
+#include <tusb.h>
 
 // Pinouts
 const uint8_t PIN_BME_SDA = 2;
 const uint8_t PIN_BME_SCL = 3;
 
+// Sampling
+const uint32_t SAMPLE_PERIOD_US = 1000000;     // Time between acquisitions, matches the SEN55 native rate
+const uint32_t JITTER_REPORT_INTERVAL = 60;     // Acquisitions between jitter reports, one minute
+const uint32_t BME280_MIN_IDLE_PERCENT = 80;    // Warn for BME280 settings that leave it idle less of its period
+const uint32_t OUTPUT_PERIOD_US = 2500000;     // Time between aligned output frames
+const uint32_t OUTPUT_DELAY_US = 2500000;      // Output lags by this much so every stream has a sample after the frame time
+const uint32_t MAX_SAMPLE_AGE_US = 5000000;    // Frames holding samples older than this are marked invalid
+
+// Boot. Devices are brought up side by side and acquisition starts with the first sensor ready,
+// the rest join as they finish. Steps that aren't ready yet are retried every BOOT_RETRY_US
+const uint32_t BOOT_RETRY_US = 50000;
+const uint32_t BOOT_TIMEOUT_US = 10000000;     // From power-up, a device still not ready then has failed
+const uint32_t USB_ENUMERATE_US = 1000000;     // A host enumerates the board within this, a charger never does
+const uint32_t USB_CONNECT_US = 5000000;       // How long an attached host gets to open the console
+
+// Low power profile for battery backed units. The MCU sleeps with unused clocks gated
+// between samples, the SEN55 fan only runs for a PM window every few minutes and the
+// SCD30 measures less often
+const bool LOW_POWER = false;
+const uint16_t SCD30_INTERVAL_S = LOW_POWER ? 30 : 2;
+const uint32_t PM_PERIOD_S = 300;              // Low power: a PM window starts this often
+const uint32_t PM_WINDOW_S = 40;               // Low power: how long the fan runs in each window
+const uint32_t PM_SETTLE_S = 10;               // Low power: readings taken this soon after the fan starts are dropped
+
+// The SEN55 VOC index needs hours of learning from a cold start. Its algorithm state is saved
+// this often and written back at boot, so the index is usable minutes after a power cycle
+const uint32_t SEN55_SAVE_INTERVAL_S = 3600;
+
+// Adaptive sampling. Each stream runs between its period bounds, in acquisitions. A fast
+// rate of change (units per second) drops it to the minimum at once, a slow rate held for
+// ADAPTIVE_HOLD_S doubles it. The SCD30 interval follows the CO2 stream and the ADC
+// oversampling ratio follows the NO2 stream
+const bool ADAPTIVE_SAMPLING = true;
+const uint32_t ADAPTIVE_HOLD_S = 120;
+const uint16_t CO2_MAX_PERIOD_S = LOW_POWER ? 120 : 30;
+const float CO2_FAST_RATE = 2.0f;               // ppm/s
+const float CO2_SLOW_RATE = 0.2f;
+const uint16_t PM_MAX_READ_PERIOD_S = 10;
+const float PM_FAST_RATE = 0.5f;                // ug/m3/s, PM 2.5
+const float PM_SLOW_RATE = 0.05f;
+const uint16_t NO2_MAX_READ_PERIOD_S = 8;
+const float NO2_FAST_RATE = 0.002f;             // ppm/s
+const float NO2_SLOW_RATE = 0.0002f;
+const uint8_t NO2_OSR_MAX = 12;                 // 40960, highest oversampling setting a longer NO2 period selects
+
+// ADC scan. The NO2 cell is always scanned, CONFIG_MCP_SCAN adds other cells and the ADC's own
+// health channels. A scan of more than the NO2 channel is read every MCP_SCAN_POLL_US between
+// ticks, the ADC only holds its latest conversion. That keeps the core awake, leave the scan to
+// the NO2 channel in the low power profile
+const uint8_t NO2_CHANNEL = SCAN_CH_0;
+const uint32_t MCP_SCAN_POLL_US = 1000;
+
+// Bus time of one read, to show what the skipped reads saved. Data ready poll and read, each
+// blocking for its execution time plus about a millisecond of transfer
+const uint32_t SEN55_READ_BUS_US = SensirionI2C::waitUs(SEN55_CMD::READ_DATA_READY) + SensirionI2C::waitUs(SEN55_CMD::READ_MEAS_VALUES) + 2000;
+const uint32_t SCD30_READ_BUS_US = SensirionI2C::waitUs(SCD30_CMD::GET_DATA_READY) + SensirionI2C::waitUs(SCD30_CMD::READ_MEASUREMENT) + 1000;
+const uint32_t MCP3564R_READ_BUS_US = 100;
+
+/// @brief Keys in the config store, in table order. New keys go at the end, renumbering
+///        or changing the meaning of a key needs a new CONFIG_VERSION
+enum CONFIG : uint8_t {
+    CONFIG_NO2_SCALE = 0,
+    CONFIG_NO2_OFFSET,
+    CONFIG_LMP91_TIA_GAIN,
+    CONFIG_LMP91_R_LOAD,
+    CONFIG_LMP91_INT_Z,
+    CONFIG_LMP91_BIAS_SIGN,
+    CONFIG_LMP91_BIAS,
+    CONFIG_MCP_GAIN,
+    CONFIG_MCP_OSR,
+    CONFIG_DISPLAY_BRIGHTNESS,
+    CONFIG_SCD30_INTERVAL,
+    CONFIG_SCD30_TEMP_OFFSET,
+    CONFIG_SCD30_ALTITUDE,
+    CONFIG_RAW_CAPTURE,
+    CONFIG_BME280_PRESET,
+    CONFIG_BME280_STANDBY,
+    CONFIG_BME280_FILTER,
+    CONFIG_BME280_COMPENSATION,
+    CONFIG_SEN55_RHT_ACC,
+    CONFIG_MCP_SCAN,
+    CONFIG_COUNT,
+};
+
+const uint16_t CONFIG_VERSION = 1;
+
+const ConfigStore_KEY CONFIG_KEYS[CONFIG_COUNT] = {
+    // -18 nA (per ppm) * 350k (TIA gain) * 1 (ADC gain) * 2.048V (ref) / 2^24 (bits), ppm per count
+    {"no2_scale",           CONFIG_TYPE::Type_float, 7.69042969e-10f},
+    {"no2_offset",          CONFIG_TYPE::Type_float, 0.0f},                             // ppm
+    {"lmp91_tia_gain",      CONFIG_TYPE::Type_int,   (float)TIA_GAIN::Gain_350k},
+    {"lmp91_r_load",        CONFIG_TYPE::Type_int,   (float)R_LOAD::Load_100},
+    {"lmp91_int_z",         CONFIG_TYPE::Type_int,   (float)INT_Z::Int_50},
+    {"lmp91_bias_sign",     CONFIG_TYPE::Type_int,   (float)BIAS_SIGN::Sign_Neg},
+    {"lmp91_bias",          CONFIG_TYPE::Type_int,   (float)BIAS::Bias_0},
+    {"mcp_gain",            CONFIG_TYPE::Type_int,   1.0f},
+    {"mcp_osr",             CONFIG_TYPE::Type_int,   9.0f},                             // 16384, at the shortest NO2 read period
+    {"display_brightness",  CONFIG_TYPE::Type_int,   5.0f},
+    {"scd30_interval",      CONFIG_TYPE::Type_int,   (float)SCD30_INTERVAL_S},          // s, shortest CO2 period
+    {"scd30_temp_offset",   CONFIG_TYPE::Type_int,   0.0f},                             // 0.01 K
+    {"scd30_altitude",      CONFIG_TYPE::Type_int,   0.0f},                             // m above sea level
+    {"raw_capture",         CONFIG_TYPE::Type_int,   0.0f},                             // 1: also send the raw codes of every read
+    {"bme280_preset",       CONFIG_TYPE::Type_int,   (float)BME280_PRESET_WEATHER},     // Oversampling, BME280_PRESET
+    {"bme280_standby",      CONFIG_TYPE::Type_int,   -1.0f},                            // BME280_STANDBY, -1: the preset's
+    {"bme280_filter",       CONFIG_TYPE::Type_int,   -1.0f},                            // BME280_FILTER, -1: the preset's
+    {"bme280_compensation", CONFIG_TYPE::Type_int,   0.0f},                             // 1: 32 bit fast path, BME280_COMPENSATION
+    {"sen55_rht_acc",       CONFIG_TYPE::Type_int,   (float)SEN55_RHT_ACC::Acc_low},    // SEN55_RHT_ACC, for how the sensor is mounted
+    {"mcp_scan",            CONFIG_TYPE::Type_int,   (float)(1u << NO2_CHANNEL)},       // Bit n scans MCP3564R_SCAN_CHANNEL n
+};
+
+// Show the overall AQI on the PM 1 display instead of PM 1
+const bool SHOW_AQI_ON_PM1_DISPLAY = false;
+
+/// @brief Metrics in each output frame, in packet order
+enum METRIC : uint8_t {
+    METRIC_TEMPERATURE = 0,
+    METRIC_NO2,
+    METRIC_HUMIDITY,
+    METRIC_CO2,
+    METRIC_PM10,
+    METRIC_PM4,
+    METRIC_PM2_5,
+    METRIC_PM1,
+    METRIC_COUNT,
+};
+
+const char* METRIC_NAMES[METRIC_COUNT] = {"Temperature", "NO2", "RH", "CO2", "PM 10", "PM 4", "PM 2.5", "PM 1"};
+
+// Where each metric goes in the packet_t payload, and whether it is sent as float or a 16 bit count
+const uint8_t METRIC_PACKET_OFFSET[METRIC_COUNT] = {
+    offsetof(packet_t, temperature), offsetof(packet_t, no2), offsetof(packet_t, humidity), offsetof(packet_t, co2),
+    offsetof(packet_t, pm10), offsetof(packet_t, pm4), offsetof(packet_t, pm2_5), offsetof(packet_t, pm1),
+};
+const bool METRIC_PACKET_FLOAT[METRIC_COUNT] = {true, true, false, false, false, false, false, false};
+
+// Aggregation windows. Longer windows are fed block means so their memory stays small
+const uint32_t OUTPUT_PERIOD_MS = OUTPUT_PERIOD_US / 1000;
+const uint32_t WINDOW_15M_PERIOD_MS = 15000;
+const uint32_t WINDOW_1H_PERIOD_MS = 60000;
+
+/// @brief 1 minute, 15 minute and 1 hour statistics for one metric
+struct MetricWindows {
+    WindowStats<60000, OUTPUT_PERIOD_MS> w1m;
+    WindowStats<900000, WINDOW_15M_PERIOD_MS> w15m;
+    WindowStats<3600000, WINDOW_1H_PERIOD_MS> w1h;
+    BlockMean<WINDOW_15M_PERIOD_MS / OUTPUT_PERIOD_MS> to15m;
+    BlockMean<WINDOW_1H_PERIOD_MS / OUTPUT_PERIOD_MS> to1h;
+
+    void add(float x) {
+        float block;
+        w1m.add(x);
+        if(to15m.add(x, &block)) w15m.add(block);
+        if(to1h.add(x, &block)) w1h.add(block);
+    }
+};
+
 // Constructors
 SEN55 sen55;
 SCD30 scd30;
-LMP91 lmp91(i2c1, 0);
+BME280 bme280(i2c1);
+uint32_t bme280_busy = 0;   // Reads skipped while a conversion was running, since the last report
+void sendBme280Calibration(void);
+LMP91 lmp91(i2c1);
 MCP3564R mcp3564r(spi1, 1);
+MCP3564RScan mcp_scan(mcp3564r);
+uint64_t mcp_scan_due = 0;                          // Next poll between ticks
+int64_t mcp_scan_sum[SCAN_CHANNEL_COUNT] = {};      // Codes taken from the rings other than NO2's, since the last report
+uint32_t mcp_scan_taken[SCAN_CHANNEL_COUNT] = {};
+SampleClock sample_clock(SAMPLE_PERIOD_US);
+Resampler resampler(OUTPUT_PERIOD_US, OUTPUT_DELAY_US);
+MetricWindows windows[METRIC_COUNT];
+AirQualityIndex aqi;
+FlashStore aqi_store(FLASHSTORE_SECTOR_AQI);
+FlashStore sen55_store(FLASHSTORE_SECTOR_SEN55);
+SEN55_STATE sen55_state;        // Tuning read or restored at boot, VOC state as last saved
+bool sen55_warm = false;        // Booted with the warm start parameter set
+bool sen55_restored = false;    // Booted with a saved VOC state
+int32_t sen55_rht_acc = -1;     // RH/T acceleration mode written to the sensor
 
-SEN55_VALUES values;
 float temp, co2, hum;
 
-uint8_t channel;
-int32_t raw_no2;
-
 #define DISPLAY_ADDRESS_1 0x70
 #define DISPLAY_ADDRESS_2 0x71
 #define DISPLAY_ADDRESS_3 0x72
@@ -41,24 +231,286 @@ SevSeg co2_display = SevSeg(i2c1, DISPLAY_ADDRESS_3);
 SevSeg pm10_display = SevSeg(i2c1, DISPLAY_ADDRESS_2);
 SevSeg pm1_display = SevSeg(i2c1, DISPLAY_ADDRESS_1);
 
-union packet_t {
-    struct {
-        float temperature;
-        float no2;
-        uint16_t humidity;
-        uint16_t co2;
-        uint16_t pm10;
-        uint16_t pm4;
-        uint16_t pm2_5;
-        uint16_t pm1;
-    };
-    uint8_t raw[20];
-} __attribute__((packed, aligned(sizeof(uint32_t))));
-
-packet_t packet;
+// Display an alert on the metric blinks, in METRIC order. Metrics without a display of their own
+// have none, PM 2.5 alerts only go out as telemetry rather than blinking the PM 10 digits
+SevSeg* metric_display[METRIC_COUNT] = {
+    &temp_display, &no2_display, nullptr, &co2_display, &pm10_display, nullptr, nullptr, &pm1_display,
+};
+
+Telemetry telemetry;
+
+void raiseAlert(uint8_t metric, ALERT_LEVEL level, float value, float threshold, uint64_t sample_time);
+AlertEngine alerts(raiseAlert);
+
+PowerManager power;
+int8_t sen55_load = power.addLoad("SEN55", POWER_SEN55_PM_MA);
+int8_t scd30_load = power.addLoad("SCD30", powerScd30Ma(SCD30_INTERVAL_S));
+int8_t analog_load = power.addLoad("NO2 front end", POWER_ANALOG_MA);
+bool sen55_pm_on = true;
+
+ConfigStore config(CONFIG_KEYS, CONFIG_COUNT, CONFIG_VERSION, FLASHSTORE_SECTOR_CONFIG_A, FLASHSTORE_SECTOR_CONFIG_B);
+void applyConfig(uint8_t key);
+
+void bootReady(uint8_t device);
+BootSequence boot(bootReady, BOOT_RETRY_US);
+bool boot_reported = false;
+
+/// @brief Boot devices, in the order they are added. Quick steps first, they share the bus
+///        with the Sensirion commands that wait out their execution time
+enum BOOT_DEVICE : uint8_t {
+    BOOT_USB = 0,
+    BOOT_MCP3564R,
+    BOOT_LMP91,
+    BOOT_BME280,
+    BOOT_DISPLAYS,
+    BOOT_SEN55,
+    BOOT_SCD30,
+    BOOT_COUNT,
+};
+
+void adaptRate(uint8_t stream, uint16_t old_period, uint16_t new_period, float rate);
+AdaptiveSampler adaptive(adaptRate, ADAPTIVE_HOLD_S);
+
+/// @brief Adaptive sampling streams, in the order they are added
+enum STREAM : uint8_t {
+    STREAM_CO2 = 0,
+    STREAM_PM,
+    STREAM_NO2,
+    STREAM_COUNT,
+};
+
+const char* STREAM_NAMES[STREAM_COUNT] = {"CO2", "PM", "NO2"};
+const uint32_t STREAM_READ_BUS_US[STREAM_COUNT] = {SCD30_READ_BUS_US, SEN55_READ_BUS_US, MCP3564R_READ_BUS_US};
+
+const char* MCP_SCAN_NAMES[SCAN_CHANNEL_COUNT] = {
+    "CH0", "CH1", "CH2", "CH3", "CH4", "CH5", "CH6", "CH7", "CH0-CH1", "CH2-CH3", "CH4-CH5", "CH6-CH7",
+    "TEMP", "AVDD", "VCM", "OFFSET",
+};
+
+/// @brief ADC oversampling setting for a NO2 read period, longer periods average over more
+///        conversions so the noise bandwidth follows the read rate. The ratio scales with the
+///        period from CONFIG_MCP_OSR's, to the nearest setting at or below it. Past 16384 the
+///        settings aren't doublings, so this goes by MCP3564R_OSR_RATIO rather than counting steps
+/// @param period 
+///        NO2 read period in acquisitions
+/// @return Ratio setting for MCP3564R::set_oversample_ratio()
+uint8_t no2OversampleRatio(uint16_t period) {
+    uint8_t base = config.getInt(CONFIG_MCP_OSR);
+    if(base >= NO2_OSR_MAX) return base;
+    uint64_t target = (uint64_t)MCP3564R_OSR_RATIO[base] * (period > 0 ? period : 1);
+    uint8_t osr = base;
+    while(osr < NO2_OSR_MAX && MCP3564R_OSR_RATIO[osr + 1] <= target) osr++;
+    return osr;
+}
+
+/// @brief BME280 settings from the config store: the preset's oversampling, and its standby time
+///        and filter unless they are set on their own
+BME280_SETTINGS bme280Settings(void) {
+    int32_t preset = config.getInt(CONFIG_BME280_PRESET);
+    BME280_SETTINGS settings = BME280_PRESETS[(preset >= 0 && preset < BME280_PRESET_COUNT) ? preset : BME280_PRESET_WEATHER];
+    if(config.getInt(CONFIG_BME280_STANDBY) >= 0) settings.standby = (BME280_STANDBY)config.getInt(CONFIG_BME280_STANDBY);
+    if(config.getInt(CONFIG_BME280_FILTER) >= 0) settings.filter = (BME280_FILTER)config.getInt(CONFIG_BME280_FILTER);
+    return settings;
+}
+
+/// @brief Cycles each BME280 compensation routine takes, counted with SysTick on the core clock.
+///        The driver is back on the configured routine afterwards
+void reportBme280Cycles(void) {
+    const BME280_RAW raw = {519888, 415148, 30000};     // Datasheet example, about 25 °C and 1007 hPa
+    const uint8_t runs = 32;
+    const char* names[4] = {"reference float", "reference fixed", "fast float", "fast fixed"};
+    uint32_t cycles[4];
+    BME280_FIXED fixed;
+
+    systick_hw->rvr = 0x00FFFFFF;
+    systick_hw->cvr = 0;
+    systick_hw->csr = M0PLUS_SYST_CSR_CLKSOURCE_BITS | M0PLUS_SYST_CSR_ENABLE_BITS;
+    for(uint8_t routine = 0; routine < 4; routine++) {
+        bme280.setCompensation(routine < 2 ? BME280_COMPENSATION::Compensation_reference : BME280_COMPENSATION::Compensation_fast);
+        uint32_t start = systick_hw->cvr;
+        for(uint8_t i = 0; i < runs; i++) {
+            if(routine % 2) bme280.compensateFixed(raw, &fixed);
+            else bme280.compensate(raw);
+        }
+        cycles[routine] = ((start - systick_hw->cvr) & 0x00FFFFFF) / runs;   // Counts down
+    }
+    systick_hw->csr = 0;
+    bme280.setCompensation((BME280_COMPENSATION)config.getInt(CONFIG_BME280_COMPENSATION));
+
+    printf("BME280 compensation cycles:");
+    for(uint8_t routine = 0; routine < 4; routine++) printf(" %s %lu,", names[routine], cycles[routine]);
+    printf(" fast path x%.1f\n", (float)cycles[0] / (float)cycles[3]);
+}
+
+/// @brief Oldest sample the resampler accepts on a channel read every longest_s at most
+uint32_t maxAgeUs(uint32_t longest_s) {
+    return (2 * longest_s * 1000000 > MAX_SAMPLE_AGE_US) ? 2 * longest_s * 1000000 : MAX_SAMPLE_AGE_US;
+}
+
+/// @brief USB console: done once a terminal has opened it. Without a host the board is never
+///        enumerated and there is nothing to wait for
+BOOT_STEP bootUsb(void) {
+    if(stdio_usb_connected()) return BOOT_STEP::Step_done;
+    if(!tud_mounted() && time_us_64() > USB_ENUMERATE_US) return BOOT_STEP::Step_failed;
+    return BOOT_STEP::Step_retry;
+}
+
+BOOT_STEP bootMcp3564r(void) {
+    mcp3564r.init();
+    // CONFIG0 and CONFIG3 are fully specified so they are written without reading them first
+    bool ok = mcp3564r.configure(MCP3564R_FIELD::VREF_SEL(false), MCP3564R_FIELD::CONFIG(true), MCP3564R_FIELD::CLK_SEL(2),
+                       MCP3564R_FIELD::CS_SEL(0), MCP3564R_FIELD::ADC_MODE(3),
+                       MCP3564R_FIELD::CONV_MODE(3), MCP3564R_FIELD::DATA_FORMAT(3), MCP3564R_FIELD::CRC_FORMAT(false),
+                       MCP3564R_FIELD::EN_CRCCOM(false), MCP3564R_FIELD::EN_OFFCAL(false), MCP3564R_FIELD::EN_GAINCAL(false));
+    return ok ? BOOT_STEP::Step_done : BOOT_STEP::Step_retry;
+}
+
+BOOT_STEP bootLmp91(void) {
+    return lmp91.init() ? BOOT_STEP::Step_done : BOOT_STEP::Step_retry;
+}
+
+BOOT_STEP bootBme280Reset(void) {
+    bme280.reset();
+    return BOOT_STEP::Step_done;
+}
+
+BOOT_STEP bootBme280(void) {
+    return bme280.setup(bme280Settings()) ? BOOT_STEP::Step_done : BOOT_STEP::Step_retry;
+}
+
+BOOT_STEP bootDisplays(void) {
+    temp_display.begin();
+    no2_display.begin();
+    co2_display.begin();
+    pm10_display.begin();
+    pm1_display.begin();
+    return BOOT_STEP::Step_done;
+}
+
+/// @brief The Sensirion resets only send the command, the next one waits out the reset time
+BOOT_STEP bootSen55Reset(void) {
+    sen55.reset();
+    return BOOT_STEP::Step_done;
+}
+
+/// @brief Parameters that can only be written in idle mode, between the reset and the start of
+///        measurement: warm start, RH/T acceleration and the saved gas algorithm state and tuning.
+///        Without a saved state the sensor's tuning is read for the first save
+BOOT_STEP bootSen55(void) {
+    // A reboot by the watchdog or the RUN pin leaves the SEN55 powered and warm, only a power-on
+    // reset means it starts cold
+    sen55_warm = watchdog_caused_reboot() ||
+                 (vreg_and_chip_reset_hw->chip_reset & VREG_AND_CHIP_RESET_CHIP_RESET_HAD_RUN_BITS);
+    sen55_rht_acc = config.getInt(CONFIG_SEN55_RHT_ACC);
+    bool ok = sen55.setWarmStart(sen55_warm ? SEN55_WARM_START : SEN55_COLD_START);
+    ok = ok && sen55.setRhtAcceleration((SEN55_RHT_ACC)sen55_rht_acc);
+
+    const SEN55_STATE* saved = (const SEN55_STATE*)sen55_store.load(SEN55_STATE_TAG, SEN55_STATE_VERSION, sizeof(SEN55_STATE));
+    sen55_restored = saved != nullptr;
+    if(saved != nullptr) {
+        sen55_state = *saved;
+        ok = ok && sen55.restore(saved);
+    } else {
+        ok = ok && sen55.getVocTuning(&sen55_state.voc_tuning) && sen55.getNoxTuning(&sen55_state.nox_tuning);
+    }
+
+    ok = ok && sen55.startMeasurement();
+    return ok ? BOOT_STEP::Step_done : BOOT_STEP::Step_retry;
+}
+
+/// @brief Save the SEN55 VOC algorithm state, with the tuning from boot, if it has changed.
+///        The state can be read while measuring
+void saveSen55State(void) {
+    if(!sen55.getVocState(sen55_state.voc_state)) {
+        printf("Failed to read SEN55 VOC state\n");
+        return;
+    }
+    const void* saved = sen55_store.load(SEN55_STATE_TAG, SEN55_STATE_VERSION, sizeof(SEN55_STATE));
+    if(saved != nullptr && memcmp(saved, &sen55_state, sizeof(SEN55_STATE)) == 0) return;
+    if(!sen55_store.save(SEN55_STATE_TAG, SEN55_STATE_VERSION, &sen55_state, sizeof(SEN55_STATE))) {
+        printf("Failed to save SEN55 state\n");
+    }
+}
+
+BOOT_STEP bootScd30Reset(void) {
+    scd30.reset();
+    return BOOT_STEP::Step_done;
+}
+
+BOOT_STEP bootScd30(void) {
+    return scd30.start() ? BOOT_STEP::Step_done : BOOT_STEP::Step_retry;
+}
+
+/// @brief Device a config key is applied to, -1 for keys only read where they are used
+int8_t configDevice(uint8_t key) {
+    switch(key) {
+        case CONFIG_LMP91_TIA_GAIN:
+        case CONFIG_LMP91_R_LOAD:
+        case CONFIG_LMP91_INT_Z:
+        case CONFIG_LMP91_BIAS_SIGN:
+        case CONFIG_LMP91_BIAS:          return BOOT_LMP91;
+        case CONFIG_MCP_GAIN:
+        case CONFIG_MCP_OSR:
+        case CONFIG_MCP_SCAN:            return BOOT_MCP3564R;
+        case CONFIG_DISPLAY_BRIGHTNESS:  return BOOT_DISPLAYS;
+        case CONFIG_SCD30_INTERVAL:
+        case CONFIG_SCD30_TEMP_OFFSET:
+        case CONFIG_SCD30_ALTITUDE:      return BOOT_SCD30;
+        case CONFIG_SEN55_RHT_ACC:       return BOOT_SEN55;
+        case CONFIG_RAW_CAPTURE:                // Sends the BME280 calibration registers
+        case CONFIG_BME280_PRESET:
+        case CONFIG_BME280_STANDBY:
+        case CONFIG_BME280_FILTER:
+        case CONFIG_BME280_COMPENSATION: return BOOT_BME280;
+        default:                         return -1;
+    }
+}
+
+/// @brief Boot callback, a device is up: apply its config keys
+void bootReady(uint8_t device) {
+    for(uint8_t key = 0; key < CONFIG_COUNT; key++) {
+        if(configDevice(key) == device) applyConfig(key);
+    }
+}
+
+/// @brief Boot report: when each device was ready and when each sensor gave its first sample,
+///        from power-up. Printed once boot is over, by then a host has had the console open
+void reportBoot(void) {
+    printf("Boot:\n");
+    for(uint8_t i = 0; i < boot.devices(); i++) {
+        const BootSequence_DEVICE* d = boot.device(i);
+        if(d->state != BOOT_STATE::State_ready) {
+            printf("  %s: failed after %u steps\n", d->name, d->attempts);
+        } else if(d->sensor) {
+            printf("  %s: ready at %llu ms, first sample at %llu ms, %u steps\n",
+                d->name, d->ready_us / 1000, d->first_sample_us / 1000, d->attempts);
+        } else {
+            printf("  %s: ready at %llu ms, %u steps\n", d->name, d->ready_us / 1000, d->attempts);
+        }
+    }
+    if(boot.ready(BOOT_SEN55)) {
+        printf("SEN55: %s start, VOC state %s\n", sen55_warm ? "warm" : "cold",
+            sen55_restored ? "restored" : "learning from scratch");
+    }
+    if(boot.ready(BOOT_BME280)) reportBme280Cycles();
+}
 
 void init() {
     stdio_init_all();
+
+    if(!config.load()) {
+        printf("No stored configuration, using defaults\n");
+    }
+    uint16_t scd30_interval = config.getInt(CONFIG_SCD30_INTERVAL);
+    uint16_t co2_max_period = (scd30_interval > CO2_MAX_PERIOD_S) ? scd30_interval : CO2_MAX_PERIOD_S;
+    adaptive.addStream(scd30_interval, co2_max_period, CO2_FAST_RATE, CO2_SLOW_RATE);    // STREAM_CO2
+    adaptive.addStream(1, PM_MAX_READ_PERIOD_S, PM_FAST_RATE, PM_SLOW_RATE);            // STREAM_PM
+    adaptive.addStream(1, NO2_MAX_READ_PERIOD_S, NO2_FAST_RATE, NO2_SLOW_RATE);         // STREAM_NO2
+
+    pico_unique_board_id_t board_id;
+    pico_get_unique_board_id(&board_id);
+    telemetry.setNode(telemetryCrc(board_id.id, sizeof(board_id.id)));
+
     i2c_init(i2c1, 400000);
     spi_init(spi1, 10000000u);
     spi_set_format(spi1, 8, spi_cpol_t::SPI_CPOL_0, spi_cpha_t::SPI_CPHA_0, spi_order_t::SPI_MSB_FIRST);
@@ -70,112 +522,626 @@ void init() {
     sen55 = SEN55(i2c1);
     scd30 = SCD30(i2c1);
 
-    sleep_ms(5000);
-    
-    printf("Initializing SEN55... ");
-    if(!sen55.init()) {
-        printf("Failed to initialize!\n");
-        while(true); // Stop here
-    } else {
-        printf("Initialized.\n");
+    // Calibration and settings from the config store are applied to each device as it finishes
+    // booting, and after that the same way as runtime changes
+    config.onChange(applyConfig);
+
+    // SCD30 drifts slowly, interpolate it when the sample after each frame time arrives within
+    // OUTPUT_DELAY_US. Adaptive sampling stretches its period up to co2_max_period, far past a
+    // delay that has to stay under RESAMPLER_BINS - 1 output periods. Linear would fall back to
+    // the held sample on most frames there, so hold it outright. SEN55 updates every second and
+    // the ADC converts continuously, average those over each output period
+    uint32_t scd30_period_s = ADAPTIVE_SAMPLING ? co2_max_period : scd30_interval;
+    uint32_t scd30_max_age_us = maxAgeUs(scd30_period_s);
+    RESAMPLE_MODE scd30_mode = (scd30_period_s * 1000000ull <= OUTPUT_DELAY_US) ? RESAMPLE_MODE::Linear : RESAMPLE_MODE::Sample_hold;
+    uint32_t pm_max_age_us = LOW_POWER ? PM_PERIOD_S * 1000000 : maxAgeUs(ADAPTIVE_SAMPLING ? PM_MAX_READ_PERIOD_S : 1);
+    uint32_t no2_max_age_us = maxAgeUs(ADAPTIVE_SAMPLING ? NO2_MAX_READ_PERIOD_S : 1);
+    resampler.addChannel(scd30_mode, scd30_max_age_us);               // METRIC_TEMPERATURE
+    resampler.addChannel(RESAMPLE_MODE::Average, no2_max_age_us);     // METRIC_NO2
+    resampler.addChannel(scd30_mode, scd30_max_age_us);               // METRIC_HUMIDITY
+    resampler.addChannel(scd30_mode, scd30_max_age_us);               // METRIC_CO2
+    resampler.addChannel(RESAMPLE_MODE::Average, pm_max_age_us);      // METRIC_PM10
+    resampler.addChannel(RESAMPLE_MODE::Average, pm_max_age_us);      // METRIC_PM4
+    resampler.addChannel(RESAMPLE_MODE::Average, pm_max_age_us);      // METRIC_PM2_5
+    resampler.addChannel(RESAMPLE_MODE::Average, pm_max_age_us);      // METRIC_PM1
+    resampler.start(time_us_64());
+
+    if(LOW_POWER) {
+        power.enableClockGating(true);
+    }
+
+    // Thresholds: CO2 in ppm, NO2 in ppm (AQI 101 and 151 breakpoints), PM 2.5 in ug/m3 (AQI 101 and 151)
+    alerts.addRule(METRIC_CO2, 1500.0f, 2500.0f, 100.0f);
+    alerts.addRule(METRIC_NO2, 0.101f, 0.361f, 0.01f);
+    alerts.addRule(METRIC_PM2_5, 35.5f, 55.5f, 2.0f);
+
+    const AQI_STATE* saved = (const AQI_STATE*)aqi_store.load(AQI_STATE_TAG, AQI_STATE_VERSION, sizeof(AQI_STATE));
+    if(saved != nullptr) {
+        aqi.restore(saved);
+        printf("AQI restored, %lu hours recorded\n", saved->hours);
     }
 
-        printf("Initializing SCD30... ");
-    if(!scd30.init()) {
-        printf("Failed to initialize!\n");
+    // Power-up and reset times overlap, acquisition starts as soon as one sensor can be read and
+    // the rest are stepped in the waits for the sample clock
+    boot.addDevice("USB console", nullptr, bootUsb, 0, 0, USB_CONNECT_US, false);              // BOOT_USB
+    boot.addDevice("MCP3564R", nullptr, bootMcp3564r, 0, 0, BOOT_TIMEOUT_US);                     // BOOT_MCP3564R
+    boot.addDevice("LMP91", nullptr, bootLmp91, LMP91_STARTUP_MS * 1000, 0, BOOT_TIMEOUT_US, false);  // BOOT_LMP91
+    boot.addDevice("BME280", bootBme280Reset, bootBme280, BME280_STARTUP_MS * 1000,
+                   BME280_STARTUP_MS * 1000, BOOT_TIMEOUT_US);                                  // BOOT_BME280
+    boot.addDevice("Displays", nullptr, bootDisplays, 0, 0, BOOT_TIMEOUT_US, false);           // BOOT_DISPLAYS
+    boot.addDevice("SEN55", bootSen55Reset, bootSen55, SEN55_POWER_UP_MS * 1000,
+                   SensirionI2C::waitUs(SEN55_CMD::RESET), BOOT_TIMEOUT_US);                    // BOOT_SEN55
+    boot.addDevice("SCD30", bootScd30Reset, bootScd30, SCD30_BOOT_MS * 1000,
+                   SensirionI2C::waitUs(SCD30_CMD::SOFT_RESET), BOOT_TIMEOUT_US);               // BOOT_SCD30
+    while(!boot.sensorReady() && !boot.settled()) {
+        power.beginSleep();
+        sleep_until(from_us_since_boot(boot.nextDue()));
+        power.endSleep();
+        boot.poll(time_us_64());
+    }
+
+    if(!sample_clock.start()) {
+        printf("Failed to start sample clock!\n");
         while(true); // Stop here
-    } else {
-        printf("Initialized.\n");
     }
+}
 
-    //LMP91000
-    lmp91.init();
-    lmp91.set_REF_SOURCE(REF_SOURCE::Source_external);
-    lmp91.set_R_LOAD(R_LOAD::Load_100);
-    lmp91.set_TIA_GAIN(TIA_GAIN::Gain_350k);
-    lmp91.set_OP_MODE(OP_MODE::Mode_3_Lead_Amperpmetric);
-    printf("LMP Initialized\n");
+/// @brief Apply one config key to the hardware. Called for every key at boot and for each
+///        key changed from the console
+/// @param key 
+///        The key
+void applyConfig(uint8_t key) {
+    int8_t device = configDevice(key);
+    if(device >= 0 && !boot.ready(device)) return;  // bootReady() applies it
+    int32_t value = config.getInt(key);
+    bool ok = true;
+    switch(key) {
+        case CONFIG_LMP91_TIA_GAIN:
+        case CONFIG_LMP91_R_LOAD:
+        case CONFIG_LMP91_INT_Z:
+        case CONFIG_LMP91_BIAS_SIGN:
+        case CONFIG_LMP91_BIAS:
+            // Every LMP91 register is fully specified, three writes and no reads
+            ok = lmp91.configure((TIA_GAIN)config.getInt(CONFIG_LMP91_TIA_GAIN), (R_LOAD)config.getInt(CONFIG_LMP91_R_LOAD),
+                                 REF_SOURCE::Source_external, (INT_Z)config.getInt(CONFIG_LMP91_INT_Z),
+                                 (BIAS_SIGN)config.getInt(CONFIG_LMP91_BIAS_SIGN), (BIAS)config.getInt(CONFIG_LMP91_BIAS),
+                                 FET_SHORT::Short_Disabled, OP_MODE::Mode_3_Lead_Amperpmetric);
+            break;
+        case CONFIG_MCP_GAIN:        ok = mcp3564r.set_adc_gain(value); break;
+        case CONFIG_MCP_OSR:         ok = mcp3564r.set_oversample_ratio(no2OversampleRatio(adaptive.period(STREAM_NO2))); break;
+        case CONFIG_MCP_SCAN:
+            // One SCAN write, the rings and rates start over
+            ok = mcp_scan.start((uint16_t)value | (1u << NO2_CHANNEL));
+            memset(mcp_scan_sum, 0, sizeof(mcp_scan_sum));
+            memset(mcp_scan_taken, 0, sizeof(mcp_scan_taken));
+            break;
+        case CONFIG_DISPLAY_BRIGHTNESS:
+            temp_display.setBrightness(value);
+            no2_display.setBrightness(value);
+            co2_display.setBrightness(value);
+            pm10_display.setBrightness(value);
+            pm1_display.setBrightness(value);
+            break;
+        case CONFIG_SCD30_INTERVAL:
+            // Under adaptive sampling this only lasts until the next CO2 transition, the new
+            // lower bound takes effect after a reboot
+            ok = scd30.setMeasurementInterval(value);
+            power.setLoad(scd30_load, powerScd30Ma(value));
+            break;
+        case CONFIG_SCD30_TEMP_OFFSET:
+            // Offsets live in the SCD30's own memory, only write them when they differ
+            if(scd30.getTemperatureOffset() != value) ok = scd30.setTemperatureOffset(value);
+            break;
+        case CONFIG_SCD30_ALTITUDE:
+            if(scd30.getAltitudeOffset() != value) ok = scd30.setAltitudeOffset(value);
+            break;
+        case CONFIG_RAW_CAPTURE:
+            // Every capture starts with the registers, the host can't compensate the codes without them
+            if(value) sendBme280Calibration();
+            break;
+        case CONFIG_BME280_COMPENSATION:
+            bme280.setCompensation((BME280_COMPENSATION)value);
+            break;
+        case CONFIG_SEN55_RHT_ACC:
+            // Idle mode only. Stopping restarts the VOC algorithm, its state is carried across
+            if(value != sen55_rht_acc) {
+                ok = sen55.getVocState(sen55_state.voc_state) && sen55.stopMeasurement() &&
+                     sen55.setRhtAcceleration((SEN55_RHT_ACC)value) && sen55.setVocState(sen55_state.voc_state) &&
+                     (sen55_pm_on ? sen55.startMeasurement() : sen55.startMeasurementRHT());
+                if(ok) sen55_rht_acc = value;
+            }
+            break;
+        case CONFIG_BME280_PRESET:
+        case CONFIG_BME280_STANDBY:
+        case CONFIG_BME280_FILTER: {
+            BME280_SETTINGS settings = bme280Settings();
+            ok = bme280.configure(settings);
+            if(ok) {
+                // Reads are a tick apart, a longer output period repeats results. A read landing
+                // in a measurement is skipped and that tick has no sample, the share of ticks
+                // that lose theirs is the measurement's share of the period
+                uint32_t period_us = bme280PeriodUs(settings);
+                uint32_t idle = (uint32_t)(100ull * bme280StandbyUs(settings) / period_us);
+                printf("BME280: measurement %lu us max, result every %lu us, idle %lu%%\n",
+                    bme280MeasurementTimeUs(settings), period_us, idle);
+                if(period_us > SAMPLE_PERIOD_US) printf("BME280 is slower than the sample clock\n");
+                if(idle < BME280_MIN_IDLE_PERCENT) {
+                    printf("BME280 standby is too short, %lu%% of reads find a conversion running\n", 100 - idle);
+                }
+            }
+            break;
+        }
+        default:
+            break;  // Read where they are used
+    }
+    if(!ok) {
+        printf("Failed to apply %s\n", CONFIG_KEYS[key].name);
+    }
+}
 
-    //MCP3564R
-    mcp3564r.init();
-    mcp3564r.set_clock_source(2);
-    mcp3564r.select_vref_source(false);
-    mcp3564r.set_data_format(3);
-    mcp3564r.enable_scan_channel(0);
-    mcp3564r.set_adc_gain(1);
-    mcp3564r.set_oversample_ratio(9);
-    mcp3564r.set_conv_mode(3);
-    mcp3564r.set_adc_mode(3);
-    printf("MCP initialized\n");
+/// @brief Alert callback, blinks the metric's display and sends a priority frame
+void raiseAlert(uint8_t metric, ALERT_LEVEL level, float value, float threshold, uint64_t sample_time) {
+    if(metric_display[metric] != nullptr && boot.ready(BOOT_DISPLAYS)) {
+        switch(level) {
+            case ALERT_LEVEL::Level_danger:  metric_display[metric]->blinkRate(BLINK_RATE::Blink_2hz); break;
+            case ALERT_LEVEL::Level_warning: metric_display[metric]->blinkRate(BLINK_RATE::Blink_halfhz); break;
+            default:                         metric_display[metric]->blinkRate(BLINK_RATE::Blink_off); break;
+        }
+    }
 
-    temp_display.begin();
-    no2_display.begin();
-    co2_display.begin();
-    pm10_display.begin();
-    pm1_display.begin();
-    
-    temp_display.setBrightness(5);
-    no2_display.setBrightness(5);
-    co2_display.setBrightness(5);
-    pm10_display.setBrightness(5);
-    pm1_display.setBrightness(5);
-    printf("Displays initialized\n");
+    TelemetryFrame_ALERT alert;
+    alert.metric = metric;
+    alert.level = (uint8_t)level;
+    alert.value = value;
+    alert.threshold = threshold;
+    alert.latency_us = (uint32_t)(time_us_64() - sample_time);
+    telemetry.sendPriority(TELEMETRY_ALERT, sample_time, &alert, sizeof(alert));
 }
 
-void loop() {
-    mcp3564r.read_data(&raw_no2, &channel);
-    if(sen55.read(&values)) {
-    printf("SEN55: \n");
-    printf("PM 1: %f\n", values.pm1);
-    printf("PM 2.5: %f\n", values.pm2_5);
-    printf("PM 4: %f\n", values.pm4);
-    printf("PM 10: %f\n", values.pm10);
-    printf("RH %: %f\n", values.RH);
-    printf("Temperature: %f\n", values.temp);
-    } else {
-        printf("Failed to read from SEN55\n");
+/// @brief Adaptive sampling callback, logs the transition and applies it to the sensor
+void adaptRate(uint8_t stream, uint16_t old_period, uint16_t new_period, float rate) {
+    printf("Adaptive: %s period %u -> %u s at %f per s\n", STREAM_NAMES[stream], old_period, new_period, rate);
+    if(stream == STREAM_CO2) {
+        if(!scd30.setMeasurementInterval(new_period)) {
+            printf("Failed to set SCD30 interval\n");
+        }
+        power.setLoad(scd30_load, powerScd30Ma(new_period));
+    } else if(stream == STREAM_NO2) {
+        if(!mcp3564r.set_oversample_ratio(no2OversampleRatio(new_period))) {
+            printf("Failed to set MCP3564R oversampling\n");
+        }
     }
-    if (scd30.read()) {
-        printf("SCD30: \n");
-        printf("CO2: %f\n", scd30.co2);
-        printf("RH: %f\n", scd30.hum);
-        printf("Temperature: %f\n", scd30.temp);
-    } else {
-        printf("Failed to read from SCD30\n");
+}
+
+void reportStats() {
+    SampleClock_STATS stats;
+    sample_clock.getStats(&stats);
+    printf("Sample clock: %lu samples, %lu overruns, lateness min %ld us, max %ld us, mean %.1f us, stddev %.1f us\n",
+        stats.ticks, stats.overruns, stats.min_us, stats.max_us, stats.mean_us, stats.stddev_us);
+    sample_clock.resetStats();
+
+    AlertEngine_STATS alert_stats;
+    alerts.getStats(&alert_stats);
+    printf("Alerts: %lu raised, %lu over %lu us, latency max %lu us, mean %lu us\n",
+        alert_stats.alerts, alert_stats.late, ALERT_LATENCY_TARGET_US, alert_stats.max_us, alert_stats.mean_us);
+    alerts.resetStats();
+
+    if(boot.ready(BOOT_MCP3564R)) {
+        MCP3564RScan_STATS scan_stats;
+        mcp_scan.getStats(&scan_stats);
+        printf("MCP3564R scan: %lu polls, %lu empty, %lu conversions missed, %lu overwritten\n",
+            scan_stats.polls, scan_stats.empty, scan_stats.missed, scan_stats.overwritten);
+        for(uint8_t i = 0; i < SCAN_CHANNEL_COUNT; i++) {
+            if(!(mcp_scan.channels() & (1u << i))) continue;
+            printf("  %s: %lu samples, %.2f Hz", MCP_SCAN_NAMES[i], scan_stats.samples[i], scan_stats.rate_hz[i]);
+            if(mcp_scan_taken[i] > 0) printf(", mean code %lld", mcp_scan_sum[i] / mcp_scan_taken[i]);
+            printf("\n");
+        }
+        mcp_scan.resetStats();
+        memset(mcp_scan_sum, 0, sizeof(mcp_scan_sum));
+        memset(mcp_scan_taken, 0, sizeof(mcp_scan_taken));
+    }
+
+    if(boot.ready(BOOT_BME280)) {
+        printf("BME280: %lu reads skipped while measuring (%lu us max per measurement)\n",
+            bme280_busy, bme280.measurementTimeUs());
+        bme280_busy = 0;
     }
 
-    // -18 nA (per ppm) * 350k (TIA gain) * 1 (ADC gain) * 2.048V (ref) / 2^24 (bits)
-    float no2_ppm = ((float)raw_no2) * 7.69042969e-10f;
-    printf("NO2: %f\n", no2_ppm);
+    PowerManager_BUDGET budget;
+    power.getBudget(&budget);
+    printf("Power: active %llu ms, sleep %llu ms, %f mJ per sample, average %f mA\n",
+        budget.active_us / 1000, budget.sleep_us / 1000, budget.energy_per_sample_mj, budget.average_ma);
+    for(uint8_t i = 0; i < power.loads(); i++) {
+        printf("  %s: %f mC\n", power.load(i)->name, power.load(i)->charge_mc);
+    }
+    power.resetBudget();
+
+    if(ADAPTIVE_SAMPLING) {
+        for(uint8_t i = 0; i < STREAM_COUNT; i++) {
+            AdaptiveSampler_STATS adaptive_stats;
+            adaptive.getStats(i, &adaptive_stats);
+            printf("Adaptive %s: period %u s, rate %f per s, %lu reads, %lu skipped (%lu ms bus time saved), %lu transitions\n",
+                STREAM_NAMES[i], adaptive_stats.period, adaptive_stats.rate, adaptive_stats.reads, adaptive_stats.skipped,
+                adaptive_stats.skipped * STREAM_READ_BUS_US[i] / 1000, adaptive_stats.transitions);
+        }
+        adaptive.resetStats();
+    }
+}
+
+/// @brief Low power profile: run the SEN55 fan for PM_WINDOW_S out of every PM_PERIOD_S
+///        and keep it in RHT/gas only mode the rest of the time
+/// @param tick 
+///        Number of acquisitions since boot, one per second
+void scheduleSen55(uint32_t tick) {
+    uint32_t phase = tick % PM_PERIOD_S;
+    if(phase == 0 && !sen55_pm_on) {
+        if(sen55.startMeasurement()) {
+            sen55_pm_on = true;
+            power.setLoad(sen55_load, POWER_SEN55_PM_MA);
+        }
+    } else if(phase == PM_WINDOW_S && sen55_pm_on) {
+        if(sen55.startMeasurementRHT()) {
+            sen55_pm_on = false;
+            power.setLoad(sen55_load, POWER_SEN55_RHT_MA);
+        }
+    }
+}
+
+/// @brief What the common pipeline stages reach outside their node
+struct PipelineContext {
+    Resampler& resampler;
+    AlertEngine& alerts;
+    AdaptiveSampler& adaptive;
+    bool adaptive_sampling;
+};
+
+PipelineContext pipeline_context = {resampler, alerts, adaptive, ADAPTIVE_SAMPLING};
+
+/// @brief Raw capture: send the codes of a read as a TELEMETRY_RAW frame, so the stored history can
+///        be recalibrated on the host when the calibration changes
+/// @param source 
+///        Sensor the codes come from
+/// @param codes 
+///        The codes, as TELEMETRY_RAW_SOURCE describes them for the source
+/// @param count 
+///        Number of codes
+/// @param timestamp 
+///        Time of the read
+void sendRaw(TELEMETRY_RAW_SOURCE source, const int32_t* codes, uint8_t count, uint64_t timestamp) {
+    TelemetryFrame_RAW raw = {};
+    raw.source = source;
+    raw.count = count;
+    if(source == RAW_MCP3564R) {
+        raw.gain = config.getInt(CONFIG_MCP_GAIN);
+        raw.osr = no2OversampleRatio(adaptive.period(STREAM_NO2));
+    }
+    memcpy(raw.codes, codes, count * sizeof(int32_t));
+    telemetry.enqueue(TELEMETRY_RAW, timestamp, &raw, telemetryRawLength(count));
+}
+
+/// @brief Send the BME280 calibration registers as a RAW_BME280_CALIB frame, the host needs them
+///        to compensate RAW_BME280 codes
+void sendBme280Calibration(void) {
+    int32_t codes[BME280_CALIB_BYTES / sizeof(int32_t)];
+    memcpy(codes, bme280.calibration(), BME280_CALIB_BYTES);
+    sendRaw(RAW_BME280_CALIB, codes, BME280_CALIB_BYTES / sizeof(int32_t), time_us_64());
+}
+
+/// @brief Send the raw codes of every read when raw capture is on. Goes right after the acquire
+///        stage, which leaves the codes in raw[]
+template<TELEMETRY_RAW_SOURCE Source>
+struct RawCaptureSink {
+    template<typename Sample>
+    bool process(Sample& sample, PipelineContext&) {
+        if(config.getInt(CONFIG_RAW_CAPTURE)) sendRaw(Source, sample.raw, Sample::channels, sample.timestamp);
+        return true;
+    }
+};
+
+/// @brief Stop the chain until the node's device has booted
+template<uint8_t Device>
+struct BootGate {
+    template<typename Sample>
+    bool process(Sample&, PipelineContext&) {
+        return boot.ready(Device);
+    }
+};
+
+/// @brief Give the boot report the time of the device's first sample. Goes right after acquire
+template<uint8_t Device>
+struct BootSample {
+    template<typename Sample>
+    bool process(Sample& sample, PipelineContext&) {
+        boot.sampled(Device, sample.timestamp);
+        return true;
+    }
+};
+
+/// @brief Mean of the NO2 conversions scanned since the last read into raw[0], timestamped with
+///        the newest. With only the NO2 channel scanned that is the one conversion read here. If
+///        none has finished since, poll again next tick instead of a period later
+struct Mcp3564rAcquire {
+    bool process(Pipeline_SAMPLE<1>& sample, PipelineContext& context) {
+        if(!mcp_scan.poll()) {
+            printf("Failed to read from MCP3564R\n");
+            return false;
+        }
+        MCP3564R_SCAN_SAMPLE scanned;
+        int64_t sum = 0;
+        uint8_t count = 0;
+        while(mcp_scan.pop(NO2_CHANNEL, &scanned)) {
+            sum += scanned.code;
+            sample.timestamp = scanned.timestamp;
+            count++;
+        }
+        if(count == 0) {
+            if(context.adaptive_sampling) context.adaptive.retry(STREAM_NO2, sample.tick);
+            return false;
+        }
+        sample.raw[0] = sum / count;
+        return true;
+    }
+};
+
+/// @brief ADC counts to ppm with the stored calibration
+struct No2Calibrate {
+    bool process(Pipeline_SAMPLE<1>& sample, PipelineContext&) {
+        sample.values[0] = sample.values[0] * config.getFloat(CONFIG_NO2_SCALE) + config.getFloat(CONFIG_NO2_OFFSET);
+        return true;
+    }
+};
 
-    packet.temperature = scd30.temp;
-    packet.humidity = scd30.hum;
-    packet.no2 = no2_ppm;
-    packet.co2 = scd30.co2;
-    packet.pm10 = values.pm10;
-    packet.pm4 = values.pm4;
-    packet.pm2_5 = values.pm2_5;
-    packet.pm1 = values.pm1;
+/// @brief Low power profile: move the SEN55 between PM and RHT/gas mode and stop the chain while
+///        there is no settled PM data
+struct Sen55PowerGate {
+    bool process(Pipeline_SAMPLE<4>& sample, PipelineContext&) {
+        if(!LOW_POWER) return true;
+        scheduleSen55(sample.tick);
+        return sen55_pm_on && (sample.tick % PM_PERIOD_S) >= PM_SETTLE_S;
+    }
+};
+
+/// @brief Read PM 1, 2.5, 4 and 10 into values[0..3], the SEN55 decodes them in place. The words
+///        as read go to raw[0..3]
+struct Sen55Acquire {
+    bool process(Pipeline_SAMPLE<4>& sample, PipelineContext&) {
+        uint16_t words[4];
+        if(!sen55.readInto(sample.values, 4, &sample.timestamp, words)) {
+            printf("Failed to read from SEN55\n");
+            return false;
+        }
+        for(uint8_t i = 0; i < 4; i++) sample.raw[i] = words[i];
+        return true;
+    }
+};
+
+/// @brief Read CO2, temperature and humidity into values[0..2] and their float bits into raw[0..2].
+///        The SCD30 only has new data every measurement interval, if it isn't ready yet poll again
+///        next tick instead of a period later
+struct Scd30Acquire {
+    bool process(Pipeline_SAMPLE<3>& sample, PipelineContext& context) {
+        if(!scd30.dataReady()) {
+            if(context.adaptive_sampling) context.adaptive.retry(STREAM_CO2, sample.tick);
+            return false;
+        }
+        if(!scd30.readInto(sample.values, &sample.timestamp, (uint32_t*)sample.raw)) {
+            printf("Failed to read from SCD30\n");
+            return false;
+        }
+        return true;
+    }
+};
+
+/// @brief Read the BME280 ADC values into raw[0..2], in RAW_BME280 order. Normal mode converts on
+///        its own, a read that finds a conversion running is skipped instead of waiting and the
+///        tick has no environment sample. The standby time keeps that rare, see applyConfig()
+struct Bme280Acquire {
+    bool process(Pipeline_SAMPLE<3>& sample, PipelineContext&) {
+        BME280_RAW raw;
+        if(!bme280.readRaw(&raw)) {
+            if(bme280.measuring) bme280_busy++;
+            else printf("Failed to read from BME280\n");
+            return false;
+        }
+        sample.timestamp = bme280.timestamp;
+        sample.raw[0] = raw.temperature;
+        sample.raw[1] = raw.pressure;
+        sample.raw[2] = raw.humidity;
+        return true;
+    }
+};
+
+/// @brief Temperature, pressure and humidity into values[0..2] with the sensor's calibration
+struct Bme280Compensate {
+    bool process(Pipeline_SAMPLE<3>& sample, PipelineContext&) {
+        bme280.compensate({sample.raw[0], sample.raw[1], sample.raw[2]});
+        sample.values[0] = bme280.temperature;
+        sample.values[1] = bme280.pressure;
+        sample.values[2] = bme280.humidity;
+        return true;
+    }
+};
+
+// One node per sensor: gates, acquire, boot report, raw capture, decode, calibrate, then alerts on the
+// unfiltered value as they are latency critical, a Hampel filter would hold a real step back for half
+// its window. The filter (window and threshold in tenths per metric) only feeds the resampler and the
+// adaptive sampler
+typedef PipelineNode<Pipeline_SAMPLE<1>,
+    BootGate<BOOT_MCP3564R>, AdaptiveGate<STREAM_NO2>, Mcp3564rAcquire, BootSample<BOOT_MCP3564R>,
+    RawCaptureSink<RAW_MCP3564R>, DecodeStage<0>, No2Calibrate, AlertSink<0, METRIC_NO2>,
+    HampelStage<0, 9, 35>,
+    ResamplerSink<METRIC_NO2>, AdaptiveSink<0, STREAM_NO2>> No2Node;
+
+typedef PipelineNode<Pipeline_SAMPLE<4>,
+    BootGate<BOOT_SEN55>, Sen55PowerGate, AdaptiveGate<STREAM_PM>, Sen55Acquire, BootSample<BOOT_SEN55>,
+    RawCaptureSink<RAW_SEN55>, AlertSink<1, METRIC_PM2_5>,
+    HampelStage<0, 7, 30>, HampelStage<1, 7, 30>, HampelStage<2, 7, 30>, HampelStage<3, 7, 30>,
+    ResamplerSink<METRIC_PM1, METRIC_PM2_5, METRIC_PM4, METRIC_PM10>,
+    AdaptiveSink<1, STREAM_PM>> PmNode;
+
+typedef PipelineNode<Pipeline_SAMPLE<3>,
+    BootGate<BOOT_SCD30>, AdaptiveGate<STREAM_CO2>, Scd30Acquire, BootSample<BOOT_SCD30>, RawCaptureSink<RAW_SCD30>,
+    AlertSink<0, METRIC_CO2>, ResamplerSink<METRIC_CO2, METRIC_TEMPERATURE, METRIC_HUMIDITY>,
+    AdaptiveSink<0, STREAM_CO2>> Co2Node;
+
+// Not in the output frame yet, read for raw capture and the console
+typedef PipelineNode<Pipeline_SAMPLE<3>,
+    BootGate<BOOT_BME280>, Bme280Acquire, BootSample<BOOT_BME280>, RawCaptureSink<RAW_BME280>, Bme280Compensate> EnvNode;
+
+Pipeline<No2Node, PmNode, Co2Node, EnvNode> pipeline;
+
+/// @brief Aggregate an aligned frame and send the 1 minute means to the packet and the displays
+/// @param frame 
+///        The frame to publish
+void publish(const Resampler_FRAME* frame) {
+    printf("Frame at %llu us (valid 0x%02x):\n", frame->timestamp, frame->valid);
+    for(uint8_t m = 0; m < METRIC_COUNT; m++) {
+        if(frame->valid & (1u << m)) {
+            windows[m].add(frame->values[m]);
+        }
+        const MetricWindows* w = &windows[m];
+        printf("%s: 1m %f (min %f max %f sd %f) 15m %f 1h %f\n", METRIC_NAMES[m],
+            w->w1m.mean(), w->w1m.min(), w->w1m.max(), w->w1m.stddev(), w->w15m.mean(), w->w1h.mean());
+    }
+
+    if(boot.ready(BOOT_BME280)) {
+        printf("BME280: %f C, %f hPa, %f %%RH\n", bme280.temperature, bme280.pressure, bme280.humidity);
+    }
+
+    if(frame->valid & (1u << METRIC_PM2_5)) aqi.add(AQI_PM2_5, frame->values[METRIC_PM2_5], frame->timestamp);
+    if(frame->valid & (1u << METRIC_PM10)) aqi.add(AQI_PM10, frame->values[METRIC_PM10], frame->timestamp);
+    if(frame->valid & (1u << METRIC_NO2)) aqi.add(AQI_NO2, frame->values[METRIC_NO2], frame->timestamp);
+    printf("AQI: %d (PM 2.5 %d, PM 10 %d, NO2 %d) NowCast PM 2.5 %f PM 10 %f, 24h PM 2.5 %f PM 10 %f\n",
+        aqi.index(), aqi.index(AQI_PM2_5), aqi.index(AQI_PM10), aqi.index(AQI_NO2),
+        aqi.nowCast(AQI_PM2_5), aqi.nowCast(AQI_PM10), aqi.dailyMean(AQI_PM2_5), aqi.dailyMean(AQI_PM10));
+    if(aqi.hourCompleted()) {
+        if(!aqi_store.save(AQI_STATE_TAG, AQI_STATE_VERSION, aqi.state(), sizeof(AQI_STATE))) {
+            printf("Failed to save AQI state\n");
+        }
+    }
+
+    // The current index goes out with every frame, the host doesn't have to recompute it
+    static_assert(AQI_POLLUTANTS == sizeof(TelemetryFrame_AQI::indices) / sizeof(int16_t), "TELEMETRY_AQI has one index per pollutant");
+    TelemetryFrame_AQI index;
+    index.index = aqi.index();
+    for(uint8_t p = 0; p < AQI_POLLUTANTS; p++) index.indices[p] = aqi.index((AQI_POLLUTANT)p);
+    index.nowcast[0] = aqi.nowCast(AQI_PM2_5);
+    index.nowcast[1] = aqi.nowCast(AQI_PM10);
+    index.daily[0] = aqi.dailyMean(AQI_PM2_5);
+    index.daily[1] = aqi.dailyMean(AQI_PM10);
+    index.no2_hourly = aqi.hourlyMean(AQI_NO2);
+    index.hours = aqi.state()->hours;
+    uint8_t* aqi_payload = telemetry.reserve(TELEMETRY_AQI, frame->timestamp, sizeof(index));
+    if(aqi_payload != nullptr) {
+        memcpy(aqi_payload, &index, sizeof(index));
+        telemetry.commit();
+    }
+
+    float means[METRIC_COUNT];
+    for(uint8_t m = 0; m < METRIC_COUNT; m++) {
+        means[m] = windows[m].w1m.mean();
+    }
+
+    // Written straight into the queued frame, no packet_t copy
+    uint8_t* payload = telemetry.reserve(TELEMETRY_SAMPLE, frame->timestamp, sizeof(packet_t));
+    if(payload != nullptr) {
+        for(uint8_t m = 0; m < METRIC_COUNT; m++) {
+            if(METRIC_PACKET_FLOAT[m]) packetPutFloat(payload, METRIC_PACKET_OFFSET[m], means[m]);
+            else packetPutU16(payload, METRIC_PACKET_OFFSET[m], means[m]);
+        }
+        telemetry.commit();
+    }
     
+    if(!boot.ready(BOOT_DISPLAYS)) return;
     temp_display.clear();
     no2_display.clear();
     co2_display.clear();
     pm10_display.clear();
     pm1_display.clear();
 
-    temp_display.printFloat((double)packet.temperature, 1, 10);
-    no2_display.printFloat((double)packet.no2, 3, 10);
-    co2_display.printNumber(packet.co2, 10);
-    pm10_display.printNumber(packet.pm10, 10);
-    pm1_display.printNumber(packet.pm1, 10);
+    temp_display.printFloat(means[METRIC_TEMPERATURE], 1, 10);
+    no2_display.printFloat(means[METRIC_NO2], 3, 10);
+    co2_display.printNumber(means[METRIC_CO2], 10);
+    pm10_display.printNumber(means[METRIC_PM10], 10);
+    if(SHOW_AQI_ON_PM1_DISPLAY) {
+        pm1_display.printNumber(aqi.index(), 10);
+    } else {
+        pm1_display.printNumber(means[METRIC_PM1], 10);
+    }
 
     temp_display.writeDisplay();
     no2_display.writeDisplay();
     co2_display.writeDisplay();
     pm10_display.writeDisplay();
     pm1_display.writeDisplay();
-    
-    sleep_ms(2500);
+}
+
+/// @brief Whether the scan is read between ticks, a scan of only the NO2 channel is read by its node
+bool scanBetweenTicks(void) {
+    return boot.ready(BOOT_MCP3564R) && mcp_scan.channels() != (1u << NO2_CHANNEL);
+}
+
+/// @brief Read the scan once and take what it filed outside the NO2 channel, for the report.
+///        The NO2 ring waits for its node
+void pollScan(void) {
+    if(!mcp_scan.poll()) return;    // The NO2 node reports read failures
+    MCP3564R_SCAN_SAMPLE scanned;
+    for(uint8_t i = 0; i < SCAN_CHANNEL_COUNT; i++) {
+        if(i == NO2_CHANNEL) continue;
+        while(mcp_scan.pop(i, &scanned)) {
+            mcp_scan_sum[i] += scanned.code;
+            mcp_scan_taken[i]++;
+        }
+    }
+}
+
+void loop() {
+    static uint32_t samples = 0;
+
+    // Devices still booting are stepped and the scan is read while waiting for the tick
+    while(true) {
+        uint64_t tick = sample_clock.nextTick();
+        uint64_t boot_due = boot.settled() ? tick : boot.nextDue();
+        uint64_t scan_due = scanBetweenTicks() ? mcp_scan_due : tick;
+        uint64_t due = (boot_due < scan_due) ? boot_due : scan_due;
+        if(due >= tick) break;
+        power.beginSleep();
+        sleep_until(from_us_since_boot(due));
+        power.endSleep();
+        if(due == boot_due) boot.poll(time_us_64());
+        if(due == scan_due) {
+            pollScan();
+            // A late poll starts a new grid instead of catching up
+            mcp_scan_due += MCP_SCAN_POLL_US;
+            if(mcp_scan_due < time_us_64()) mcp_scan_due = time_us_64() + MCP_SCAN_POLL_US;
+        }
+    }
+    if(!boot_reported && boot.complete()) {
+        reportBoot();
+        boot_reported = true;
+    }
+
+    power.beginSleep();
+    sample_clock.wait();
+    power.endSleep();
+    power.countSample();
+    pipeline.run(pipeline_context, samples);
+
+    Resampler_FRAME frame;
+    while(resampler.next(time_us_64(), &frame)) {
+        publish(&frame);
+    }
+    telemetry.flush();
+    config.poll();
+
+    if(samples % SEN55_SAVE_INTERVAL_S == SEN55_SAVE_INTERVAL_S - 1 && boot.ready(BOOT_SEN55)) {
+        saveSen55State();
+    }
+
+    if(++samples % JITTER_REPORT_INTERVAL == 0) {
+        reportStats();
+    }
 }
 
 int main() {